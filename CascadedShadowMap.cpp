@@ -0,0 +1,232 @@
+#include "CascadedShadowMap.h"
+
+#include "Renderer.h"
+
+#include <chrono>
+#include <glm/gtc/matrix_transform.hpp>
+#include <string>
+
+CascadedShadowMap::CascadedShadowMap(unsigned int resolution, unsigned int cascadeCount)
+    : m_Resolution(resolution)
+    , m_CascadeCount(glm::clamp(cascadeCount, 1u, MaxCascades))
+    , m_StaticDepth(0)
+    , m_Depth(0)
+    , m_Framebuffer(0)
+    , m_ShadowDistance(150.0f)
+    , m_SplitLambda(0.75f)
+    , m_LightDirection(0.0f, -1.0f, 0.0f)
+    , m_SplitDepths {}
+    , m_TexelSizes {}
+    , m_StaticCenter(0.0f)
+    , m_StaticRadius(100.0f)
+    , m_StaticDirection(0.0f)
+    , m_StaticLightViewProj(1.0f)
+    , m_StaticTexelSize(0.0f)
+    , m_StaticValid(false)
+    , m_StaticRenders(0)
+    , m_TotalStaticRenders(0)
+    , m_CpuTime(0.0f) {
+
+    // A layer per cascade, and a single one for the static casters. Both are sampled with
+    // hardware depth comparison.
+    GLCall(glGenTextures(1, &m_Depth));
+    GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, m_Depth));
+    GLCall(glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, m_Resolution,
+        m_Resolution, m_CascadeCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr));
+    GLCall(glGenTextures(1, &m_StaticDepth));
+    GLCall(glBindTexture(GL_TEXTURE_2D, m_StaticDepth));
+    GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, m_Resolution, m_Resolution, 0,
+        GL_DEPTH_COMPONENT, GL_FLOAT, nullptr));
+    for (unsigned int target : { GL_TEXTURE_2D_ARRAY, GL_TEXTURE_2D }) {
+        GLCall(glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+        GLCall(glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+        GLCall(glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+        GLCall(glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+        GLCall(glTexParameteri(target, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE));
+        GLCall(glTexParameteri(target, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL));
+    }
+    GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+    GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, 0));
+
+    GLCall(glGenFramebuffers(1, &m_Framebuffer));
+}
+
+CascadedShadowMap::~CascadedShadowMap() {
+    GLCall(glDeleteFramebuffers(1, &m_Framebuffer));
+    GLCall(glDeleteTextures(1, &m_StaticDepth));
+    GLCall(glDeleteTextures(1, &m_Depth));
+}
+
+void CascadedShadowMap::InvalidateStatic() {
+    m_StaticValid = false;
+}
+
+void CascadedShadowMap::SetStaticBounds(const glm::vec3 &center, float radius) {
+    m_StaticCenter = center;
+    m_StaticRadius = glm::max(radius, 1e-3f);
+    m_StaticValid = false;
+}
+
+void CascadedShadowMap::Update(
+    const glm::mat4 &view, const glm::mat4 &proj, const glm::vec3 &lightDirection) {
+    // Recover the clip planes from the projection so any perspective matrix works
+    float nearPlane = proj[3][2] / (proj[2][2] - 1.0f);
+    float farPlane = glm::min(proj[3][2] / (proj[2][2] + 1.0f), m_ShadowDistance);
+
+    // Frustum corners at the near and far plane, view space depth is linear along each edge
+    glm::mat4 inverseViewProj = glm::inverse(proj * view);
+    glm::vec3 nearCorners[4], farCorners[4];
+    for (int i = 0; i < 4; i++) {
+        glm::vec2 ndc((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f);
+        glm::vec4 nearCorner = inverseViewProj * glm::vec4(ndc, -1.0f, 1.0f);
+        glm::vec4 farCorner = inverseViewProj * glm::vec4(ndc, 1.0f, 1.0f);
+        nearCorners[i] = glm::vec3(nearCorner) / nearCorner.w;
+        farCorners[i] = glm::vec3(farCorner) / farCorner.w;
+    }
+    float fullFar = proj[3][2] / (proj[2][2] + 1.0f);
+
+    glm::vec3 direction = glm::length(lightDirection) > 1e-4f ? glm::normalize(lightDirection)
+                                                               : glm::vec3(0.0f, -1.0f, 0.0f);
+    glm::vec3 up = glm::abs(direction.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+    m_LightDirection = direction;
+
+    float sliceNear = nearPlane;
+    for (unsigned int cascade = 0; cascade < m_CascadeCount; cascade++) {
+        // Practical split scheme, blending logarithmic and uniform distribution
+        float t = (cascade + 1) / (float) m_CascadeCount;
+        float logSplit = nearPlane * glm::pow(farPlane / nearPlane, t);
+        float uniformSplit = nearPlane + (farPlane - nearPlane) * t;
+        float sliceFar = glm::mix(uniformSplit, logSplit, m_SplitLambda);
+        m_SplitDepths[cascade] = sliceFar;
+
+        glm::vec3 corners[8];
+        glm::vec3 center(0.0f);
+        for (int i = 0; i < 4; i++) {
+            float a = (sliceNear - nearPlane) / (fullFar - nearPlane);
+            float b = (sliceFar - nearPlane) / (fullFar - nearPlane);
+            corners[i] = glm::mix(nearCorners[i], farCorners[i], a);
+            corners[i + 4] = glm::mix(nearCorners[i], farCorners[i], b);
+            center += corners[i] + corners[i + 4];
+        }
+        center /= 8.0f;
+
+        // A bounding sphere keeps the projection size constant while the camera rotates
+        float radius = 0.0f;
+        for (const glm::vec3 &corner : corners) {
+            radius = glm::max(radius, glm::length(corner - center));
+        }
+        radius = glm::ceil(radius);
+
+        glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), direction, up);
+        // Snap the center to whole shadow map texels so edges do not shimmer while the camera
+        // moves
+        float texelSize = 2.0f * radius / m_Resolution;
+        m_TexelSizes[cascade] = texelSize;
+        glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+        lightCenter.x = glm::floor(lightCenter.x / texelSize) * texelSize;
+        lightCenter.y = glm::floor(lightCenter.y / texelSize) * texelSize;
+
+        // Depth range generous enough to catch casters outside the slice
+        glm::mat4 lightProj = glm::ortho(lightCenter.x - radius, lightCenter.x + radius,
+            lightCenter.y - radius, lightCenter.y + radius, -lightCenter.z - 4.0f * radius,
+            -lightCenter.z + 4.0f * radius);
+        m_LightViewProj[cascade] = lightProj * lightView;
+
+        sliceNear = sliceFar;
+    }
+}
+
+void CascadedShadowMap::BindLayer(unsigned int texture, unsigned int cascade) const {
+    GLCall(glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer));
+    GLCall(glFramebufferTextureLayer(
+        GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, cascade));
+    GLCall(glDrawBuffer(GL_NONE));
+    GLCall(glReadBuffer(GL_NONE));
+}
+
+void CascadedShadowMap::Render(const DrawCallback &drawStatic, const DrawCallback &drawDynamic) {
+    auto start = std::chrono::high_resolution_clock::now();
+    m_Timer.Begin();
+
+    GLint previousFramebuffer = 0;
+    GLint previousViewport[4];
+    GLCall(glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer));
+    GLCall(glGetIntegerv(GL_VIEWPORT, previousViewport));
+
+    GLCall(glViewport(0, 0, m_Resolution, m_Resolution));
+    GLCall(glEnable(GL_DEPTH_TEST));
+    GLCall(glDepthMask(GL_TRUE));
+    GLCall(glEnable(GL_POLYGON_OFFSET_FILL));
+    GLCall(glPolygonOffset(2.0f, 4.0f));
+
+    // The static map only depends on the light and the static bounds, never on the camera
+    m_StaticRenders = 0;
+    if (!m_StaticValid || m_StaticDirection != m_LightDirection) {
+        glm::vec3 up = glm::abs(m_LightDirection.y) > 0.99f ? glm::vec3(0, 0, 1)
+                                                            : glm::vec3(0, 1, 0);
+        glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), m_LightDirection, up);
+        glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(m_StaticCenter, 1.0f));
+        float radius = m_StaticRadius;
+        glm::mat4 lightProj = glm::ortho(lightCenter.x - radius, lightCenter.x + radius,
+            lightCenter.y - radius, lightCenter.y + radius, -lightCenter.z - radius,
+            -lightCenter.z + radius);
+        m_StaticLightViewProj = lightProj * lightView;
+        m_StaticTexelSize = 2.0f * radius / m_Resolution;
+
+        GLCall(glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer));
+        GLCall(glFramebufferTexture2D(
+            GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_StaticDepth, 0));
+        GLCall(glDrawBuffer(GL_NONE));
+        GLCall(glReadBuffer(GL_NONE));
+        GLCall(glClear(GL_DEPTH_BUFFER_BIT));
+        drawStatic(m_StaticLightViewProj);
+
+        m_StaticDirection = m_LightDirection;
+        m_StaticValid = true;
+        m_StaticRenders++;
+        m_TotalStaticRenders++;
+    }
+
+    for (unsigned int cascade = 0; cascade < m_CascadeCount; cascade++) {
+        BindLayer(m_Depth, cascade);
+        GLCall(glClear(GL_DEPTH_BUFFER_BIT));
+        drawDynamic(m_LightViewProj[cascade]);
+    }
+
+    GLCall(glDisable(GL_POLYGON_OFFSET_FILL));
+    GLCall(glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer));
+    GLCall(glViewport(
+        previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]));
+
+    m_Timer.End();
+    m_CpuTime = std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::high_resolution_clock::now() - start)
+                    .count();
+}
+
+void CascadedShadowMap::SetUniforms(Shader &shader, unsigned int slot) const {
+    GLCall(glActiveTexture(GL_TEXTURE0 + slot));
+    GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, m_Depth));
+
+    GLCall(glActiveTexture(GL_TEXTURE0 + slot + 1));
+    GLCall(glBindTexture(GL_TEXTURE_2D, m_StaticDepth));
+
+    shader.SetUniform1i("u_ShadowMap", slot);
+    shader.SetUniform1i("u_StaticShadowMap", slot + 1);
+    shader.SetUniformMat4f("u_StaticMatrix", m_StaticLightViewProj);
+    shader.SetUniform1f("u_StaticTexelSize", m_StaticTexelSize);
+    shader.SetUniform1i("u_CascadeCount", m_CascadeCount);
+    for (unsigned int cascade = 0; cascade < m_CascadeCount; cascade++) {
+        shader.SetUniformMat4f(
+            "u_CascadeMatrices[" + std::to_string(cascade) + "]", m_LightViewProj[cascade]);
+    }
+    float splits[MaxCascades] = {};
+    float texelSizes[MaxCascades] = {};
+    for (unsigned int cascade = 0; cascade < MaxCascades; cascade++) {
+        splits[cascade] = m_SplitDepths[glm::min(cascade, m_CascadeCount - 1)];
+        texelSizes[cascade] = m_TexelSizes[glm::min(cascade, m_CascadeCount - 1)];
+    }
+    shader.SetUniform4f("u_CascadeSplits", splits[0], splits[1], splits[2], splits[3]);
+    shader.SetUniform4f("u_CascadeTexelSizes", texelSizes[0], texelSizes[1], texelSizes[2],
+        texelSizes[3]);
+}
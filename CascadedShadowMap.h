@@ -0,0 +1,100 @@
+#pragma once
+
+#include "GpuTimer.h"
+#include "Shader.h"
+
+#include <functional>
+#include <glm/glm.hpp>
+
+// Cascaded shadow maps for one directional light. Only the dynamic casters are drawn into the
+// cascades each frame, ideally with one instanced draw per cascade. Static casters (terrain,
+// floors) go into a separate map over their bounds whose light matrix does not depend on the
+// camera, so it is only re-rendered when the light direction changes, the bounds are set or
+// InvalidateStatic is called. The lookup takes the darker of the two.
+class CascadedShadowMap {
+public:
+    static const unsigned int MaxCascades = 4;
+
+    // Receives the light view-projection of the cascade being rendered
+    using DrawCallback = std::function<void(const glm::mat4 &lightViewProj)>;
+
+    CascadedShadowMap(unsigned int resolution = 2048, unsigned int cascadeCount = MaxCascades);
+    ~CascadedShadowMap();
+
+    // Fits the cascades to the camera frustum, lightDirection points from the light
+    void Update(const glm::mat4 &view, const glm::mat4 &proj, const glm::vec3 &lightDirection);
+    void Render(const DrawCallback &drawStatic, const DrawCallback &drawDynamic);
+
+    // Forces the static casters to be redrawn, e.g. after the terrain changed
+    void InvalidateStatic();
+    // World space sphere around every static caster, the static map covers it
+    void SetStaticBounds(const glm::vec3 &center, float radius);
+
+    // Binds the cascades to slot and the static map to slot + 1, and sets the uniforms used by
+    // include/Shadows.glsl
+    void SetUniforms(Shader &shader, unsigned int slot) const;
+
+    void SetShadowDistance(float distance) {
+        m_ShadowDistance = distance;
+    }
+    float GetShadowDistance() const {
+        return m_ShadowDistance;
+    }
+    void SetSplitLambda(float lambda) {
+        m_SplitLambda = lambda;
+    }
+    float GetSplitLambda() const {
+        return m_SplitLambda;
+    }
+
+    inline unsigned int GetCascadeCount() const {
+        return m_CascadeCount;
+    }
+    inline float GetSplitDepth(unsigned int cascade) const {
+        return m_SplitDepths[cascade];
+    }
+    // 1 when the last Render redrew the static casters
+    inline unsigned int GetStaticRenders() const {
+        return m_StaticRenders;
+    }
+    inline unsigned int GetTotalStaticRenders() const {
+        return m_TotalStaticRenders;
+    }
+    inline float GetGpuTime() const {
+        return m_Timer.GetMilliseconds();
+    }
+    inline float GetCpuTime() const {
+        return m_CpuTime;
+    }
+
+private:
+    void BindLayer(unsigned int texture, unsigned int cascade) const;
+
+    unsigned int m_Resolution;
+    unsigned int m_CascadeCount;
+    unsigned int m_StaticDepth;
+    unsigned int m_Depth;
+    unsigned int m_Framebuffer;
+
+    float m_ShadowDistance;
+    float m_SplitLambda;
+
+    glm::vec3 m_LightDirection;
+    glm::mat4 m_LightViewProj[MaxCascades];
+    float m_SplitDepths[MaxCascades];
+    // World space size of a shadow map texel, for the normal offset
+    float m_TexelSizes[MaxCascades];
+
+    glm::vec3 m_StaticCenter;
+    float m_StaticRadius;
+    // The light direction the static map was rendered with
+    glm::vec3 m_StaticDirection;
+    glm::mat4 m_StaticLightViewProj;
+    float m_StaticTexelSize;
+    bool m_StaticValid;
+
+    unsigned int m_StaticRenders;
+    unsigned int m_TotalStaticRenders;
+    float m_CpuTime;
+    GpuTimer m_Timer;
+};
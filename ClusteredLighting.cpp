@@ -0,0 +1,264 @@
+#include "ClusteredLighting.h"
+
+#include "Renderer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#ifdef SPARTAN_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+// Padding lanes sit far away with a zero radius so they never pass the overlap test
+const float c_PaddingPosition = 1e18f;
+
+unsigned int RoundUp4(unsigned int value) {
+    return (value + 3) & ~3u;
+}
+
+void CreateBufferTexture(unsigned int &buffer, unsigned int &texture, GLenum format) {
+    GLCall(glGenBuffers(1, &buffer));
+    GLCall(glBindBuffer(GL_TEXTURE_BUFFER, buffer));
+    GLCall(glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW));
+    GLCall(glGenTextures(1, &texture));
+    GLCall(glBindTexture(GL_TEXTURE_BUFFER, texture));
+    GLCall(glTexBuffer(GL_TEXTURE_BUFFER, format, buffer));
+}
+
+void UploadBuffer(unsigned int buffer, const void *data, size_t size) {
+    GLCall(glBindBuffer(GL_TEXTURE_BUFFER, buffer));
+    // Re-specifying the store lets the driver hand out fresh memory instead of syncing
+    GLCall(glBufferData(GL_TEXTURE_BUFFER, std::max(size, (size_t) 16), nullptr, GL_STREAM_DRAW));
+    if (size > 0) {
+        GLCall(glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data));
+    }
+}
+
+}
+
+ClusteredLighting::ClusteredLighting()
+    : m_LightCount(0)
+    , m_Proj(0.0f)
+    , m_Near(0.0f)
+    , m_Far(0.0f)
+    , m_Bounds(ClusterCount)
+    , m_Slices(DimZ)
+    , m_Grid(ClusterCount) {
+    CreateBufferTexture(m_LightBuffer, m_LightTexture, GL_RGBA32F);
+    CreateBufferTexture(m_GridBuffer, m_GridTexture, GL_RG32UI);
+    CreateBufferTexture(m_IndexBuffer, m_IndexTexture, GL_R32UI);
+    GLCall(glBindBuffer(GL_TEXTURE_BUFFER, 0));
+    GLCall(glBindTexture(GL_TEXTURE_BUFFER, 0));
+}
+
+ClusteredLighting::~ClusteredLighting() {
+    unsigned int buffers[] = { m_LightBuffer, m_GridBuffer, m_IndexBuffer };
+    unsigned int textures[] = { m_LightTexture, m_GridTexture, m_IndexTexture };
+    GLCall(glDeleteBuffers(3, buffers));
+    GLCall(glDeleteTextures(3, textures));
+}
+
+void ClusteredLighting::BuildClusterBounds(const glm::mat4 &proj) {
+    m_Proj = proj;
+    m_Near = proj[3][2] / (proj[2][2] - 1.0f);
+    m_Far = proj[3][2] / (proj[2][2] + 1.0f);
+
+    glm::mat4 inverseProj = glm::inverse(proj);
+    auto nearPoint = [&](float x, float y) {
+        glm::vec4 point = inverseProj * glm::vec4(x, y, -1.0f, 1.0f);
+        return glm::vec3(point) / point.w;
+    };
+
+    for (unsigned int z = 0; z < DimZ; z++) {
+        float depths[2] = { m_Near * std::pow(m_Far / m_Near, z / (float) DimZ),
+            m_Near * std::pow(m_Far / m_Near, (z + 1) / (float) DimZ) };
+        for (unsigned int y = 0; y < DimY; y++) {
+            for (unsigned int x = 0; x < DimX; x++) {
+                float x0 = -1.0f + 2.0f * x / DimX, x1 = -1.0f + 2.0f * (x + 1) / DimX;
+                float y0 = -1.0f + 2.0f * y / DimY, y1 = -1.0f + 2.0f * (y + 1) / DimY;
+                glm::vec3 corners[4]
+                    = { nearPoint(x0, y0), nearPoint(x1, y0), nearPoint(x0, y1), nearPoint(x1, y1) };
+
+                ClusterBounds bounds = { glm::vec3(1e30f), glm::vec3(-1e30f) };
+                for (const glm::vec3 &corner : corners) {
+                    for (float depth : depths) {
+                        // Slide along the eye ray until the point reaches the slice depth
+                        glm::vec3 point = corner * (depth / -corner.z);
+                        bounds.Min = glm::min(bounds.Min, point);
+                        bounds.Max = glm::max(bounds.Max, point);
+                    }
+                }
+                m_Bounds[x + DimX * (y + DimY * z)] = bounds;
+            }
+        }
+    }
+}
+
+void ClusteredLighting::BinSlice(unsigned int slice) {
+    SliceBins &bins = m_Slices[slice];
+    bins.Candidates.clear();
+    bins.X.clear();
+    bins.Y.clear();
+    bins.Z.clear();
+    bins.Radius.clear();
+    bins.Indices.clear();
+
+    // Cheap depth range rejection first, the cluster tests only see lights near the slice
+    const ClusterBounds &first = m_Bounds[DimX * DimY * slice];
+    float sliceMin = first.Min.z, sliceMax = first.Max.z;
+    for (unsigned int i = 0; i < m_LightCount; i++) {
+        float z = m_LightZ[i], radius = m_LightRadius[i];
+        if (z + radius >= sliceMin && z - radius <= sliceMax) {
+            bins.Candidates.push_back(i);
+            bins.X.push_back(m_LightX[i]);
+            bins.Y.push_back(m_LightY[i]);
+            bins.Z.push_back(z);
+            bins.Radius.push_back(radius);
+        }
+    }
+    unsigned int candidates = (unsigned int) bins.Candidates.size();
+    unsigned int padded = RoundUp4(candidates);
+    bins.X.resize(padded, c_PaddingPosition);
+    bins.Y.resize(padded, c_PaddingPosition);
+    bins.Z.resize(padded, c_PaddingPosition);
+    bins.Radius.resize(padded, 0.0f);
+
+    for (unsigned int tile = 0; tile < DimX * DimY; tile++) {
+        unsigned int cluster = tile + DimX * DimY * slice;
+        const ClusterBounds &bounds = m_Bounds[cluster];
+        unsigned int offset = (unsigned int) bins.Indices.size();
+
+        // Sphere vs box: squared distance from the center to the box against radius squared
+#ifdef SPARTAN_SSE
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 minX = _mm_set1_ps(bounds.Min.x), maxX = _mm_set1_ps(bounds.Max.x);
+        const __m128 minY = _mm_set1_ps(bounds.Min.y), maxY = _mm_set1_ps(bounds.Max.y);
+        const __m128 minZ = _mm_set1_ps(bounds.Min.z), maxZ = _mm_set1_ps(bounds.Max.z);
+        for (unsigned int i = 0; i < padded; i += 4) {
+            __m128 x = _mm_loadu_ps(&bins.X[i]);
+            __m128 y = _mm_loadu_ps(&bins.Y[i]);
+            __m128 z = _mm_loadu_ps(&bins.Z[i]);
+            __m128 radius = _mm_loadu_ps(&bins.Radius[i]);
+
+            __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, x), _mm_sub_ps(x, maxX)), zero);
+            __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, y), _mm_sub_ps(y, maxY)), zero);
+            __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, z), _mm_sub_ps(z, maxZ)), zero);
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+            int mask = _mm_movemask_ps(_mm_cmple_ps(distance, _mm_mul_ps(radius, radius)));
+            for (int lane = 0; mask != 0; lane++, mask >>= 1) {
+                if (mask & 1) {
+                    bins.Indices.push_back(bins.Candidates[i + lane]);
+                }
+            }
+        }
+#else
+        for (unsigned int i = 0; i < candidates; i++) {
+            glm::vec3 center(bins.X[i], bins.Y[i], bins.Z[i]);
+            glm::vec3 delta = glm::max(glm::max(bounds.Min - center, center - bounds.Max), 0.0f);
+            if (glm::dot(delta, delta) <= bins.Radius[i] * bins.Radius[i]) {
+                bins.Indices.push_back(bins.Candidates[i]);
+            }
+        }
+#endif
+        m_Grid[cluster] = glm::uvec2(offset, (unsigned int) bins.Indices.size() - offset);
+    }
+}
+
+void ClusteredLighting::Update(
+    const glm::mat4 &view, const glm::mat4 &proj, const std::vector<PointLight> &lights) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    if (proj != m_Proj) {
+        BuildClusterBounds(proj);
+    }
+
+    m_LightCount = (unsigned int) lights.size();
+    unsigned int padded = RoundUp4(m_LightCount);
+    m_LightX.resize(padded);
+    m_LightY.resize(padded);
+    m_LightZ.resize(padded);
+    m_LightRadius.resize(padded);
+    for (unsigned int i = 0; i < m_LightCount; i++) {
+        glm::vec3 position = glm::vec3(view * glm::vec4(lights[i].Position, 1.0f));
+        m_LightX[i] = position.x;
+        m_LightY[i] = position.y;
+        m_LightZ[i] = position.z;
+        m_LightRadius[i] = lights[i].Radius;
+    }
+
+    // Slices are independent, every job writes only to its own bins
+    ThreadPool::Get().ParallelFor(DimZ, 1, [this](unsigned int begin, unsigned int end) {
+        for (unsigned int slice = begin; slice < end; slice++) {
+            BinSlice(slice);
+        }
+    });
+
+    m_Indices.clear();
+    for (unsigned int slice = 0; slice < DimZ; slice++) {
+        unsigned int base = (unsigned int) m_Indices.size();
+        const std::vector<unsigned int> &indices = m_Slices[slice].Indices;
+        m_Indices.insert(m_Indices.end(), indices.begin(), indices.end());
+        for (unsigned int tile = 0; tile < DimX * DimY; tile++) {
+            m_Grid[tile + DimX * DimY * slice].x += base;
+        }
+    }
+
+    m_Stats = ClusterStats();
+    unsigned int occupied = 0;
+    for (const glm::uvec2 &cluster : m_Grid) {
+        m_Stats.MaxLightsPerCluster = std::max(m_Stats.MaxLightsPerCluster, cluster.y);
+        occupied += cluster.y > 0;
+    }
+    m_Stats.Lights = m_LightCount;
+    m_Stats.Indices = (unsigned int) m_Indices.size();
+    m_Stats.AverageLightsPerCluster = m_Indices.size() / (float) ClusterCount;
+    m_Stats.AverageLightsPerOccupiedCluster
+        = occupied > 0 ? m_Indices.size() / (float) occupied : 0.0f;
+    m_Stats.BinningTime = std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::high_resolution_clock::now() - start)
+                              .count();
+
+    Upload(lights);
+}
+
+void ClusteredLighting::Upload(const std::vector<PointLight> &lights) {
+    // Two texels per light: position and radius, then premultiplied color
+    std::vector<glm::vec4> lightData(lights.size() * 2);
+    for (size_t i = 0; i < lights.size(); i++) {
+        lightData[i * 2] = glm::vec4(lights[i].Position, lights[i].Radius);
+        lightData[i * 2 + 1] = glm::vec4(lights[i].Color * lights[i].Intensity, 0.0f);
+    }
+
+    UploadBuffer(m_LightBuffer, lightData.data(), lightData.size() * sizeof(glm::vec4));
+    UploadBuffer(m_GridBuffer, m_Grid.data(), m_Grid.size() * sizeof(glm::uvec2));
+    UploadBuffer(m_IndexBuffer, m_Indices.data(), m_Indices.size() * sizeof(unsigned int));
+    GLCall(glBindBuffer(GL_TEXTURE_BUFFER, 0));
+}
+
+void ClusteredLighting::SetUniforms(Shader &shader, unsigned int slot) const {
+    GLint viewport[4];
+    GLCall(glGetIntegerv(GL_VIEWPORT, viewport));
+
+    unsigned int textures[] = { m_LightTexture, m_GridTexture, m_IndexTexture };
+    for (unsigned int i = 0; i < 3; i++) {
+        GLCall(glActiveTexture(GL_TEXTURE0 + slot + i));
+        GLCall(glBindTexture(GL_TEXTURE_BUFFER, textures[i]));
+    }
+    GLCall(glActiveTexture(GL_TEXTURE0));
+
+    shader.SetUniform1i("u_Lights", slot);
+    shader.SetUniform1i("u_ClusterGrid", slot + 1);
+    shader.SetUniform1i("u_LightIndices", slot + 2);
+    shader.SetUniform3f("u_ClusterDims", (float) DimX, (float) DimY, (float) DimZ);
+
+    // slice = log(depth) * scale + bias, matching the exponential split in BuildClusterBounds
+    float logRange = std::log(m_Far / m_Near);
+    shader.SetUniform4f("u_ClusterParams", viewport[2] / (float) DimX,
+        viewport[3] / (float) DimY, DimZ / logRange, -DimZ * std::log(m_Near) / logRange);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Shader.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+struct PointLight {
+    glm::vec3 Position;
+    float Radius;
+    glm::vec3 Color;
+    float Intensity;
+};
+
+struct ClusterStats {
+    unsigned int Lights = 0;
+    unsigned int Indices = 0;
+    unsigned int MaxLightsPerCluster = 0;
+    float AverageLightsPerCluster = 0.0f;
+    // Average over the clusters that have at least one light
+    float AverageLightsPerOccupiedCluster = 0.0f;
+    float BinningTime = 0.0f;
+};
+
+// Clustered forward lighting: the view frustum is split into a grid of tiles and exponential
+// depth slices, every point light is binned into the clusters its sphere touches and the
+// per-cluster index lists are uploaded as buffer textures for include/Clustered.glsl.
+class ClusteredLighting {
+public:
+    static const unsigned int DimX = 16;
+    static const unsigned int DimY = 9;
+    static const unsigned int DimZ = 24;
+    static const unsigned int ClusterCount = DimX * DimY * DimZ;
+
+    ClusteredLighting();
+    ~ClusteredLighting();
+
+    // Bins the lights for this camera and uploads the result
+    void Update(const glm::mat4 &view, const glm::mat4 &proj, const std::vector<PointLight> &lights);
+
+    // Binds the buffer textures to slot, slot + 1 and slot + 2
+    void SetUniforms(Shader &shader, unsigned int slot) const;
+
+    inline const ClusterStats &GetStats() const {
+        return m_Stats;
+    }
+
+private:
+    struct ClusterBounds {
+        glm::vec3 Min;
+        glm::vec3 Max;
+    };
+
+    void BuildClusterBounds(const glm::mat4 &proj);
+    void BinSlice(unsigned int slice);
+    void Upload(const std::vector<PointLight> &lights);
+
+    // Lights in view space, structure of arrays padded to a multiple of 4 for SIMD
+    std::vector<float> m_LightX, m_LightY, m_LightZ, m_LightRadius;
+    unsigned int m_LightCount;
+
+    glm::mat4 m_Proj;
+    float m_Near;
+    float m_Far;
+    std::vector<ClusterBounds> m_Bounds;
+
+    // Filled by the slice jobs, each slice owns its own index list
+    struct SliceBins {
+        // Lights overlapping the slice depth range, copied out for the cluster tests
+        std::vector<unsigned int> Candidates;
+        std::vector<float> X, Y, Z, Radius;
+        std::vector<unsigned int> Indices;
+    };
+    std::vector<SliceBins> m_Slices;
+    // Offset into the slice's index list and count, per cluster
+    std::vector<glm::uvec2> m_Grid;
+    std::vector<unsigned int> m_Indices;
+
+    unsigned int m_LightBuffer, m_LightTexture;
+    unsigned int m_GridBuffer, m_GridTexture;
+    unsigned int m_IndexBuffer, m_IndexTexture;
+
+    ClusterStats m_Stats;
+};
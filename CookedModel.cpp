@@ -0,0 +1,488 @@
+#include "CookedModel.h"
+
+#include "MeshOptimizer.h"
+#include "ResourceCache.h"
+#include "ThreadPool.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <glm/glm.hpp>
+
+namespace {
+
+const char *c_CacheDirectory = "res/cache/models";
+const uint32_t c_Magic = 0x4d505053; // "SPPM"
+// Bump when the layout or the quantization changes, old entries then simply miss
+const uint32_t c_Version = 5;
+// Blobs start on this, the vertex and index arrays are read in place
+const size_t c_Alignment = 16;
+// Vertices converted per task, so one large mesh is still spread over the workers
+const unsigned int c_ChunkVertices = 16384;
+
+float Milliseconds(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::high_resolution_clock::now() - start)
+        .count();
+}
+
+std::string GetCachePath(uint64_t key) {
+    std::stringstream ss;
+    ss << c_CacheDirectory << "/" << std::hex << std::setw(16) << std::setfill('0') << key
+       << ".model";
+    return ss.str();
+}
+
+void CopyName(char *destination, size_t size, const char *name) {
+    std::strncpy(destination, name, size - 1);
+    destination[size - 1] = '\0';
+}
+
+// Appends size bytes on the next aligned offset and returns that offset
+uint64_t Append(std::vector<unsigned char> &file, const void *data, size_t size) {
+    size_t offset = (file.size() + c_Alignment - 1) / c_Alignment * c_Alignment;
+    file.resize(offset + size);
+    if (data) {
+        std::memcpy(file.data() + offset, data, size);
+    }
+    return offset;
+}
+
+bool StoreCache(const std::string &path, const std::vector<unsigned char> &file) {
+    std::error_code error;
+    std::filesystem::create_directories(c_CacheDirectory, error);
+
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+        if (!stream) {
+            return false;
+        }
+        stream.write((const char *) file.data(), file.size());
+        if (!stream) {
+            return false;
+        }
+    }
+    std::filesystem::rename(tempPath, path, error);
+    return !error;
+}
+
+}
+
+CookedModel::CookedModel(const std::string &sourcePath, unsigned int importFlags)
+    : m_Data(nullptr)
+    , m_Size(0)
+    , m_Header(nullptr)
+    , m_Meshes(nullptr)
+    , m_Batches(nullptr)
+    , m_Meshlets(nullptr)
+    , m_Materials(nullptr)
+    , m_Images(nullptr)
+    , m_Cooked(false)
+    , m_LoadMilliseconds(0.0f)
+    , m_CookMilliseconds(0.0f)
+    , m_ConvertMilliseconds(0.0f) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Keyed by the contents rather than the timestamp, so a touched file still hits
+    uint64_t key;
+    {
+        MappedFile source;
+        if (!source.Open(sourcePath)) {
+            std::cout << "ERROR::MODEL::Could not open " << sourcePath << std::endl;
+            return;
+        }
+        key = ContentHash(source.GetData(), source.GetSize());
+        key = ContentHash(&importFlags, sizeof(importFlags), key);
+        key = ContentHash(&c_Version, sizeof(c_Version), key);
+    }
+
+    std::string path = GetCachePath(key);
+    if (m_File.Open(path) && Attach(m_File.GetData(), m_File.GetSize(), key)) {
+        m_LoadMilliseconds = Milliseconds(start);
+        return;
+    }
+    m_File.Close();
+
+    auto cookStart = std::chrono::high_resolution_clock::now();
+    std::vector<unsigned char> file;
+    if (!Cook(sourcePath, importFlags, key, file, m_ConvertMilliseconds)) {
+        return;
+    }
+    m_Cooked = true;
+    // Read back through the mapping like a warm load would, the memory copy is only a fallback
+    if (!StoreCache(path, file) || !m_File.Open(path)
+        || !Attach(m_File.GetData(), m_File.GetSize(), key)) {
+        m_File.Close();
+        m_Memory = std::move(file);
+        Attach(m_Memory.data(), m_Memory.size(), key);
+    }
+    m_CookMilliseconds = Milliseconds(cookStart);
+    m_LoadMilliseconds = Milliseconds(start);
+}
+
+bool CookedModel::Cook(const std::string &sourcePath, unsigned int importFlags, uint64_t key,
+    std::vector<unsigned char> &file, float &convertMilliseconds) {
+    Assimp::Importer importer;
+    const aiScene *scene = importer.ReadFile(sourcePath, importFlags);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+        return false;
+    }
+
+    // Only compressed images (PNG, JPEG, ...) are stored, the texture cooker decodes them.
+    // Uncompressed ones (mHeight != 0, aiTexel pixels) are left out, their materials are drawn
+    // untextured.
+    std::vector<int32_t> imageIndices(scene->mNumTextures, -1);
+    std::vector<CookedImage> images;
+    for (unsigned int i = 0; i < scene->mNumTextures; i++) {
+        const aiTexture *texture = scene->mTextures[i];
+        if (texture->mHeight != 0) {
+            std::cerr << "WARNING::MODEL::Skipping uncompressed embedded image "
+                      << texture->mFilename.C_Str() << " (" << texture->mWidth << "x"
+                      << texture->mHeight << ") in " << sourcePath << std::endl;
+            continue;
+        }
+        CookedImage image = {};
+        CopyName(image.Name, sizeof(image.Name), texture->mFilename.C_Str());
+        CopyName(image.FormatHint, sizeof(image.FormatHint), texture->achFormatHint);
+        image.Size = texture->mWidth;
+        imageIndices[i] = (int32_t) images.size();
+        images.push_back(image);
+    }
+
+    std::vector<CookedMaterial> materials(scene->mNumMaterials);
+    for (unsigned int i = 0; i < scene->mNumMaterials; i++) {
+        const aiMaterial *material = scene->mMaterials[i];
+        CookedMaterial &cooked = materials[i];
+        CopyName(cooked.Name, sizeof(cooked.Name), material->GetName().C_Str());
+        cooked.Image = -1;
+        // The diffuse image wins over the specular one
+        for (aiTextureType type : { aiTextureType_DIFFUSE, aiTextureType_SPECULAR }) {
+            aiString texturePath;
+            if (material->GetTexture(type, 0, &texturePath) != AI_SUCCESS) {
+                continue;
+            }
+            int index = scene->GetEmbeddedTextureAndIndex(texturePath.C_Str()).second;
+            if (index >= 0 && imageIndices[index] >= 0) {
+                cooked.Image = imageIndices[index];
+                break;
+            }
+        }
+    }
+
+    // Meshes of the same material and primitive type share a batch, in order of appearance
+    std::vector<CookedMesh> meshes(scene->mNumMeshes);
+    std::vector<CookedBatch> batches;
+    std::vector<unsigned int> batchTypes;
+    for (unsigned int meshIndex = 0; meshIndex < scene->mNumMeshes; meshIndex++) {
+        const aiMesh *mesh = scene->mMeshes[meshIndex];
+        CookedMesh &cooked = meshes[meshIndex];
+        CopyName(cooked.Name, sizeof(cooked.Name), mesh->mName.C_Str());
+        cooked.VertexCount = mesh->mNumVertices;
+        cooked.Material = mesh->mMaterialIndex;
+        cooked.FaceCount = mesh->mNumFaces;
+        cooked.BoneCount = mesh->mNumBones;
+        cooked.Flags = (mesh->HasNormals() ? CookedMeshNormals : 0u)
+            | (mesh->HasTangentsAndBitangents() ? CookedMeshTangents : 0u)
+            | (mesh->HasTextureCoords(0) ? CookedMeshTexCoords : 0u)
+            | (mesh->HasVertexColors(0) ? CookedMeshColors : 0u);
+        // Points and lines survive SortByPType, so count the indices rather than assume
+        // triangles
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+            cooked.IndexCount += mesh->mFaces[i].mNumIndices;
+        }
+        std::memcpy(cooked.BoundsMin, &mesh->mAABB.mMin, sizeof(cooked.BoundsMin));
+        std::memcpy(cooked.BoundsMax, &mesh->mAABB.mMax, sizeof(cooked.BoundsMax));
+
+        unsigned int batch = 0;
+        while (batch < batches.size()
+            && (batches[batch].Material != cooked.Material
+                || batchTypes[batch] != mesh->mPrimitiveTypes)) {
+            batch++;
+        }
+        if (batch == batches.size()) {
+            CookedBatch added = {};
+            added.Material = cooked.Material;
+            std::memcpy(added.BoundsMin, cooked.BoundsMin, sizeof(added.BoundsMin));
+            std::memcpy(added.BoundsMax, cooked.BoundsMax, sizeof(added.BoundsMax));
+            batches.push_back(added);
+            batchTypes.push_back(mesh->mPrimitiveTypes);
+        }
+        CookedBatch &merged = batches[batch];
+        cooked.Batch = batch;
+        cooked.BaseVertex = merged.VertexCount;
+        cooked.FirstIndex = merged.IndexCount;
+        merged.VertexCount += cooked.VertexCount;
+        merged.IndexCount += cooked.IndexCount;
+        merged.MeshCount++;
+        for (int axis = 0; axis < 3; axis++) {
+            merged.BoundsMin[axis] = std::min(merged.BoundsMin[axis], cooked.BoundsMin[axis]);
+            merged.BoundsMax[axis] = std::max(merged.BoundsMax[axis], cooked.BoundsMax[axis]);
+        }
+    }
+
+    CookedModelHeader header = { c_Magic, c_Version, key, scene->mNumMeshes,
+        (uint32_t) batches.size(), (uint32_t) materials.size(), (uint32_t) images.size(),
+        scene->mNumLights, scene->mNumCameras, scene->mNumAnimations, 0, 0 };
+    Append(file, &header, sizeof(header));
+    // The records are written once all offsets are known
+    uint64_t meshesOffset = Append(file, nullptr, meshes.size() * sizeof(CookedMesh));
+    uint64_t batchesOffset = Append(file, nullptr, batches.size() * sizeof(CookedBatch));
+    Append(file, materials.data(), materials.size() * sizeof(CookedMaterial));
+    uint64_t imagesOffset = Append(file, nullptr, images.size() * sizeof(CookedImage));
+    for (CookedBatch &batch : batches) {
+        batch.VertexOffset = Append(file, nullptr, batch.VertexCount * sizeof(QuantizedVertex));
+        batch.IndexOffset = Append(file, nullptr, batch.IndexCount * sizeof(unsigned int));
+    }
+    for (CookedImage &image : images) {
+        image.Offset = Append(file, nullptr, image.Size);
+    }
+
+    // Every range is allocated now, so the conversion writes into disjoint slices of the file
+    // from the workers. Large meshes are split, otherwise one of them ends up on one thread.
+    auto convertStart = std::chrono::high_resolution_clock::now();
+    struct Chunk {
+        unsigned int Mesh;
+        unsigned int FirstVertex;
+        unsigned int VertexCount;
+        // The first chunk of a mesh also copies its indices
+        bool Indices;
+    };
+    std::vector<Chunk> chunks;
+    for (unsigned int meshIndex = 0; meshIndex < meshes.size(); meshIndex++) {
+        unsigned int vertexCount = meshes[meshIndex].VertexCount;
+        unsigned int first = 0;
+        do {
+            unsigned int count = std::min(vertexCount - first, c_ChunkVertices);
+            chunks.push_back({ meshIndex, first, count, first == 0 });
+            first += count;
+        } while (first < vertexCount);
+    }
+
+    unsigned char *data = file.data();
+    ThreadPool::Get().ParallelFor(
+        (unsigned int) chunks.size(), 1, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int chunkIndex = begin; chunkIndex < end; chunkIndex++) {
+                const Chunk &chunk = chunks[chunkIndex];
+                const aiMesh *mesh = scene->mMeshes[chunk.Mesh];
+                const CookedMesh &cooked = meshes[chunk.Mesh];
+                const CookedBatch &batch = batches[cooked.Batch];
+
+                // Positions are stored relative to the batch's bounding box, the bounds map
+                // them back
+                glm::vec3 boxMin(batch.BoundsMin[0], batch.BoundsMin[1], batch.BoundsMin[2]);
+                glm::vec3 boxMax(batch.BoundsMax[0], batch.BoundsMax[1], batch.BoundsMax[2]);
+                glm::vec3 center = (boxMin + boxMax) * 0.5f;
+                glm::vec3 extent = glm::max((boxMax - boxMin) * 0.5f, glm::vec3(1e-6f));
+
+                QuantizedVertex *vertex = (QuantizedVertex *) (data + batch.VertexOffset)
+                    + cooked.BaseVertex + chunk.FirstVertex;
+                for (unsigned int i = chunk.FirstVertex;
+                     i < chunk.FirstVertex + chunk.VertexCount; i++) {
+                    const aiVector3D &source = mesh->mVertices[i];
+                    glm::vec3 position
+                        = (glm::vec3(source.x, source.y, source.z) - center) / extent;
+
+                    glm::vec2 texCoord(0.0f);
+                    if (mesh->HasTextureCoords(0)) {
+                        texCoord
+                            = { mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y };
+                    }
+
+                    *vertex++ = { { VertexPack::Snorm16(position.x),
+                                      VertexPack::Snorm16(position.y),
+                                      VertexPack::Snorm16(position.z), 32767 },
+                        { VertexPack::Half(texCoord.x), VertexPack::Half(texCoord.y) } };
+                }
+
+                if (!chunk.Indices) {
+                    continue;
+                }
+                unsigned int *index
+                    = (unsigned int *) (data + batch.IndexOffset) + cooked.FirstIndex;
+                for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+                    const aiFace &face = mesh->mFaces[i];
+                    for (unsigned int j = 0; j < face.mNumIndices; j++) {
+                        *index++ = face.mIndices[j] + cooked.BaseVertex;
+                    }
+                }
+            }
+        });
+
+    // Each mesh on its own, so the slices stay where the records say, and with the source
+    // positions for the overdraw order. The meshlets are cut from the optimized order.
+    std::vector<std::vector<Meshlet>> meshMeshlets(meshes.size());
+    ThreadPool::Get().ParallelFor(
+        (unsigned int) meshes.size(), 1, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int meshIndex = begin; meshIndex < end; meshIndex++) {
+                const aiMesh *mesh = scene->mMeshes[meshIndex];
+                const CookedMesh &cooked = meshes[meshIndex];
+                std::vector<Meshlet> &meshlets = meshMeshlets[meshIndex];
+                if (mesh->mPrimitiveTypes != aiPrimitiveType_TRIANGLE) {
+                    // Points and lines are only frustum culled, as a whole
+                    const float *lo = cooked.BoundsMin, *hi = cooked.BoundsMax;
+                    glm::vec3 boxMin(lo[0], lo[1], lo[2]), boxMax(hi[0], hi[1], hi[2]);
+                    meshlets.push_back({ cooked.FirstIndex, cooked.IndexCount,
+                        (boxMin + boxMax) * 0.5f, glm::distance(boxMin, boxMax) * 0.5f,
+                        glm::vec3(0.0f), 1.0f });
+                    continue;
+                }
+                const CookedBatch &batch = batches[cooked.Batch];
+                QuantizedVertex *vertices
+                    = (QuantizedVertex *) (data + batch.VertexOffset) + cooked.BaseVertex;
+                unsigned int *indices
+                    = (unsigned int *) (data + batch.IndexOffset) + cooked.FirstIndex;
+                for (unsigned int i = 0; i < cooked.IndexCount; i++) {
+                    indices[i] -= cooked.BaseVertex;
+                }
+                MeshOptimizer::Optimize(vertices, cooked.VertexCount, sizeof(QuantizedVertex),
+                    indices, cooked.IndexCount, &mesh->mVertices[0].x, 3);
+
+                // The vertices moved, so the bounds come from the quantized ones
+                glm::vec3 boxMin(batch.BoundsMin[0], batch.BoundsMin[1], batch.BoundsMin[2]);
+                glm::vec3 boxMax(batch.BoundsMax[0], batch.BoundsMax[1], batch.BoundsMax[2]);
+                glm::vec3 center = (boxMin + boxMax) * 0.5f;
+                glm::vec3 extent = glm::max((boxMax - boxMin) * 0.5f, glm::vec3(1e-6f));
+                std::vector<glm::vec3> positions(cooked.VertexCount);
+                for (unsigned int v = 0; v < cooked.VertexCount; v++) {
+                    const int16_t *position = vertices[v].Position;
+                    positions[v] = center
+                        + glm::vec3(VertexUnpack::Snorm16(position[0]),
+                              VertexUnpack::Snorm16(position[1]),
+                              VertexUnpack::Snorm16(position[2]))
+                            * extent;
+                }
+                MeshOptimizer::BuildMeshlets(indices, cooked.IndexCount,
+                    (const float *) positions.data(), 3, cooked.VertexCount, meshlets);
+
+                for (Meshlet &meshlet : meshlets) {
+                    meshlet.FirstIndex += cooked.FirstIndex;
+                }
+                for (unsigned int i = 0; i < cooked.IndexCount; i++) {
+                    indices[i] += cooked.BaseVertex;
+                }
+            }
+        });
+    convertMilliseconds = Milliseconds(convertStart);
+
+    // Each batch's meshlets in the order of its meshes, which is the order of their indices
+    std::vector<CookedMeshlet> meshlets;
+    for (unsigned int batchIndex = 0; batchIndex < batches.size(); batchIndex++) {
+        CookedBatch &batch = batches[batchIndex];
+        batch.FirstMeshlet = (uint32_t) meshlets.size();
+        for (unsigned int meshIndex = 0; meshIndex < meshes.size(); meshIndex++) {
+            if (meshes[meshIndex].Batch != batchIndex) {
+                continue;
+            }
+            for (const Meshlet &meshlet : meshMeshlets[meshIndex]) {
+                meshlets.push_back({ meshlet.FirstIndex, meshlet.IndexCount,
+                    { meshlet.Center.x, meshlet.Center.y, meshlet.Center.z }, meshlet.Radius,
+                    { meshlet.ConeAxis.x, meshlet.ConeAxis.y, meshlet.ConeAxis.z },
+                    meshlet.ConeCutoff });
+            }
+        }
+        batch.MeshletCount = (uint32_t) meshlets.size() - batch.FirstMeshlet;
+    }
+
+    std::memcpy(data + meshesOffset, meshes.data(), meshes.size() * sizeof(CookedMesh));
+    std::memcpy(data + batchesOffset, batches.data(), batches.size() * sizeof(CookedBatch));
+    std::memcpy(data + imagesOffset, images.data(), images.size() * sizeof(CookedImage));
+    for (unsigned int i = 0, imageIndex = 0; i < scene->mNumTextures; i++) {
+        if (imageIndices[i] >= 0) {
+            const CookedImage &image = images[imageIndex++];
+            std::memcpy(data + image.Offset, scene->mTextures[i]->pcData, image.Size);
+        }
+    }
+
+    // Moves the file, data is stale from here on
+    header.MeshletCount = (uint32_t) meshlets.size();
+    header.MeshletOffset
+        = Append(file, meshlets.data(), meshlets.size() * sizeof(CookedMeshlet));
+    std::memcpy(file.data(), &header, sizeof(header));
+    return true;
+}
+
+bool CookedModel::Attach(const unsigned char *data, size_t size, uint64_t key) {
+    m_Header = nullptr;
+    if (size < sizeof(CookedModelHeader)) {
+        return false;
+    }
+    const CookedModelHeader *header = (const CookedModelHeader *) data;
+    if (header->Magic != c_Magic || header->Version != c_Version || header->Key != key) {
+        return false;
+    }
+
+    // Same layout as Cook writes it
+    auto align = [](uint64_t offset) {
+        return (offset + c_Alignment - 1) / c_Alignment * c_Alignment;
+    };
+    uint64_t meshesOffset = align(sizeof(CookedModelHeader));
+    uint64_t batchesOffset = align(meshesOffset + header->MeshCount * sizeof(CookedMesh));
+    uint64_t materialsOffset = align(batchesOffset + header->BatchCount * sizeof(CookedBatch));
+    uint64_t imagesOffset
+        = align(materialsOffset + header->MaterialCount * sizeof(CookedMaterial));
+    if (imagesOffset + header->ImageCount * sizeof(CookedImage) > size) {
+        return false;
+    }
+    const CookedMesh *meshes = (const CookedMesh *) (data + meshesOffset);
+    const CookedBatch *batches = (const CookedBatch *) (data + batchesOffset);
+    const CookedMaterial *materials = (const CookedMaterial *) (data + materialsOffset);
+    const CookedImage *images = (const CookedImage *) (data + imagesOffset);
+    if (header->MeshletOffset % c_Alignment != 0
+        || header->MeshletOffset + header->MeshletCount * sizeof(CookedMeshlet) > size) {
+        return false;
+    }
+    const CookedMeshlet *meshlets = (const CookedMeshlet *) (data + header->MeshletOffset);
+
+    // A truncated or stale file must not be read past its end
+    for (unsigned int i = 0; i < header->BatchCount; i++) {
+        const CookedBatch &batch = batches[i];
+        if (batch.VertexOffset + (uint64_t) batch.VertexCount * sizeof(QuantizedVertex) > size
+            || batch.IndexOffset + (uint64_t) batch.IndexCount * sizeof(unsigned int) > size
+            || batch.VertexOffset % c_Alignment != 0 || batch.IndexOffset % c_Alignment != 0
+            || batch.Material >= header->MaterialCount
+            || (uint64_t) batch.FirstMeshlet + batch.MeshletCount > header->MeshletCount) {
+            return false;
+        }
+        for (unsigned int m = batch.FirstMeshlet; m < batch.FirstMeshlet + batch.MeshletCount;
+             m++) {
+            if ((uint64_t) meshlets[m].FirstIndex + meshlets[m].IndexCount > batch.IndexCount) {
+                return false;
+            }
+        }
+    }
+    for (unsigned int i = 0; i < header->MeshCount; i++) {
+        const CookedMesh &mesh = meshes[i];
+        if (mesh.Batch >= header->BatchCount || mesh.Material >= header->MaterialCount) {
+            return false;
+        }
+    }
+    for (unsigned int i = 0; i < header->MaterialCount; i++) {
+        if (materials[i].Image >= (int32_t) header->ImageCount) {
+            return false;
+        }
+    }
+    for (unsigned int i = 0; i < header->ImageCount; i++) {
+        if (images[i].Offset + images[i].Size > size) {
+            return false;
+        }
+    }
+
+    m_Data = data;
+    m_Size = size;
+    m_Header = header;
+    m_Meshes = meshes;
+    m_Batches = batches;
+    m_Meshlets = meshlets;
+    m_Materials = materials;
+    m_Images = images;
+    return true;
+}
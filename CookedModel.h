@@ -0,0 +1,175 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "VertexFormat.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The records below are stored in the file as they are and used straight from the mapping
+
+struct CookedModelHeader {
+    uint32_t Magic;
+    uint32_t Version;
+    uint64_t Key;
+    uint32_t MeshCount;
+    uint32_t BatchCount;
+    uint32_t MaterialCount;
+    uint32_t ImageCount;
+    uint32_t LightCount;
+    uint32_t CameraCount;
+    uint32_t AnimationCount;
+    uint32_t MeshletCount;
+    // Meshlets are built after the vertex data, they come last
+    uint64_t MeshletOffset;
+};
+
+enum CookedMeshFlags : uint32_t {
+    CookedMeshNormals = 1,
+    CookedMeshTangents = 2,
+    CookedMeshTexCoords = 4,
+    CookedMeshColors = 8,
+};
+
+// The meshes of one material and primitive type merged into a single vertex and index range,
+// drawn with one call
+struct CookedBatch {
+    // QuantizedVertex positions relative to the bounds, unsigned int indices into the batch
+    uint64_t VertexOffset;
+    uint64_t IndexOffset;
+    uint32_t VertexCount;
+    uint32_t IndexCount;
+    float BoundsMin[3];
+    float BoundsMax[3];
+    uint32_t Material;
+    uint32_t MeshCount;
+    uint32_t FirstMeshlet;
+    uint32_t MeshletCount;
+};
+
+// Up to 64 vertices and 124 triangles of a batch, see Meshlet. Bounds are in model space.
+struct CookedMeshlet {
+    uint32_t FirstIndex;
+    uint32_t IndexCount;
+    float Center[3];
+    float Radius;
+    float ConeAxis[3];
+    float ConeCutoff;
+};
+
+// A source mesh, its vertices and indices are a slice of its batch
+struct CookedMesh {
+    char Name[64];
+    uint32_t Batch;
+    uint32_t BaseVertex;
+    uint32_t FirstIndex;
+    uint32_t VertexCount;
+    uint32_t IndexCount;
+    float BoundsMin[3];
+    float BoundsMax[3];
+    uint32_t Material;
+    uint32_t FaceCount;
+    uint32_t BoneCount;
+    uint32_t Flags;
+};
+
+struct CookedMaterial {
+    char Name[64];
+    // The embedded diffuse image, or the specular one without it, -1 for none
+    int32_t Image;
+};
+
+// Embedded image as it was in the model file (PNG, JPEG, ...)
+struct CookedImage {
+    char Name[64];
+    char FormatHint[16];
+    uint64_t Offset;
+    uint64_t Size;
+};
+
+// An imported model in one file: the final quantized vertices and indices, optimized and
+// merged into one batch per material and split into meshlets, with bounds, materials and the
+// embedded images. Cooked with Assimp into res/cache/models the first time, keyed by the source
+// file's contents and the import flags; after that the file is only mapped, so warm loads skip
+// Assimp and upload from the page cache.
+class CookedModel {
+public:
+    CookedModel(const std::string &sourcePath, unsigned int importFlags);
+
+    inline bool IsValid() const {
+        return m_Header != nullptr;
+    }
+    // Imported with Assimp by this load rather than found in the cache
+    inline bool WasCooked() const {
+        return m_Cooked;
+    }
+    // Everything the constructor did, and the Assimp import and write when cooking
+    inline float GetLoadMilliseconds() const {
+        return m_LoadMilliseconds;
+    }
+    inline float GetCookMilliseconds() const {
+        return m_CookMilliseconds;
+    }
+    // The part of the cook after the Assimp import, conversion and MeshOptimizer spread over
+    // the thread pool
+    inline float GetConvertMilliseconds() const {
+        return m_ConvertMilliseconds;
+    }
+    inline size_t GetSize() const {
+        return m_Size;
+    }
+
+    inline const CookedModelHeader &GetHeader() const {
+        return *m_Header;
+    }
+    inline const CookedMesh &GetMesh(unsigned int index) const {
+        return m_Meshes[index];
+    }
+    inline const CookedBatch &GetBatch(unsigned int index) const {
+        return m_Batches[index];
+    }
+    inline const CookedMeshlet &GetMeshlet(unsigned int index) const {
+        return m_Meshlets[index];
+    }
+    inline const CookedMaterial &GetMaterial(unsigned int index) const {
+        return m_Materials[index];
+    }
+    inline const CookedImage &GetImage(unsigned int index) const {
+        return m_Images[index];
+    }
+    inline const QuantizedVertex *GetVertices(const CookedBatch &batch) const {
+        return (const QuantizedVertex *) (m_Data + batch.VertexOffset);
+    }
+    inline const unsigned int *GetIndices(const CookedBatch &batch) const {
+        return (const unsigned int *) (m_Data + batch.IndexOffset);
+    }
+    inline const unsigned char *GetImageData(const CookedImage &image) const {
+        return m_Data + image.Offset;
+    }
+
+private:
+    // Imports with Assimp and lays out the whole file in memory
+    static bool Cook(const std::string &sourcePath, unsigned int importFlags, uint64_t key,
+        std::vector<unsigned char> &file, float &convertMilliseconds);
+    // Points the records into data, false if anything lies outside of it
+    bool Attach(const unsigned char *data, size_t size, uint64_t key);
+
+    MappedFile m_File;
+    // Only used when the cooked file could not be written and mapped
+    std::vector<unsigned char> m_Memory;
+
+    const unsigned char *m_Data;
+    size_t m_Size;
+    const CookedModelHeader *m_Header;
+    const CookedMesh *m_Meshes;
+    const CookedBatch *m_Batches;
+    const CookedMeshlet *m_Meshlets;
+    const CookedMaterial *m_Materials;
+    const CookedImage *m_Images;
+
+    bool m_Cooked;
+    float m_LoadMilliseconds;
+    float m_CookMilliseconds;
+    float m_ConvertMilliseconds;
+};
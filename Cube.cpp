@@ -1,11 +1,34 @@
 #include "Cube.h"
 
+#include "MeshBuilder.h"
 #include "Renderer.h"
 
+#include <cstring>
 #include <glm/gtc/matrix_transform.hpp>
 
 Cube::Cube() {
-    float vertices[] = {
+    MeshBuilder builder("Cube", VertexBufferLayout::Of<CubeVertex>(), VertexCount, IndexCount);
+    generateCube(builder.GetVertices<CubeVertex>(), builder.GetIndices());
+
+    MeshBuffers mesh = builder.Finish();
+    m_VAO = std::move(mesh.VAO);
+    m_VBO = std::move(mesh.VBO);
+    m_IBO = std::move(mesh.IBO);
+
+    m_Shader = std::make_unique<Shader>("res/shaders/Normal.shader");
+    m_Shader->Bind();
+
+    m_VAO->UnBind();
+    m_VBO->UnBind();
+    m_IBO->UnBind();
+    m_Shader->UnBind();
+}
+
+Cube::~Cube() {
+}
+
+void Cube::generateCube(CubeVertex *vertex, unsigned int *index) {
+    static const float vertices[] = {
         // Position (3) // Normal (3) // Tex coord (2)
         // Front
         -0.5f, -0.5f, 0.5f, 0.0f, 0.0f, 1.f, 0.0f, 0.0f, // 0
@@ -38,7 +61,7 @@ Cube::Cube() {
         0.5f, -0.5f, 0.5f, 0.f, -1.0f, 0.f, 1.0f, 1.0f, // 22
         0.5f, -0.5f, -0.5f, 0.f, -1.0f, 0.f, 0.0f, 1.0f, // 23
     };
-    unsigned int indices[] = {
+    static const unsigned int indices[] = {
         // Front
         0, 1, 2, // 0
         2, 3, 0, // 1
@@ -59,26 +82,12 @@ Cube::Cube() {
         22, 23, 20 // 11
     };
 
-    m_VAO = std::make_unique<VertexArray>();
     // 6 faces of 4 vertices of 8 floats
-    m_VBO = std::make_unique<VertexBuffer>(vertices, 6 * 4 * 8 * sizeof(float));
-    VertexBufferLayout layout = VertexBufferLayout();
-    layout.Push<float>(3); // position
-    layout.Push<float>(3); // normal
-    layout.Push<float>(2); // UV
-    m_VAO->AddBuffer(*m_VBO, layout);
-    m_IBO = std::make_unique<IndexBuffer>(indices, 36);
-
-    m_Shader = std::make_unique<Shader>("res/shaders/Normal.shader");
-    m_Shader->Bind();
-
-    m_VAO->UnBind();
-    m_VBO->UnBind();
-    m_IBO->UnBind();
-    m_Shader->UnBind();
-}
-
-Cube::~Cube() {
+    for (unsigned int i = 0; i < VertexCount; i++) {
+        const float *v = &vertices[i * 8];
+        vertex[i] = CubeVertex::Pack({ v[0], v[1], v[2] }, { v[3], v[4], v[5] }, { v[6], v[7] });
+    }
+    std::memcpy(index, indices, sizeof(indices));
 }
 
 void Cube::draw(const glm::mat4 &MVP, std::optional<Shader *> opt_shader,
@@ -91,4 +100,18 @@ void Cube::draw(const glm::mat4 &MVP, std::optional<Shader *> opt_shader,
         opt_texture.value()->Bind();
     }
     renderer.Draw(*m_VAO, *m_IBO, *shader);
+}
+
+void Cube::drawInstanced(const glm::mat4 &viewProj, Shader &shader, const StreamBuffer &instances,
+    unsigned int offset, unsigned int count) {
+    VertexBufferLayout layout = VertexBufferLayout();
+    for (int column = 0; column < 4; column++) {
+        layout.Push<float>(4); // Model matrix column
+    }
+    m_VAO->AddInstanceBuffer(instances, offset, layout, 4);
+
+    Renderer renderer;
+    shader.Bind();
+    shader.SetUniformMat4f("u_ViewProj", viewProj);
+    renderer.DrawInstanced(*m_VAO, *m_IBO, shader, count);
 }
\ No newline at end of file
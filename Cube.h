@@ -2,6 +2,7 @@
 
 #include "IndexBuffer.h"
 #include "Shader.h"
+#include "StreamBuffer.h"
 #include "Texture.h"
 #include "VertexArray.h"
 #include "VertexBuffer.h"
@@ -12,10 +13,20 @@
 
 class Cube {
 public:
+    static const unsigned int VertexCount = 6 * 4;
+    static const unsigned int IndexCount = 36;
+
     Cube();
     ~Cube();
     void draw(const glm::mat4 &MVP, std::optional<Shader *> shader = std::nullopt,
         std::optional<Texture *> texture = std::nullopt);
+    // Draws count cubes whose model matrices are packed at offset in instances, with a shader
+    // built with ShaderFeature::Instanced
+    void drawInstanced(const glm::mat4 &viewProj, Shader &shader, const StreamBuffer &instances,
+        unsigned int offset, unsigned int count);
+
+    // VertexCount vertices and IndexCount indices, needs no GL context
+    static void generateCube(CubeVertex *vertex, unsigned int *index);
 
 private:
     std::unique_ptr<VertexArray> m_VAO;
@@ -0,0 +1,101 @@
+#include "DynamicResolution.h"
+
+#include "Renderer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Relative scale changes smaller than this are ignored, they would only make it oscillate
+const float c_DeadBand = 0.02f;
+const float c_MaxDecrease = 0.1f;
+const float c_MaxIncrease = 0.025f;
+
+}
+
+DynamicResolution::DynamicResolution(unsigned int latency)
+    : m_Latency(latency)
+    , m_Cooldown(0)
+    , m_Scale(1.0f)
+    , m_Smoothed(0.0f)
+    , m_State(DynamicResolutionState::Stable)
+    , m_ScaleHistory(HistorySize, 1.0f)
+    , m_TimeHistory(HistorySize, 0.0f) {
+    m_Shader = std::make_unique<Shader>("res/shaders/Upscale.shader");
+    m_VAO = std::make_unique<VertexArray>();
+}
+
+DynamicResolution::~DynamicResolution() {
+}
+
+void DynamicResolution::Update(float gpuMilliseconds) {
+    // The timer reports 0 until its first query comes back
+    if (gpuMilliseconds > 0.0f) {
+        m_Smoothed = m_Smoothed > 0.0f
+            ? m_Smoothed + (gpuMilliseconds - m_Smoothed) * m_Settings.Smoothing
+            : gpuMilliseconds;
+    }
+
+    std::rotate(m_ScaleHistory.begin(), m_ScaleHistory.begin() + 1, m_ScaleHistory.end());
+    std::rotate(m_TimeHistory.begin(), m_TimeHistory.begin() + 1, m_TimeHistory.end());
+    m_TimeHistory.back() = gpuMilliseconds;
+    m_ScaleHistory.back() = GetScale();
+
+    if (!m_Settings.Enabled || m_Smoothed <= 0.0f) {
+        m_State = DynamicResolutionState::Stable;
+        return;
+    }
+    // The times still describe frames rendered before the last change
+    if (m_Cooldown > 0) {
+        m_Cooldown--;
+        m_State = DynamicResolutionState::Settling;
+        return;
+    }
+
+    float budget = m_Settings.TargetMilliseconds * m_Settings.Headroom;
+    float ideal = m_Scale * std::sqrt(budget / std::max(m_Smoothed, 0.01f));
+    ideal = glm::clamp(ideal, m_Settings.MinScale, m_Settings.MaxScale);
+
+    float delta = ideal - m_Scale;
+    if (std::abs(delta) < c_DeadBand * m_Scale) {
+        m_State = DynamicResolutionState::Stable;
+        return;
+    }
+    delta = glm::clamp(delta, -c_MaxDecrease, c_MaxIncrease);
+    m_Scale = glm::clamp(m_Scale + delta, m_Settings.MinScale, m_Settings.MaxScale);
+    m_State = delta < 0.0f ? DynamicResolutionState::Decreasing
+                           : DynamicResolutionState::Increasing;
+    m_Cooldown = m_Latency;
+}
+
+glm::ivec2 DynamicResolution::GetRenderSize(int width, int height) const {
+    float scale = GetScale();
+    auto round = [](float size) { return std::max(8, ((int) (size + 4.0f) / 8) * 8); };
+    return { std::min(width, round(width * scale)), std::min(height, round(height * scale)) };
+}
+
+void DynamicResolution::Upscale(unsigned int texture, const glm::ivec2 &renderSize) const {
+    GLCall(glActiveTexture(GL_TEXTURE0));
+    GLCall(glBindTexture(GL_TEXTURE_2D, texture));
+
+    m_Shader->Bind();
+    m_Shader->SetUniform1i("u_Scene", 0);
+    m_Shader->SetUniform2f("u_RenderSize", (float) renderSize.x, (float) renderSize.y);
+    m_Shader->SetUniform1f("u_Sharpness", m_Settings.Sharpness);
+
+    GLCall(glDisable(GL_DEPTH_TEST));
+    Renderer renderer;
+    renderer.DrawArrays(*m_VAO, *m_Shader, GL_TRIANGLES, 3);
+    GLCall(glEnable(GL_DEPTH_TEST));
+}
+
+const char *DynamicResolution::GetStateName(DynamicResolutionState state) {
+    switch (state) {
+    case DynamicResolutionState::Stable: return "stable";
+    case DynamicResolutionState::Decreasing: return "decreasing";
+    case DynamicResolutionState::Increasing: return "increasing";
+    case DynamicResolutionState::Settling: return "settling";
+    }
+    return "";
+}
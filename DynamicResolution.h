@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Shader.h"
+#include "VertexArray.h"
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+struct DynamicResolutionSettings {
+    bool Enabled = true;
+    float TargetMilliseconds = 16.6f;
+    // Fraction of the target to aim for, leaves room for spikes
+    float Headroom = 0.9f;
+    float MinScale = 0.5f;
+    float MaxScale = 1.0f;
+    // Weight of the newest GPU time in the moving average
+    float Smoothing = 0.1f;
+    // 0 is a plain bilinear upscale
+    float Sharpness = 0.5f;
+};
+
+enum class DynamicResolutionState { Stable, Decreasing, Increasing, Settling };
+
+// Picks the scene's render scale from the GPU time of previous frames and upscales the scaled
+// render to the native target with a contrast adaptive sharpen. The controller moves the scale
+// by the square root of budget / smoothed time (cost follows the pixel count), ignores changes
+// inside a small dead band, drops quickly and recovers slowly, then waits for the timer
+// latency to pass before judging its last step.
+class DynamicResolution {
+public:
+    static const unsigned int HistorySize = 120;
+
+    DynamicResolution(unsigned int latency = 4);
+    ~DynamicResolution();
+
+    // Feeds the GPU time of the scaled passes, once per frame
+    void Update(float gpuMilliseconds);
+
+    // Render area for a native size, rounded to multiples of 8 pixels
+    glm::ivec2 GetRenderSize(int width, int height) const;
+    // Draws the lower left renderSize part of texture over the current viewport
+    void Upscale(unsigned int texture, const glm::ivec2 &renderSize) const;
+
+    inline float GetScale() const {
+        return m_Settings.Enabled ? m_Scale : 1.0f;
+    }
+    inline DynamicResolutionSettings &GetSettings() {
+        return m_Settings;
+    }
+    inline DynamicResolutionState GetState() const {
+        return m_State;
+    }
+    inline float GetSmoothedMilliseconds() const {
+        return m_Smoothed;
+    }
+    // Oldest first, for ImGui::PlotLines
+    inline const std::vector<float> &GetScaleHistory() const {
+        return m_ScaleHistory;
+    }
+    inline const std::vector<float> &GetTimeHistory() const {
+        return m_TimeHistory;
+    }
+
+    static const char *GetStateName(DynamicResolutionState state);
+
+private:
+    DynamicResolutionSettings m_Settings;
+    unsigned int m_Latency;
+    unsigned int m_Cooldown;
+    float m_Scale;
+    float m_Smoothed;
+    DynamicResolutionState m_State;
+
+    std::vector<float> m_ScaleHistory;
+    std::vector<float> m_TimeHistory;
+
+    std::unique_ptr<Shader> m_Shader;
+    // Core profile needs a bound vertex array even for the attribute-less fullscreen triangle
+    std::unique_ptr<VertexArray> m_VAO;
+};
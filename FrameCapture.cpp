@@ -0,0 +1,247 @@
+#include "FrameCapture.h"
+
+#include "ImageWriter.h"
+#include "Renderer.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+FrameCapture::FrameCapture(const std::string &directory, unsigned int ringSize)
+    : m_Directory(directory)
+    , m_ScreenshotRequested(false)
+    , m_Screenshots(0)
+    , m_Recording(false)
+    , m_SequenceFormat(CaptureFormat::Png)
+    , m_SequenceFrame(0)
+    , m_SequenceWidth(0)
+    , m_SequenceHeight(0)
+    , m_Written(0)
+    , m_EncodeMicroseconds(0) {
+    for (unsigned int i = 0; i < ringSize; i++) {
+        m_Slots.push_back(std::make_unique<Slot>());
+        GLCall(glGenBuffers(1, &m_Slots.back()->Buffer));
+    }
+}
+
+FrameCapture::~FrameCapture() {
+    StopSequence();
+    Collect(true);
+    for (const auto &slot : m_Slots) {
+        GLCall(glDeleteBuffers(1, &slot->Buffer));
+    }
+}
+
+void FrameCapture::Screenshot() {
+    m_ScreenshotRequested = true;
+}
+
+void FrameCapture::StartSequence(CaptureFormat format) {
+    StopSequence();
+
+    std::stringstream ss;
+    ss << m_Directory << "/sequence_" << std::chrono::system_clock::now().time_since_epoch().count()
+       / 1000000;
+    m_SequencePath = ss.str();
+    std::error_code error;
+    std::filesystem::create_directories(m_SequencePath, error);
+
+    m_SequenceFormat = format;
+    m_SequenceFrame = 0;
+    m_SequenceWidth = 0;
+    m_SequenceHeight = 0;
+    m_Recording = true;
+}
+
+void FrameCapture::StopSequence() {
+    if (!m_Recording) {
+        return;
+    }
+    m_Recording = false;
+
+    // The raw file has to stay open until the last frame is in
+    Collect(true);
+    std::lock_guard<std::mutex> lock(m_RawMutex);
+    if (m_RawFile.is_open()) {
+        m_RawFile.close();
+        std::cout << "Captured " << m_SequenceFrame << " frames to " << m_SequencePath
+                  << "/frames.rgba, e.g. ffmpeg -f rawvideo -pix_fmt rgba -s "
+                  << m_SequenceWidth << "x" << m_SequenceHeight << " -i frames.rgba out.mp4"
+                  << std::endl;
+    } else {
+        std::cout << "Captured " << m_SequenceFrame << " frames to " << m_SequencePath
+                  << std::endl;
+    }
+}
+
+void FrameCapture::EndFrame(int width, int height) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    Collect(false);
+
+    if (m_Recording) {
+        // A raw file only holds one size, end the sequence when the window is resized
+        if (m_SequenceFrame > 0 && (width != m_SequenceWidth || height != m_SequenceHeight)) {
+            StopSequence();
+        } else {
+            m_SequenceWidth = width;
+            m_SequenceHeight = height;
+            std::stringstream ss;
+            ss << m_SequencePath << "/frame_" << std::setw(6) << std::setfill('0')
+               << m_SequenceFrame << ".png";
+            if (Queue(width, height, m_SequenceFormat, ss.str(), m_SequenceFrame)) {
+                m_SequenceFrame++;
+            } else {
+                m_Stats.Dropped++;
+            }
+        }
+    }
+    if (m_ScreenshotRequested) {
+        std::error_code error;
+        std::filesystem::create_directories(m_Directory, error);
+        std::stringstream ss;
+        ss << m_Directory << "/screenshot_" << std::setw(4) << std::setfill('0') << m_Screenshots
+           << ".png";
+        // With every buffer busy the screenshot just waits for the next frame
+        if (Queue(width, height, CaptureFormat::Png, ss.str(), 0)) {
+            m_ScreenshotRequested = false;
+            m_Screenshots++;
+        }
+    }
+
+    m_Stats.Written = m_Written;
+    if (m_Stats.Written > 0) {
+        m_Stats.EncodeMilliseconds = m_EncodeMicroseconds / 1000.0f / m_Stats.Written;
+    }
+    m_Stats.LastMilliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::high_resolution_clock::now() - start)
+                                   .count();
+    m_Stats.MaxMilliseconds = std::max(m_Stats.MaxMilliseconds, m_Stats.LastMilliseconds);
+}
+
+bool FrameCapture::Queue(int width, int height, CaptureFormat format, const std::string &path,
+    unsigned int frame) {
+    Slot *slot = nullptr;
+    for (const auto &candidate : m_Slots) {
+        if (candidate->State == SlotState::Free) {
+            slot = candidate.get();
+            break;
+        }
+    }
+    if (!slot) {
+        return false;
+    }
+
+    unsigned int size = (unsigned int) width * height * 4;
+    GLCall(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->Buffer));
+    if (slot->Capacity < size) {
+        GLCall(glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ));
+        slot->Capacity = size;
+    }
+    GLCall(glBindFramebuffer(GL_READ_FRAMEBUFFER, 0));
+    GLCall(glReadBuffer(GL_BACK));
+    GLCall(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+    // Into the bound pack buffer, this only queues the copy
+    GLCall(glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+    GLCall(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+    GLCall(slot->Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+
+    slot->State = SlotState::Reading;
+    slot->Width = width;
+    slot->Height = height;
+    slot->Format = format;
+    slot->Path = path;
+    slot->Frame = frame;
+    m_Stats.Queued++;
+    return true;
+}
+
+void FrameCapture::Collect(bool wait) {
+    for (const auto &slot : m_Slots) {
+        if (slot->State == SlotState::Encoding) {
+            if (wait) {
+                while (!slot->Done) {
+                    std::this_thread::yield();
+                }
+            }
+            if (slot->Done) {
+                GLCall(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->Buffer));
+                GLCall(glUnmapBuffer(GL_PIXEL_PACK_BUFFER));
+                GLCall(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+                slot->State = SlotState::Free;
+            }
+        }
+
+        if (slot->State == SlotState::Reading) {
+            GLuint64 timeout = wait ? 1000000000ull : 0;
+            GLCall(GLenum status = glClientWaitSync(slot->Fence, 0, timeout));
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+                continue;
+            }
+            GLCall(glDeleteSync(slot->Fence));
+            slot->Fence = nullptr;
+
+            // The copy is done, mapping won't block. The pointer stays valid until unmapped.
+            unsigned int size = (unsigned int) slot->Width * slot->Height * 4;
+            GLCall(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->Buffer));
+            GLCall(const unsigned char *pixels = (const unsigned char *) glMapBufferRange(
+                       GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT));
+            GLCall(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+            if (!pixels) {
+                slot->State = SlotState::Free;
+                continue;
+            }
+
+            slot->State = SlotState::Encoding;
+            slot->Done = false;
+            Slot *job = slot.get();
+            ThreadPool::Get().Submit([this, job, pixels]() { Encode(*job, pixels); });
+
+            if (wait) {
+                while (!slot->Done) {
+                    std::this_thread::yield();
+                }
+                GLCall(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->Buffer));
+                GLCall(glUnmapBuffer(GL_PIXEL_PACK_BUFFER));
+                GLCall(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+                slot->State = SlotState::Free;
+            }
+        }
+    }
+}
+
+void FrameCapture::Encode(Slot &slot, const unsigned char *pixels) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    bool written = false;
+    if (slot.Format == CaptureFormat::Png) {
+        written = WritePng(slot.Path, pixels, slot.Width, slot.Height);
+    } else {
+        // Top-down rows so the file plays back upright
+        std::lock_guard<std::mutex> lock(m_RawMutex);
+        if (!m_RawFile.is_open()) {
+            std::string path = slot.Path.substr(0, slot.Path.rfind('/')) + "/frames.rgba";
+            m_RawFile.open(path, std::ios::binary | std::ios::trunc);
+        }
+        size_t rowSize = (size_t) slot.Width * 4;
+        m_RawFile.seekp((std::streamoff) (rowSize * slot.Height * slot.Frame));
+        for (int y = slot.Height - 1; y >= 0; y--) {
+            m_RawFile.write((const char *) pixels + rowSize * y, rowSize);
+        }
+        written = (bool) m_RawFile;
+    }
+    if (!written) {
+        std::cerr << "Failed to write capture " << slot.Path << std::endl;
+    }
+
+    m_EncodeMicroseconds += (unsigned int) std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now() - start)
+                                .count();
+    m_Written++;
+    slot.Done = true;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class CaptureFormat { Png, Raw };
+
+struct FrameCaptureStats {
+    unsigned int Queued = 0;
+    unsigned int Written = 0;
+    // Frames of a sequence skipped because every buffer of the ring was still busy
+    unsigned int Dropped = 0;
+    // Time spent in EndFrame on the render thread
+    float LastMilliseconds = 0.0f;
+    float MaxMilliseconds = 0.0f;
+    // Average time a worker needs to encode and write one frame
+    float EncodeMilliseconds = 0.0f;
+};
+
+// Reads the back buffer into a ring of pixel pack buffers without stalling. Each read is
+// fenced, its buffer is only mapped once the fence has passed (normally a couple of frames
+// later) and the mapped pointer goes straight to a ThreadPool task that encodes it, so the
+// render thread never copies pixels. The buffer is unmapped and reused once the task is done.
+// Screenshots are PNG, sequences are numbered PNGs or one raw RGBA file.
+class FrameCapture {
+public:
+    FrameCapture(const std::string &directory = "captures", unsigned int ringSize = 3);
+    // Waits for everything still in flight, needs the GL context
+    ~FrameCapture();
+
+    // Captures the next frame
+    void Screenshot();
+    void StartSequence(CaptureFormat format);
+    void StopSequence();
+    inline bool IsRecording() const {
+        return m_Recording;
+    }
+
+    // Call after the frame is rendered and before swapping buffers
+    void EndFrame(int width, int height);
+
+    inline const FrameCaptureStats &GetStats() const {
+        return m_Stats;
+    }
+
+private:
+    enum class SlotState { Free, Reading, Encoding };
+
+    struct Slot {
+        unsigned int Buffer = 0;
+        unsigned int Capacity = 0;
+        GLsync Fence = nullptr;
+        SlotState State = SlotState::Free;
+        std::atomic<bool> Done { false };
+
+        int Width = 0;
+        int Height = 0;
+        CaptureFormat Format = CaptureFormat::Png;
+        std::string Path;
+        // Frame number inside a raw sequence
+        unsigned int Frame = 0;
+    };
+
+    void Collect(bool wait);
+    void Encode(Slot &slot, const unsigned char *pixels);
+    // Starts reading the back buffer into a free slot, false if there is none
+    bool Queue(int width, int height, CaptureFormat format, const std::string &path,
+        unsigned int frame);
+
+    std::string m_Directory;
+    std::vector<std::unique_ptr<Slot>> m_Slots;
+
+    bool m_ScreenshotRequested;
+    unsigned int m_Screenshots;
+    bool m_Recording;
+    CaptureFormat m_SequenceFormat;
+    std::string m_SequencePath;
+    unsigned int m_SequenceFrame;
+    int m_SequenceWidth;
+    int m_SequenceHeight;
+
+    // Raw sequences are one file, workers write their frame at its offset
+    std::mutex m_RawMutex;
+    std::ofstream m_RawFile;
+
+    FrameCaptureStats m_Stats;
+    std::atomic<unsigned int> m_Written;
+    std::atomic<unsigned int> m_EncodeMicroseconds;
+};
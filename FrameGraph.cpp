@@ -0,0 +1,470 @@
+#include "FrameGraph.h"
+
+#include "Renderer.h"
+
+#include <algorithm>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+namespace {
+
+// Textures nobody asked for in this many frames are deleted, e.g. after a resize
+const unsigned int c_TextureLifetime = 120;
+
+struct FormatInfo {
+    unsigned int Format;
+    unsigned int BaseFormat;
+    unsigned int Type;
+    unsigned int BytesPerPixel;
+};
+
+const FormatInfo c_Formats[] = {
+    { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4 },
+    { GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, 4 },
+    { GL_R11F_G11F_B10F, GL_RGB, GL_FLOAT, 4 },
+    { GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 8 },
+    { GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1 },
+    { GL_R32F, GL_RED, GL_FLOAT, 4 },
+    { GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 4 },
+    { GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, 4 },
+    { GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, 4 },
+};
+
+const FormatInfo *FindFormat(unsigned int format) {
+    for (const FormatInfo &info : c_Formats) {
+        if (info.Format == format) {
+            return &info;
+        }
+    }
+    return nullptr;
+}
+
+const char *GetLoadName(FrameGraphLoad load) {
+    switch (load) {
+    case FrameGraphLoad::Preserve: return "preserve";
+    case FrameGraphLoad::Clear: return "clear";
+    case FrameGraphLoad::DontCare: return "don't care";
+    }
+    return "";
+}
+
+}
+
+FrameGraphResource FrameGraphBuilder::Create(
+    const std::string &name, const FrameGraphTextureDesc &desc) {
+    ASSERT(FindFormat(desc.Format));
+    FrameGraph::Resource resource;
+    resource.Name = name;
+    resource.Kind = FrameGraph::ResourceKind::Transient;
+    resource.Desc = desc;
+    m_Graph.m_Resources.push_back(resource);
+    return (FrameGraphResource) m_Graph.m_Resources.size() - 1;
+}
+
+void FrameGraphBuilder::Read(FrameGraphResource resource) {
+    m_Graph.m_Passes[m_Pass].Reads.push_back(resource);
+}
+
+void FrameGraphBuilder::Write(FrameGraphResource resource, FrameGraphLoad load) {
+    m_Graph.m_Passes[m_Pass].Writes.push_back({ resource, load });
+}
+
+void FrameGraphBuilder::SetClearColor(const glm::vec4 &color) {
+    m_Graph.m_Passes[m_Pass].ClearColor = color;
+}
+
+void FrameGraphBuilder::SetViewport(int width, int height) {
+    m_Graph.m_Passes[m_Pass].ViewportWidth = width;
+    m_Graph.m_Passes[m_Pass].ViewportHeight = height;
+}
+
+FrameGraph::FrameGraph()
+    : m_Compiled(false)
+    , m_Frame(0)
+    , m_PassWidth(0)
+    , m_PassHeight(0) {
+}
+
+FrameGraph::~FrameGraph() {
+    m_Framebuffers.clear();
+    for (const PooledTexture &texture : m_Textures) {
+        GLCall(glDeleteTextures(1, &texture.RendererID));
+    }
+}
+
+void FrameGraph::Reset() {
+    m_Resources.clear();
+    m_Passes.clear();
+    m_Compiled = false;
+}
+
+FrameGraphResource FrameGraph::ImportBackbuffer(const std::string &name, int width, int height) {
+    Resource resource;
+    resource.Name = name;
+    resource.Kind = ResourceKind::Backbuffer;
+    resource.Desc = { width, height, GL_RGBA8 };
+    m_Resources.push_back(resource);
+    return (FrameGraphResource) m_Resources.size() - 1;
+}
+
+FrameGraphResource FrameGraph::ImportExternal(const std::string &name) {
+    Resource resource;
+    resource.Name = name;
+    resource.Kind = ResourceKind::External;
+    m_Resources.push_back(resource);
+    return (FrameGraphResource) m_Resources.size() - 1;
+}
+
+void FrameGraph::AddPass(const std::string &name, const SetupFunc &setup,
+    const ExecuteFunc &execute) {
+    Pass pass;
+    pass.Name = name;
+    pass.Execute = execute;
+    m_Passes.push_back(pass);
+
+    FrameGraphBuilder builder(*this, (unsigned int) m_Passes.size() - 1);
+    setup(builder);
+}
+
+void FrameGraph::Compile() {
+    m_Stats = FrameGraphStats();
+    m_Frame++;
+
+    CullPasses();
+    AssignTextures();
+    ReleaseUnusedTextures();
+    BuildReport();
+    m_Compiled = true;
+}
+
+void FrameGraph::CullPasses() {
+    // Walk backwards from the backbuffer. A pass is needed if it writes something a later
+    // needed pass reads. Clearing or overwriting a resource ends the interest in its previous
+    // contents, so earlier writers of it can go.
+    std::set<FrameGraphResource> needed;
+    for (FrameGraphResource i = 0; i < (FrameGraphResource) m_Resources.size(); i++) {
+        if (m_Resources[i].Kind == ResourceKind::Backbuffer) {
+            needed.insert(i);
+        }
+    }
+
+    for (int i = (int) m_Passes.size() - 1; i >= 0; i--) {
+        Pass &pass = m_Passes[i];
+        pass.Culled = std::none_of(pass.Writes.begin(), pass.Writes.end(),
+            [&](const ResourceWrite &write) { return needed.count(write.Handle) > 0; });
+        if (pass.Culled) {
+            m_Stats.CulledPasses++;
+            for (const ResourceWrite &write : pass.Writes) {
+                if (write.Load == FrameGraphLoad::Clear) {
+                    m_Stats.DroppedClears++;
+                }
+            }
+            continue;
+        }
+
+        for (const ResourceWrite &write : pass.Writes) {
+            if (write.Load != FrameGraphLoad::Preserve) {
+                needed.erase(write.Handle);
+            }
+        }
+        for (const ResourceWrite &write : pass.Writes) {
+            if (write.Load == FrameGraphLoad::Preserve) {
+                needed.insert(write.Handle);
+            }
+        }
+        for (FrameGraphResource read : pass.Reads) {
+            needed.insert(read);
+        }
+    }
+    m_Stats.Passes = (unsigned int) m_Passes.size();
+
+    for (int i = 0; i < (int) m_Passes.size(); i++) {
+        if (m_Passes[i].Culled) {
+            continue;
+        }
+        auto use = [&](FrameGraphResource handle) {
+            Resource &resource = m_Resources[handle];
+            if (resource.FirstPass < 0) {
+                resource.FirstPass = i;
+            }
+            resource.LastPass = i;
+        };
+        for (FrameGraphResource read : m_Passes[i].Reads) {
+            use(read);
+        }
+        for (const ResourceWrite &write : m_Passes[i].Writes) {
+            use(write.Handle);
+        }
+    }
+}
+
+void FrameGraph::AssignTextures() {
+    for (PooledTexture &texture : m_Textures) {
+        texture.BusyUntil = -1;
+    }
+
+    // In order of first use, so a texture freed by an earlier resource can be taken over
+    std::vector<FrameGraphResource> transients;
+    for (FrameGraphResource i = 0; i < (FrameGraphResource) m_Resources.size(); i++) {
+        const Resource &resource = m_Resources[i];
+        if (resource.Kind == ResourceKind::Transient && resource.FirstPass >= 0) {
+            transients.push_back(i);
+        }
+    }
+    std::stable_sort(transients.begin(), transients.end(),
+        [&](FrameGraphResource a, FrameGraphResource b) {
+            return m_Resources[a].FirstPass < m_Resources[b].FirstPass;
+        });
+
+    std::set<int> used;
+    for (FrameGraphResource handle : transients) {
+        Resource &resource = m_Resources[handle];
+        m_Stats.Transients++;
+        m_Stats.RequestedBytes += GetTextureSize(resource.Desc);
+
+        for (int i = 0; i < (int) m_Textures.size(); i++) {
+            PooledTexture &texture = m_Textures[i];
+            if (texture.Desc == resource.Desc && texture.BusyUntil < resource.FirstPass) {
+                resource.Texture = i;
+                break;
+            }
+        }
+
+        if (resource.Texture < 0) {
+            const FormatInfo *info = FindFormat(resource.Desc.Format);
+            PooledTexture texture;
+            texture.Desc = resource.Desc;
+            GLCall(glGenTextures(1, &texture.RendererID));
+            GLCall(glBindTexture(GL_TEXTURE_2D, texture.RendererID));
+            GLCall(glTexImage2D(GL_TEXTURE_2D, 0, info->Format, resource.Desc.Width,
+                resource.Desc.Height, 0, info->BaseFormat, info->Type, nullptr));
+            GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+            GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+            GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+            GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+            GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+            m_Textures.push_back(texture);
+            resource.Texture = (int) m_Textures.size() - 1;
+        }
+
+        PooledTexture &texture = m_Textures[resource.Texture];
+        texture.BusyUntil = resource.LastPass;
+        texture.LastUsedFrame = m_Frame;
+        if (used.insert(resource.Texture).second) {
+            m_Stats.Textures++;
+            m_Stats.AllocatedBytes += GetTextureSize(texture.Desc);
+        }
+    }
+}
+
+void FrameGraph::ReleaseUnusedTextures() {
+    for (int i = (int) m_Textures.size() - 1; i >= 0; i--) {
+        if (m_Frame - m_Textures[i].LastUsedFrame <= c_TextureLifetime) {
+            continue;
+        }
+        GLCall(glDeleteTextures(1, &m_Textures[i].RendererID));
+        m_Textures.erase(m_Textures.begin() + i);
+        for (Resource &resource : m_Resources) {
+            if (resource.Texture > i) {
+                resource.Texture--;
+            }
+        }
+        // Rare, simpler to rebuild every framebuffer than to find the ones using it
+        m_Framebuffers.clear();
+    }
+}
+
+void FrameGraph::BuildReport() {
+    std::stringstream ss;
+    ss << "Frame " << m_Frame << ": " << m_Stats.Passes << " passes (" << m_Stats.CulledPasses
+       << " culled), " << m_Stats.Transients << " transients in " << m_Stats.Textures
+       << " textures (" << m_Stats.AllocatedBytes / 1024 << " of "
+       << m_Stats.RequestedBytes / 1024 << " KB)\n";
+
+    auto describe = [&](FrameGraphResource handle) {
+        const Resource &resource = m_Resources[handle];
+        ss << resource.Name;
+        if (resource.Kind == ResourceKind::Transient && resource.Texture >= 0) {
+            ss << " [texture " << m_Textures[resource.Texture].RendererID << "]";
+        } else if (resource.Kind == ResourceKind::External) {
+            ss << " [external]";
+        }
+    };
+
+    for (const Pass &pass : m_Passes) {
+        ss << "  " << pass.Name << (pass.Culled ? " (culled)" : "") << ":";
+        if (!pass.Reads.empty()) {
+            ss << " reads";
+            for (FrameGraphResource read : pass.Reads) {
+                ss << " ";
+                describe(read);
+            }
+            ss << ";";
+        }
+        if (!pass.Writes.empty()) {
+            ss << " writes";
+            for (const ResourceWrite &write : pass.Writes) {
+                ss << " ";
+                describe(write.Handle);
+                ss << " (" << GetLoadName(write.Load) << ")";
+            }
+        }
+        ss << "\n";
+    }
+    m_Report = ss.str();
+}
+
+void FrameGraph::Execute() {
+    if (!m_Compiled) {
+        Compile();
+    }
+
+    GLint viewport[4];
+    GLCall(glGetIntegerv(GL_VIEWPORT, viewport));
+
+    for (unsigned int i = 0; i < m_Passes.size(); i++) {
+        if (m_Passes[i].Culled) {
+            continue;
+        }
+        BeginPass(i);
+        m_Passes[i].Execute(*this);
+        EndPass(i);
+    }
+
+    GLCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+    GLCall(glViewport(viewport[0], viewport[1], viewport[2], viewport[3]));
+}
+
+void FrameGraph::BeginPass(unsigned int index) {
+    const Pass &pass = m_Passes[index];
+
+    const Resource *backbuffer = nullptr;
+    std::vector<unsigned int> colors;
+    unsigned int depth = 0;
+    bool stencil = false;
+    const Resource *target = nullptr;
+    for (const ResourceWrite &write : pass.Writes) {
+        const Resource &resource = m_Resources[write.Handle];
+        if (resource.Kind == ResourceKind::Backbuffer) {
+            backbuffer = &resource;
+        } else if (resource.Kind == ResourceKind::Transient) {
+            unsigned int texture = m_Textures[resource.Texture].RendererID;
+            if (IsDepthFormat(resource.Desc.Format)) {
+                depth = texture;
+                stencil = resource.Desc.Format == GL_DEPTH24_STENCIL8;
+            } else {
+                colors.push_back(texture);
+            }
+            target = &resource;
+        }
+    }
+
+    // Passes that only write external resources bind their own targets
+    if (backbuffer) {
+        GLCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+        target = backbuffer;
+    } else if (target) {
+        GetFramebuffer(colors, depth, stencil).Bind();
+    } else {
+        return;
+    }
+    m_PassWidth = pass.ViewportWidth > 0 ? pass.ViewportWidth : target->Desc.Width;
+    m_PassHeight = pass.ViewportHeight > 0 ? pass.ViewportHeight : target->Desc.Height;
+    GLCall(glViewport(0, 0, m_PassWidth, m_PassHeight));
+
+    // Only the first write of a transient can skip its clear, before that it has no contents
+    unsigned int colorIndex = 0;
+    for (const ResourceWrite &write : pass.Writes) {
+        const Resource &resource = m_Resources[write.Handle];
+        if (resource.Kind == ResourceKind::External) {
+            continue;
+        }
+        bool depthTarget = resource.Kind == ResourceKind::Transient
+            && IsDepthFormat(resource.Desc.Format);
+        if (write.Load == FrameGraphLoad::Clear) {
+            if (depthTarget) {
+                GLCall(glDepthMask(GL_TRUE));
+                GLCall(glClearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0));
+            } else if (resource.Kind == ResourceKind::Backbuffer) {
+                GLCall(glClearColor(
+                    pass.ClearColor.r, pass.ClearColor.g, pass.ClearColor.b, pass.ClearColor.a));
+                GLCall(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+            } else {
+                GLCall(glClearBufferfv(GL_COLOR, colorIndex, &pass.ClearColor.r));
+            }
+            m_Stats.Clears++;
+        } else if (write.Load == FrameGraphLoad::Preserve
+            && resource.Kind == ResourceKind::Transient && resource.FirstPass == (int) index) {
+            m_Stats.DroppedClears++;
+        }
+        if (resource.Kind == ResourceKind::Transient && !depthTarget) {
+            colorIndex++;
+        }
+    }
+}
+
+void FrameGraph::EndPass(unsigned int index) {
+    // Nothing reads these again this frame, let the driver drop them instead of storing them
+    if (!GLEW_ARB_invalidate_subdata) {
+        return;
+    }
+    for (const Resource &resource : m_Resources) {
+        if (resource.Kind == ResourceKind::Transient && resource.LastPass == (int) index) {
+            GLCall(glInvalidateTexImage(m_Textures[resource.Texture].RendererID, 0));
+            m_Stats.Invalidates++;
+        }
+    }
+}
+
+unsigned int FrameGraph::GetTexture(FrameGraphResource resource) const {
+    const Resource &r = m_Resources[resource];
+    ASSERT(r.Kind == ResourceKind::Transient && r.Texture >= 0);
+    return m_Textures[r.Texture].RendererID;
+}
+
+const FrameGraphTextureDesc &FrameGraph::GetDesc(FrameGraphResource resource) const {
+    return m_Resources[resource].Desc;
+}
+
+void FrameGraph::Blit(FrameGraphResource source, unsigned int filter) const {
+    const FrameGraphTextureDesc &desc = GetDesc(source);
+
+    GLint drawFramebuffer = 0;
+    GLCall(glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer));
+    Framebuffer &read = GetFramebuffer({ GetTexture(source) }, 0, false);
+    GLCall(glBindFramebuffer(GL_READ_FRAMEBUFFER, read.GetRendererID()));
+    GLCall(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer));
+    GLCall(glBlitFramebuffer(0, 0, desc.Width, desc.Height, 0, 0, m_PassWidth, m_PassHeight,
+        GL_COLOR_BUFFER_BIT, filter));
+    GLCall(glBindFramebuffer(GL_FRAMEBUFFER, drawFramebuffer));
+}
+
+Framebuffer &FrameGraph::GetFramebuffer(
+    const std::vector<unsigned int> &colors, unsigned int depth, bool stencil) const {
+    std::vector<unsigned int> key = colors;
+    key.push_back(depth);
+
+    std::unique_ptr<Framebuffer> &framebuffer = m_Framebuffers[key];
+    if (!framebuffer) {
+        framebuffer = std::make_unique<Framebuffer>();
+        for (unsigned int i = 0; i < colors.size(); i++) {
+            framebuffer->AttachColor(i, colors[i]);
+        }
+        if (depth) {
+            framebuffer->AttachDepth(depth, stencil);
+        }
+        framebuffer->Finalize();
+    }
+    return *framebuffer;
+}
+
+bool FrameGraph::IsDepthFormat(unsigned int format) {
+    return format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F
+        || format == GL_DEPTH24_STENCIL8;
+}
+
+size_t FrameGraph::GetTextureSize(const FrameGraphTextureDesc &desc) {
+    const FormatInfo *info = FindFormat(desc.Format);
+    return (size_t) desc.Width * desc.Height * (info ? info->BytesPerPixel : 4);
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "Framebuffer.h"
+
+#include <GL/glew.h>
+#include <functional>
+#include <glm/glm.hpp>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Handle to a resource of the frame being built, only valid until the next Reset
+using FrameGraphResource = int;
+
+// What a pass needs from a resource it writes: its previous contents, a clear or nothing
+enum class FrameGraphLoad { Preserve, Clear, DontCare };
+
+struct FrameGraphTextureDesc {
+    int Width = 0;
+    int Height = 0;
+    // Sized internal format, GL_DEPTH_* formats become depth attachments
+    unsigned int Format = GL_RGBA8;
+
+    bool operator==(const FrameGraphTextureDesc &other) const {
+        return Width == other.Width && Height == other.Height && Format == other.Format;
+    }
+};
+
+struct FrameGraphStats {
+    unsigned int Passes = 0;
+    unsigned int CulledPasses = 0;
+    unsigned int Transients = 0;
+    // Textures backing the transients after aliasing
+    unsigned int Textures = 0;
+    size_t RequestedBytes = 0;
+    size_t AllocatedBytes = 0;
+    unsigned int Clears = 0;
+    // Clears (and loads of undefined contents) that were skipped
+    unsigned int DroppedClears = 0;
+    unsigned int Invalidates = 0;
+};
+
+class FrameGraph;
+
+// Handed to a pass's setup function to declare what it creates, reads and writes
+class FrameGraphBuilder {
+public:
+    FrameGraphResource Create(const std::string &name, const FrameGraphTextureDesc &desc);
+    void Read(FrameGraphResource resource);
+    void Write(FrameGraphResource resource, FrameGraphLoad load = FrameGraphLoad::Preserve);
+    void SetClearColor(const glm::vec4 &color);
+    // Renders to the lower left width x height of the targets instead of all of them, e.g.
+    // for dynamic resolution without reallocating anything
+    void SetViewport(int width, int height);
+
+private:
+    friend class FrameGraph;
+    FrameGraphBuilder(FrameGraph &graph, unsigned int pass)
+        : m_Graph(graph)
+        , m_Pass(pass) {
+    }
+
+    FrameGraph &m_Graph;
+    unsigned int m_Pass;
+};
+
+// Rebuilt every frame: passes declare the textures they read and write, Compile drops the
+// passes nothing depends on and lets transient textures with disjoint lifetimes share one GL
+// texture, Execute binds each pass's targets and clears only what needs clearing. Textures and
+// framebuffers are pooled across frames.
+class FrameGraph {
+public:
+    using SetupFunc = std::function<void(FrameGraphBuilder &builder)>;
+    using ExecuteFunc = std::function<void(const FrameGraph &graph)>;
+
+    FrameGraph();
+    ~FrameGraph();
+
+    // Forgets the passes and resources of the previous frame
+    void Reset();
+
+    // The default framebuffer. Anything that ends up here is the frame's output.
+    FrameGraphResource ImportBackbuffer(const std::string &name, int width, int height);
+    // Owned and bound by someone else (e.g. the shadow map), only used to order and cull passes
+    FrameGraphResource ImportExternal(const std::string &name);
+
+    void AddPass(const std::string &name, const SetupFunc &setup, const ExecuteFunc &execute);
+
+    void Compile();
+    void Execute();
+
+    // For execute functions: the GL texture behind a transient
+    unsigned int GetTexture(FrameGraphResource resource) const;
+    const FrameGraphTextureDesc &GetDesc(FrameGraphResource resource) const;
+    // Copies source into the current pass's targets, scaled to fill the viewport
+    void Blit(FrameGraphResource source, unsigned int filter = GL_NEAREST) const;
+
+    inline const FrameGraphStats &GetStats() const {
+        return m_Stats;
+    }
+    // One line per pass with the resources it uses and the textures behind them
+    inline const std::string &GetReport() const {
+        return m_Report;
+    }
+
+private:
+    friend class FrameGraphBuilder;
+
+    enum class ResourceKind { Transient, Backbuffer, External };
+
+    struct Resource {
+        std::string Name;
+        ResourceKind Kind;
+        FrameGraphTextureDesc Desc;
+        // First and last live pass using it, -1 if none
+        int FirstPass = -1;
+        int LastPass = -1;
+        // Index into m_Textures for transients
+        int Texture = -1;
+    };
+
+    struct ResourceWrite {
+        FrameGraphResource Handle;
+        FrameGraphLoad Load;
+    };
+
+    struct Pass {
+        std::string Name;
+        ExecuteFunc Execute;
+        std::vector<FrameGraphResource> Reads;
+        std::vector<ResourceWrite> Writes;
+        glm::vec4 ClearColor = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        // 0 for the size of the targets
+        int ViewportWidth = 0;
+        int ViewportHeight = 0;
+        bool Culled = false;
+    };
+
+    struct PooledTexture {
+        unsigned int RendererID;
+        FrameGraphTextureDesc Desc;
+        // Last pass of this frame that uses it, -1 while free
+        int BusyUntil;
+        unsigned int LastUsedFrame;
+    };
+
+    void CullPasses();
+    void AssignTextures();
+    void ReleaseUnusedTextures();
+    void BuildReport();
+    void BeginPass(unsigned int index);
+    void EndPass(unsigned int index);
+    Framebuffer &GetFramebuffer(const std::vector<unsigned int> &colors, unsigned int depth,
+        bool stencil) const;
+
+    static bool IsDepthFormat(unsigned int format);
+    static size_t GetTextureSize(const FrameGraphTextureDesc &desc);
+
+    std::vector<Resource> m_Resources;
+    std::vector<Pass> m_Passes;
+    bool m_Compiled;
+
+    std::vector<PooledTexture> m_Textures;
+    // Keyed by the attached textures, colors followed by depth
+    mutable std::map<std::vector<unsigned int>, std::unique_ptr<Framebuffer>> m_Framebuffers;
+    unsigned int m_Frame;
+
+    // Viewport of the current pass, Blit targets it
+    int m_PassWidth;
+    int m_PassHeight;
+
+    FrameGraphStats m_Stats;
+    std::string m_Report;
+};
@@ -0,0 +1,52 @@
+#include "Framebuffer.h"
+
+#include "Renderer.h"
+
+#include <iostream>
+
+Framebuffer::Framebuffer() {
+    GLCall(glGenFramebuffers(1, &m_RendererID));
+}
+
+Framebuffer::~Framebuffer() {
+    GLCall(glDeleteFramebuffers(1, &m_RendererID));
+}
+
+void Framebuffer::AttachColor(unsigned int index, unsigned int texture) {
+    Bind();
+    GLCall(glFramebufferTexture2D(
+        GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + index, GL_TEXTURE_2D, texture, 0));
+    m_ColorAttachments.push_back(GL_COLOR_ATTACHMENT0 + index);
+}
+
+void Framebuffer::AttachDepth(unsigned int texture, bool stencil) {
+    Bind();
+    GLCall(glFramebufferTexture2D(GL_FRAMEBUFFER,
+        stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0));
+}
+
+bool Framebuffer::Finalize() {
+    Bind();
+    if (m_ColorAttachments.empty()) {
+        GLCall(glDrawBuffer(GL_NONE));
+        GLCall(glReadBuffer(GL_NONE));
+    } else {
+        GLCall(glDrawBuffers((GLsizei) m_ColorAttachments.size(), m_ColorAttachments.data()));
+    }
+
+    GLCall(GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER));
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Framebuffer is incomplete (0x" << std::hex << status << std::dec << ")"
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void Framebuffer::Bind() const {
+    GLCall(glBindFramebuffer(GL_FRAMEBUFFER, m_RendererID));
+}
+
+void Framebuffer::UnBind() const {
+    GLCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+// Framebuffer object with 2D texture attachments
+class Framebuffer {
+public:
+    Framebuffer();
+    ~Framebuffer();
+
+    Framebuffer(const Framebuffer &) = delete;
+    Framebuffer &operator=(const Framebuffer &) = delete;
+
+    void AttachColor(unsigned int index, unsigned int texture);
+    // Stencil as well for packed depth stencil textures
+    void AttachDepth(unsigned int texture, bool stencil = false);
+    // Routes fragment outputs to the attached colors, false if the driver rejects the combination
+    bool Finalize();
+
+    void Bind() const;
+    void UnBind() const;
+
+    inline unsigned int GetRendererID() const {
+        return m_RendererID;
+    }
+
+private:
+    unsigned int m_RendererID;
+    std::vector<unsigned int> m_ColorAttachments;
+};
@@ -0,0 +1,155 @@
+#include "GLDebug.h"
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<const GLCallSite *> g_GLCurrentCallSite(nullptr);
+std::atomic<bool> g_GLDebugError(false);
+#ifdef _DEBUG
+// Until GLDebugInit finds KHR_debug, fall back to draining glGetError around every call
+bool g_GLPollErrors = true;
+#else
+bool g_GLPollErrors = false;
+#endif
+
+namespace {
+
+std::mutex s_CallSiteMutex;
+std::vector<std::unique_ptr<GLCallSite>> s_CallSites;
+bool s_CallbackActive = false;
+bool s_Synchronous = false;
+
+const char *GetTypeName(GLenum type) {
+    switch (type) {
+    case GL_DEBUG_TYPE_ERROR: return "Error";
+    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "Deprecated";
+    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "Undefined behavior";
+    case GL_DEBUG_TYPE_PORTABILITY: return "Portability";
+    case GL_DEBUG_TYPE_PERFORMANCE: return "Performance";
+    default: return "Other";
+    }
+}
+
+void GLAPIENTRY DebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
+    GLsizei length, const GLchar *message, const void *userParam) {
+    (void) source;
+    (void) length;
+    (void) userParam;
+
+    if (severity == GL_DEBUG_SEVERITY_NOTIFICATION) {
+        return;
+    }
+
+    std::cerr << "[OpenGL " << GetTypeName(type) << "] (" << id << "): " << message;
+    const GLCallSite *site = g_GLCurrentCallSite.load(std::memory_order_relaxed);
+    if (site) {
+        std::cerr << (s_Synchronous ? " at " : " near ") << site->Function << " " << site->File
+                  << ":" << site->Line;
+    }
+    std::cerr << std::endl;
+
+    if (type == GL_DEBUG_TYPE_ERROR && s_Synchronous) {
+        g_GLDebugError.store(true, std::memory_order_relaxed);
+    }
+}
+
+}
+
+GLCallSite *GLRegisterCallSite(const char *function, const char *file, int line) {
+    std::lock_guard<std::mutex> lock(s_CallSiteMutex);
+    GLCallSite *site = s_CallSites.emplace_back(std::make_unique<GLCallSite>()).get();
+    site->Function = function;
+    site->File = file;
+    site->Line = line;
+    site->Count.store(0, std::memory_order_relaxed);
+    return site;
+}
+
+void GLDebugInit(bool synchronous) {
+#ifdef _DEBUG
+    if (!GLEW_KHR_debug) {
+        std::cout << "KHR_debug unavailable, checking glGetError after every GL call"
+                  << std::endl;
+        return;
+    }
+
+    s_Synchronous = synchronous;
+    glEnable(GL_DEBUG_OUTPUT);
+    if (synchronous) {
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    } else {
+        glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    }
+    glDebugMessageCallback(DebugCallback, nullptr);
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+
+    s_CallbackActive = true;
+    g_GLPollErrors = false;
+    std::cout << "GL errors reported through KHR_debug ("
+              << (synchronous ? "synchronous" : "asynchronous") << ")" << std::endl;
+#else
+    (void) synchronous;
+#endif
+}
+
+bool GLDebugIsCallbackActive() {
+    return s_CallbackActive;
+}
+
+size_t GLGetCallSites(const GLCallSite **sites, size_t maxSites) {
+    std::lock_guard<std::mutex> lock(s_CallSiteMutex);
+    std::vector<const GLCallSite *> sorted;
+    sorted.reserve(s_CallSites.size());
+    for (const auto &site : s_CallSites) {
+        sorted.push_back(site.get());
+    }
+    size_t count = std::min(maxSites, sorted.size());
+    std::partial_sort(sorted.begin(), sorted.begin() + count, sorted.end(),
+        [](const GLCallSite *a, const GLCallSite *b) {
+            return a->Count.load(std::memory_order_relaxed)
+                > b->Count.load(std::memory_order_relaxed);
+        });
+    std::copy(sorted.begin(), sorted.begin() + count, sites);
+    return count;
+}
+
+void GLDumpCallCounters(std::ostream &stream, size_t maxSites) {
+#ifdef SPARTAN_GL_CALL_COUNTERS
+    std::vector<const GLCallSite *> sites(maxSites);
+    sites.resize(GLGetCallSites(sites.data(), maxSites));
+    stream << "GL call sites by invocation count:" << std::endl;
+    for (const GLCallSite *site : sites) {
+        stream << "  " << site->Count.load(std::memory_order_relaxed) << "\t" << site->File
+               << ":" << site->Line << " " << site->Function << std::endl;
+    }
+#else
+    (void) stream;
+    (void) maxSites;
+#endif
+}
+
+void GLResetCallCounters() {
+    std::lock_guard<std::mutex> lock(s_CallSiteMutex);
+    for (auto &site : s_CallSites) {
+        site->Count.store(0, std::memory_order_relaxed);
+    }
+}
+
+void GLClearError() {
+    while (glGetError() != GL_NO_ERROR) {
+        ;
+    }
+}
+
+bool GLLogCall(const char *function, const char *file, int line) {
+    while (GLenum error = glGetError()) {
+        std::cerr << "[OpenGL Error] (" << error << "): " << function << " " << file << ":" << line
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <ostream>
+
+// One per GLCall in the source, created the first time that line runs. Count is bumped by the
+// render thread and read by the main thread's UI, relaxed is enough for a counter.
+struct GLCallSite {
+    const char *Function;
+    const char *File;
+    int Line;
+    std::atomic<unsigned long long> Count;
+};
+
+GLCallSite *GLRegisterCallSite(const char *function, const char *file, int line);
+
+// Routes GL errors through glDebugMessageCallback when KHR_debug is available. Messages are
+// asynchronous (and attributed to the most recent GLCall) unless synchronous is set, in which
+// case the failing GLCall asserts. Without KHR_debug every GLCall polls glGetError instead.
+void GLDebugInit(bool synchronous);
+bool GLDebugIsCallbackActive();
+
+// Call sites sorted by invocation count, only counted with SPARTAN_GL_CALL_COUNTERS
+void GLDumpCallCounters(std::ostream &stream, size_t maxSites);
+void GLResetCallCounters();
+size_t GLGetCallSites(const GLCallSite **sites, size_t maxSites);
+
+void GLClearError();
+bool GLLogCall(const char *function, const char *file, int line);
+
+extern std::atomic<const GLCallSite *> g_GLCurrentCallSite;
+extern bool g_GLPollErrors;
+// Set by the callback on the thread that made the failing call, read back by GLEndCall
+extern std::atomic<bool> g_GLDebugError;
+
+inline void GLBeginCall(GLCallSite *site) {
+    g_GLCurrentCallSite.store(site, std::memory_order_relaxed);
+#ifdef SPARTAN_GL_CALL_COUNTERS
+    site->Count.fetch_add(1, std::memory_order_relaxed);
+#endif
+    if (g_GLPollErrors) {
+        GLClearError();
+    }
+}
+
+inline bool GLEndCall() {
+    if (g_GLPollErrors) {
+        const GLCallSite *site = g_GLCurrentCallSite.load(std::memory_order_relaxed);
+        return GLLogCall(site->Function, site->File, site->Line);
+    }
+    // Only set by the callback in synchronous mode, so it belongs to this call
+    return !g_GLDebugError.exchange(false, std::memory_order_relaxed);
+}
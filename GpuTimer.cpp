@@ -0,0 +1,44 @@
+#include "GpuTimer.h"
+
+#include "Renderer.h"
+
+GpuTimer::GpuTimer(unsigned int latency)
+    : m_Slots(latency)
+    , m_Index(0)
+    , m_Milliseconds(0.0f) {
+    for (auto &slot : m_Slots) {
+        GLCall(glGenQueries(1, &slot.Begin));
+        GLCall(glGenQueries(1, &slot.End));
+        slot.Issued = false;
+    }
+}
+
+GpuTimer::~GpuTimer() {
+    for (auto &slot : m_Slots) {
+        GLCall(glDeleteQueries(1, &slot.Begin));
+        GLCall(glDeleteQueries(1, &slot.End));
+    }
+}
+
+void GpuTimer::Begin() {
+    Slot &slot = m_Slots[m_Index];
+    if (slot.Issued) {
+        // Skip the reading rather than stall if the GPU is further behind than expected
+        int available = 0;
+        GLCall(glGetQueryObjectiv(slot.End, GL_QUERY_RESULT_AVAILABLE, &available));
+        if (available) {
+            GLuint64 begin, end;
+            GLCall(glGetQueryObjectui64v(slot.Begin, GL_QUERY_RESULT, &begin));
+            GLCall(glGetQueryObjectui64v(slot.End, GL_QUERY_RESULT, &end));
+            m_Milliseconds = (end - begin) / 1000000.0f;
+        }
+    }
+    GLCall(glQueryCounter(slot.Begin, GL_TIMESTAMP));
+}
+
+void GpuTimer::End() {
+    Slot &slot = m_Slots[m_Index];
+    GLCall(glQueryCounter(slot.End, GL_TIMESTAMP));
+    slot.Issued = true;
+    m_Index = (m_Index + 1) % m_Slots.size();
+}
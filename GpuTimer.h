@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+// Measures GPU time between Begin and End with timestamp queries. Results are read back a few
+// frames later so the CPU never waits for them; timestamps (unlike GL_TIME_ELAPSED) may nest.
+class GpuTimer {
+private:
+    struct Slot {
+        unsigned int Begin;
+        unsigned int End;
+        bool Issued;
+    };
+
+    std::vector<Slot> m_Slots;
+    unsigned int m_Index;
+    float m_Milliseconds;
+
+public:
+    GpuTimer(unsigned int latency = 4);
+    ~GpuTimer();
+
+    void Begin();
+    void End();
+
+    // Most recent result available, in milliseconds
+    inline float GetMilliseconds() const {
+        return m_Milliseconds;
+    }
+};
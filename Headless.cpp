@@ -0,0 +1,146 @@
+#include "Headless.h"
+
+#include "Cube.h"
+#include "ImageWriter.h"
+#include "Plane.h"
+#include "Renderer.h"
+#include "SoftwareRenderer.h"
+#include "SoftwareShaders.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <chrono>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const unsigned int c_Width = 1920;
+const unsigned int c_Height = 1080;
+// Fixed time step of a test's OnUpdate
+const float c_FrameTime = 1.0f / 60.0f;
+// Cubes per side of the grid
+const int c_GridSize = 16;
+const int c_FloorSegments = 32;
+
+float Milliseconds(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::high_resolution_clock::now() - start)
+        .count();
+}
+
+// Returns the milliseconds spent on the frames
+float RenderScene(SoftwareRenderer &renderer, unsigned int frames) {
+    std::vector<CubeVertex> cubeVertices(Cube::VertexCount);
+    std::vector<unsigned int> cubeIndices(Cube::IndexCount);
+    Cube::generateCube(cubeVertices.data(), cubeIndices.data());
+
+    std::vector<GridVertex> floorVertices((c_FloorSegments + 1) * (c_FloorSegments + 1));
+    std::vector<unsigned int> floorIndices(c_FloorSegments * c_FloorSegments * 6);
+    Plane::generatePlane(
+        c_FloorSegments, c_FloorSegments, floorVertices.data(), floorIndices.data());
+
+    const glm::vec3 markerVertices[] = { { -0.5f, 0.0f, 0.0f }, { 0.5f, 0.0f, 0.0f },
+        { 0.0f, 1.0f, 0.0f } };
+    const unsigned int markerIndices[] = { 0, 1, 2 };
+
+    glm::mat4 proj
+        = glm::perspective(glm::radians(45.0f), (float) c_Width / c_Height, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(
+        glm::vec3(0.0f, 9.0f, 18.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 viewProj = proj * view;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        float time = frame / 60.0f;
+        renderer.Clear(glm::vec4(0.1f, 0.1f, 0.1f, 1.0f));
+
+        SoftwareShaders::Plane floor;
+        floor.MVP = viewProj
+            * glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f))
+            * glm::scale(glm::mat4(1.0f), glm::vec3(40.0f));
+        renderer.Draw(floorVertices.data(), (unsigned int) floorVertices.size(),
+            floorIndices.data(), (unsigned int) floorIndices.size(), floor);
+
+        SoftwareShaders::Normal cube;
+        for (int z = 0; z < c_GridSize; z++) {
+            for (int x = 0; x < c_GridSize; x++) {
+                float phase = (x * 7 + z * 13) * 0.1f;
+                glm::vec3 position((x - c_GridSize / 2 + 0.5f) * 2.0f,
+                    0.75f + 0.25f * glm::sin(time * 2.0f + phase),
+                    (z - c_GridSize / 2 + 0.5f) * 2.0f);
+                glm::mat4 model = glm::translate(glm::mat4(1.0f), position)
+                    * glm::rotate(glm::mat4(1.0f), time + phase,
+                        glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)));
+                cube.MVP = viewProj * model;
+                renderer.Draw(cubeVertices.data(), Cube::VertexCount, cubeIndices.data(),
+                    Cube::IndexCount, cube);
+            }
+        }
+
+        SoftwareShaders::Basic marker;
+        marker.MVP = viewProj * glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 2.5f, 0.0f))
+            * glm::rotate(glm::mat4(1.0f), time, glm::vec3(0.0f, 1.0f, 0.0f))
+            * glm::scale(glm::mat4(1.0f), glm::vec3(2.0f));
+        marker.Color = glm::vec4(1.0f, 0.5f, 0.2f, 1.0f);
+        renderer.Draw(markerVertices, 3, markerIndices, 3, marker);
+
+        renderer.Flush();
+    }
+    return Milliseconds(start);
+}
+
+// The frame loop of main without the UI and the render thread
+float RenderTest(SoftwareRenderer &renderer, const std::function<test::Test *()> &createTest,
+    unsigned int frames) {
+    // The test's buffers and shaders are created, and destroyed, on the software backend
+    Renderer::SetSoftwareBackend(&renderer);
+    std::unique_ptr<test::Test> test(createTest());
+    test->OnWindowResize(c_Width, c_Height);
+
+    Renderer screen;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        test->OnUpdate(c_FrameTime);
+        test->OnSync();
+        screen.Clear();
+        test->OnRender();
+        renderer.Flush();
+    }
+    float elapsed = Milliseconds(start);
+
+    test.reset();
+    Renderer::SetSoftwareBackend(nullptr);
+    return elapsed;
+}
+
+}
+
+int RunHeadless(const std::string &outputPath, const std::function<test::Test *()> &createTest,
+    unsigned int frames) {
+    SoftwareRenderer renderer(c_Width, c_Height);
+    float elapsed = createTest ? RenderTest(renderer, createTest, frames)
+                               : RenderScene(renderer, frames);
+
+    const SoftwareRendererStats &stats = renderer.GetStats();
+    float count = (float) std::max(frames, 1u);
+    std::cout << "Rendered " << frames << " frames at " << c_Width << "x" << c_Height << " in "
+              << elapsed << " ms, " << elapsed / count << " ms/frame (vertex "
+              << stats.VertexTime / count << ", setup " << stats.SetupTime / count
+              << ", raster " << stats.RasterTime / count << ")" << std::endl;
+    std::cout << "Per frame: " << stats.Triangles / count << " triangles, "
+              << stats.Culled / count << " culled, " << stats.Clipped / count << " clipped, "
+              << stats.Binned / count << " tile bins, " << stats.Pixels / count << " pixels"
+              << std::endl;
+
+    std::vector<unsigned char> pixels;
+    renderer.ReadPixels(pixels);
+    if (!WritePng(outputPath, pixels.data(), c_Width, c_Height)) {
+        std::cerr << "Failed to write " << outputPath << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << outputPath << std::endl;
+    return 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+namespace test {
+class Test;
+}
+
+// Renders with SoftwareRenderer, without a window or a GL context, prints the timings and writes
+// the last frame to outputPath as PNG. With createTest the test runs as in the main loop, with
+// Renderer routing its draws to the CPU (see Renderer::SetSoftwareBackend), so it has to be one
+// registered with software set (TestMenu::RegisterTest). Without it a fixed scene of cubes over
+// a floor is drawn directly. Time comes from the frame number, so the image is the same on
+// every run and every machine with the same float behaviour. Returns the process exit code.
+int RunHeadless(const std::string &outputPath,
+    const std::function<test::Test *()> &createTest = nullptr, unsigned int frames = 120);
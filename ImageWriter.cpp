@@ -0,0 +1,100 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+uint32_t Crc32(uint32_t crc, const unsigned char *data, size_t length) {
+    static const std::vector<uint32_t> table = [] {
+        std::vector<uint32_t> table(256);
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        return table;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void PutBigEndian(std::vector<unsigned char> &out, uint32_t value) {
+    out.push_back((unsigned char) (value >> 24));
+    out.push_back((unsigned char) (value >> 16));
+    out.push_back((unsigned char) (value >> 8));
+    out.push_back((unsigned char) value);
+}
+
+void WriteChunk(std::ofstream &stream, const char *type, const std::vector<unsigned char> &data) {
+    std::vector<unsigned char> chunk;
+    chunk.reserve(data.size() + 12);
+    PutBigEndian(chunk, (uint32_t) data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    PutBigEndian(chunk, Crc32(0, chunk.data() + 4, data.size() + 4));
+    stream.write((const char *) chunk.data(), chunk.size());
+}
+
+}
+
+bool WritePng(const std::string &path, const unsigned char *pixels, int width, int height) {
+    const size_t rowSize = (size_t) width * 4;
+    const size_t streamSize = (rowSize + 1) * height;
+
+    std::vector<unsigned char> idat;
+    idat.reserve(streamSize + streamSize / 65535 * 5 + 16);
+    idat.push_back(0x78);
+    idat.push_back(0x01);
+
+    uint32_t a = 1, b = 0;
+    size_t blockLeft = 0;
+    size_t remaining = streamSize;
+    auto put = [&](unsigned char value) {
+        if (blockLeft == 0) {
+            blockLeft = std::min<size_t>(remaining, 65535);
+            remaining -= blockLeft;
+            idat.push_back(remaining == 0 ? 1 : 0);
+            idat.push_back((unsigned char) blockLeft);
+            idat.push_back((unsigned char) (blockLeft >> 8));
+            idat.push_back((unsigned char) ~blockLeft);
+            idat.push_back((unsigned char) (~blockLeft >> 8));
+        }
+        idat.push_back(value);
+        blockLeft--;
+        a = (a + value) % 65521;
+        b = (b + a) % 65521;
+    };
+    for (int y = height - 1; y >= 0; y--) {
+        put(0); // No filter
+        const unsigned char *row = pixels + rowSize * y;
+        for (size_t x = 0; x < rowSize; x++) {
+            put(row[x]);
+        }
+    }
+    PutBigEndian(idat, (b << 16) | a);
+
+    std::vector<unsigned char> header;
+    PutBigEndian(header, width);
+    PutBigEndian(header, height);
+    header.insert(header.end(), { 8, 6, 0, 0, 0 }); // 8 bit RGBA, no interlacing
+
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream) {
+        return false;
+    }
+    const unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    stream.write((const char *) signature, sizeof(signature));
+    WriteChunk(stream, "IHDR", header);
+    WriteChunk(stream, "IDAT", idat);
+    WriteChunk(stream, "IEND", {});
+    return (bool) stream;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+// RGBA8 PNG of bottom-up rows (as glReadPixels returns them). The image data uses stored
+// deflate blocks: no zlib dependency and no compression time on the caller, at the price of
+// file size.
+bool WritePng(const std::string &path, const unsigned char *pixels, int width, int height);
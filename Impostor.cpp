@@ -0,0 +1,272 @@
+#include "Impostor.h"
+
+#include "Renderer.h"
+#include "ResourceCache.h"
+#include "ThreadPool.h"
+#include "VertexFormat.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+const char *c_CacheDirectory = "res/cache/impostors";
+const uint32_t c_Magic = 0x4d495053; // "SPIM"
+const uint32_t c_Version = 1;
+
+struct CacheHeader {
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t FramesPerSide;
+    uint32_t FrameSize;
+};
+
+unsigned int CreateTexture(unsigned int internalFormat, unsigned int format, unsigned int type,
+    unsigned int size, const void *data = nullptr) {
+    unsigned int texture;
+    GLCall(glGenTextures(1, &texture));
+    GLCall(glBindTexture(GL_TEXTURE_2D, texture));
+    GLCall(glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, size, size, 0, format, type, data));
+    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+    GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+    return texture;
+}
+
+}
+
+Impostor::Impostor(const std::string &sourcePath, const glm::vec3 &center, float radius,
+    unsigned int framesPerSide, unsigned int frameSize)
+    : m_Center(center)
+    , m_Radius(radius)
+    , m_FramesPerSide(std::max(framesPerSide, 2u))
+    , m_FrameSize(frameSize)
+    , m_AtlasSize(m_FramesPerSide * frameSize)
+    , m_Albedo(0)
+    , m_NormalDepth(0)
+    , m_Depth(0)
+    , m_BakedFrames(0)
+    , m_Cached(false)
+    , m_BakeMilliseconds(0.0f) {
+    std::error_code error;
+    uint64_t fileSize = std::filesystem::file_size(sourcePath, error);
+    int64_t modified
+        = std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count();
+    uint64_t key = ContentHash(sourcePath.data(), sourcePath.size());
+    key = ContentHash(&fileSize, sizeof(fileSize), key);
+    key = ContentHash(&modified, sizeof(modified), key);
+    key = ContentHash(&m_FramesPerSide, sizeof(m_FramesPerSide), key);
+    key = ContentHash(&m_FrameSize, sizeof(m_FrameSize), key);
+    std::stringstream ss;
+    ss << c_CacheDirectory << "/" << std::hex << std::setw(16) << std::setfill('0') << key
+       << ".impostor";
+    m_CachePath = ss.str();
+
+    m_BakeShader = std::make_unique<Shader>("res/shaders/ImpostorBake.shader");
+    m_Shader = std::make_unique<Shader>("res/shaders/Impostor.shader");
+    m_VAO = std::make_unique<VertexArray>();
+
+    if (LoadCache()) {
+        return;
+    }
+
+    m_Albedo = CreateTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, m_AtlasSize);
+    m_NormalDepth = CreateTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, m_AtlasSize);
+    m_Depth = CreateTexture(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_FLOAT, m_AtlasSize);
+    m_Framebuffer = std::make_unique<Framebuffer>();
+    m_Framebuffer->AttachColor(0, m_Albedo);
+    m_Framebuffer->AttachColor(1, m_NormalDepth);
+    m_Framebuffer->AttachDepth(m_Depth);
+    m_Framebuffer->Finalize();
+    m_Framebuffer->UnBind();
+}
+
+Impostor::~Impostor() {
+    GLCall(glDeleteTextures(1, &m_Albedo));
+    GLCall(glDeleteTextures(1, &m_NormalDepth));
+    if (m_Depth) {
+        GLCall(glDeleteTextures(1, &m_Depth));
+    }
+}
+
+glm::vec3 Impostor::GetFrameDirection(unsigned int x, unsigned int y) const {
+    glm::vec2 grid = glm::vec2(x, y) / (float) (m_FramesPerSide - 1);
+    return VertexPack::OctahedralDecode(grid * 2.0f - 1.0f);
+}
+
+bool Impostor::Bake(const DrawFunc &draw, unsigned int maxFrames) {
+    if (IsReady()) {
+        return true;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+
+    GLint framebuffer, viewport[4];
+    GLCall(glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer));
+    GLCall(glGetIntegerv(GL_VIEWPORT, viewport));
+
+    m_Framebuffer->Bind();
+    if (m_BakedFrames == 0) {
+        GLCall(glViewport(0, 0, m_AtlasSize, m_AtlasSize));
+        GLCall(glClearColor(0.0f, 0.0f, 0.0f, 0.0f));
+        GLCall(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+    }
+    GLCall(glEnable(GL_DEPTH_TEST));
+
+    // Orthographic around the bounding sphere, from twice its radius away
+    glm::mat4 proj
+        = glm::ortho(-m_Radius, m_Radius, -m_Radius, m_Radius, m_Radius, 3.0f * m_Radius);
+    unsigned int frameCount = m_FramesPerSide * m_FramesPerSide;
+    for (unsigned int i = 0; i < maxFrames && m_BakedFrames < frameCount; i++, m_BakedFrames++) {
+        unsigned int x = m_BakedFrames % m_FramesPerSide;
+        unsigned int y = m_BakedFrames / m_FramesPerSide;
+        GLCall(glViewport(x * m_FrameSize, y * m_FrameSize, m_FrameSize, m_FrameSize));
+
+        glm::vec3 direction = GetFrameDirection(x, y);
+        glm::vec3 up = glm::abs(direction.y) > 0.999f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+        glm::mat4 view = glm::lookAt(m_Center + direction * 2.0f * m_Radius, m_Center, up);
+
+        m_BakeShader->Bind();
+        m_BakeShader->SetUniformMat4f("u_ViewProj", proj * view);
+        m_BakeShader->SetUniform3f("u_ViewDir", direction.x, direction.y, direction.z);
+        draw(*m_BakeShader);
+    }
+
+    GLCall(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer));
+    GLCall(glViewport(viewport[0], viewport[1], viewport[2], viewport[3]));
+
+    m_BakeMilliseconds += std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::high_resolution_clock::now() - start)
+                              .count();
+
+    if (IsReady()) {
+        std::cout << "Baked " << frameCount << " impostor views in " << m_BakeMilliseconds
+                  << " ms" << std::endl;
+        StoreCache();
+        FinishAtlas();
+    }
+    return IsReady();
+}
+
+void Impostor::FinishAtlas() {
+    // Only needed while baking
+    m_Framebuffer.reset();
+    if (m_Depth) {
+        GLCall(glDeleteTextures(1, &m_Depth));
+        m_Depth = 0;
+    }
+
+    for (unsigned int texture : { m_Albedo, m_NormalDepth }) {
+        GLCall(glBindTexture(GL_TEXTURE_2D, texture));
+        GLCall(glGenerateMipmap(GL_TEXTURE_2D));
+        GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR));
+    }
+    GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+}
+
+bool Impostor::LoadCache() {
+    std::ifstream stream(m_CachePath, std::ios::binary);
+    if (!stream) {
+        return false;
+    }
+
+    CacheHeader header;
+    if (!stream.read((char *) &header, sizeof(header)) || header.Magic != c_Magic
+        || header.Version != c_Version || header.FramesPerSide != m_FramesPerSide
+        || header.FrameSize != m_FrameSize) {
+        return false;
+    }
+
+    size_t size = (size_t) m_AtlasSize * m_AtlasSize * 4;
+    std::vector<unsigned char> albedo(size);
+    std::vector<unsigned char> normalDepth(size);
+    if (!stream.read((char *) albedo.data(), size)
+        || !stream.read((char *) normalDepth.data(), size)) {
+        return false;
+    }
+
+    m_Albedo = CreateTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, m_AtlasSize, albedo.data());
+    m_NormalDepth
+        = CreateTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, m_AtlasSize, normalDepth.data());
+    m_BakedFrames = m_FramesPerSide * m_FramesPerSide;
+    m_Cached = true;
+    FinishAtlas();
+    return true;
+}
+
+void Impostor::StoreCache() {
+    size_t size = (size_t) m_AtlasSize * m_AtlasSize * 4;
+    auto albedo = std::make_shared<std::vector<unsigned char>>(size);
+    auto normalDepth = std::make_shared<std::vector<unsigned char>>(size);
+    GLCall(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+    GLCall(glBindTexture(GL_TEXTURE_2D, m_Albedo));
+    GLCall(glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, albedo->data()));
+    GLCall(glBindTexture(GL_TEXTURE_2D, m_NormalDepth));
+    GLCall(glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, normalDepth->data()));
+    GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+
+    CacheHeader header = { c_Magic, c_Version, m_FramesPerSide, m_FrameSize };
+    std::string path = m_CachePath;
+    // Megabytes of atlas, keep the disk off the render thread
+    ThreadPool::Get().Submit([header, path, albedo, normalDepth]() {
+        std::error_code error;
+        std::filesystem::create_directories(c_CacheDirectory, error);
+
+        // Write to a temporary file first so that a crash never leaves a truncated entry behind
+        std::string tempPath = path + ".tmp";
+        {
+            std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+            if (!stream) {
+                return;
+            }
+            stream.write((const char *) &header, sizeof(header));
+            stream.write((const char *) albedo->data(), albedo->size());
+            stream.write((const char *) normalDepth->data(), normalDepth->size());
+            if (!stream) {
+                return;
+            }
+        }
+        std::filesystem::rename(tempPath, path, error);
+    });
+}
+
+void Impostor::Draw(const glm::mat4 &view, const glm::mat4 &proj, float scale,
+    const StreamBuffer &instances, unsigned int offset, unsigned int count, ImpostorView mode) {
+    if (!IsReady() || count == 0) {
+        return;
+    }
+
+    VertexBufferLayout layout;
+    layout.Push<float>(4); // Position, rotation
+    m_VAO->AddInstanceBuffer(instances, offset, layout, 0);
+
+    glm::vec3 cameraPosition = glm::vec3(glm::inverse(view)[3]);
+    GLCall(glActiveTexture(GL_TEXTURE0));
+    GLCall(glBindTexture(GL_TEXTURE_2D, m_Albedo));
+    GLCall(glActiveTexture(GL_TEXTURE1));
+    GLCall(glBindTexture(GL_TEXTURE_2D, m_NormalDepth));
+    GLCall(glActiveTexture(GL_TEXTURE0));
+
+    m_Shader->Bind();
+    m_Shader->SetUniformMat4f("u_View", view);
+    m_Shader->SetUniformMat4f("u_Proj", proj);
+    m_Shader->SetUniform3f("u_CameraPos", cameraPosition.x, cameraPosition.y, cameraPosition.z);
+    m_Shader->SetUniform3f("u_Center", m_Center.x, m_Center.y, m_Center.z);
+    m_Shader->SetUniform1f("u_Radius", m_Radius);
+    m_Shader->SetUniform1f("u_Scale", scale);
+    m_Shader->SetUniform1f("u_Frames", (float) m_FramesPerSide);
+    m_Shader->SetUniform1i("u_Albedo", 0);
+    m_Shader->SetUniform1i("u_NormalDepth", 1);
+    m_Shader->SetUniform1i("u_Mode", (int) mode);
+
+    Renderer renderer;
+    renderer.DrawArraysInstanced(*m_VAO, *m_Shader, GL_TRIANGLE_STRIP, 4, count);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Framebuffer.h"
+#include "Shader.h"
+#include "StreamBuffer.h"
+#include "VertexArray.h"
+
+#include <functional>
+#include <glm/glm.hpp>
+#include <memory>
+#include <string>
+
+enum class ImpostorView { Albedo, Normal, Depth };
+
+// Pictures of a model taken from an octahedral grid of directions around its bounding sphere,
+// stored as atlases of albedo and of object space normal + depth. Baked a few views per frame
+// (or loaded from res/cache/impostors when the model file hasn't changed) and drawn as one
+// instanced camera facing quad per copy that blends the four nearest views and offsets its
+// depth by the baked depth, so distant copies cost two triangles instead of the whole mesh.
+class Impostor {
+public:
+    // Draws the model in its object space with the bake shader, which has u_ViewProj set.
+    // Set u_Model for each part and bind its texture to slot 0.
+    using DrawFunc = std::function<void(Shader &shader)>;
+
+    // center and radius bound the model in object space. The cache is keyed by the source
+    // file's size and modification time together with the grid settings.
+    Impostor(const std::string &sourcePath, const glm::vec3 &center, float radius,
+        unsigned int framesPerSide = 8, unsigned int frameSize = 128);
+    ~Impostor();
+
+    // Renders up to maxFrames more views, true once the atlas is complete. Restores the bound
+    // framebuffer and viewport. The finished atlas is written to the cache in the background.
+    bool Bake(const DrawFunc &draw, unsigned int maxFrames = 4);
+
+    // Instances are a vec4 each at offset in buffer: world position of the object space
+    // origin and a rotation around y. scale converts object space to world units.
+    void Draw(const glm::mat4 &view, const glm::mat4 &proj, float scale,
+        const StreamBuffer &instances, unsigned int offset, unsigned int count,
+        ImpostorView mode = ImpostorView::Albedo);
+
+    inline bool IsReady() const {
+        return m_BakedFrames == m_FramesPerSide * m_FramesPerSide;
+    }
+    inline float GetBakeProgress() const {
+        return (float) m_BakedFrames / (m_FramesPerSide * m_FramesPerSide);
+    }
+    inline bool IsCached() const {
+        return m_Cached;
+    }
+    inline float GetBakeMilliseconds() const {
+        return m_BakeMilliseconds;
+    }
+    // Both atlases, in bytes
+    inline size_t GetMemorySize() const {
+        return (size_t) m_AtlasSize * m_AtlasSize * 4 * 2 * 4 / 3;
+    }
+
+    // Direction from the model to the camera of grid cell (x, y), matches Impostor.shader
+    glm::vec3 GetFrameDirection(unsigned int x, unsigned int y) const;
+
+private:
+    bool LoadCache();
+    void StoreCache();
+    void FinishAtlas();
+
+    std::string m_CachePath;
+    glm::vec3 m_Center;
+    float m_Radius;
+    unsigned int m_FramesPerSide;
+    unsigned int m_FrameSize;
+    unsigned int m_AtlasSize;
+
+    unsigned int m_Albedo;
+    unsigned int m_NormalDepth;
+    unsigned int m_Depth;
+    std::unique_ptr<Framebuffer> m_Framebuffer;
+    unsigned int m_BakedFrames;
+    bool m_Cached;
+    float m_BakeMilliseconds;
+
+    std::unique_ptr<Shader> m_BakeShader;
+    std::unique_ptr<Shader> m_Shader;
+    std::unique_ptr<VertexArray> m_VAO;
+};
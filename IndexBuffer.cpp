@@ -2,24 +2,98 @@
 
 #include "Renderer.h"
 
+#include <cstdint>
+#include <cstring>
+
 IndexBuffer::IndexBuffer(const unsigned int *data, unsigned int count)
-    : m_Count(count) {
+    : m_RendererID(0)
+    , m_Count(count)
+    , m_Type(GL_UNSIGNED_INT) {
     ASSERT(sizeof(unsigned int) == sizeof(GLuint));
+    Create(data);
+}
 
-    GLCall(glGenBuffers(1, &m_RendererID));
-    GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_RendererID));
-    GLCall(
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(unsigned int), data, GL_STATIC_DRAW));
+IndexBuffer::IndexBuffer(const unsigned short *data, unsigned int count)
+    : m_RendererID(0)
+    , m_Count(count)
+    , m_Type(GL_UNSIGNED_SHORT) {
+    ASSERT(sizeof(unsigned short) == sizeof(GLushort));
+    Create(data);
 }
 
 IndexBuffer::~IndexBuffer() {
+    if (Renderer::GetSoftwareBackend()) {
+        return;
+    }
     GLCall(glDeleteBuffers(1, &m_RendererID));
 }
 
+void IndexBuffer::Create(const void *data) {
+    if (Renderer::GetSoftwareBackend()) {
+        m_SoftwareData.resize(m_Count * GetIndexSize());
+        if (data) {
+            std::memcpy(m_SoftwareData.data(), data, m_SoftwareData.size());
+        }
+        return;
+    }
+    GLCall(glGenBuffers(1, &m_RendererID));
+    GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_RendererID));
+    GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_Count * GetIndexSize(), data, GL_STATIC_DRAW));
+}
+
+unsigned int IndexBuffer::GetIndexSize() const {
+    return m_Type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+unsigned int IndexBuffer::GetSoftwareIndex(unsigned int i) const {
+    if (m_Type == GL_UNSIGNED_SHORT) {
+        uint16_t index;
+        std::memcpy(&index, m_SoftwareData.data() + i * sizeof(index), sizeof(index));
+        return index;
+    }
+    uint32_t index;
+    std::memcpy(&index, m_SoftwareData.data() + i * sizeof(index), sizeof(index));
+    return index;
+}
+
 void IndexBuffer::Bind() const {
+    if (Renderer::GetSoftwareBackend()) {
+        return;
+    }
     GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_RendererID));
 }
 
 void IndexBuffer::UnBind() const {
+    if (Renderer::GetSoftwareBackend()) {
+        return;
+    }
     GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
-}
\ No newline at end of file
+}
+
+void *IndexBuffer::Map() {
+    if (Renderer::GetSoftwareBackend()) {
+        return m_SoftwareData.data();
+    }
+    Bind();
+    GLCall(void *data = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, m_Count * GetIndexSize(),
+               GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    return data;
+}
+
+bool IndexBuffer::Unmap() {
+    if (Renderer::GetSoftwareBackend()) {
+        return true;
+    }
+    Bind();
+    GLCall(GLboolean intact = glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER));
+    return intact == GL_TRUE;
+}
+
+void IndexBuffer::SetData(const void *data) {
+    if (Renderer::GetSoftwareBackend()) {
+        std::memcpy(m_SoftwareData.data(), data, m_SoftwareData.size());
+        return;
+    }
+    Bind();
+    GLCall(glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, m_Count * GetIndexSize(), data));
+}
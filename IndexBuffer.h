@@ -1,18 +1,41 @@
 #pragma once
 
+#include <vector>
+
 class IndexBuffer {
 private:
     unsigned int m_RendererID;
     unsigned int m_Count;
+    // GL_UNSIGNED_INT or GL_UNSIGNED_SHORT
+    unsigned int m_Type;
+    // The indices in m_Type when there is a software backend, instead of the GL buffer
+    std::vector<unsigned char> m_SoftwareData;
 
 public:
     IndexBuffer(const unsigned int *data, unsigned int count);
+    // Half the size, for meshes with at most 65536 vertices
+    IndexBuffer(const unsigned short *data, unsigned int count);
     ~IndexBuffer();
 
     void Bind() const;
     void UnBind() const;
 
+    // Same as VertexBuffer, binding changes the element buffer of the bound vertex array.
+    // The data is in the buffer's index type.
+    void *Map();
+    bool Unmap();
+    void SetData(const void *data);
+
     inline unsigned int GetCount() const {
         return m_Count;
     }
-};
\ No newline at end of file
+    inline unsigned int GetType() const {
+        return m_Type;
+    }
+    unsigned int GetIndexSize() const;
+    // Index i widened to 32 bits, only with a software backend
+    unsigned int GetSoftwareIndex(unsigned int i) const;
+
+private:
+    void Create(const void *data);
+};
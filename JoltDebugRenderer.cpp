@@ -0,0 +1,308 @@
+#include "JoltDebugRenderer.h"
+
+#ifdef JPH_DEBUG_RENDERER
+
+#include "Renderer.h"
+#include "VertexBufferLayout.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Per frame stream regions, large enough for the bounding boxes of every body at once
+const unsigned int c_PrimitiveBufferSize = 32 * 1024 * 1024;
+const unsigned int c_InstanceBufferSize = 8 * 1024 * 1024;
+
+glm::vec3 ToGlm(JPH::Vec3Arg v) {
+    return glm::vec3(v.GetX(), v.GetY(), v.GetZ());
+}
+
+// Allocates as many of count items of size bytes as still fit, returns that number
+unsigned int AllocateFitting(
+    StreamBuffer &buffer, unsigned int count, unsigned int size, StreamAllocation &allocation) {
+    // Leave room for the alignment padding Allocate may add
+    unsigned int available = buffer.GetRemaining();
+    available = available > 16 ? available - 16 : 0;
+    count = std::min(count, available / size);
+    if (count == 0) {
+        return 0;
+    }
+    allocation = buffer.Allocate(count * size);
+    return allocation.Data ? count : 0;
+}
+
+}
+
+template <> struct VertexFormat<JPH::DebugRenderer::Vertex> {
+    using Vertex = JPH::DebugRenderer::Vertex;
+    static constexpr VertexAttribute Attributes[] = {
+        VertexAttribute::Float(3, offsetof(Vertex, mPosition)),
+        VertexAttribute::Float(3, offsetof(Vertex, mNormal)),
+        VertexAttribute::Float(2, offsetof(Vertex, mUV)),
+        VertexAttribute::Unorm8(4, offsetof(Vertex, mColor)),
+    };
+};
+static_assert(IsVertexFormatPacked<JPH::DebugRenderer::Vertex>(),
+    "Jolt's debug vertex no longer matches its attributes");
+
+// A shape's triangles, uploaded once and drawn instanced for every body that uses it
+class JoltDebugRenderer::BatchImpl : public JPH::RefTargetVirtual {
+public:
+    JPH_OVERRIDE_NEW_DELETE
+
+    BatchImpl(const Vertex *vertices, int vertexCount, const JPH::uint32 *indices, int indexCount)
+        : m_RefCount(0) {
+        VBO = std::make_unique<VertexBuffer>(vertices, vertexCount * sizeof(Vertex));
+        VAO.AddBuffer(*VBO, VertexBufferLayout::Of<Vertex>());
+        IBO = std::make_unique<IndexBuffer>(indices, indexCount);
+    }
+
+    void AddRef() override {
+        ++m_RefCount;
+    }
+    void Release() override {
+        if (--m_RefCount == 0) {
+            delete this;
+        }
+    }
+
+    VertexArray VAO;
+    std::unique_ptr<VertexBuffer> VBO;
+    std::unique_ptr<IndexBuffer> IBO;
+
+private:
+    std::atomic<unsigned int> m_RefCount;
+};
+
+JoltDebugRenderer::JoltDebugRenderer()
+    : m_ViewProj(1.0f)
+    , m_FrustumPlanes {}
+    , m_CameraPosition(0.0f)
+    , m_FrustumCulled(0)
+    , m_CreatedBatches(0) {
+    static_assert(sizeof(LineVertex) == 16, "Layout below assumes a tightly packed vertex");
+    static_assert(sizeof(Instance) == 68, "Layout below assumes a tightly packed instance");
+
+    m_PrimitiveBuffer = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, c_PrimitiveBufferSize);
+    m_InstanceBuffer = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, c_InstanceBufferSize);
+    m_PrimitiveShader = std::make_unique<Shader>("res/shaders/DebugPrimitive.shader");
+    m_GeometryShader = std::make_unique<Shader>("res/shaders/DebugGeometry.shader");
+
+    // Builds the shared geometry (boxes, spheres, ...) through CreateTriangleBatch
+    Initialize();
+}
+
+JoltDebugRenderer::~JoltDebugRenderer() {
+}
+
+void JoltDebugRenderer::DrawLine(JPH::RVec3Arg inFrom, JPH::RVec3Arg inTo, JPH::ColorArg inColor) {
+    LineVertex from, to;
+    JPH::Vec3(inFrom).StoreFloat3(&from.Position);
+    JPH::Vec3(inTo).StoreFloat3(&to.Position);
+    from.Color = to.Color = inColor;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Lines.push_back(from);
+    m_Lines.push_back(to);
+}
+
+void JoltDebugRenderer::DrawTriangle(JPH::RVec3Arg inV1, JPH::RVec3Arg inV2, JPH::RVec3Arg inV3,
+    JPH::ColorArg inColor, ECastShadow inCastShadow) {
+    (void) inCastShadow;
+    LineVertex vertices[3];
+    JPH::Vec3(inV1).StoreFloat3(&vertices[0].Position);
+    JPH::Vec3(inV2).StoreFloat3(&vertices[1].Position);
+    JPH::Vec3(inV3).StoreFloat3(&vertices[2].Position);
+    vertices[0].Color = vertices[1].Color = vertices[2].Color = inColor;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Triangles.insert(m_Triangles.end(), vertices, vertices + 3);
+}
+
+JoltDebugRenderer::Batch JoltDebugRenderer::CreateTriangleBatch(
+    const Triangle *inTriangles, int inTriangleCount) {
+    std::vector<JPH::uint32> indices(inTriangleCount * 3);
+    for (size_t i = 0; i < indices.size(); i++) {
+        indices[i] = (JPH::uint32) i;
+    }
+    return CreateTriangleBatch(inTriangles ? inTriangles->mV : nullptr, inTriangleCount * 3,
+        indices.data(), (int) indices.size());
+}
+
+JoltDebugRenderer::Batch JoltDebugRenderer::CreateTriangleBatch(const Vertex *inVertices,
+    int inVertexCount, const JPH::uint32 *inIndices, int inIndexCount) {
+    m_CreatedBatches++;
+    return new BatchImpl(inVertices, inVertexCount, inIndices, inIndexCount);
+}
+
+void JoltDebugRenderer::DrawGeometry(JPH::RMat44Arg inModelMatrix,
+    const JPH::AABox &inWorldSpaceBounds, float inLODScaleSq, JPH::ColorArg inModelColor,
+    const GeometryRef &inGeometry, ECullMode inCullMode, ECastShadow inCastShadow,
+    EDrawMode inDrawMode) {
+    // Face culling is left off, the cull mode only matters for the inside of shapes
+    (void) inCullMode;
+    (void) inCastShadow;
+
+    // Skip bodies outside the view before they cost an instance
+    glm::vec3 min = ToGlm(inWorldSpaceBounds.mMin), max = ToGlm(inWorldSpaceBounds.mMax);
+    for (const glm::vec4 &plane : m_FrustumPlanes) {
+        glm::vec3 positive(plane.x > 0 ? max.x : min.x, plane.y > 0 ? max.y : min.y,
+            plane.z > 0 ? max.z : min.z);
+        if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f) {
+            m_FrustumCulled++;
+            return;
+        }
+    }
+
+    // Pick the first LOD whose range covers the distance to the camera
+    JPH::Vec3 camera(m_CameraPosition.x, m_CameraPosition.y, m_CameraPosition.z);
+    float distanceSq = inWorldSpaceBounds.GetSqDistanceTo(camera);
+    const LOD *lod = &inGeometry->mLODs.back();
+    for (const LOD &candidate : inGeometry->mLODs) {
+        if (distanceSq <= inLODScaleSq * candidate.mDistance * candidate.mDistance) {
+            lod = &candidate;
+            break;
+        }
+    }
+
+    Instance instance;
+    JPH::Mat44(inModelMatrix).StoreFloat4x4(instance.Model);
+    instance.Color = inModelColor;
+
+    BatchImpl *batch = static_cast<BatchImpl *>(lod->mTriangleBatch.GetPtr());
+    bool wireframe = inDrawMode == EDrawMode::Wireframe;
+    uint64_t key = (uint64_t) (uintptr_t) batch | (wireframe ? 1 : 0);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    InstanceGroup &group = m_Groups[key];
+    if (group.Instances.empty()) {
+        group.Owner = lod->mTriangleBatch;
+        group.Impl = batch;
+        group.Wireframe = wireframe;
+    }
+    group.Instances.push_back(instance);
+}
+
+void JoltDebugRenderer::DrawText3D(JPH::RVec3Arg inPosition, const std::string_view &inString,
+    JPH::ColorArg inColor, float inHeight) {
+    (void) inPosition;
+    (void) inString;
+    (void) inColor;
+    (void) inHeight;
+}
+
+void JoltDebugRenderer::SetCamera(const glm::mat4 &viewProj, const glm::vec3 &position) {
+    m_ViewProj = viewProj;
+    m_CameraPosition = position;
+
+    // Gribb-Hartmann: the planes are sums and differences of the matrix rows
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        m_FrustumPlanes[i * 2] = rows[3] + rows[i];
+        m_FrustumPlanes[i * 2 + 1] = rows[3] - rows[i];
+    }
+}
+
+void JoltDebugRenderer::FlushPrimitives(
+    std::vector<LineVertex> &vertices, unsigned int mode, unsigned int verticesPerPrimitive) {
+    unsigned int primitives = (unsigned int) vertices.size() / verticesPerPrimitive;
+    unsigned int primitiveSize = verticesPerPrimitive * sizeof(LineVertex);
+    StreamAllocation allocation;
+    unsigned int fitting
+        = AllocateFitting(*m_PrimitiveBuffer, primitives, primitiveSize, allocation);
+    m_Stats.Dropped += primitives - fitting;
+    if (fitting > 0) {
+        memcpy(allocation.Data, vertices.data(), fitting * primitiveSize);
+        m_PrimitiveBuffer->Commit();
+
+        VertexBufferLayout layout;
+        layout.Push<float>(3); // Position
+        layout.Push<unsigned char>(4); // Color
+        m_PrimitiveVAO.AddBuffer(*m_PrimitiveBuffer, allocation.Offset, layout);
+
+        Renderer renderer;
+        renderer.DrawArrays(
+            m_PrimitiveVAO, *m_PrimitiveShader, mode, fitting * verticesPerPrimitive);
+        m_Stats.DrawCalls++;
+    }
+    vertices.clear();
+}
+
+void JoltDebugRenderer::Flush() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Stats = JoltDebugStats();
+    m_Stats.FrustumCulled = m_FrustumCulled.exchange(0);
+    m_Stats.Lines = (unsigned int) m_Lines.size() / 2;
+    m_Stats.Triangles = (unsigned int) m_Triangles.size() / 3;
+    m_Stats.CachedBatches = m_CreatedBatches;
+
+    m_PrimitiveBuffer->BeginFrame();
+    m_PrimitiveShader->Bind();
+    m_PrimitiveShader->SetUniformMat4f("u_ViewProj", m_ViewProj);
+    FlushPrimitives(m_Lines, GL_LINES, 2);
+    FlushPrimitives(m_Triangles, GL_TRIANGLES, 3);
+    m_PrimitiveBuffer->EndFrame();
+
+    // Write every group's instances first so the buffer is committed once
+    m_InstanceBuffer->BeginFrame();
+    std::vector<std::pair<InstanceGroup *, StreamAllocation>> draws;
+    std::vector<unsigned int> counts;
+    for (auto &[key, group] : m_Groups) {
+        (void) key;
+        if (group.Instances.empty()) {
+            continue;
+        }
+        unsigned int instances = (unsigned int) group.Instances.size();
+        StreamAllocation allocation;
+        unsigned int fitting
+            = AllocateFitting(*m_InstanceBuffer, instances, sizeof(Instance), allocation);
+        m_Stats.Dropped += instances - fitting;
+        m_Stats.Instances += fitting;
+        if (fitting > 0) {
+            memcpy(allocation.Data, group.Instances.data(), fitting * sizeof(Instance));
+            draws.push_back({ &group, allocation });
+            counts.push_back(fitting);
+        }
+    }
+    m_InstanceBuffer->Commit();
+
+    VertexBufferLayout instanceLayout;
+    for (int column = 0; column < 4; column++) {
+        instanceLayout.Push<float>(4); // Model matrix column
+    }
+    instanceLayout.Push<unsigned char>(4); // Color
+
+    Renderer renderer;
+    m_GeometryShader->Bind();
+    m_GeometryShader->SetUniformMat4f("u_ViewProj", m_ViewProj);
+    m_GeometryShader->SetUniform3f("u_LightDir", -0.4f, -1.0f, -0.3f);
+    for (size_t i = 0; i < draws.size(); i++) {
+        InstanceGroup &group = *draws[i].first;
+        if (group.Impl->IBO->GetCount() == 0) {
+            continue;
+        }
+        group.Impl->VAO.AddInstanceBuffer(
+            *m_InstanceBuffer, draws[i].second.Offset, instanceLayout, 4);
+        if (group.Wireframe) {
+            GLCall(glPolygonMode(GL_FRONT_AND_BACK, GL_LINE));
+        }
+        renderer.DrawInstanced(group.Impl->VAO, *group.Impl->IBO, *m_GeometryShader, counts[i]);
+        if (group.Wireframe) {
+            GLCall(glPolygonMode(GL_FRONT_AND_BACK, GL_FILL));
+        }
+        m_Stats.DrawCalls++;
+    }
+    m_InstanceBuffer->EndFrame();
+
+    for (auto &[key, group] : m_Groups) {
+        (void) key;
+        group.Instances.clear();
+        group.Owner = nullptr;
+    }
+}
+
+#endif // JPH_DEBUG_RENDERER
@@ -0,0 +1,108 @@
+#pragma once
+
+#ifdef JPH_DEBUG_RENDERER
+
+#include "IndexBuffer.h"
+#include "Shader.h"
+#include "StreamBuffer.h"
+#include "VertexArray.h"
+#include "VertexBuffer.h"
+
+#include <Jolt/Jolt.h>
+
+#include <Jolt/Renderer/DebugRenderer.h>
+
+#include <atomic>
+#include <glm/glm.hpp>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct JoltDebugStats {
+    unsigned int Lines = 0;
+    unsigned int Triangles = 0;
+    unsigned int Instances = 0;
+    unsigned int FrustumCulled = 0;
+    unsigned int DrawCalls = 0;
+    // Primitives that did not fit in this frame's stream buffer region
+    unsigned int Dropped = 0;
+    unsigned int CachedBatches = 0;
+};
+
+// JPH::DebugRenderer on top of our Renderer. Loose lines and triangles are collected on the CPU
+// and streamed in one go at Flush, shapes arrive as cached triangle batches (one VAO each) and
+// every use of a batch becomes an instance, so each distinct shape is a single instanced draw.
+// Drawing may happen from physics jobs; everything but Flush is thread safe.
+class JoltDebugRenderer final : public JPH::DebugRenderer {
+public:
+    JoltDebugRenderer();
+    ~JoltDebugRenderer() override;
+
+    void DrawLine(JPH::RVec3Arg inFrom, JPH::RVec3Arg inTo, JPH::ColorArg inColor) override;
+    void DrawTriangle(JPH::RVec3Arg inV1, JPH::RVec3Arg inV2, JPH::RVec3Arg inV3,
+        JPH::ColorArg inColor, ECastShadow inCastShadow = ECastShadow::Off) override;
+    Batch CreateTriangleBatch(const Triangle *inTriangles, int inTriangleCount) override;
+    Batch CreateTriangleBatch(const Vertex *inVertices, int inVertexCount,
+        const JPH::uint32 *inIndices, int inIndexCount) override;
+    void DrawGeometry(JPH::RMat44Arg inModelMatrix, const JPH::AABox &inWorldSpaceBounds,
+        float inLODScaleSq, JPH::ColorArg inModelColor, const GeometryRef &inGeometry,
+        ECullMode inCullMode = ECullMode::CullBackFace, ECastShadow inCastShadow = ECastShadow::On,
+        EDrawMode inDrawMode = EDrawMode::Solid) override;
+    // No font rendering yet, text is ignored
+    void DrawText3D(JPH::RVec3Arg inPosition, const std::string_view &inString,
+        JPH::ColorArg inColor = JPH::Color::sWhite, float inHeight = 0.5f) override;
+
+    // Camera used for LOD selection and frustum culling of geometry, set before drawing
+    void SetCamera(const glm::mat4 &viewProj, const glm::vec3 &position);
+    // Draws and clears everything collected since the last Flush
+    void Flush();
+
+    inline const JoltDebugStats &GetStats() const {
+        return m_Stats;
+    }
+
+private:
+    class BatchImpl;
+
+    struct LineVertex {
+        JPH::Float3 Position;
+        JPH::Color Color;
+    };
+    struct Instance {
+        JPH::Float4 Model[4];
+        JPH::Color Color;
+    };
+    struct InstanceGroup {
+        // Keeps the batch alive until it has been drawn
+        Batch Owner;
+        BatchImpl *Impl;
+        bool Wireframe;
+        std::vector<Instance> Instances;
+    };
+
+    void FlushPrimitives(std::vector<LineVertex> &vertices, unsigned int mode,
+        unsigned int verticesPerPrimitive);
+
+    std::mutex m_Mutex;
+    std::vector<LineVertex> m_Lines;
+    std::vector<LineVertex> m_Triangles;
+    // Keyed by batch and draw mode; entries (and their capacity) are reused every frame
+    std::unordered_map<uint64_t, InstanceGroup> m_Groups;
+
+    std::unique_ptr<StreamBuffer> m_PrimitiveBuffer;
+    std::unique_ptr<StreamBuffer> m_InstanceBuffer;
+    VertexArray m_PrimitiveVAO;
+    std::unique_ptr<Shader> m_PrimitiveShader;
+    std::unique_ptr<Shader> m_GeometryShader;
+
+    glm::mat4 m_ViewProj;
+    glm::vec4 m_FrustumPlanes[6];
+    glm::vec3 m_CameraPosition;
+
+    JoltDebugStats m_Stats;
+    std::atomic<unsigned int> m_FrustumCulled;
+    std::atomic<unsigned int> m_CreatedBatches;
+};
+
+#endif // JPH_DEBUG_RENDERER
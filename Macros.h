@@ -1,5 +1,7 @@
 #pragma once
 
+#include "GLDebug.h"
+
 #include <GL/glew.h>
 #include <signal.h>
 
@@ -13,11 +15,27 @@
         raise(SIGTRAP);
 #endif
 
+// SSE2 is always there on x86-64, other targets take the scalar paths
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define SPARTAN_SSE 1
+#endif
+
+// The lambda gives every GLCall its own static call site without naming clashes
+#define GL_CALL_SITE(x)                                                                            \
+    []() {                                                                                         \
+        static GLCallSite *site = GLRegisterCallSite(#x, __FILE__, __LINE__);                      \
+        return site;                                                                               \
+    }()
+
 #ifdef _DEBUG
 #define GLCall(x)                                                                                  \
-    GLClearError();                                                                                \
+    GLBeginCall(GL_CALL_SITE(x));                                                                  \
     x;                                                                                             \
-    ASSERT(GLLogCall(#x, __FILE__, __LINE__))
+    ASSERT(GLEndCall())
+#elif defined(SPARTAN_GL_CALL_COUNTERS)
+#define GLCall(x)                                                                                  \
+    GLBeginCall(GL_CALL_SITE(x));                                                                  \
+    x
 #else
 #define GLCall(x) x
 #endif
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only view of a whole file through the OS page cache. Pages are faulted in as they are
+// touched, so opening is cheap no matter the size and nothing is copied into the process.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // Unmaps whatever was open before, false if the file is missing or empty
+    bool Open(const std::string &path);
+    void Close();
+
+    inline const unsigned char *GetData() const {
+        return m_Data;
+    }
+    inline size_t GetSize() const {
+        return m_Size;
+    }
+    inline bool IsOpen() const {
+        return m_Data != nullptr;
+    }
+
+private:
+    const unsigned char *m_Data;
+    size_t m_Size;
+#ifdef _WIN32
+    void *m_File;
+    void *m_Mapping;
+#endif
+};
@@ -0,0 +1,180 @@
+#include "MeshBuilder.h"
+
+#include "MeshOptimizer.h"
+#include "Renderer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+MeshBuilderStats MeshBuilder::s_Stats;
+size_t MeshBuilder::s_LiveStagingBytes = 0;
+
+MeshBuilder::MeshBuilder(const std::string &name, const VertexBufferLayout &layout,
+    unsigned int vertexCount, unsigned int indexCount, bool optimize)
+    : m_Name(name)
+    , m_Layout(layout)
+    , m_VertexCount(vertexCount)
+    , m_IndexCount(indexCount)
+    , m_Optimize(optimize)
+    , m_ShortIndices(vertexCount <= 65536)
+    , m_VerticesMapped(false)
+    , m_IndicesMapped(false)
+    , m_Vertices(nullptr)
+    , m_Indices(nullptr) {
+    unsigned int vertexBytes = vertexCount * layout.GetStride();
+
+    // The element buffer binding is vertex array state, so bind ours before creating the IBO
+    m_Buffers.VAO = std::make_unique<VertexArray>();
+    m_Buffers.VAO->Bind();
+    m_Buffers.VBO = std::make_unique<VertexBuffer>(nullptr, vertexBytes);
+    if (m_ShortIndices) {
+        m_Buffers.IBO = std::make_unique<IndexBuffer>((const unsigned short *) nullptr, indexCount);
+    } else {
+        m_Buffers.IBO = std::make_unique<IndexBuffer>((const unsigned int *) nullptr, indexCount);
+    }
+
+    // The optimizer reads and reorders, and 16 bit indices are narrowed by Finish, neither
+    // works on write-combined memory
+    bool stageVertices = m_Optimize;
+    bool stageIndices = m_Optimize || m_ShortIndices;
+    // Mapping an empty buffer is an error, those go through the (empty) arena as well
+    if (vertexBytes > 0 && indexCount > 0) {
+        if (!stageVertices) {
+            m_Vertices = (unsigned char *) m_Buffers.VBO->Map(vertexBytes);
+            m_VerticesMapped = m_Vertices != nullptr;
+        }
+        if (!stageIndices) {
+            m_Indices = (unsigned int *) m_Buffers.IBO->Map();
+            m_IndicesMapped = m_Indices != nullptr;
+        }
+    }
+    if ((!stageVertices && !m_VerticesMapped) || (!stageIndices && !m_IndicesMapped)) {
+        Unmap();
+        stageVertices = true;
+        stageIndices = true;
+    }
+    size_t stagedVertexBytes = stageVertices ? vertexBytes : 0;
+    size_t stagedBytes = stagedVertexBytes + (stageIndices ? indexCount * sizeof(unsigned int) : 0);
+    if (stagedBytes > 0) {
+        m_Arena.resize(stagedBytes);
+        s_Stats.StagedBytes += m_Arena.size();
+        s_LiveStagingBytes += m_Arena.size();
+        s_Stats.PeakStagingBytes = std::max(s_Stats.PeakStagingBytes, s_LiveStagingBytes);
+    }
+    if (stageVertices) {
+        m_Vertices = m_Arena.data();
+    }
+    if (stageIndices) {
+        m_Indices = (unsigned int *) (m_Arena.data() + stagedVertexBytes);
+    }
+    m_Buffers.VAO->UnBind();
+}
+
+MeshBuilder::~MeshBuilder() {
+    if (m_Buffers.VAO) {
+        m_Buffers.VAO->Bind();
+        Unmap();
+        m_Buffers.VAO->UnBind();
+    }
+    s_LiveStagingBytes -= m_Arena.size();
+}
+
+void MeshBuilder::Unmap() {
+    if (m_VerticesMapped) {
+        m_Buffers.VBO->Unmap();
+    }
+    if (m_IndicesMapped) {
+        m_Buffers.IBO->Unmap();
+    }
+    m_VerticesMapped = false;
+    m_IndicesMapped = false;
+    m_Vertices = nullptr;
+    m_Indices = nullptr;
+}
+
+std::vector<float> MeshBuilder::GetPositions() const {
+    std::vector<float> positions;
+    const VertexBufferElement &element = m_Layout.GetElements().front();
+    if (element.count < 3) {
+        return positions;
+    }
+    positions.resize(m_VertexCount * 3);
+    for (unsigned int v = 0; v < m_VertexCount; v++) {
+        const unsigned char *source = m_Vertices + v * m_Layout.GetStride() + element.offset;
+        for (unsigned int axis = 0; axis < 3; axis++) {
+            float &position = positions[v * 3 + axis];
+            if (element.type == GL_FLOAT) {
+                std::memcpy(&position, source + axis * sizeof(float), sizeof(float));
+            } else if (element.type == GL_SHORT && element.normalized) {
+                int16_t value;
+                std::memcpy(&value, source + axis * sizeof(value), sizeof(value));
+                position = VertexUnpack::Snorm16(value);
+            } else if (element.type == GL_HALF_FLOAT) {
+                uint16_t value;
+                std::memcpy(&value, source + axis * sizeof(value), sizeof(value));
+                position = VertexUnpack::Half(value);
+            } else {
+                positions.clear();
+                return positions;
+            }
+        }
+    }
+    return positions;
+}
+
+MeshBuffers MeshBuilder::Finish() {
+    unsigned int vertexBytes = m_VertexCount * m_Layout.GetStride();
+
+    bool mapped = IsMapped();
+    size_t stagedBytes = m_Arena.size();
+
+    m_Buffers.VAO->Bind();
+    bool vertices = !m_VerticesMapped || m_Buffers.VBO->Unmap();
+    bool indices = !m_IndicesMapped || m_Buffers.IBO->Unmap();
+    m_VerticesMapped = false;
+    m_IndicesMapped = false;
+    // Rare (e.g. a mode switch while mapped), there is no copy to restore from
+    if (!vertices || !indices) {
+        std::cerr << "MeshBuilder: " << m_Name << " lost its contents while mapped" << std::endl;
+    }
+
+    if (stagedBytes > 0) {
+        bool stagedVertices = m_Vertices == m_Arena.data();
+        if (m_Optimize && stagedVertices && !m_Layout.GetElements().empty()) {
+            std::vector<float> positions = GetPositions();
+            MeshOptimizer::Optimize(m_Vertices, m_VertexCount, m_Layout.GetStride(), m_Indices,
+                m_IndexCount, positions.empty() ? nullptr : positions.data(), 3);
+        }
+        if (stagedVertices) {
+            m_Buffers.VBO->SetData(m_Vertices, vertexBytes);
+        }
+        if (m_ShortIndices) {
+            std::vector<uint16_t> narrow(m_Indices, m_Indices + m_IndexCount);
+            m_Buffers.IBO->SetData(narrow.data());
+        } else {
+            m_Buffers.IBO->SetData(m_Indices);
+        }
+        s_LiveStagingBytes -= m_Arena.size();
+        std::vector<unsigned char>().swap(m_Arena);
+    }
+    m_Vertices = nullptr;
+    m_Indices = nullptr;
+    m_Buffers.VAO->AddBuffer(*m_Buffers.VBO, m_Layout);
+    m_Buffers.VAO->UnBind();
+
+    size_t gpuBytes = vertexBytes + m_IndexCount * m_Buffers.IBO->GetIndexSize();
+    s_Stats.Meshes++;
+    s_Stats.GpuBytes += gpuBytes;
+    s_Stats.WideGpuBytes += vertexBytes + m_IndexCount * sizeof(unsigned int);
+    s_Stats.ShortIndexMeshes += m_ShortIndices;
+    m_Buffers.GpuBytes = gpuBytes;
+
+    std::cout << "Built " << m_Name << ": " << gpuBytes / 1024 << " KB ("
+              << (mapped ? "mapped" : "staged") << ", " << stagedBytes / 1024 << " KB on the CPU"
+              << (m_ShortIndices ? ", 16 bit indices" : "") << (m_Optimize ? ", optimized" : "")
+              << ")" << std::endl;
+
+    return std::move(m_Buffers);
+}
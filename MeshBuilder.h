@@ -0,0 +1,89 @@
+#pragma once
+
+#include "IndexBuffer.h"
+#include "VertexArray.h"
+#include "VertexBuffer.h"
+#include "VertexBufferLayout.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct MeshBuffers {
+    std::unique_ptr<VertexArray> VAO;
+    std::unique_ptr<VertexBuffer> VBO;
+    std::unique_ptr<IndexBuffer> IBO;
+    size_t GpuBytes = 0;
+};
+
+struct MeshBuilderStats {
+    unsigned int Meshes = 0;
+    size_t GpuBytes = 0;
+    // The same meshes with 32 bit indices, and how many got 16 bit ones instead
+    size_t WideGpuBytes = 0;
+    unsigned int ShortIndexMeshes = 0;
+    // CPU memory used to stage meshes that are optimized, get 16 bit indices or whose buffers
+    // could not be mapped
+    size_t StagedBytes = 0;
+    size_t PeakStagingBytes = 0;
+};
+
+// Sizes a mesh's VBO and IBO up front and maps them, so generators write interleaved vertices
+// and indices straight into GPU memory instead of building vectors to copy from. If mapping
+// fails both go to one staging arena that is uploaded by Finish. The mapping is write-combined
+// memory: write every byte sequentially once and never read it back.
+// Generators always write 32 bit indices. Meshes with at most 65536 vertices stage them and
+// get a 16 bit IBO. With optimize, the vertices are staged too and Finish runs MeshOptimizer
+// on them (position is the first attribute), which reorders both.
+class MeshBuilder {
+public:
+    MeshBuilder(const std::string &name, const VertexBufferLayout &layout,
+        unsigned int vertexCount, unsigned int indexCount, bool optimize = true);
+    ~MeshBuilder();
+
+    template <typename T> T *GetVertices() {
+        return (T *) m_Vertices;
+    }
+    unsigned int *GetIndices() {
+        return m_Indices;
+    }
+    inline unsigned int GetVertexCount() const {
+        return m_VertexCount;
+    }
+    inline unsigned int GetIndexCount() const {
+        return m_IndexCount;
+    }
+    inline bool IsMapped() const {
+        return m_VerticesMapped || m_IndicesMapped;
+    }
+
+    // Unmaps (or uploads) and sets up the vertex array, the builder is empty afterwards
+    MeshBuffers Finish();
+
+    static const MeshBuilderStats &GetStats() {
+        return s_Stats;
+    }
+
+private:
+    void Unmap();
+    // xyz floats of the first attribute, empty if its type is not supported
+    std::vector<float> GetPositions() const;
+
+    std::string m_Name;
+    VertexBufferLayout m_Layout;
+    unsigned int m_VertexCount;
+    unsigned int m_IndexCount;
+    MeshBuffers m_Buffers;
+    bool m_Optimize;
+    bool m_ShortIndices;
+
+    bool m_VerticesMapped;
+    bool m_IndicesMapped;
+    unsigned char *m_Vertices;
+    unsigned int *m_Indices;
+    std::vector<unsigned char> m_Arena;
+
+    static MeshBuilderStats s_Stats;
+    static size_t s_LiveStagingBytes;
+};
@@ -0,0 +1,454 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <glm/glm.hpp>
+
+namespace {
+
+const unsigned int c_Unused = ~0u;
+// Vertex fetch is modelled as 64 byte lines through a FIFO of this many lines
+const size_t c_FetchLineSize = 64;
+const unsigned int c_FetchCacheLines = 64;
+
+std::mutex s_StatsMutex;
+MeshOptimizerStats s_Stats;
+
+float Milliseconds(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::high_resolution_clock::now() - start)
+        .count();
+}
+
+// FIFO cache simulated with insertion stamps: an entry is still cached while fewer than size
+// entries were inserted after it. Reset flushes it without touching the stamps.
+class FifoCache {
+public:
+    FifoCache(size_t entries, unsigned int size)
+        : m_Stamps(entries, 0)
+        , m_Time(size + 1)
+        , m_Size(size) {
+    }
+
+    // True on a miss, the entry is then inserted
+    inline bool Access(size_t entry) {
+        if (m_Time - m_Stamps[entry] > m_Size) {
+            m_Stamps[entry] = m_Time++;
+            return true;
+        }
+        return false;
+    }
+    inline void Reset() {
+        m_Time += m_Size + 1;
+    }
+
+private:
+    std::vector<size_t> m_Stamps;
+    size_t m_Time;
+    unsigned int m_Size;
+};
+
+// Triangles using each vertex, as offsets into one list
+struct Adjacency {
+    std::vector<unsigned int> Offsets;
+    std::vector<unsigned int> Triangles;
+
+    Adjacency(const unsigned int *indices, unsigned int indexCount, unsigned int vertexCount)
+        : Offsets(vertexCount + 1, 0)
+        , Triangles(indexCount) {
+        for (unsigned int i = 0; i < indexCount; i++) {
+            Offsets[indices[i] + 1]++;
+        }
+        for (unsigned int v = 0; v < vertexCount; v++) {
+            Offsets[v + 1] += Offsets[v];
+        }
+        std::vector<unsigned int> fill(Offsets.begin(), Offsets.end() - 1);
+        for (unsigned int i = 0; i < indexCount; i++) {
+            Triangles[fill[indices[i]]++] = i / 3;
+        }
+    }
+};
+
+// Orders the clusters (first triangles of each) so the ones facing away from the mesh center
+// come first
+void SortClusters(const unsigned int *indices, unsigned int indexCount, const float *positions,
+    size_t positionStride, const std::vector<unsigned int> &clusters,
+    std::vector<unsigned int> &result) {
+    unsigned int triangleCount = indexCount / 3;
+    auto position = [&](unsigned int v) {
+        const float *p = positions + v * positionStride;
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    // Area weighted centroid and normal of every cluster, and of the whole mesh
+    glm::vec3 meshCenter(0.0f);
+    float meshArea = 0.0f;
+    std::vector<glm::vec3> centers(clusters.size()), normals(clusters.size());
+    for (size_t c = 0; c < clusters.size(); c++) {
+        unsigned int end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        glm::vec3 center(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (unsigned int triangle = clusters[c]; triangle < end; triangle++) {
+            glm::vec3 a = position(indices[triangle * 3]);
+            glm::vec3 b = position(indices[triangle * 3 + 1]);
+            glm::vec3 d = position(indices[triangle * 3 + 2]);
+            glm::vec3 cross = glm::cross(b - a, d - a);
+            float triangleArea = glm::length(cross);
+            center += (a + b + d) * (triangleArea / 3.0f);
+            normal += cross;
+            area += triangleArea;
+        }
+        meshCenter += center;
+        meshArea += area;
+        centers[c] = area > 0.0f ? center / area : position(indices[clusters[c] * 3]);
+        float length = glm::length(normal);
+        normals[c] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+    }
+    if (meshArea > 0.0f) {
+        meshCenter /= meshArea;
+    }
+
+    std::vector<unsigned int> order(clusters.size());
+    std::vector<float> keys(clusters.size());
+    for (size_t c = 0; c < clusters.size(); c++) {
+        order[c] = (unsigned int) c;
+        keys[c] = glm::dot(centers[c] - meshCenter, normals[c]);
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [&keys](unsigned int a, unsigned int b) { return keys[a] > keys[b]; });
+
+    result.clear();
+    result.reserve(indexCount);
+    for (unsigned int c : order) {
+        unsigned int end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        result.insert(result.end(), indices + clusters[c] * 3, indices + end * 3);
+    }
+}
+
+}
+
+size_t MeshOptimizer::AnalyzeVertexCache(const unsigned int *indices, unsigned int indexCount,
+    unsigned int vertexCount, unsigned int cacheSize) {
+    FifoCache cache(vertexCount, cacheSize);
+    size_t misses = 0;
+    for (unsigned int i = 0; i < indexCount; i++) {
+        misses += cache.Access(indices[i]);
+    }
+    return misses;
+}
+
+size_t MeshOptimizer::AnalyzeVertexFetch(const unsigned int *indices, unsigned int indexCount,
+    unsigned int vertexCount, size_t stride) {
+    size_t lineCount = (vertexCount * stride + c_FetchLineSize - 1) / c_FetchLineSize;
+    FifoCache cache(lineCount, c_FetchCacheLines);
+    size_t lines = 0;
+    for (unsigned int i = 0; i < indexCount; i++) {
+        size_t first = indices[i] * stride / c_FetchLineSize;
+        size_t last = (indices[i] * stride + stride - 1) / c_FetchLineSize;
+        for (size_t line = first; line <= last; line++) {
+            lines += cache.Access(line);
+        }
+    }
+    return lines * c_FetchLineSize;
+}
+
+// Tipsify from Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and
+// Reduced Overdraw". Fans around a vertex, then continues with the neighbour that is still in
+// the cache and has the fewest triangles left, or backtracks on a dead end.
+void MeshOptimizer::OptimizeVertexCache(unsigned int *indices, unsigned int indexCount,
+    unsigned int vertexCount, std::vector<unsigned int> *clusters) {
+    unsigned int triangleCount = indexCount / 3;
+    if (clusters) {
+        clusters->assign(1, 0);
+    }
+    if (triangleCount == 0) {
+        return;
+    }
+
+    Adjacency adjacency(indices, indexCount, vertexCount);
+    std::vector<unsigned int> live(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; v++) {
+        live[v] = adjacency.Offsets[v + 1] - adjacency.Offsets[v];
+    }
+    // Insertion stamps as in FifoCache, time starts past the cache size so nothing is cached
+    const int cacheSize = (int) CacheSize;
+    std::vector<int> stamps(vertexCount, 0);
+    int time = cacheSize + 1;
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> deadEnds;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> result;
+    result.reserve(indexCount);
+    unsigned int cursor = 0;
+
+    int fan = 0;
+    while (fan >= 0) {
+        candidates.clear();
+        for (unsigned int a = adjacency.Offsets[fan]; a < adjacency.Offsets[fan + 1]; a++) {
+            unsigned int triangle = adjacency.Triangles[a];
+            if (emitted[triangle]) {
+                continue;
+            }
+            for (unsigned int corner = 0; corner < 3; corner++) {
+                unsigned int v = indices[triangle * 3 + corner];
+                result.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - stamps[v] > cacheSize) {
+                    stamps[v] = time++;
+                }
+            }
+            emitted[triangle] = true;
+        }
+
+        // The candidate that stays in the cache while its triangles are emitted, the oldest
+        // such one, so it is used before it would be evicted
+        int next = -1, best = -1;
+        for (unsigned int v : candidates) {
+            if (live[v] == 0) {
+                continue;
+            }
+            int priority = 0;
+            if (time - stamps[v] + 2 * (int) live[v] <= cacheSize) {
+                priority = time - stamps[v];
+            }
+            if (priority > best) {
+                best = priority;
+                next = (int) v;
+            }
+        }
+        if (next < 0) {
+            // Dead end: the most recent vertex with triangles left, else the next in input order
+            while (!deadEnds.empty() && next < 0) {
+                unsigned int v = deadEnds.back();
+                deadEnds.pop_back();
+                if (live[v] > 0) {
+                    next = (int) v;
+                }
+            }
+            while (next < 0 && cursor < vertexCount) {
+                if (live[cursor] > 0) {
+                    next = (int) cursor;
+                }
+                cursor++;
+            }
+            unsigned int emittedTriangles = (unsigned int) result.size() / 3;
+            if (clusters && next >= 0 && emittedTriangles > clusters->back()) {
+                clusters->push_back(emittedTriangles);
+            }
+        }
+        fan = next;
+    }
+    std::memcpy(indices, result.data(), indexCount * sizeof(unsigned int));
+}
+
+// The linear overdraw ordering from the same paper: the cache order is split into clusters
+// that keep roughly its efficiency when drawn on their own, then clusters facing away from the
+// mesh center are drawn first so they occlude the rest from most directions.
+void MeshOptimizer::OptimizeOverdraw(unsigned int *indices, unsigned int indexCount,
+    const float *positions, size_t positionStride, unsigned int vertexCount,
+    const std::vector<unsigned int> &clusters, float threshold) {
+    unsigned int triangleCount = indexCount / 3;
+    if (triangleCount == 0 || clusters.empty()) {
+        return;
+    }
+    size_t missesBefore = AnalyzeVertexCache(indices, indexCount, vertexCount);
+
+    // Split the hard clusters where the running ACMR first gets close to the cluster's own,
+    // flushing the cache so each piece can be moved on its own
+    std::vector<unsigned int> soft;
+    FifoCache cache(vertexCount, CacheSize);
+    for (size_t c = 0; c < clusters.size(); c++) {
+        unsigned int begin = clusters[c];
+        unsigned int end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+        cache.Reset();
+        size_t clusterMisses = 0;
+        for (unsigned int i = begin * 3; i < end * 3; i++) {
+            clusterMisses += cache.Access(indices[i]);
+        }
+        float limit = threshold * clusterMisses / (float) (end - begin);
+
+        cache.Reset();
+        soft.push_back(begin);
+        size_t misses = 0;
+        unsigned int start = begin;
+        for (unsigned int triangle = begin; triangle < end; triangle++) {
+            for (unsigned int corner = 0; corner < 3; corner++) {
+                misses += cache.Access(indices[triangle * 3 + corner]);
+            }
+            if (triangle + 1 < end && misses <= limit * (triangle + 1 - start)) {
+                soft.push_back(triangle + 1);
+                cache.Reset();
+                misses = 0;
+                start = triangle + 1;
+            }
+        }
+    }
+
+    // Soft clusters give the sort more freedom but cost a cache warm-up each, fall back to the
+    // hard ones if that goes over the threshold
+    std::vector<unsigned int> result;
+    const std::vector<unsigned int> *candidates[] = { &soft, &clusters };
+    for (const std::vector<unsigned int> *boundaries : candidates) {
+        SortClusters(indices, indexCount, positions, positionStride, *boundaries, result);
+        if (AnalyzeVertexCache(result.data(), indexCount, vertexCount)
+            <= missesBefore * threshold) {
+            std::memcpy(indices, result.data(), indexCount * sizeof(unsigned int));
+            return;
+        }
+    }
+}
+
+unsigned int MeshOptimizer::OptimizeVertexFetch(void *vertices, unsigned int vertexCount,
+    size_t stride, unsigned int *indices, unsigned int indexCount) {
+    std::vector<unsigned int> remap(vertexCount, c_Unused);
+    unsigned int used = 0;
+    for (unsigned int i = 0; i < indexCount; i++) {
+        unsigned int &target = remap[indices[i]];
+        if (target == c_Unused) {
+            target = used++;
+        }
+        indices[i] = target;
+    }
+    unsigned int next = used;
+    for (unsigned int &target : remap) {
+        if (target == c_Unused) {
+            target = next++;
+        }
+    }
+
+    std::vector<unsigned char> source(
+        (unsigned char *) vertices, (unsigned char *) vertices + vertexCount * stride);
+    for (unsigned int v = 0; v < vertexCount; v++) {
+        std::memcpy((unsigned char *) vertices + remap[v] * stride, source.data() + v * stride,
+            stride);
+    }
+    return used;
+}
+
+void MeshOptimizer::Optimize(void *vertices, unsigned int vertexCount, size_t stride,
+    unsigned int *indices, unsigned int indexCount, const float *positions,
+    size_t positionStride) {
+    // Triangle lists only
+    if (indexCount == 0 || indexCount % 3 != 0) {
+        return;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+
+    size_t missesBefore = AnalyzeVertexCache(indices, indexCount, vertexCount);
+    size_t fetchedBefore = AnalyzeVertexFetch(indices, indexCount, vertexCount, stride);
+
+    std::vector<unsigned int> clusters;
+    OptimizeVertexCache(indices, indexCount, vertexCount, &clusters);
+    if (positions) {
+        OptimizeOverdraw(
+            indices, indexCount, positions, positionStride, vertexCount, clusters);
+    }
+    OptimizeVertexFetch(vertices, vertexCount, stride, indices, indexCount);
+
+    size_t missesAfter = AnalyzeVertexCache(indices, indexCount, vertexCount);
+    size_t fetchedAfter = AnalyzeVertexFetch(indices, indexCount, vertexCount, stride);
+    float milliseconds = Milliseconds(start);
+
+    std::lock_guard<std::mutex> lock(s_StatsMutex);
+    s_Stats.Meshes++;
+    s_Stats.Triangles += indexCount / 3;
+    s_Stats.MissesBefore += missesBefore;
+    s_Stats.MissesAfter += missesAfter;
+    s_Stats.FetchedBytesBefore += fetchedBefore;
+    s_Stats.FetchedBytesAfter += fetchedAfter;
+    s_Stats.VertexBytes += vertexCount * stride;
+    s_Stats.Milliseconds += milliseconds;
+}
+
+void MeshOptimizer::BuildMeshlets(const unsigned int *indices, unsigned int indexCount,
+    const float *positions, size_t positionStride, unsigned int vertexCount,
+    std::vector<Meshlet> &meshlets) {
+    auto position = [&](unsigned int v) {
+        const float *p = positions + v * positionStride;
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    // Marks the vertices of the meshlet being filled, to count the distinct ones
+    std::vector<unsigned int> owner(vertexCount, c_Unused);
+    std::vector<unsigned int> vertices;
+    unsigned int first = 0;
+    auto close = [&](unsigned int end) {
+        if (end == first) {
+            return;
+        }
+        Meshlet meshlet = { first, end - first, glm::vec3(0.0f), 0.0f, glm::vec3(0.0f), 1.0f };
+
+        glm::vec3 min(position(vertices[0])), max(min);
+        for (unsigned int v : vertices) {
+            min = glm::min(min, position(v));
+            max = glm::max(max, position(v));
+        }
+        meshlet.Center = (min + max) * 0.5f;
+        for (unsigned int v : vertices) {
+            meshlet.Radius = std::max(meshlet.Radius, glm::distance(meshlet.Center, position(v)));
+        }
+
+        // The cone around the average normal, degenerate triangles do not count
+        std::vector<glm::vec3> normals;
+        glm::vec3 sum(0.0f);
+        for (unsigned int i = first; i + 2 < end; i += 3) {
+            glm::vec3 a = position(indices[i]);
+            glm::vec3 normal
+                = glm::cross(position(indices[i + 1]) - a, position(indices[i + 2]) - a);
+            float length = glm::length(normal);
+            if (length > 0.0f) {
+                normals.push_back(normal / length);
+                sum += normals.back();
+            }
+        }
+        float sumLength = glm::length(sum);
+        if (!normals.empty() && sumLength > 0.0f) {
+            meshlet.ConeAxis = sum / sumLength;
+            float minDot = 1.0f;
+            for (const glm::vec3 &normal : normals) {
+                minDot = std::min(minDot, glm::dot(normal, meshlet.ConeAxis));
+            }
+            // Wider than about 84 degrees from the axis the test would rarely pass
+            if (minDot > 0.1f) {
+                meshlet.ConeCutoff = std::sqrt(1.0f - minDot * minDot);
+            }
+        }
+        meshlets.push_back(meshlet);
+
+        for (unsigned int v : vertices) {
+            owner[v] = c_Unused;
+        }
+        vertices.clear();
+        first = end;
+    };
+
+    for (unsigned int i = 0; i + 2 < indexCount; i += 3) {
+        unsigned int added = 0;
+        for (unsigned int corner = 0; corner < 3; corner++) {
+            added += owner[indices[i + corner]] == c_Unused;
+        }
+        if (vertices.size() + added > MaxMeshletVertices
+            || (i - first) / 3 + 1 > MaxMeshletTriangles) {
+            close(i);
+        }
+        for (unsigned int corner = 0; corner < 3; corner++) {
+            unsigned int v = indices[i + corner];
+            if (owner[v] == c_Unused) {
+                owner[v] = 0;
+                vertices.push_back(v);
+            }
+        }
+    }
+    close(indexCount - indexCount % 3);
+}
+
+MeshOptimizerStats MeshOptimizer::GetStats() {
+    std::lock_guard<std::mutex> lock(s_StatsMutex);
+    return s_Stats;
+}
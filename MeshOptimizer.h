@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+struct MeshOptimizerStats {
+    unsigned int Meshes = 0;
+    unsigned int Triangles = 0;
+    // Post-transform cache misses of the optimized meshes, ACMR is misses per triangle
+    size_t MissesBefore = 0;
+    size_t MissesAfter = 0;
+    // Vertex bytes pulled in 64 byte cache lines, against the vertex buffer size
+    size_t FetchedBytesBefore = 0;
+    size_t FetchedBytesAfter = 0;
+    size_t VertexBytes = 0;
+    float Milliseconds = 0.0f;
+};
+
+// A run of consecutive triangles of a mesh, small enough to be culled on its own
+struct Meshlet {
+    unsigned int FirstIndex;
+    unsigned int IndexCount;
+    // Bounding sphere of its vertices
+    glm::vec3 Center;
+    float Radius;
+    // Every triangle faces away from a camera at c when
+    // dot(Center - c, ConeAxis) >= ConeCutoff * length(Center - c) + Radius. A cutoff of 1
+    // never culls, for meshlets whose normals spread too far.
+    glm::vec3 ConeAxis;
+    float ConeCutoff;
+};
+
+// Reorders indexed triangle lists for the GPU without changing what is drawn:
+// - OptimizeVertexCache orders triangles with Tipsify so the post-transform cache hits
+// - OptimizeOverdraw then sorts clusters of that order so outward facing ones come first,
+//   as long as the cache efficiency stays within a threshold
+// - OptimizeVertexFetch renumbers vertices in the order they are first used
+// Optimize runs all three and adds to the stats, it may be called from any thread.
+// BuildMeshlets then splits the result into meshlets for cluster culling.
+class MeshOptimizer {
+public:
+    // Entries of the simulated FIFO cache, a conservative size for current GPUs
+    static const unsigned int CacheSize = 16;
+
+    // Cache misses of drawing the indices in order
+    static size_t AnalyzeVertexCache(const unsigned int *indices, unsigned int indexCount,
+        unsigned int vertexCount, unsigned int cacheSize = CacheSize);
+    // Bytes read from the vertex buffer in 64 byte lines through a small cache
+    static size_t AnalyzeVertexFetch(const unsigned int *indices, unsigned int indexCount,
+        unsigned int vertexCount, size_t stride);
+
+    // clusters receives the first triangle of every run that started on a cache flush
+    static void OptimizeVertexCache(unsigned int *indices, unsigned int indexCount,
+        unsigned int vertexCount, std::vector<unsigned int> *clusters = nullptr);
+    // positions are xyz floats, positionStride floats apart. Keeps the order if sorting would
+    // raise the cache misses by more than threshold.
+    static void OptimizeOverdraw(unsigned int *indices, unsigned int indexCount,
+        const float *positions, size_t positionStride, unsigned int vertexCount,
+        const std::vector<unsigned int> &clusters, float threshold = 1.05f);
+    // Reorders the vertices in place, unused ones move to the end. Returns the used count.
+    static unsigned int OptimizeVertexFetch(void *vertices, unsigned int vertexCount,
+        size_t stride, unsigned int *indices, unsigned int indexCount);
+
+    static void Optimize(void *vertices, unsigned int vertexCount, size_t stride,
+        unsigned int *indices, unsigned int indexCount, const float *positions,
+        size_t positionStride);
+
+    // Greedy over the triangles in order, which after OptimizeVertexCache keeps neighbours
+    // together. Appends the meshlets, index ranges are relative to indices.
+    static const unsigned int MaxMeshletVertices = 64;
+    static const unsigned int MaxMeshletTriangles = 124;
+    static void BuildMeshlets(const unsigned int *indices, unsigned int indexCount,
+        const float *positions, size_t positionStride, unsigned int vertexCount,
+        std::vector<Meshlet> &meshlets);
+
+    static MeshOptimizerStats GetStats();
+};
@@ -0,0 +1,151 @@
+#include "MeshletCuller.h"
+
+#include "Macros.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#ifdef SPARTAN_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+float Milliseconds(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::high_resolution_clock::now() - start)
+        .count();
+}
+
+}
+
+MeshletCuller::MeshletCuller(const CookedModel &model) {
+    unsigned int count = model.IsValid() ? model.GetHeader().MeshletCount : 0;
+    // Padded with meshlets that are never read back, see Cull
+    unsigned int padded = count + 3;
+    for (std::vector<float> *component : { &m_CenterX, &m_CenterY, &m_CenterZ, &m_Radius,
+             &m_AxisX, &m_AxisY, &m_AxisZ, &m_Cutoff }) {
+        component->resize(padded, 0.0f);
+    }
+    m_FirstIndex.resize(padded, 0);
+    m_IndexCount.resize(padded, 0);
+
+    for (unsigned int i = 0; i < count; i++) {
+        const CookedMeshlet &meshlet = model.GetMeshlet(i);
+        m_CenterX[i] = meshlet.Center[0];
+        m_CenterY[i] = meshlet.Center[1];
+        m_CenterZ[i] = meshlet.Center[2];
+        m_Radius[i] = meshlet.Radius;
+        m_AxisX[i] = meshlet.ConeAxis[0];
+        m_AxisY[i] = meshlet.ConeAxis[1];
+        m_AxisZ[i] = meshlet.ConeAxis[2];
+        m_Cutoff[i] = meshlet.ConeCutoff;
+        m_FirstIndex[i] = meshlet.FirstIndex;
+        m_IndexCount[i] = meshlet.IndexCount;
+    }
+}
+
+void MeshletCuller::BeginFrame() {
+    m_Stats = MeshletCullerStats();
+}
+
+void MeshletCuller::Cull(const glm::mat4 &mvp, const glm::vec3 &camera, unsigned int firstMeshlet,
+    unsigned int meshletCount, std::vector<DrawElementsIndirectCommand> &commands) {
+    auto start = std::chrono::high_resolution_clock::now();
+    ASSERT(firstMeshlet + meshletCount + 3 <= m_Radius.size());
+
+    // Frustum planes in model space from the rows of the matrix (Gribb and Hartmann), normalized
+    // so the distance compares against the radius
+    glm::vec4 planes[6];
+    for (int axis = 0; axis < 3; axis++) {
+        glm::vec4 row(mvp[0][axis], mvp[1][axis], mvp[2][axis], mvp[3][axis]);
+        glm::vec4 w(mvp[0][3], mvp[1][3], mvp[2][3], mvp[3][3]);
+        planes[axis * 2] = w + row;
+        planes[axis * 2 + 1] = w - row;
+    }
+    for (glm::vec4 &plane : planes) {
+        plane /= std::max(glm::length(glm::vec3(plane)), 1e-12f);
+    }
+
+    size_t firstCommand = commands.size();
+    unsigned int end = firstMeshlet + meshletCount;
+    for (unsigned int group = firstMeshlet; group < end; group += 4) {
+        // Bit i set when meshlet group + i is culled by the frustum or by its cone
+        int frustumCulled = 0;
+        int coneCulled = 0;
+#ifdef SPARTAN_SSE
+        __m128 centerX = _mm_loadu_ps(&m_CenterX[group]);
+        __m128 centerY = _mm_loadu_ps(&m_CenterY[group]);
+        __m128 centerZ = _mm_loadu_ps(&m_CenterZ[group]);
+        __m128 radius = _mm_loadu_ps(&m_Radius[group]);
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+
+        __m128 outside = _mm_setzero_ps();
+        for (const glm::vec4 &plane : planes) {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(centerX, _mm_set1_ps(plane.x)),
+                    _mm_mul_ps(centerY, _mm_set1_ps(plane.y))),
+                _mm_add_ps(_mm_mul_ps(centerZ, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+        }
+
+        __m128 toX = _mm_sub_ps(centerX, _mm_set1_ps(camera.x));
+        __m128 toY = _mm_sub_ps(centerY, _mm_set1_ps(camera.y));
+        __m128 toZ = _mm_sub_ps(centerZ, _mm_set1_ps(camera.z));
+        __m128 distance = _mm_sqrt_ps(_mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(toX, toX), _mm_mul_ps(toY, toY)), _mm_mul_ps(toZ, toZ)));
+        __m128 facing = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(toX, _mm_loadu_ps(&m_AxisX[group])),
+                _mm_mul_ps(toY, _mm_loadu_ps(&m_AxisY[group]))),
+            _mm_mul_ps(toZ, _mm_loadu_ps(&m_AxisZ[group])));
+        __m128 cutoff = _mm_loadu_ps(&m_Cutoff[group]);
+        __m128 backfacing = _mm_and_ps(
+            _mm_cmpge_ps(facing, _mm_add_ps(_mm_mul_ps(cutoff, distance), radius)),
+            _mm_cmplt_ps(cutoff, _mm_set1_ps(1.0f)));
+
+        frustumCulled = _mm_movemask_ps(outside);
+        coneCulled = _mm_movemask_ps(_mm_andnot_ps(outside, backfacing));
+#else
+        for (unsigned int i = 0; i < 4; i++) {
+            unsigned int m = group + i;
+            glm::vec3 center(m_CenterX[m], m_CenterY[m], m_CenterZ[m]);
+            bool outside = false;
+            for (const glm::vec4 &plane : planes) {
+                outside |= glm::dot(glm::vec3(plane), center) + plane.w < -m_Radius[m];
+            }
+            glm::vec3 to = center - camera;
+            bool backfacing = m_Cutoff[m] < 1.0f
+                && glm::dot(to, glm::vec3(m_AxisX[m], m_AxisY[m], m_AxisZ[m]))
+                    >= m_Cutoff[m] * glm::length(to) + m_Radius[m];
+            frustumCulled |= outside << i;
+            coneCulled |= (!outside && backfacing) << i;
+        }
+#endif
+
+        // The lanes past the end belong to the next batch or the padding
+        unsigned int lanes = std::min(end - group, 4u);
+        for (unsigned int i = 0; i < lanes; i++) {
+            unsigned int m = group + i;
+            unsigned int triangles = m_IndexCount[m] / 3;
+            m_Stats.Meshlets++;
+            m_Stats.Triangles += triangles;
+            if ((frustumCulled | coneCulled) & (1 << i)) {
+                m_Stats.FrustumCulled += (frustumCulled >> i) & 1;
+                m_Stats.ConeCulled += (coneCulled >> i) & 1;
+                m_Stats.CulledTriangles += triangles;
+                continue;
+            }
+
+            if (commands.size() > firstCommand
+                && commands.back().FirstIndex + commands.back().Count == m_FirstIndex[m]) {
+                commands.back().Count += m_IndexCount[m];
+            } else {
+                commands.push_back({ m_IndexCount[m], 1, m_FirstIndex[m], 0, 0 });
+            }
+        }
+    }
+
+    m_Stats.Commands += (unsigned int) (commands.size() - firstCommand);
+    m_Stats.Milliseconds += Milliseconds(start);
+}
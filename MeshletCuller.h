@@ -0,0 +1,46 @@
+#pragma once
+
+#include "CookedModel.h"
+#include "Renderer.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+struct MeshletCullerStats {
+    unsigned int Meshlets = 0;
+    unsigned int FrustumCulled = 0;
+    // Facing away from the camera, of the ones inside the frustum
+    unsigned int ConeCulled = 0;
+    size_t Triangles = 0;
+    size_t CulledTriangles = 0;
+    unsigned int Commands = 0;
+    float Milliseconds = 0.0f;
+};
+
+// Culls the meshlets of a CookedModel against the frustum and their normal cones on the CPU,
+// four at a time from a copy of the bounds laid out per component. What survives becomes draw
+// commands, consecutive meshlets merged into one, since their indices follow each other.
+class MeshletCuller {
+public:
+    MeshletCuller(const CookedModel &model);
+
+    // Starts the stats of a new frame
+    void BeginFrame();
+    // mvp maps model space to clip space and camera is in model space, the model matrix may
+    // only rotate, translate and scale uniformly. Appends commands for the visible meshlets of
+    // [firstMeshlet, firstMeshlet + meshletCount), with FirstIndex relative to their batch.
+    void Cull(const glm::mat4 &mvp, const glm::vec3 &camera, unsigned int firstMeshlet,
+        unsigned int meshletCount, std::vector<DrawElementsIndirectCommand> &commands);
+
+    inline const MeshletCullerStats &GetStats() const {
+        return m_Stats;
+    }
+
+private:
+    // One entry per meshlet, padded so a group of four never reads past the end
+    std::vector<float> m_CenterX, m_CenterY, m_CenterZ, m_Radius;
+    std::vector<float> m_AxisX, m_AxisY, m_AxisZ, m_Cutoff;
+    std::vector<unsigned int> m_FirstIndex, m_IndexCount;
+
+    MeshletCullerStats m_Stats;
+};
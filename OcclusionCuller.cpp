@@ -0,0 +1,296 @@
+#include "OcclusionCuller.h"
+
+#include "Macros.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#ifdef SPARTAN_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+// Anything closer to the camera plane than this is treated as crossing it
+const float c_MinW = 1e-4f;
+
+float Milliseconds(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::high_resolution_clock::now() - start)
+        .count();
+}
+
+}
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height)
+    : m_Width((width + TileSize - 1) / TileSize * TileSize)
+    , m_Height((height + TileSize - 1) / TileSize * TileSize)
+    , m_TilesX(m_Width / TileSize)
+    , m_TilesY(m_Height / TileSize)
+    , m_ViewProj(1.0f)
+    , m_TileBins(m_TilesX * m_TilesY) {
+    glm::uvec2 size(m_Width, m_Height);
+    while (true) {
+        m_LevelSizes.push_back(size);
+        m_MaxLevels.emplace_back(size.x * size.y, 1.0f);
+        m_MinLevels.emplace_back(size.x * size.y, 1.0f);
+        if (size.x == 1 && size.y == 1) {
+            break;
+        }
+        size = glm::max((size + 1u) / 2u, glm::uvec2(1));
+    }
+}
+
+void OcclusionCuller::BeginFrame(const glm::mat4 &viewProj) {
+    m_ViewProj = viewProj;
+    m_Triangles.clear();
+    for (std::vector<unsigned int> &bin : m_TileBins) {
+        bin.clear();
+    }
+    m_Stats = OcclusionStats();
+}
+
+void OcclusionCuller::AddOccluder(const std::vector<glm::vec3> &positions,
+    const std::vector<unsigned int> &indices, const glm::mat4 &model) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    glm::mat4 mvp = m_ViewProj * model;
+    m_ClipPositions.resize(positions.size());
+    ThreadPool::Get().ParallelFor((unsigned int) positions.size(), 4096,
+        [&](unsigned int begin, unsigned int end) {
+            for (unsigned int i = begin; i < end; i++) {
+                m_ClipPositions[i] = mvp * glm::vec4(positions[i], 1.0f);
+            }
+        });
+
+    glm::vec2 screen(m_Width, m_Height);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        m_Stats.OccluderTriangles++;
+
+        glm::vec4 clip[3] = { m_ClipPositions[indices[i]], m_ClipPositions[indices[i + 1]],
+            m_ClipPositions[indices[i + 2]] };
+        glm::vec3 v[3];
+        bool rejected = false;
+        for (int k = 0; k < 3; k++) {
+            // Dropping near plane crossings instead of clipping keeps the result conservative
+            if (clip[k].w < c_MinW || clip[k].z < -clip[k].w) {
+                rejected = true;
+                break;
+            }
+            glm::vec3 ndc = glm::vec3(clip[k]) / clip[k].w;
+            v[k] = glm::vec3((glm::vec2(ndc) * 0.5f + 0.5f) * screen, ndc.z * 0.5f + 0.5f);
+        }
+        if (rejected || (v[0].z > 1.0f && v[1].z > 1.0f && v[2].z > 1.0f)) {
+            continue;
+        }
+
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+        if (std::abs(area) < 1e-6f) {
+            continue;
+        }
+        // Occluders are two sided, the rasterizer expects counter clockwise winding
+        if (area < 0.0f) {
+            std::swap(v[1], v[2]);
+        }
+
+        glm::vec2 lo = glm::min(glm::min(glm::vec2(v[0]), glm::vec2(v[1])), glm::vec2(v[2]));
+        glm::vec2 hi = glm::max(glm::max(glm::vec2(v[0]), glm::vec2(v[1])), glm::vec2(v[2]));
+        if (hi.x < 0.0f || hi.y < 0.0f || lo.x >= screen.x || lo.y >= screen.y) {
+            continue;
+        }
+        int tileX0 = std::max((int) lo.x, 0) / TileSize;
+        int tileY0 = std::max((int) lo.y, 0) / TileSize;
+        int tileX1 = std::min((int) hi.x / (int) TileSize, (int) m_TilesX - 1);
+        int tileY1 = std::min((int) hi.y / (int) TileSize, (int) m_TilesY - 1);
+
+        unsigned int index = (unsigned int) m_Triangles.size();
+        m_Triangles.push_back({ v[0], v[1], v[2] });
+        for (int y = tileY0; y <= tileY1; y++) {
+            for (int x = tileX0; x <= tileX1; x++) {
+                m_TileBins[x + y * m_TilesX].push_back(index);
+            }
+        }
+    }
+    m_Stats.RasterizedTriangles = (unsigned int) m_Triangles.size();
+    m_Stats.SetupTime += Milliseconds(start);
+}
+
+void OcclusionCuller::Rasterize() {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<float> &depth = m_MaxLevels[0];
+    std::fill(depth.begin(), depth.end(), 1.0f);
+
+    // Every tile owns its pixels, so tiles can be filled in any order on any thread
+    ThreadPool::Get().ParallelFor(
+        m_TilesX * m_TilesY, 1, [this](unsigned int begin, unsigned int end) {
+            for (unsigned int tile = begin; tile < end; tile++) {
+                RasterizeTile(tile);
+            }
+        });
+    m_Stats.RasterTime = Milliseconds(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    BuildPyramid();
+    m_Stats.PyramidTime = Milliseconds(start);
+}
+
+void OcclusionCuller::RasterizeTile(unsigned int tile) {
+    int tileX0 = (tile % m_TilesX) * TileSize, tileY0 = (tile / m_TilesX) * TileSize;
+    int tileX1 = tileX0 + TileSize, tileY1 = tileY0 + TileSize;
+    float *depth = m_MaxLevels[0].data();
+
+    for (unsigned int index : m_TileBins[tile]) {
+        const Triangle &t = m_Triangles[index];
+
+        // Edge functions as A * x + B * y + C, positive inside for counter clockwise triangles
+        glm::vec3 v[3] = { t.V0, t.V1, t.V2 };
+        float A[3], B[3], C[3];
+        for (int e = 0; e < 3; e++) {
+            const glm::vec3 &a = v[(e + 1) % 3], &b = v[(e + 2) % 3];
+            A[e] = a.y - b.y;
+            B[e] = b.x - a.x;
+            C[e] = a.x * b.y - a.y * b.x;
+        }
+        // Edge e is opposite vertex e, so it is that vertex's barycentric weight times area
+        float area = C[0] + C[1] + C[2];
+        float zA = (v[0].z * A[0] + v[1].z * A[1] + v[2].z * A[2]) / area;
+        float zB = (v[0].z * B[0] + v[1].z * B[1] + v[2].z * B[2]) / area;
+        float zC = (v[0].z * C[0] + v[1].z * C[1] + v[2].z * C[2]) / area;
+
+        float minX = std::min(std::min(v[0].x, v[1].x), v[2].x);
+        float maxX = std::max(std::max(v[0].x, v[1].x), v[2].x);
+        float minY = std::min(std::min(v[0].y, v[1].y), v[2].y);
+        float maxY = std::max(std::max(v[0].y, v[1].y), v[2].y);
+        // Tiles are a multiple of 4 wide, so aligning down stays inside the tile
+        int x0 = std::max((int) minX, tileX0) & ~3;
+        int x1 = std::min((int) std::ceil(maxX), tileX1);
+        int y0 = std::max((int) minY, tileY0);
+        int y1 = std::min((int) std::ceil(maxY), tileY1);
+
+        for (int y = y0; y < y1; y++) {
+            float py = y + 0.5f;
+            float *row = depth + y * m_Width;
+#ifdef SPARTAN_SSE
+            const __m128 zero = _mm_setzero_ps();
+            __m128 rowE0 = _mm_set1_ps(B[0] * py + C[0]);
+            __m128 rowE1 = _mm_set1_ps(B[1] * py + C[1]);
+            __m128 rowE2 = _mm_set1_ps(B[2] * py + C[2]);
+            __m128 rowZ = _mm_set1_ps(zB * py + zC);
+            for (int x = x0; x < x1; x += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float) x), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[0]), px), rowE0);
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[1]), px), rowE1);
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[2]), px), rowE2);
+                // Strictly inside only, shared edges may leave gaps but never over-occlude
+                __m128 inside = _mm_and_ps(
+                    _mm_and_ps(_mm_cmpgt_ps(e0, zero), _mm_cmpgt_ps(e1, zero)),
+                    _mm_cmpgt_ps(e2, zero));
+                if (_mm_movemask_ps(inside) == 0) {
+                    continue;
+                }
+                __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zA), px), rowZ);
+                __m128 previous = _mm_loadu_ps(row + x);
+                __m128 nearest = _mm_min_ps(previous, z);
+                _mm_storeu_ps(row + x,
+                    _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, previous)));
+            }
+#else
+            for (int x = x0; x < x1; x++) {
+                float px = x + 0.5f;
+                if (A[0] * px + B[0] * py + C[0] > 0.0f && A[1] * px + B[1] * py + C[1] > 0.0f
+                    && A[2] * px + B[2] * py + C[2] > 0.0f) {
+                    row[x] = std::min(row[x], zA * px + zB * py + zC);
+                }
+            }
+#endif
+        }
+    }
+}
+
+void OcclusionCuller::BuildPyramid() {
+    m_MinLevels[0] = m_MaxLevels[0];
+    for (size_t level = 1; level < m_LevelSizes.size(); level++) {
+        glm::uvec2 source = m_LevelSizes[level - 1], size = m_LevelSizes[level];
+        const std::vector<float> &sourceMax = m_MaxLevels[level - 1];
+        const std::vector<float> &sourceMin = m_MinLevels[level - 1];
+        for (unsigned int y = 0; y < size.y; y++) {
+            // Odd sizes clamp to the last row and column so nothing falls off the edge
+            unsigned int y0 = std::min(y * 2, source.y - 1), y1 = std::min(y * 2 + 1, source.y - 1);
+            for (unsigned int x = 0; x < size.x; x++) {
+                unsigned int x0 = std::min(x * 2, source.x - 1);
+                unsigned int x1 = std::min(x * 2 + 1, source.x - 1);
+                unsigned int a = x0 + y0 * source.x, b = x1 + y0 * source.x;
+                unsigned int c = x0 + y1 * source.x, d = x1 + y1 * source.x;
+                m_MaxLevels[level][x + y * size.x] = std::max(
+                    std::max(sourceMax[a], sourceMax[b]), std::max(sourceMax[c], sourceMax[d]));
+                m_MinLevels[level][x + y * size.x] = std::min(
+                    std::min(sourceMin[a], sourceMin[b]), std::min(sourceMin[c], sourceMin[d]));
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::IsVisible(const glm::vec3 &min, const glm::vec3 &max) {
+    m_Stats.Tested++;
+
+    glm::vec2 lo(1e30f), hi(-1e30f);
+    float nearest = 1e30f, farthest = -1e30f;
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 position((corner & 1) ? max.x : min.x, (corner & 2) ? max.y : min.y,
+            (corner & 4) ? max.z : min.z);
+        glm::vec4 clip = m_ViewProj * glm::vec4(position, 1.0f);
+        // Boxes around the camera can't be tested in screen space
+        if (clip.w < c_MinW) {
+            return true;
+        }
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        lo = glm::min(lo, glm::vec2(ndc));
+        hi = glm::max(hi, glm::vec2(ndc));
+        nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+        farthest = std::max(farthest, ndc.z * 0.5f + 0.5f);
+    }
+
+    if (hi.x < -1.0f || lo.x > 1.0f || hi.y < -1.0f || lo.y > 1.0f || nearest > 1.0f) {
+        m_Stats.FrustumCulled++;
+        return false;
+    }
+    if (nearest <= 0.0f) {
+        return true;
+    }
+
+    int x0 = glm::clamp((int) ((lo.x * 0.5f + 0.5f) * m_Width), 0, (int) m_Width - 1);
+    int x1 = glm::clamp((int) ((hi.x * 0.5f + 0.5f) * m_Width), 0, (int) m_Width - 1);
+    int y0 = glm::clamp((int) ((lo.y * 0.5f + 0.5f) * m_Height), 0, (int) m_Height - 1);
+    int y1 = glm::clamp((int) ((hi.y * 0.5f + 0.5f) * m_Height), 0, (int) m_Height - 1);
+
+    // Coarsest level at which the rectangle still covers at most 2x2 texels
+    unsigned int level = 0;
+    while (level + 1 < m_LevelSizes.size()
+        && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) {
+        level++;
+    }
+
+    glm::uvec2 size = m_LevelSizes[level];
+    float occluderMax = 0.0f, occluderMin = 1.0f;
+    for (int y = y0 >> level; y <= (y1 >> level); y++) {
+        for (int x = x0 >> level; x <= (x1 >> level); x++) {
+            unsigned int texel = std::min((unsigned int) x, size.x - 1)
+                + std::min((unsigned int) y, size.y - 1) * size.x;
+            occluderMax = std::max(occluderMax, m_MaxLevels[level][texel]);
+            occluderMin = std::min(occluderMin, m_MinLevels[level][texel]);
+        }
+    }
+
+    // Entirely in front of every occluder in the region, no need to look any further
+    if (farthest < occluderMin) {
+        return true;
+    }
+    if (nearest > occluderMax) {
+        m_Stats.Occluded++;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+struct OcclusionStats {
+    unsigned int OccluderTriangles = 0;
+    // Triangles that survived setup (in front of the camera, not degenerate, on screen)
+    unsigned int RasterizedTriangles = 0;
+    unsigned int Tested = 0;
+    unsigned int FrustumCulled = 0;
+    unsigned int Occluded = 0;
+    float SetupTime = 0.0f;
+    float RasterTime = 0.0f;
+    float PyramidTime = 0.0f;
+};
+
+// CPU occlusion culling against a small software depth buffer. Occluders are rasterized
+// conservatively (triangles crossing the near plane are dropped, coverage is strict) into
+// tiles in parallel, then a min/max depth pyramid lets each bounding box be tested against
+// a couple of texels instead of every pixel it covers.
+class OcclusionCuller {
+public:
+    static const unsigned int TileSize = 32;
+
+    OcclusionCuller(unsigned int width = 256, unsigned int height = 128);
+
+    void BeginFrame(const glm::mat4 &viewProj);
+    void AddOccluder(const std::vector<glm::vec3> &positions,
+        const std::vector<unsigned int> &indices, const glm::mat4 &model);
+    // Rasterizes every occluder added this frame and builds the depth pyramid
+    void Rasterize();
+
+    // World space bounding box, false if it is outside the frustum or fully hidden
+    bool IsVisible(const glm::vec3 &min, const glm::vec3 &max);
+
+    inline const OcclusionStats &GetStats() const {
+        return m_Stats;
+    }
+    inline unsigned int GetWidth() const {
+        return m_Width;
+    }
+    inline unsigned int GetHeight() const {
+        return m_Height;
+    }
+    // Full resolution depth, 0 near and 1 far
+    inline const std::vector<float> &GetDepth() const {
+        return m_MaxLevels[0];
+    }
+
+private:
+    struct Triangle {
+        // Screen space x, y and depth
+        glm::vec3 V0, V1, V2;
+    };
+
+    void RasterizeTile(unsigned int tile);
+    void BuildPyramid();
+
+    unsigned int m_Width;
+    unsigned int m_Height;
+    unsigned int m_TilesX;
+    unsigned int m_TilesY;
+
+    glm::mat4 m_ViewProj;
+    std::vector<glm::vec4> m_ClipPositions;
+    std::vector<Triangle> m_Triangles;
+    std::vector<std::vector<unsigned int>> m_TileBins;
+
+    // Level 0 is the depth buffer itself, each further level halves both dimensions
+    std::vector<std::vector<float>> m_MaxLevels;
+    std::vector<std::vector<float>> m_MinLevels;
+    std::vector<glm::uvec2> m_LevelSizes;
+
+    OcclusionStats m_Stats;
+};
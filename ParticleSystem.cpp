@@ -0,0 +1,379 @@
+#include "ParticleSystem.h"
+
+#include "Macros.h"
+#include "Renderer.h"
+#include "ThreadPool.h"
+#include "VertexBufferLayout.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#ifdef SPARTAN_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+// Particles per ThreadPool task, a multiple of 4 so every task starts on a whole SSE group
+const unsigned int c_Grain = 16384;
+
+// Set bits of a 4 bit movemask
+const unsigned int c_MaskBits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+float Milliseconds(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::high_resolution_clock::now() - start)
+        .count();
+}
+
+}
+
+void ParticleEmitter::Storage::Resize(size_t size) {
+    size = (size + 3) & ~(size_t) 3;
+    for (std::vector<float> *array : { &PositionX, &PositionY, &PositionZ, &VelocityX,
+             &VelocityY, &VelocityZ, &Age, &InverseLifetime }) {
+        array->resize(size, 0.0f);
+    }
+}
+
+ParticleEmitter::ParticleEmitter(const std::string &name, const ParticleEmitterSettings &settings)
+    : m_Name(name)
+    , m_Settings(settings)
+    , m_Enabled(true)
+    , m_Seed(0x9e3779b9u)
+    , m_EmitRemainder(0.0f)
+    , m_Current(0)
+    , m_Count(0)
+    , m_Back(0)
+    , m_DrawSettings(settings) {
+    m_Particles[0].Resize(settings.MaxParticles);
+    m_Particles[1].Resize(settings.MaxParticles);
+}
+
+void ParticleEmitter::Burst(const glm::vec3 &position, unsigned int count) {
+    m_Bursts.push_back({ position, count });
+}
+
+void ParticleEmitter::Update(float deltaTime, const glm::vec3 &cameraPosition) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Integrate in place and count the survivors of each chunk
+    unsigned int count = m_Count;
+    unsigned int chunks = (count + c_Grain - 1) / c_Grain;
+    m_ChunkOffsets.assign(chunks, 0);
+    ThreadPool::Get().ParallelFor(chunks, 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int chunk = begin; chunk < end; chunk++) {
+            m_ChunkOffsets[chunk] = Simulate(
+                deltaTime, chunk * c_Grain, std::min(count, (chunk + 1) * c_Grain));
+        }
+    });
+    unsigned int alive = 0;
+    for (unsigned int &offset : m_ChunkOffsets) {
+        unsigned int survivors = offset;
+        offset = alive;
+        alive += survivors;
+    }
+
+    float wanted = m_Enabled ? m_Settings.Rate * deltaTime + m_EmitRemainder : 0.0f;
+    unsigned int fromRate = (unsigned int) std::min(wanted, (float) m_Settings.MaxParticles);
+    m_EmitRemainder = wanted - std::floor(wanted);
+    unsigned int fromBursts = 0;
+    for (const PendingBurst &burst : m_Bursts) {
+        fromBursts += burst.Count;
+    }
+    unsigned int room = m_Settings.MaxParticles - alive;
+    unsigned int emitted = std::min(fromRate + fromBursts, room);
+
+    // Every chunk knows where its survivors go, so they move in parallel
+    std::vector<glm::vec4> &instances = m_Instances[m_Back];
+    instances.resize(alive + emitted);
+    ThreadPool::Get().ParallelFor(chunks, 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int chunk = begin; chunk < end; chunk++) {
+            Compact(chunk * c_Grain, std::min(count, (chunk + 1) * c_Grain),
+                m_ChunkOffsets[chunk]);
+        }
+    });
+
+    unsigned int at = alive;
+    for (const PendingBurst &burst : m_Bursts) {
+        unsigned int n = std::min(burst.Count, alive + emitted - at);
+        Emit(burst.Position, m_Settings.Extent, n, at);
+        at += n;
+    }
+    m_Bursts.clear();
+    Emit(m_Settings.Position, m_Settings.Extent, alive + emitted - at, at);
+
+    m_Current ^= 1;
+    m_Count = alive + emitted;
+    m_Stats.Alive = m_Count;
+    m_Stats.Emitted = emitted;
+    m_Stats.Died = count - alive;
+    m_Stats.Dropped = fromRate + fromBursts - emitted;
+    m_Stats.SimulateTime = Milliseconds(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    if (m_Settings.Blend == ParticleBlend::Alpha) {
+        SortBackToFront(cameraPosition);
+    }
+    m_Stats.SortTime = Milliseconds(start);
+}
+
+void ParticleEmitter::Publish() {
+    m_Back ^= 1;
+    m_DrawSettings = m_Settings;
+}
+
+unsigned int ParticleEmitter::Simulate(float deltaTime, unsigned int begin, unsigned int end) {
+    Storage &s = m_Particles[m_Current];
+    glm::vec3 dv = m_Settings.Acceleration * deltaTime;
+    float drag = std::max(1.0f - m_Settings.Drag * deltaTime, 0.0f);
+    float ground = m_Settings.Ground, bounce = -m_Settings.Restitution;
+
+    unsigned int alive = 0;
+    unsigned int i = begin;
+#ifdef SPARTAN_SSE
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 dt = _mm_set1_ps(deltaTime), dragFactor = _mm_set1_ps(drag);
+    const __m128 dvx = _mm_set1_ps(dv.x), dvy = _mm_set1_ps(dv.y), dvz = _mm_set1_ps(dv.z);
+    const __m128 groundY = _mm_set1_ps(ground), bounceFactor = _mm_set1_ps(bounce);
+    for (; i + 4 <= end; i += 4) {
+        __m128 vx = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&s.VelocityX[i]), dvx), dragFactor);
+        __m128 vy = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&s.VelocityY[i]), dvy), dragFactor);
+        __m128 vz = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&s.VelocityZ[i]), dvz), dragFactor);
+        __m128 px = _mm_add_ps(_mm_loadu_ps(&s.PositionX[i]), _mm_mul_ps(vx, dt));
+        __m128 py = _mm_add_ps(_mm_loadu_ps(&s.PositionY[i]), _mm_mul_ps(vy, dt));
+        __m128 pz = _mm_add_ps(_mm_loadu_ps(&s.PositionZ[i]), _mm_mul_ps(vz, dt));
+
+        __m128 below = _mm_cmplt_ps(py, groundY);
+        __m128 falling = _mm_and_ps(below, _mm_cmplt_ps(vy, zero));
+        py = _mm_or_ps(_mm_and_ps(below, groundY), _mm_andnot_ps(below, py));
+        vy = _mm_or_ps(
+            _mm_and_ps(falling, _mm_mul_ps(vy, bounceFactor)), _mm_andnot_ps(falling, vy));
+
+        __m128 age = _mm_add_ps(_mm_loadu_ps(&s.Age[i]), dt);
+        __m128 t = _mm_mul_ps(age, _mm_loadu_ps(&s.InverseLifetime[i]));
+        alive += c_MaskBits[_mm_movemask_ps(_mm_cmplt_ps(t, one))];
+
+        _mm_storeu_ps(&s.VelocityX[i], vx);
+        _mm_storeu_ps(&s.VelocityY[i], vy);
+        _mm_storeu_ps(&s.VelocityZ[i], vz);
+        _mm_storeu_ps(&s.PositionX[i], px);
+        _mm_storeu_ps(&s.PositionY[i], py);
+        _mm_storeu_ps(&s.PositionZ[i], pz);
+        _mm_storeu_ps(&s.Age[i], age);
+    }
+#endif
+    for (; i < end; i++) {
+        s.VelocityX[i] = (s.VelocityX[i] + dv.x) * drag;
+        s.VelocityY[i] = (s.VelocityY[i] + dv.y) * drag;
+        s.VelocityZ[i] = (s.VelocityZ[i] + dv.z) * drag;
+        s.PositionX[i] += s.VelocityX[i] * deltaTime;
+        s.PositionY[i] += s.VelocityY[i] * deltaTime;
+        s.PositionZ[i] += s.VelocityZ[i] * deltaTime;
+        if (s.PositionY[i] < ground) {
+            s.PositionY[i] = ground;
+            if (s.VelocityY[i] < 0.0f) {
+                s.VelocityY[i] *= bounce;
+            }
+        }
+        s.Age[i] += deltaTime;
+        alive += s.Age[i] * s.InverseLifetime[i] < 1.0f;
+    }
+    return alive;
+}
+
+void ParticleEmitter::Compact(unsigned int begin, unsigned int end, unsigned int offset) {
+    const Storage &s = m_Particles[m_Current];
+    Storage &d = m_Particles[m_Current ^ 1];
+    glm::vec4 *instances = m_Instances[m_Back].data();
+    for (unsigned int i = begin; i < end; i++) {
+        // Same test as Simulate, so the counts match
+        float t = s.Age[i] * s.InverseLifetime[i];
+        if (!(t < 1.0f)) {
+            continue;
+        }
+        d.PositionX[offset] = s.PositionX[i];
+        d.PositionY[offset] = s.PositionY[i];
+        d.PositionZ[offset] = s.PositionZ[i];
+        d.VelocityX[offset] = s.VelocityX[i];
+        d.VelocityY[offset] = s.VelocityY[i];
+        d.VelocityZ[offset] = s.VelocityZ[i];
+        d.Age[offset] = s.Age[i];
+        d.InverseLifetime[offset] = s.InverseLifetime[i];
+        instances[offset] = glm::vec4(s.PositionX[i], s.PositionY[i], s.PositionZ[i], t);
+        offset++;
+    }
+}
+
+void ParticleEmitter::Emit(
+    const glm::vec3 &position, const glm::vec3 &extent, unsigned int count, unsigned int at) {
+    Storage &d = m_Particles[m_Current ^ 1];
+    glm::vec4 *instances = m_Instances[m_Back].data();
+    for (unsigned int i = at; i < at + count; i++) {
+        glm::vec3 p = position
+            + extent * glm::vec3(Random() * 2.0f - 1.0f, Random() * 2.0f - 1.0f,
+                Random() * 2.0f - 1.0f);
+        glm::vec3 v = m_Settings.Velocity
+            + m_Settings.VelocityJitter
+                * glm::vec3(Random() * 2.0f - 1.0f, Random() * 2.0f - 1.0f,
+                    Random() * 2.0f - 1.0f);
+        float lifetime = m_Settings.Lifetime + m_Settings.LifetimeJitter * (Random() * 2.0f - 1.0f);
+
+        d.PositionX[i] = p.x;
+        d.PositionY[i] = p.y;
+        d.PositionZ[i] = p.z;
+        d.VelocityX[i] = v.x;
+        d.VelocityY[i] = v.y;
+        d.VelocityZ[i] = v.z;
+        d.Age[i] = 0.0f;
+        d.InverseLifetime[i] = 1.0f / std::max(lifetime, 0.01f);
+        instances[i] = glm::vec4(p, 0.0f);
+    }
+}
+
+void ParticleEmitter::SortBackToFront(const glm::vec3 &cameraPosition) {
+    std::vector<glm::vec4> &instances = m_Instances[m_Back];
+    unsigned int count = (unsigned int) instances.size();
+    m_SortScratch.resize(count);
+    m_SortKeys[0].resize(count);
+    m_SortKeys[1].resize(count);
+
+    // The top half of a positive float orders like the float, to within 1%. Inverted so
+    // the farthest particle gets the smallest key.
+    ThreadPool::Get().ParallelFor(count, c_Grain, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++) {
+            glm::vec3 d = glm::vec3(instances[i]) - cameraPosition;
+            float distance = glm::dot(d, d);
+            uint32_t bits;
+            std::memcpy(&bits, &distance, sizeof(bits));
+            m_SortKeys[0][i] = (uint16_t) (0xffff - (bits >> 16));
+        }
+    });
+
+    // Two 8 bit LSD radix passes, which leaves the result back in instances
+    glm::vec4 *source = instances.data(), *target = m_SortScratch.data();
+    uint16_t *sourceKeys = m_SortKeys[0].data(), *targetKeys = m_SortKeys[1].data();
+    for (int shift = 0; shift < 16; shift += 8) {
+        unsigned int offsets[256] = {};
+        for (unsigned int i = 0; i < count; i++) {
+            offsets[(sourceKeys[i] >> shift) & 0xff]++;
+        }
+        unsigned int total = 0;
+        for (unsigned int &offset : offsets) {
+            unsigned int n = offset;
+            offset = total;
+            total += n;
+        }
+        for (unsigned int i = 0; i < count; i++) {
+            unsigned int to = offsets[(sourceKeys[i] >> shift) & 0xff]++;
+            target[to] = source[i];
+            targetKeys[to] = sourceKeys[i];
+        }
+        std::swap(source, target);
+        std::swap(sourceKeys, targetKeys);
+    }
+}
+
+float ParticleEmitter::Random() {
+    // xorshift32, 24 bits into [0, 1)
+    m_Seed ^= m_Seed << 13;
+    m_Seed ^= m_Seed >> 17;
+    m_Seed ^= m_Seed << 5;
+    return (m_Seed >> 8) * (1.0f / 16777216.0f);
+}
+
+ParticleSystem::ParticleSystem()
+    : m_Shader(std::make_unique<Shader>("res/shaders/Particle.shader"))
+    , m_VAO(std::make_unique<VertexArray>()) {
+}
+
+ParticleSystem::~ParticleSystem() {
+}
+
+ParticleEmitter &ParticleSystem::AddEmitter(
+    const std::string &name, const ParticleEmitterSettings &settings) {
+    m_Emitters.push_back(std::make_unique<ParticleEmitter>(name, settings));
+    m_Stats.Capacity += settings.MaxParticles;
+    return *m_Emitters.back();
+}
+
+void ParticleSystem::Update(float deltaTime, const glm::vec3 &cameraPosition) {
+    auto start = std::chrono::high_resolution_clock::now();
+    m_Stats.Alive = 0;
+    for (const auto &emitter : m_Emitters) {
+        emitter->Update(deltaTime, cameraPosition);
+        m_Stats.Alive += emitter->GetStats().Alive;
+    }
+    m_Stats.UpdateTime = Milliseconds(start);
+}
+
+void ParticleSystem::Publish() {
+    for (const auto &emitter : m_Emitters) {
+        emitter->Publish();
+    }
+}
+
+void ParticleSystem::Draw(const glm::mat4 &view, const glm::mat4 &proj) {
+    if (!m_Instances) {
+        m_Instances = std::make_unique<StreamBuffer>(
+            GL_ARRAY_BUFFER, m_Stats.Capacity * (unsigned int) sizeof(glm::vec4));
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    m_Instances->BeginFrame();
+    std::vector<StreamAllocation> allocations;
+    for (const auto &emitter : m_Emitters) {
+        const std::vector<glm::vec4> &instances = emitter->m_Instances[emitter->m_Back ^ 1];
+        StreamAllocation allocation
+            = m_Instances->Allocate((unsigned int) (instances.size() * sizeof(glm::vec4)));
+        if (allocation.Data && !instances.empty()) {
+            glm::vec4 *target = (glm::vec4 *) allocation.Data;
+            ThreadPool::Get().ParallelFor((unsigned int) instances.size(), 65536,
+                [&](unsigned int begin, unsigned int end) {
+                    std::memcpy(target + begin, instances.data() + begin,
+                        (end - begin) * sizeof(glm::vec4));
+                });
+        }
+        allocations.push_back(allocation);
+    }
+    m_Instances->Commit();
+    m_Stats.UploadTime = Milliseconds(start);
+
+    // Sorted or additive, either way the particles must not hide each other
+    GLCall(glDepthMask(GL_FALSE));
+    m_Shader->Bind();
+    m_Shader->SetUniformMat4f("u_View", view);
+    m_Shader->SetUniformMat4f("u_Proj", proj);
+
+    VertexBufferLayout layout;
+    layout.Push<float>(4); // Position, age / lifetime
+    Renderer renderer;
+    m_Stats.Draws = 0;
+    for (size_t i = 0; i < m_Emitters.size(); i++) {
+        const ParticleEmitter &emitter = *m_Emitters[i];
+        unsigned int count = (unsigned int) emitter.m_Instances[emitter.m_Back ^ 1].size();
+        if (!allocations[i].Data || count == 0) {
+            continue;
+        }
+        const ParticleEmitterSettings &settings = emitter.m_DrawSettings;
+        if (settings.Blend == ParticleBlend::Additive) {
+            GLCall(glBlendFunc(GL_SRC_ALPHA, GL_ONE));
+        } else {
+            GLCall(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+        }
+        m_Shader->SetUniform2f("u_Size", settings.StartSize, settings.EndSize);
+        m_Shader->SetUniform4f("u_StartColor", settings.StartColor.r, settings.StartColor.g,
+            settings.StartColor.b, settings.StartColor.a);
+        m_Shader->SetUniform4f("u_EndColor", settings.EndColor.r, settings.EndColor.g,
+            settings.EndColor.b, settings.EndColor.a);
+
+        m_VAO->AddInstanceBuffer(*m_Instances, allocations[i].Offset, layout, 0);
+        renderer.DrawArraysInstanced(*m_VAO, *m_Shader, GL_TRIANGLE_STRIP, 4, count);
+        m_Stats.Draws++;
+    }
+
+    GLCall(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+    GLCall(glDepthMask(GL_TRUE));
+    m_Instances->EndFrame();
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "Shader.h"
+#include "StreamBuffer.h"
+#include "VertexArray.h"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Additive particles look the same in any order, alpha blended ones are sorted back to front
+enum class ParticleBlend { Additive, Alpha };
+
+struct ParticleEmitterSettings {
+    // Fixed at construction, the storage is allocated once
+    unsigned int MaxParticles = 100000;
+    // Particles per second, spawned uniformly inside Position +- Extent
+    float Rate = 1000.0f;
+    glm::vec3 Position = glm::vec3(0.0f);
+    glm::vec3 Extent = glm::vec3(0.0f);
+    // Initial velocity, plus a uniform random +- VelocityJitter on each axis
+    glm::vec3 Velocity = glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::vec3 VelocityJitter = glm::vec3(0.5f);
+    float Lifetime = 2.0f;
+    float LifetimeJitter = 0.5f;
+    glm::vec3 Acceleration = glm::vec3(0.0f, -9.81f, 0.0f);
+    // Fraction of the velocity lost per second
+    float Drag = 0.0f;
+    // Particles bounce off the plane y = Ground, keeping Restitution of their vertical speed
+    float Ground = -1e30f;
+    float Restitution = 0.3f;
+    // Size and color over the lifetime, interpolated in the shader
+    float StartSize = 0.1f;
+    float EndSize = 0.1f;
+    glm::vec4 StartColor = glm::vec4(1.0f);
+    glm::vec4 EndColor = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+    ParticleBlend Blend = ParticleBlend::Additive;
+};
+
+struct ParticleStats {
+    unsigned int Alive = 0;
+    unsigned int Emitted = 0;
+    unsigned int Died = 0;
+    // Particles wanted by the rate or a burst while the emitter was full
+    unsigned int Dropped = 0;
+    float SimulateTime = 0.0f;
+    float SortTime = 0.0f;
+};
+
+// Particles of one emitter in structure of arrays storage. Update integrates them 4 at a
+// time with SSE, split across the ThreadPool, and writes the surviving ones compacted into a
+// second set of arrays along with their instance data (position and normalized age), so no
+// particle is ever moved twice. Alpha blended emitters sort that instance data by distance
+// to the camera with a radix sort; additive ones skip it.
+class ParticleEmitter {
+public:
+    ParticleEmitter(const std::string &name, const ParticleEmitterSettings &settings);
+
+    // count extra particles around position, e.g. dust where something hit the ground
+    void Burst(const glm::vec3 &position, unsigned int count);
+    // Simulates and builds the instance data for the next Publish. Main thread.
+    void Update(float deltaTime, const glm::vec3 &cameraPosition);
+    // Makes the last Update's instances the ones Draw uses, while nothing renders
+    void Publish();
+
+    inline const std::string &GetName() const {
+        return m_Name;
+    }
+    // Everything but MaxParticles can change between updates
+    inline ParticleEmitterSettings &GetSettings() {
+        return m_Settings;
+    }
+    inline const ParticleStats &GetStats() const {
+        return m_Stats;
+    }
+    // Disabled emitters stop spawning and let their particles run out
+    inline bool IsEnabled() const {
+        return m_Enabled;
+    }
+    inline void SetEnabled(bool enabled) {
+        m_Enabled = enabled;
+    }
+
+private:
+    friend class ParticleSystem;
+
+    // One set of particle arrays, padded to a multiple of 4 for the SSE loop
+    struct Storage {
+        std::vector<float> PositionX, PositionY, PositionZ;
+        std::vector<float> VelocityX, VelocityY, VelocityZ;
+        std::vector<float> Age, InverseLifetime;
+
+        void Resize(size_t size);
+    };
+
+    // Integrates [begin, end) of the current storage in place, returns how many survive
+    unsigned int Simulate(float deltaTime, unsigned int begin, unsigned int end);
+    // Copies the survivors of [begin, end) to the other storage and instances from offset
+    void Compact(unsigned int begin, unsigned int end, unsigned int offset);
+    // Writes count new particles from index at of the other storage and the instances
+    void Emit(const glm::vec3 &position, const glm::vec3 &extent, unsigned int count,
+        unsigned int at);
+    void SortBackToFront(const glm::vec3 &cameraPosition);
+    float Random();
+
+    std::string m_Name;
+    ParticleEmitterSettings m_Settings;
+    bool m_Enabled;
+    uint32_t m_Seed;
+    float m_EmitRemainder;
+
+    Storage m_Particles[2];
+    unsigned int m_Current;
+    unsigned int m_Count;
+
+    struct PendingBurst {
+        glm::vec3 Position;
+        unsigned int Count;
+    };
+    std::vector<PendingBurst> m_Bursts;
+
+    // xyz position, w age / lifetime. Update writes m_Instances[m_Back], Publish flips.
+    std::vector<glm::vec4> m_Instances[2];
+    std::vector<glm::vec4> m_SortScratch;
+    std::vector<uint16_t> m_SortKeys[2];
+    // Survivors of each ThreadPool chunk, then where that chunk's survivors start
+    std::vector<unsigned int> m_ChunkOffsets;
+    unsigned int m_Back;
+    // What the published instances were built with, for Draw
+    ParticleEmitterSettings m_DrawSettings;
+
+    ParticleStats m_Stats;
+};
+
+struct ParticleSystemStats {
+    unsigned int Alive = 0;
+    unsigned int Capacity = 0;
+    unsigned int Draws = 0;
+    float UpdateTime = 0.0f;
+    // Copying the instances into the stream buffer, on the render thread
+    float UploadTime = 0.0f;
+};
+
+// Owns the emitters and draws each one as one instanced draw of camera facing quads from a
+// single stream buffer sized for every emitter at its maximum.
+class ParticleSystem {
+public:
+    ParticleSystem();
+    ~ParticleSystem();
+
+    ParticleEmitter &AddEmitter(const std::string &name, const ParticleEmitterSettings &settings);
+
+    void Update(float deltaTime, const glm::vec3 &cameraPosition);
+    void Publish();
+    // Blends without writing depth, restores the default blend function afterwards
+    void Draw(const glm::mat4 &view, const glm::mat4 &proj);
+
+    inline std::vector<std::unique_ptr<ParticleEmitter>> &GetEmitters() {
+        return m_Emitters;
+    }
+    inline const ParticleSystemStats &GetStats() const {
+        return m_Stats;
+    }
+
+private:
+    std::vector<std::unique_ptr<ParticleEmitter>> m_Emitters;
+    std::unique_ptr<Shader> m_Shader;
+    std::unique_ptr<VertexArray> m_VAO;
+    std::unique_ptr<StreamBuffer> m_Instances;
+    ParticleSystemStats m_Stats;
+};
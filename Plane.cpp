@@ -1,5 +1,6 @@
 #include "Plane.h"
 
+#include "MeshBuilder.h"
 #include "Renderer.h"
 
 #include <glm/gtc/noise.hpp>
@@ -7,21 +8,16 @@
 #include <vector>
 
 Plane::Plane(int widthSegments, int heightSegments) {
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
+    MeshBuilder builder("Plane", VertexBufferLayout::Of<GridVertex>(),
+        (widthSegments + 1) * (heightSegments + 1),
+        widthSegments * heightSegments * 6);
+    generatePlane(
+        widthSegments, heightSegments, builder.GetVertices<GridVertex>(), builder.GetIndices());
 
-    generatePlane(widthSegments, heightSegments, vertices, indices);
-
-    VertexBufferLayout layout = VertexBufferLayout();
-    layout.Push<float>(3); // Position
-    layout.Push<float>(3); // Normal
-    layout.Push<float>(2); // Texture
-    layout.Push<float>(3); // Color
-
-    m_VAO = std::make_shared<VertexArray>();
-    m_VBO = std::make_shared<VertexBuffer>(&vertices[0], vertices.size() * sizeof(float));
-    m_VAO->AddBuffer(*m_VBO, layout);
-    m_IBO = std::make_shared<IndexBuffer>(&indices[0], indices.size());
+    MeshBuffers mesh = builder.Finish();
+    m_VAO = std::move(mesh.VAO);
+    m_VBO = std::move(mesh.VBO);
+    m_IBO = std::move(mesh.IBO);
 
     m_Shader = std::make_shared<Shader>("res/shaders/Plane.shader");
     m_Shader->Bind();
@@ -42,7 +38,8 @@ void Plane::Render(glm::mat4 MVP) {
     renderer.Draw(*m_VAO, *m_IBO, *m_Shader);
 }
 
-void Plane::generatePlane(int widthSegments, int heightSegments, std::vector<float>& vertices, std::vector<unsigned int>& indices) {
+void Plane::generatePlane(
+    int widthSegments, int heightSegments, GridVertex *vertex, unsigned int *index) {
     float seg_width = 1.0f / widthSegments;
     float seg_height = 1.0f / heightSegments;
 
@@ -53,25 +50,10 @@ void Plane::generatePlane(int widthSegments, int heightSegments, std::vector<flo
             float x = j * seg_width - 0.5f;
             float z = 0.0f;
 
-            // Position
-            vertices.push_back(x);
-            vertices.push_back(y);
-            vertices.push_back(z);
-
-            // Normal
-            vertices.push_back(0.0f);
-            vertices.push_back(0.0f);
-            vertices.push_back(1.0f);
-
-            // Texture
-            vertices.push_back(j * seg_width);
-            vertices.push_back(i * seg_height);
-
-            // Color
+            glm::vec3 normal = glm::vec3(0.0f, 0.0f, 1.0f);
             glm::vec3 color = glm::vec3(1.0f, 1.0f, 1.0f);
-            vertices.push_back(color.r);
-            vertices.push_back(color.g);
-            vertices.push_back(color.b);
+            *vertex++ = GridVertex::Pack(
+                glm::vec3(x, y, z), normal, glm::vec2(j * seg_width, i * seg_height), color);
         }
     }
 
@@ -82,13 +64,13 @@ void Plane::generatePlane(int widthSegments, int heightSegments, std::vector<flo
             unsigned int c = (i + 1) * (widthSegments + 1) + j;
             unsigned int d = (i + 1) * (widthSegments + 1) + (j + 1);
 
-            indices.push_back(a);
-            indices.push_back(b);
-            indices.push_back(c);
+            *index++ = a;
+            *index++ = b;
+            *index++ = c;
 
-            indices.push_back(c);
-            indices.push_back(d);
-            indices.push_back(a);
+            *index++ = c;
+            *index++ = d;
+            *index++ = a;
         }
     }
 }
\ No newline at end of file
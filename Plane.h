@@ -1,6 +1,7 @@
 #pragma once
 
 #include "IndexBuffer.h"
+#include "MeshBuilder.h"
 #include "Shader.h"
 #include "VertexArray.h"
 #include "VertexBuffer.h"
@@ -15,10 +16,12 @@ public:
 
     void Render(glm::mat4 MVP);
 
-protected:
-	void generatePlane(int widthSegments, int heightSegments,
-        std::vector<float> &vertices, std::vector<unsigned int> &indices);
+    // (widthSegments + 1) * (heightSegments + 1) vertices and widthSegments * heightSegments * 6
+    // indices, needs no GL context
+    static void generatePlane(
+        int widthSegments, int heightSegments, GridVertex *vertex, unsigned int *index);
 
+protected:
     std::shared_ptr<VertexArray> m_VAO;
     std::shared_ptr<VertexBuffer> m_VBO;
     std::shared_ptr<IndexBuffer> m_IBO;
@@ -0,0 +1,165 @@
+#include "RenderThread.h"
+
+#include <GLFW/glfw3.h>
+#include <algorithm>
+
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+
+float MillisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<float, std::chrono::milliseconds::period>(Clock::now() - start)
+        .count();
+}
+
+float Smooth(float average, float value) {
+    return average + (value - average) * 0.1f;
+}
+
+}
+
+void RenderCommandList::Execute() {
+    for (const Command &command : m_Commands) {
+        command();
+    }
+    m_Commands.clear();
+}
+
+RenderThread::RenderThread(GLFWwindow *window, bool threaded)
+    : m_Window(window)
+    , m_Threaded(threaded)
+    , m_Recording(0)
+    , m_Submitted(-1)
+    , m_SyncFunc(nullptr)
+    , m_Stopping(false)
+    , m_MainTime(0.0f)
+    , m_WaitTime(0.0f)
+    , m_RenderTime(0.0f)
+    , m_IdleTime(0.0f)
+    , m_SyncTime(0.0f)
+    , m_MainStart(Clock::now())
+    , m_MainHistory(HistorySize, 0.0f)
+    , m_RenderHistory(HistorySize, 0.0f) {
+    if (m_Threaded) {
+        // A context can only be current on one thread at a time
+        glfwMakeContextCurrent(nullptr);
+        m_Thread = std::thread(&RenderThread::ThreadLoop, this);
+    }
+}
+
+RenderThread::~RenderThread() {
+    if (!m_Threaded) {
+        return;
+    }
+    Finish();
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_Condition.notify_all();
+    m_Thread.join();
+    glfwMakeContextCurrent(m_Window);
+}
+
+void RenderThread::Submit() {
+    if (!m_Threaded) {
+        auto start = Clock::now();
+        m_Stats.Commands = GetCommandList().GetSize();
+        GetCommandList().Execute();
+        m_RenderTime = MillisecondsSince(start);
+        EndFrame();
+        return;
+    }
+
+    Finish();
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Stats.Commands = GetCommandList().GetSize();
+    EndFrame();
+    m_Submitted = (int) m_Recording;
+    m_Recording ^= 1;
+    m_Condition.notify_all();
+}
+
+void RenderThread::Finish() {
+    if (!m_Threaded) {
+        return;
+    }
+    auto start = Clock::now();
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Condition.wait(lock, [this]() { return m_Submitted < 0 && !m_SyncFunc; });
+    m_WaitTime += MillisecondsSince(start);
+}
+
+void RenderThread::Sync(const std::function<void()> &func) {
+    if (!m_Threaded) {
+        auto start = Clock::now();
+        func();
+        m_SyncTime += MillisecondsSince(start);
+        return;
+    }
+
+    Finish();
+    auto start = Clock::now();
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_SyncFunc = &func;
+    m_Condition.notify_all();
+    m_Condition.wait(lock, [this]() { return !m_SyncFunc; });
+    m_SyncTime += MillisecondsSince(start);
+}
+
+void RenderThread::EndFrame() {
+    float frame = MillisecondsSince(m_MainStart);
+    m_MainStart = Clock::now();
+    m_MainTime = std::max(frame - m_WaitTime - m_SyncTime, 0.0f);
+
+    m_Stats.MainMilliseconds = Smooth(m_Stats.MainMilliseconds, m_MainTime);
+    m_Stats.WaitMilliseconds = Smooth(m_Stats.WaitMilliseconds, m_WaitTime);
+    m_Stats.RenderMilliseconds = Smooth(m_Stats.RenderMilliseconds, m_RenderTime);
+    m_Stats.IdleMilliseconds = Smooth(m_Stats.IdleMilliseconds, m_IdleTime);
+    m_Stats.SyncMilliseconds = Smooth(m_Stats.SyncMilliseconds, m_SyncTime);
+    m_Stats.Frames++;
+
+    std::rotate(m_MainHistory.begin(), m_MainHistory.begin() + 1, m_MainHistory.end());
+    m_MainHistory.back() = m_MainTime;
+    std::rotate(m_RenderHistory.begin(), m_RenderHistory.begin() + 1, m_RenderHistory.end());
+    m_RenderHistory.back() = m_RenderTime;
+
+    m_WaitTime = 0.0f;
+    m_SyncTime = 0.0f;
+    m_RenderTime = 0.0f;
+    m_IdleTime = 0.0f;
+}
+
+void RenderThread::ThreadLoop() {
+    glfwMakeContextCurrent(m_Window);
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while (true) {
+        auto idle = Clock::now();
+        m_Condition.wait(lock, [this]() { return m_Stopping || m_Submitted >= 0 || m_SyncFunc; });
+        m_IdleTime += MillisecondsSince(idle);
+
+        if (m_SyncFunc) {
+            lock.unlock();
+            (*m_SyncFunc)();
+            lock.lock();
+            m_SyncFunc = nullptr;
+            m_Condition.notify_all();
+        } else if (m_Submitted >= 0) {
+            RenderCommandList &list = m_Lists[m_Submitted];
+            lock.unlock();
+            auto start = Clock::now();
+            list.Execute();
+            float time = MillisecondsSince(start);
+            lock.lock();
+            m_RenderTime += time;
+            m_Submitted = -1;
+            m_Condition.notify_all();
+        } else {
+            break;
+        }
+    }
+    lock.unlock();
+
+    glfwMakeContextCurrent(nullptr);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct GLFWwindow;
+
+// Work for the render thread, recorded on the main thread. Commands run in order and may use
+// GL; whatever they capture must stay valid until the list has been executed.
+class RenderCommandList {
+public:
+    using Command = std::function<void()>;
+
+    inline void Record(Command command) {
+        m_Commands.push_back(std::move(command));
+    }
+    // Runs every command and clears the list, keeping its storage
+    void Execute();
+
+    inline unsigned int GetSize() const {
+        return (unsigned int) m_Commands.size();
+    }
+
+private:
+    std::vector<Command> m_Commands;
+};
+
+// Smoothed per-thread times of a frame, in milliseconds
+struct RenderThreadStats {
+    // Main thread: simulation and recording, then blocked on the render thread
+    float MainMilliseconds = 0.0f;
+    float WaitMilliseconds = 0.0f;
+    // Render thread: executing the command list (including the swap), then waiting for one
+    float RenderMilliseconds = 0.0f;
+    float IdleMilliseconds = 0.0f;
+    float SyncMilliseconds = 0.0f;
+    unsigned int Commands = 0;
+    unsigned int Frames = 0;
+};
+
+// Owns the GL context on a thread of its own. The main thread records frame N+1 into one
+// command list while the render thread executes frame N from the other. Sync is the one point
+// per frame where both stand still: it waits for the previous list and runs a function on the
+// render thread, the place for UI, test switching and copying simulated state for rendering.
+// Without threading everything runs inline on the caller, with the context staying there.
+class RenderThread {
+public:
+    static const unsigned int HistorySize = 120;
+
+    // Takes the context of window away from the calling thread when threaded
+    RenderThread(GLFWwindow *window, bool threaded = true);
+    // Finishes the last list and makes the context current on the calling thread again
+    ~RenderThread();
+
+    // The list the main thread records the next frame into
+    inline RenderCommandList &GetCommandList() {
+        return m_Lists[m_Recording];
+    }
+    // Hands the recorded list to the render thread and switches to the other one
+    void Submit();
+    // Waits until the render thread is done with everything submitted
+    void Finish();
+    // Finish, then runs func on the render thread while the main thread waits
+    void Sync(const std::function<void()> &func);
+
+    inline bool IsThreaded() const {
+        return m_Threaded;
+    }
+    inline const RenderThreadStats &GetStats() const {
+        return m_Stats;
+    }
+    // Oldest first, for ImGui::PlotLines
+    inline const std::vector<float> &GetMainHistory() const {
+        return m_MainHistory;
+    }
+    inline const std::vector<float> &GetRenderHistory() const {
+        return m_RenderHistory;
+    }
+
+private:
+    void ThreadLoop();
+    // Called by the main thread once per frame, at Submit
+    void EndFrame();
+
+    GLFWwindow *m_Window;
+    bool m_Threaded;
+    std::thread m_Thread;
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+
+    RenderCommandList m_Lists[2];
+    unsigned int m_Recording;
+    // Index of the list handed over by Submit, -1 once it has been executed
+    int m_Submitted;
+    const std::function<void()> *m_SyncFunc;
+    bool m_Stopping;
+
+    // Raw times of the current frame, folded into m_Stats at EndFrame
+    float m_MainTime;
+    float m_WaitTime;
+    float m_RenderTime;
+    float m_IdleTime;
+    float m_SyncTime;
+    std::chrono::high_resolution_clock::time_point m_MainStart;
+
+    RenderThreadStats m_Stats;
+    std::vector<float> m_MainHistory;
+    std::vector<float> m_RenderHistory;
+};
@@ -1,30 +1,201 @@
 #include "Renderer.h"
 
+#include "SoftwareRenderer.h"
+#include "SoftwareShaders.h"
+
+#include <cstdint>
 #include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+SoftwareRenderer *Renderer::s_Software = nullptr;
 
-void GLClearError() {
-    while (glGetError() != GL_NO_ERROR) {
-        ;
+namespace {
+
+// Warns once per kind of draw the software backend cannot run
+void SkipSoftware(const std::string &what) {
+    static std::unordered_set<std::string> s_Skipped;
+    if (s_Skipped.insert(what).second) {
+        std::cerr << "WARNING::RENDERER::Skipping " << what << " on the software backend"
+                  << std::endl;
     }
 }
 
-bool GLLogCall(const char *function, const char *file, int line) {
-    while (GLenum error = glGetError()) {
-        std::cerr << "[OpenGL Error] (" << error << "): " << function << " " << file << ":" << line
-                  << std::endl;
+glm::mat4 GetUniform(const Shader &shader, const char *name, const glm::mat4 &fallback) {
+    const glm::mat4 *value = shader.GetSoftwareUniform(name);
+    return value ? *value : fallback;
+}
+
+// The CPU shaders read the same vertex structs as the .shader files, so the buffer is only
+// drawn if its layout has their stride
+template <typename VertexT, typename ShaderT>
+bool Submit(SoftwareRenderer &renderer, const VertexArray &va,
+    const std::vector<unsigned int> &indices, const ShaderT &shader) {
+    const VertexBuffer *vb = va.GetSoftwareBuffer();
+    if (!vb || va.GetSoftwareLayout().GetStride() != sizeof(VertexT)) {
         return false;
     }
+    const std::vector<unsigned char> &data = vb->GetSoftwareData();
+    renderer.Draw((const VertexT *) data.data(), (unsigned int) (data.size() / sizeof(VertexT)),
+        indices.data(), (unsigned int) indices.size(), shader);
     return true;
 }
 
+// Triangles [first, first + count) of the index buffer, or of the vertices without one, with
+// the SoftwareShaders equivalent of the shader's file
+void DrawSoftware(SoftwareRenderer &renderer, const VertexArray &va, const IndexBuffer *ib,
+    const Shader &shader, unsigned int first, unsigned int count) {
+    std::vector<unsigned int> indices(count);
+    for (unsigned int i = 0; i < count; i++) {
+        indices[i] = ib ? ib->GetSoftwareIndex(first + i) : first + i;
+    }
+
+    const std::string &path = shader.GetFilePath();
+    glm::mat4 mvp = GetUniform(shader, "u_MVP", glm::mat4(1.0f));
+    bool drawn = false;
+    if (path == "res/shaders/Basic.shader") {
+        SoftwareShaders::Basic program;
+        program.MVP = mvp;
+        program.Color = GetUniform(shader, "u_Color", glm::mat4(1.0f))[0];
+        drawn = Submit<glm::vec3>(renderer, va, indices, program);
+    } else if (path == "res/shaders/Normal.shader") {
+        SoftwareShaders::Normal program;
+        program.MVP = mvp;
+        drawn = Submit<CubeVertex>(renderer, va, indices, program);
+    } else if (path == "res/shaders/Plane.shader") {
+        SoftwareShaders::Plane program;
+        program.MVP = mvp;
+        drawn = Submit<GridVertex>(renderer, va, indices, program);
+    }
+    if (!drawn) {
+        SkipSoftware("draws with " + (path.empty() ? std::string("inline shaders") : path));
+    }
+}
+
+}
+
+void Renderer::SetSoftwareBackend(SoftwareRenderer *backend) {
+    s_Software = backend;
+}
+
 void Renderer::Draw(const VertexArray &va, const IndexBuffer &ib, const Shader &shader) const {
+    if (s_Software) {
+        DrawSoftware(*s_Software, va, &ib, shader, 0, ib.GetCount());
+        return;
+    }
     shader.Bind();
     va.Bind();
     ib.Bind();
 
-    GLCall(glDrawElements(GL_TRIANGLES, ib.GetCount(), GL_UNSIGNED_INT, nullptr));
+    GLCall(glDrawElements(GL_TRIANGLES, ib.GetCount(), ib.GetType(), nullptr));
+}
+
+void Renderer::DrawInstanced(const VertexArray &va, const IndexBuffer &ib, const Shader &shader,
+    unsigned int instanceCount) const {
+    if (s_Software) {
+        SkipSoftware("instanced draws");
+        return;
+    }
+    shader.Bind();
+    va.Bind();
+    ib.Bind();
+
+    GLCall(glDrawElementsInstanced(
+        GL_TRIANGLES, ib.GetCount(), ib.GetType(), nullptr, instanceCount));
+}
+
+void Renderer::DrawIndirect(const VertexArray &va, const IndexBuffer &ib, const Shader &shader,
+    unsigned int offset, unsigned int drawCount) const {
+    if (s_Software) {
+        SkipSoftware("indirect draws");
+        return;
+    }
+    shader.Bind();
+    va.Bind();
+    ib.Bind();
+
+    GLCall(glMultiDrawElementsIndirect(GL_TRIANGLES, ib.GetType(),
+        (const void *) (uintptr_t) offset, drawCount, sizeof(DrawElementsIndirectCommand)));
+}
+
+void Renderer::DrawRanges(const VertexArray &va, const IndexBuffer &ib, const Shader &shader,
+    const DrawElementsIndirectCommand *commands, unsigned int drawCount) const {
+    if (s_Software) {
+        for (unsigned int i = 0; i < drawCount; i++) {
+            DrawSoftware(*s_Software, va, &ib, shader, commands[i].FirstIndex, commands[i].Count);
+        }
+        return;
+    }
+    shader.Bind();
+    va.Bind();
+    ib.Bind();
+
+    std::vector<GLsizei> counts(drawCount);
+    std::vector<const void *> offsets(drawCount);
+    for (unsigned int i = 0; i < drawCount; i++) {
+        counts[i] = commands[i].Count;
+        offsets[i] = (const void *) ((uintptr_t) commands[i].FirstIndex * ib.GetIndexSize());
+    }
+    GLCall(glMultiDrawElements(
+        GL_TRIANGLES, counts.data(), ib.GetType(), offsets.data(), drawCount));
+}
+
+void Renderer::DrawArrays(const VertexArray &va, const Shader &shader, unsigned int mode,
+    unsigned int count) const {
+    if (s_Software) {
+        if (mode == GL_TRIANGLES) {
+            DrawSoftware(*s_Software, va, nullptr, shader, 0, count);
+        } else {
+            SkipSoftware("lines and points");
+        }
+        return;
+    }
+    shader.Bind();
+    va.Bind();
+
+    GLCall(glDrawArrays(mode, 0, count));
+}
+
+void Renderer::DrawArraysInstanced(const VertexArray &va, const Shader &shader, unsigned int mode,
+    unsigned int count, unsigned int instanceCount) const {
+    if (s_Software) {
+        SkipSoftware("instanced draws");
+        return;
+    }
+    shader.Bind();
+    va.Bind();
+
+    GLCall(glDrawArraysInstanced(mode, 0, count, instanceCount));
 }
 
 void Renderer::Clear() const {
+    if (s_Software) {
+        s_Software->Clear(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        return;
+    }
     GLCall(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+}
+
+void Renderer::SetDepthTest(bool enable) const {
+    if (s_Software) {
+        return;
+    }
+    if (enable) {
+        GLCall(glEnable(GL_DEPTH_TEST));
+    } else {
+        GLCall(glDisable(GL_DEPTH_TEST));
+    }
+}
+
+void Renderer::SetBackFaceCulling(bool enable) const {
+    if (s_Software) {
+        s_Software->SetCullBackFaces(enable);
+        return;
+    }
+    if (enable) {
+        GLCall(glEnable(GL_CULL_FACE));
+    } else {
+        GLCall(glDisable(GL_CULL_FACE));
+    }
 }
\ No newline at end of file
@@ -8,12 +8,50 @@
 #include <GL/glew.h>
 #include <signal.h>
 
-void GLClearError();
+class SoftwareRenderer;
 
-bool GLLogCall(const char *function, const char *file, int line);
+// Layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+    unsigned int Count;
+    unsigned int InstanceCount;
+    unsigned int FirstIndex;
+    unsigned int BaseVertex;
+    unsigned int BaseInstance;
+};
 
 class Renderer {
 public:
+    // While a software backend is set (see RunHeadless), the draws below rasterize on the CPU and
+    // VertexBuffer, IndexBuffer, VertexArray and Shader keep their data in memory instead of
+    // creating GL objects. It has to stay set for as long as any of those objects live.
+    // Instanced and indirect draws need stream or indirect buffers and are skipped.
+    static void SetSoftwareBackend(SoftwareRenderer *backend);
+    static inline SoftwareRenderer *GetSoftwareBackend() {
+        return s_Software;
+    }
+
+    // To opaque black like the main loop when headless
     void Clear() const;
+    // The software backend always tests depth, with GL_LESS
+    void SetDepthTest(bool enable) const;
+    void SetBackFaceCulling(bool enable) const;
     void Draw(const VertexArray &va, const IndexBuffer &ib, const Shader &shader) const;
+    void DrawInstanced(const VertexArray &va, const IndexBuffer &ib, const Shader &shader,
+        unsigned int instanceCount) const;
+    // drawCount commands from the bound GL_DRAW_INDIRECT_BUFFER, starting at offset bytes.
+    // Needs ARB_multi_draw_indirect.
+    void DrawIndirect(const VertexArray &va, const IndexBuffer &ib, const Shader &shader,
+        unsigned int offset, unsigned int drawCount) const;
+    // The same ranges from client memory with glMultiDrawElements, for when there is no
+    // indirect buffer. Only Count and FirstIndex are used.
+    void DrawRanges(const VertexArray &va, const IndexBuffer &ib, const Shader &shader,
+        const DrawElementsIndirectCommand *commands, unsigned int drawCount) const;
+    // Non-indexed draw of count vertices, mode is GL_LINES, GL_TRIANGLES, ...
+    void DrawArrays(const VertexArray &va, const Shader &shader, unsigned int mode,
+        unsigned int count) const;
+    void DrawArraysInstanced(const VertexArray &va, const Shader &shader, unsigned int mode,
+        unsigned int count, unsigned int instanceCount) const;
+
+private:
+    static SoftwareRenderer *s_Software;
 };
\ No newline at end of file
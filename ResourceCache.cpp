@@ -0,0 +1,18 @@
+#include "ResourceCache.h"
+
+#include <iomanip>
+#include <sstream>
+
+uint64_t ContentHash(const void *data, size_t size, uint64_t hash) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= ((const unsigned char *) data)[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::string ContentKey(uint64_t hash) {
+    std::stringstream ss;
+    ss << "#" << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return ss.str();
+}
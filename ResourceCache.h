@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// FNV-1a, chain calls to hash several arrays into one key
+uint64_t ContentHash(const void *data, size_t size, uint64_t hash = 0xcbf29ce484222325ull);
+std::string ContentKey(uint64_t hash);
+
+struct ResourceCacheStats {
+    unsigned int Hits = 0;
+    unsigned int Misses = 0;
+    unsigned int Evictions = 0;
+    unsigned int Entries = 0;
+    // Entries nobody holds any more, kept in case they are asked for again
+    unsigned int Retained = 0;
+    size_t Bytes = 0;
+    size_t RetainedBytes = 0;
+    // What the hits would have loaded and uploaded again
+    size_t SavedBytes = 0;
+};
+
+// Shares GPU resources by key, a path or a ContentKey of the source data. Acquire hands out
+// shared_ptrs, so an entry is in use while anyone holds it. Released entries stay cached until
+// the retained ones exceed the retain budget, then Trim evicts the least recently used. Only
+// used from the thread with the GL context; the caches are owned by main and Get returns the
+// one for T while it exists.
+template <typename T> class ResourceCache {
+public:
+    using LoadFunc = std::function<std::shared_ptr<T>()>;
+    using SizeFunc = std::function<size_t(const T &)>;
+
+    ResourceCache(const std::string &name, size_t retainBytes, SizeFunc size)
+        : m_Name(name)
+        , m_RetainBytes(retainBytes)
+        , m_Size(std::move(size))
+        , m_Clock(0) {
+        s_Instance = this;
+    }
+    // Destroys the retained entries, needs the GL context
+    ~ResourceCache() {
+        s_Instance = nullptr;
+    }
+
+    // The cached resource for key, calling load only on a miss. Failed loads (nullptr) are
+    // not cached.
+    std::shared_ptr<T> Acquire(const std::string &key, const LoadFunc &load) {
+        auto found = m_Entries.find(key);
+        if (found != m_Entries.end()) {
+            m_Stats.Hits++;
+            m_Stats.SavedBytes += m_Size(*found->second.Resource);
+            found->second.LastUse = ++m_Clock;
+            return found->second.Resource;
+        }
+
+        m_Stats.Misses++;
+        std::shared_ptr<T> resource = load();
+        if (resource) {
+            m_Entries[key] = { resource, ++m_Clock };
+        }
+        return resource;
+    }
+
+    // Once per frame: refreshes the stats and evicts released entries over the budget
+    void Trim() {
+        m_Clock++;
+        std::vector<std::pair<uint64_t, const std::string *>> released;
+        m_Stats.Bytes = 0;
+        m_Stats.RetainedBytes = 0;
+        for (auto &[key, entry] : m_Entries) {
+            size_t size = m_Size(*entry.Resource);
+            m_Stats.Bytes += size;
+            // Only the cache holds it
+            if (entry.Resource.use_count() == 1) {
+                m_Stats.RetainedBytes += size;
+                released.push_back({ entry.LastUse, &key });
+            } else {
+                entry.LastUse = m_Clock;
+            }
+        }
+
+        if (m_Stats.RetainedBytes > m_RetainBytes) {
+            std::sort(released.begin(), released.end());
+            for (const auto &[lastUse, key] : released) {
+                if (m_Stats.RetainedBytes <= m_RetainBytes) {
+                    break;
+                }
+                auto entry = m_Entries.find(*key);
+                size_t size = m_Size(*entry->second.Resource);
+                m_Stats.RetainedBytes -= size;
+                m_Stats.Bytes -= size;
+                m_Stats.Evictions++;
+                m_Entries.erase(entry);
+            }
+        }
+        m_Stats.Entries = (unsigned int) m_Entries.size();
+        m_Stats.Retained = 0;
+        for (const auto &[key, entry] : m_Entries) {
+            m_Stats.Retained += entry.Resource.use_count() == 1;
+        }
+    }
+
+    inline const std::string &GetName() const {
+        return m_Name;
+    }
+    inline size_t GetRetainBudget() const {
+        return m_RetainBytes;
+    }
+    inline void SetRetainBudget(size_t bytes) {
+        m_RetainBytes = bytes;
+    }
+    inline const ResourceCacheStats &GetStats() const {
+        return m_Stats;
+    }
+
+    static ResourceCache *Get() {
+        return s_Instance;
+    }
+
+private:
+    struct Entry {
+        std::shared_ptr<T> Resource;
+        uint64_t LastUse;
+    };
+
+    std::string m_Name;
+    size_t m_RetainBytes;
+    SizeFunc m_Size;
+    uint64_t m_Clock;
+    std::unordered_map<std::string, Entry> m_Entries;
+    ResourceCacheStats m_Stats;
+
+    static ResourceCache *s_Instance;
+};
+
+template <typename T> ResourceCache<T> *ResourceCache<T>::s_Instance = nullptr;
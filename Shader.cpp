@@ -1,48 +1,194 @@
 #include "Shader.h"
 
 #include "Renderer.h"
+#include "ShaderCache.h"
 
 #include <GL/glew.h>
+#include <cctype>
+#include <chrono>
 #include <fstream>
 #include <iostream>
-#include <sstream>
+#include <iterator>
+#include <string_view>
 
 std::unordered_map<std::string, std::pair<unsigned int, unsigned int>> Shader::s_ShaderMap;
+std::unordered_map<unsigned int, Shader::PendingProgram> Shader::s_PendingPrograms;
+
+namespace {
+
+const struct {
+    unsigned int Feature;
+    const char *Name;
+} c_Features[] = {
+    { ShaderFeature::Textured, "textured" },
+    { ShaderFeature::Lit, "lit" },
+    { ShaderFeature::Instanced, "instanced" },
+    { ShaderFeature::Skinned, "skinned" },
+    { ShaderFeature::Shadowed, "shadowed" },
+    { ShaderFeature::Clustered, "clustered" },
+};
+
+// Guards against include cycles
+const int c_MaxIncludeDepth = 16;
+
+std::string ReadFile(const std::string &filepath) {
+    std::ifstream stream(filepath, std::ios::binary);
+    if (!stream) {
+        std::cerr << "Failed to open shader file " << filepath << std::endl;
+        return "";
+    }
+    return std::string(
+        (std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+}
+
+std::string GetDirectory(const std::string &filepath) {
+    size_t slash = filepath.find_last_of("/\\");
+    return slash == std::string::npos ? "" : filepath.substr(0, slash + 1);
+}
+
+// Calls callback for every line of text, without the line break
+template <typename F> void ForEachLine(const std::string &text, F callback) {
+    size_t begin = 0;
+    while (begin < text.size()) {
+        size_t end = text.find('\n', begin);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        callback(std::string_view(text.data() + begin, end - begin));
+        begin = end + 1;
+    }
+}
+
+// Returns the quoted path of an #include line, or an empty view
+std::string_view GetIncludePath(std::string_view line) {
+    size_t directive = line.find("#include");
+    if (directive == std::string_view::npos) {
+        return {};
+    }
+    size_t open = line.find('"', directive);
+    size_t close = open == std::string_view::npos ? open : line.find('"', open + 1);
+    if (close == std::string_view::npos) {
+        return {};
+    }
+    return line.substr(open + 1, close - open - 1);
+}
+
+void AppendInclude(const std::string &filepath, std::string &out, int depth) {
+    if (depth > c_MaxIncludeDepth) {
+        std::cerr << "Shader includes nested too deep at " << filepath << std::endl;
+        return;
+    }
 
-Shader::Shader(const std::string &filepath)
+    std::string directory = GetDirectory(filepath);
+    ForEachLine(ReadFile(filepath), [&](std::string_view line) {
+        std::string_view include = GetIncludePath(line);
+        if (!include.empty()) {
+            AppendInclude(directory + std::string(include), out, depth + 1);
+        } else {
+            out.append(line).append(1, '\n');
+        }
+    });
+}
+
+// GLSL needs #version first, so the feature defines go right after it
+void InsertDefines(std::string &source, const std::string &defines) {
+    size_t version = source.find("#version");
+    size_t position = version == std::string::npos ? 0 : source.find('\n', version);
+    if (position == std::string::npos) {
+        source += '\n';
+        position = source.size();
+    } else if (version != std::string::npos) {
+        position++;
+    }
+    source.insert(position, defines);
+}
+
+// Vector uniform as recorded for the software backend
+glm::mat4 SoftwareVector(float v0, float v1, float v2, float v3) {
+    glm::mat4 value(0.0f);
+    value[0] = glm::vec4(v0, v1, v2, v3);
+    return value;
+}
+
+}
+
+Shader::Shader(const std::string &filepath, unsigned int features)
     : m_RendererId(0)
-    , m_FilePath(filepath) {
+    , m_FilePath(filepath)
+    , m_MapKey(filepath) {
+
+    if (features != ShaderFeature::None) {
+        m_MapKey += "#" + std::to_string(features);
+    }
+    // Renderer picks the CPU version of the program by m_FilePath
+    if (Renderer::GetSoftwareBackend()) {
+        return;
+    }
 
-    if (s_ShaderMap.find(filepath) != s_ShaderMap.end()) {
-        m_RendererId = s_ShaderMap[filepath].first;
-        s_ShaderMap[filepath].second++;
+    if (s_ShaderMap.find(m_MapKey) != s_ShaderMap.end()) {
+        m_RendererId = s_ShaderMap[m_MapKey].first;
+        s_ShaderMap[m_MapKey].second++;
         return;
     }
 
-    ShaderProgramSource source = ParseShader(filepath);
-    std::cout << "Compiling " << filepath << std::endl;
-    m_RendererId = CreateShader(source.VertexSource, source.FragmentSource);
+    auto start = std::chrono::high_resolution_clock::now();
+
+    ShaderProgramSource source = ParseShader(filepath, features);
+    uint64_t key = ShaderCache::Hash(source.VertexSource, source.FragmentSource);
+    m_RendererId = ShaderCache::Load(key);
+
+    if (m_RendererId != 0) {
+        float elapsed = std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - start)
+                            .count();
+        ShaderCache::RecordLoadTime(true, elapsed);
+        std::cout << "Loaded cached " << m_MapKey << " in " << elapsed << " ms" << std::endl;
+    } else {
+        std::cout << "Compiling " << m_MapKey << std::endl;
+        PendingProgram pending = { 0, 0, key, m_MapKey, start };
+        m_RendererId = BeginCreateShader(source.VertexSource, source.FragmentSource,
+            pending.VertexShader, pending.FragmentShader);
+        s_PendingPrograms[m_RendererId] = pending;
+
+        // Without parallel compilation the driver would block on the first query anyway
+        if (!SupportsParallelCompile()) {
+            FinishProgram(m_RendererId);
+        }
+    }
 
-    s_ShaderMap[filepath] = std::make_pair(m_RendererId, 1);
+    s_ShaderMap[m_MapKey] = std::make_pair(m_RendererId, 1);
 }
 
 Shader::Shader(const std::string& vertexShader, const std::string& fragmentShader)
     : m_RendererId(0)
     , m_FilePath("") {
+    // No CPU version of a program given as source, its draws are skipped
+    if (Renderer::GetSoftwareBackend()) {
+        return;
+    }
 
 	std::cout << "Compiling " << m_FilePath << std::endl;
 	m_RendererId = CreateShader(vertexShader, fragmentShader);
 }
 
 Shader::~Shader() {
+    if (Renderer::GetSoftwareBackend()) {
+        return;
+    }
     if (m_FilePath == "") {
         GLCall(glDeleteProgram(m_RendererId));
     }
     else {
-        if (s_ShaderMap.find(m_FilePath) != s_ShaderMap.end()) {
-            s_ShaderMap[m_FilePath].second--;
-            if (s_ShaderMap[m_FilePath].second == 0) {
-                s_ShaderMap.erase(m_FilePath);
+        if (s_ShaderMap.find(m_MapKey) != s_ShaderMap.end()) {
+            s_ShaderMap[m_MapKey].second--;
+            if (s_ShaderMap[m_MapKey].second == 0) {
+                s_ShaderMap.erase(m_MapKey);
+                auto pending = s_PendingPrograms.find(m_RendererId);
+                if (pending != s_PendingPrograms.end()) {
+                    GLCall(glDeleteShader(pending->second.VertexShader));
+                    GLCall(glDeleteShader(pending->second.FragmentShader));
+                    s_PendingPrograms.erase(pending);
+                }
                 GLCall(glDeleteProgram(m_RendererId));
             }
         }
@@ -58,6 +204,10 @@ unsigned int Shader::CompileShader(unsigned int type, const std::string &source)
     glShaderSource(id, 1, &src, nullptr);
     glCompileShader(id);
 
+    return id;
+}
+
+bool Shader::CheckShader(unsigned int id, unsigned int type) {
     int result;
     glGetShaderiv(id, GL_COMPILE_STATUS, &result);
     if (result == GL_FALSE) {
@@ -68,46 +218,85 @@ unsigned int Shader::CompileShader(unsigned int type, const std::string &source)
         std::cout << "Failed to compile " << (type == GL_VERTEX_SHADER ? "vertex" : "fragment")
                   << "shader!" << std::endl;
         std::cout << message << std::endl;
-        return 0;
+        return false;
     }
 
-    return id;
+    return true;
 }
 
-ShaderProgramSource Shader::ParseShader(const std::string &filepath) {
-    std::ifstream stream(filepath);
-
+ShaderProgramSource Shader::ParseShader(const std::string &filepath, unsigned int features) {
     enum class ShaderType { NONE = -1, VERTEX = 0, FRAGMENT = 1 };
 
-    std::string line;
-    std::stringstream ss[2];
+    ShaderProgramSource result;
+    std::string *sources[2] = { &result.VertexSource, &result.FragmentSource };
     ShaderType type = ShaderType::NONE;
+    std::string directory = GetDirectory(filepath);
 
-    while (getline(stream, line)) {
-        if (line.find("#shader") != std::string::npos) {
-            if (line.find("vertex") != std::string::npos) {
+    ForEachLine(ReadFile(filepath), [&](std::string_view line) {
+        if (line.find("#shader") != std::string_view::npos) {
+            if (line.find("vertex") != std::string_view::npos) {
                 type = ShaderType::VERTEX;
-            } else if (line.find("fragment") != std::string::npos) {
+            } else if (line.find("fragment") != std::string_view::npos) {
                 type = ShaderType::FRAGMENT;
             }
+        } else if (line.find("#features") != std::string_view::npos) {
+            for (const auto &feature : c_Features) {
+                if (line.find(feature.Name) != std::string_view::npos) {
+                    result.Features |= feature.Feature;
+                }
+            }
         } else if (type != ShaderType::NONE) {
-            ss[(int) type] << line << '\n';
+            std::string_view include = GetIncludePath(line);
+            if (!include.empty()) {
+                AppendInclude(directory + std::string(include), *sources[(int) type], 1);
+            } else {
+                sources[(int) type]->append(line).append(1, '\n');
+            }
         }
+    });
+
+    std::string defines;
+    for (const auto &feature : c_Features) {
+        if (features & feature.Feature & result.Features) {
+            defines += "#define FEATURE_";
+            for (const char *c = feature.Name; *c; c++) {
+                defines += (char) toupper(*c);
+            }
+            defines += '\n';
+        }
+    }
+    if (!defines.empty()) {
+        InsertDefines(result.VertexSource, defines);
+        InsertDefines(result.FragmentSource, defines);
     }
 
-    return { ss[0].str(), ss[1].str() };
+    return result;
 }
 
-unsigned int Shader::CreateShader(
-    const std::string &vertexShader, const std::string &fragmentShader) {
+unsigned int Shader::BeginCreateShader(const std::string &vertexShader,
+    const std::string &fragmentShader, unsigned int &vs, unsigned int &fs) {
 
     GLCall(unsigned int program = glCreateProgram());
-    unsigned int vs = CompileShader(GL_VERTEX_SHADER, vertexShader);
-    unsigned int fs = CompileShader(GL_FRAGMENT_SHADER, fragmentShader);
+    vs = CompileShader(GL_VERTEX_SHADER, vertexShader);
+    fs = CompileShader(GL_FRAGMENT_SHADER, fragmentShader);
 
     GLCall(glAttachShader(program, vs));
     GLCall(glAttachShader(program, fs));
+    if (ShaderCache::IsSupported()) {
+        GLCall(glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+    }
     GLCall(glLinkProgram(program));
+
+    return program;
+}
+
+unsigned int Shader::CreateShader(
+    const std::string &vertexShader, const std::string &fragmentShader) {
+
+    unsigned int vs, fs;
+    unsigned int program = BeginCreateShader(vertexShader, fragmentShader, vs, fs);
+    CheckShader(vs, GL_VERTEX_SHADER);
+    CheckShader(fs, GL_FRAGMENT_SHADER);
     GLCall(glValidateProgram(program));
 
     GLCall(glDeleteShader(vs));
@@ -116,43 +305,157 @@ unsigned int Shader::CreateShader(
     return program;
 }
 
+void Shader::FinishProgram(unsigned int program) {
+    auto it = s_PendingPrograms.find(program);
+    if (it == s_PendingPrograms.end()) {
+        return;
+    }
+    PendingProgram pending = it->second;
+    s_PendingPrograms.erase(it);
+
+    // These queries block until the driver's compiler threads are done with the program
+    bool compiled = CheckShader(pending.VertexShader, GL_VERTEX_SHADER);
+    compiled &= CheckShader(pending.FragmentShader, GL_FRAGMENT_SHADER);
+    GLCall(glValidateProgram(program));
+
+    GLCall(glDeleteShader(pending.VertexShader));
+    GLCall(glDeleteShader(pending.FragmentShader));
+
+    if (compiled) {
+        ShaderCache::Store(pending.CacheKey, program);
+    }
+
+    float elapsed = std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::high_resolution_clock::now() - pending.Start)
+                        .count();
+    ShaderCache::RecordLoadTime(false, elapsed);
+    std::cout << "Compiled " << pending.Name << " in " << elapsed << " ms" << std::endl;
+}
+
+bool Shader::SupportsParallelCompile() {
+    static int supported = -1;
+    if (supported == -1) {
+        supported = 0;
+        if (GLEW_KHR_parallel_shader_compile) {
+            GLCall(glMaxShaderCompilerThreadsKHR(0xFFFFFFFF));
+            supported = 1;
+        } else if (GLEW_ARB_parallel_shader_compile) {
+            GLCall(glMaxShaderCompilerThreadsARB(0xFFFFFFFF));
+            supported = 1;
+        }
+    }
+    return supported == 1;
+}
+
+const char *Shader::GetFeatureName(unsigned int feature) {
+    for (const auto &entry : c_Features) {
+        if (entry.Feature == feature) {
+            return entry.Name;
+        }
+    }
+    return "unknown";
+}
+
+bool Shader::IsReady() const {
+    if (Renderer::GetSoftwareBackend()) {
+        return true;
+    }
+    if (s_PendingPrograms.find(m_RendererId) == s_PendingPrograms.end()) {
+        return true;
+    }
+
+    int complete = GL_FALSE;
+    GLCall(glGetProgramiv(m_RendererId, GL_COMPLETION_STATUS_KHR, &complete));
+    if (complete == GL_FALSE) {
+        return false;
+    }
+
+    FinishProgram(m_RendererId);
+    return true;
+}
+
+void Shader::WaitUntilReady() const {
+    if (!s_PendingPrograms.empty()) {
+        FinishProgram(m_RendererId);
+    }
+}
+
 void Shader::Bind() const {
+    if (Renderer::GetSoftwareBackend()) {
+        return;
+    }
+    WaitUntilReady();
     GLCall(glUseProgram(m_RendererId));
 }
 void Shader::UnBind() const {
+    if (Renderer::GetSoftwareBackend()) {
+        return;
+    }
     GLCall(glUseProgram(0));
 }
 
 // Set uniforms
 void Shader::SetUniform1i(const std::string &name, int value) {
+    if (SetSoftwareUniform(name, glm::mat4((float) value))) {
+        return;
+    }
     GLCall(glUniform1i(GetUniformLocation(name), value));
 }
 
 void Shader::SetUniform1f(const std::string &name, float value) {
+    if (SetSoftwareUniform(name, glm::mat4(value))) {
+        return;
+    }
     GLCall(glUniform1f(GetUniformLocation(name), value));
 }
 
 void Shader::SetUniform2f(const std::string& name, float v0, float v1) {
+    if (SetSoftwareUniform(name, SoftwareVector(v0, v1, 0.0f, 0.0f))) {
+        return;
+    }
 	GLCall(glUniform2f(GetUniformLocation(name), v0, v1));
 }
 
 void Shader::SetUniform3f(const std::string& name, float v0, float v1, float v2) {
+    if (SetSoftwareUniform(name, SoftwareVector(v0, v1, v2, 0.0f))) {
+        return;
+    }
 	GLCall(glUniform3f(GetUniformLocation(name), v0, v1, v2));
 }
 
 void Shader::SetUniform4f(const std::string &name, float v0, float v1, float v2, float v3) {
+    if (SetSoftwareUniform(name, SoftwareVector(v0, v1, v2, v3))) {
+        return;
+    }
     GLCall(glUniform4f(GetUniformLocation(name), v0, v1, v2, v3));
 }
 
 void Shader::SetUniformMat4f(const std::string &name, const glm::mat4 &matrix) {
+    if (SetSoftwareUniform(name, matrix)) {
+        return;
+    }
     GLCall(glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, &matrix[0][0]));
 }
 
+bool Shader::SetSoftwareUniform(const std::string &name, const glm::mat4 &value) {
+    if (!Renderer::GetSoftwareBackend()) {
+        return false;
+    }
+    m_SoftwareUniforms[name] = value;
+    return true;
+}
+
+const glm::mat4 *Shader::GetSoftwareUniform(const std::string &name) const {
+    auto uniform = m_SoftwareUniforms.find(name);
+    return uniform == m_SoftwareUniforms.end() ? nullptr : &uniform->second;
+}
+
 int Shader::GetUniformLocation(const std::string &name) const {
     if (m_UniformLocationCache.find(name) != m_UniformLocationCache.end()) {
         return m_UniformLocationCache[name];
     }
 
+    WaitUntilReady();
     GLCall(int location = glGetUniformLocation(m_RendererId, name.c_str()));
     if (location == -1) {
         std::cerr << "Warning: uniform \'" << name << "\' doesn't exist!" << std::endl;
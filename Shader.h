@@ -1,30 +1,66 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <string>
 #include <unordered_map>
 
+// Feature keywords a .shader file can opt into with a "#features" line. Each one requested
+// for a variant is compiled in as FEATURE_<NAME>, so unused features cost nothing on the GPU.
+namespace ShaderFeature {
+    enum : unsigned int {
+        None = 0,
+        Textured = 1 << 0,
+        Lit = 1 << 1,
+        Instanced = 1 << 2,
+        Skinned = 1 << 3,
+        // Directional light with cascaded shadows, needs Lit
+        Shadowed = 1 << 4,
+        // Point lights from ClusteredLighting, needs Lit
+        Clustered = 1 << 5,
+    };
+};
+
 struct ShaderProgramSource {
     std::string VertexSource;
     std::string FragmentSource;
+    // Features declared by the file, requests for anything else are ignored
+    unsigned int Features = 0;
 };
 
 class Shader {
 private:
     unsigned int m_RendererId;
     std::string m_FilePath;
+    std::string m_MapKey;
     mutable std::unordered_map<std::string, int> m_UniformLocationCache;
-    // string: filepath, pair: rendererId, reference count
+    // Uniforms set while there is a software backend, vectors in the first column
+    std::unordered_map<std::string, glm::mat4> m_SoftwareUniforms;
+    // string: filepath (and feature mask), pair: rendererId, reference count
     static std::unordered_map<std::string, std::pair<unsigned int, unsigned int>> s_ShaderMap;
 
+    // Programs whose compile and link were only kicked off (KHR_parallel_shader_compile)
+    struct PendingProgram {
+        unsigned int VertexShader;
+        unsigned int FragmentShader;
+        uint64_t CacheKey;
+        std::string Name;
+        std::chrono::high_resolution_clock::time_point Start;
+    };
+    static std::unordered_map<unsigned int, PendingProgram> s_PendingPrograms;
+
 public:
-    Shader(const std::string &filepath);
+    Shader(const std::string &filepath, unsigned int features = ShaderFeature::None);
     Shader(const std::string &vertexShader, const std::string &fragmentShader);
     ~Shader();
 
     void Bind() const;
     void UnBind() const;
 
+    // False while the driver is still compiling this program in the background
+    bool IsReady() const;
+
     // Set uniforms
     void SetUniform1i(const std::string &name, int value);
     void SetUniform1f(const std::string &name, float value);
@@ -33,10 +69,27 @@ public:
     void SetUniform4f(const std::string &name, float v0, float v1, float v2, float v3);
     void SetUniformMat4f(const std::string &name, const glm::mat4 &matrix);
 
+    inline const std::string &GetFilePath() const {
+        return m_FilePath;
+    }
+    // nullptr if it was never set
+    const glm::mat4 *GetSoftwareUniform(const std::string &name) const;
+
+    static bool SupportsParallelCompile();
+    static const char *GetFeatureName(unsigned int feature);
+
 private:
     int GetUniformLocation(const std::string &name) const;
+    // True if there is a software backend and the value was recorded instead of sent to GL
+    bool SetSoftwareUniform(const std::string &name, const glm::mat4 &value);
+    void WaitUntilReady() const;
 
-    ShaderProgramSource ParseShader(const std::string &filepath);
+    ShaderProgramSource ParseShader(const std::string &filepath, unsigned int features);
     unsigned int CompileShader(unsigned int type, const std::string &source);
     unsigned int CreateShader(const std::string &vertexShader, const std::string &fragmentShader);
-};
\ No newline at end of file
+    unsigned int BeginCreateShader(const std::string &vertexShader,
+        const std::string &fragmentShader, unsigned int &vs, unsigned int &fs);
+
+    static void FinishProgram(unsigned int program);
+    static bool CheckShader(unsigned int id, unsigned int type);
+};
@@ -0,0 +1,163 @@
+#include "ShaderCache.h"
+
+#include "Renderer.h"
+#include "ResourceCache.h"
+
+#include <GL/glew.h>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+ShaderCacheStats ShaderCache::s_Stats;
+
+namespace {
+
+const char *c_CacheDirectory = "res/cache/shaders";
+const uint32_t c_Magic = 0x42535053; // "SPSB"
+const uint32_t c_Version = 1;
+
+struct CacheHeader {
+    uint32_t Magic;
+    uint32_t Version;
+    uint64_t Key;
+    uint32_t Format;
+    uint32_t Length;
+};
+
+}
+
+bool ShaderCache::IsSupported() {
+    if (!GLEW_ARB_get_program_binary) {
+        return false;
+    }
+    // Some drivers expose the extension but no binary formats at all
+    GLint formats = 0;
+    GLCall(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats));
+    return formats > 0;
+}
+
+const std::string &ShaderCache::GetDriverString() {
+    static std::string driver;
+    if (driver.empty()) {
+        for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+            GLCall(const GLubyte *value = glGetString(name));
+            if (value) {
+                driver += (const char *) value;
+            }
+            driver += '\n';
+        }
+    }
+    return driver;
+}
+
+uint64_t ShaderCache::Hash(const std::string &vertexSource, const std::string &fragmentSource) {
+    const std::string &driver = GetDriverString();
+
+    uint64_t hash = ContentHash(driver.data(), driver.size());
+    hash = ContentHash(vertexSource.data(), vertexSource.size(), hash);
+    // Separator so that moving text between the stages changes the key
+    hash = ContentHash("\0", 1, hash);
+    hash = ContentHash(fragmentSource.data(), fragmentSource.size(), hash);
+    return hash;
+}
+
+std::string ShaderCache::GetPath(uint64_t key) {
+    std::stringstream ss;
+    ss << c_CacheDirectory << "/" << std::hex << std::setw(16) << std::setfill('0') << key
+       << ".bin";
+    return ss.str();
+}
+
+unsigned int ShaderCache::Load(uint64_t key) {
+    if (!IsSupported()) {
+        return 0;
+    }
+
+    std::ifstream stream(GetPath(key), std::ios::binary);
+    if (!stream) {
+        return 0;
+    }
+
+    CacheHeader header;
+    if (!stream.read((char *) &header, sizeof(header)) || header.Magic != c_Magic
+        || header.Version != c_Version || header.Key != key) {
+        s_Stats.Rejected++;
+        return 0;
+    }
+
+    std::vector<char> binary(header.Length);
+    if (!stream.read(binary.data(), binary.size())) {
+        s_Stats.Rejected++;
+        return 0;
+    }
+
+    GLCall(unsigned int program = glCreateProgram());
+    GLCall(glProgramBinary(program, header.Format, binary.data(), (GLsizei) binary.size()));
+
+    // The driver is free to refuse a binary (e.g. after an update), fall back to compiling
+    int linked = GL_FALSE;
+    GLCall(glGetProgramiv(program, GL_LINK_STATUS, &linked));
+    if (linked == GL_FALSE) {
+        std::cout << "Cached shader binary was rejected by the driver" << std::endl;
+        GLCall(glDeleteProgram(program));
+        s_Stats.Rejected++;
+        return 0;
+    }
+
+    return program;
+}
+
+void ShaderCache::Store(uint64_t key, unsigned int program) {
+    if (!IsSupported()) {
+        return;
+    }
+
+    int linked = GL_FALSE;
+    GLCall(glGetProgramiv(program, GL_LINK_STATUS, &linked));
+    if (linked == GL_FALSE) {
+        return;
+    }
+
+    int length = 0;
+    GLCall(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+    if (length <= 0) {
+        return;
+    }
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    GLCall(glGetProgramBinary(program, length, &length, &format, binary.data()));
+
+    std::error_code error;
+    std::filesystem::create_directories(c_CacheDirectory, error);
+
+    // Write to a temporary file first so that a crash never leaves a truncated entry behind
+    std::string path = GetPath(key);
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+        if (!stream) {
+            return;
+        }
+        CacheHeader header = { c_Magic, c_Version, key, format, (uint32_t) length };
+        stream.write((const char *) &header, sizeof(header));
+        stream.write(binary.data(), length);
+        if (!stream) {
+            return;
+        }
+    }
+    std::filesystem::rename(tempPath, path, error);
+}
+
+void ShaderCache::RecordLoadTime(bool hit, float milliseconds) {
+    if (hit) {
+        s_Stats.Hits++;
+        s_Stats.HitTime += milliseconds;
+    } else {
+        s_Stats.Misses++;
+        s_Stats.MissTime += milliseconds;
+    }
+}
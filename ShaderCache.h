@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+struct ShaderCacheStats {
+    unsigned int Hits = 0;
+    unsigned int Misses = 0;
+    unsigned int Rejected = 0;
+    // Milliseconds spent turning shader files into linked programs
+    float HitTime = 0.0f;
+    float MissTime = 0.0f;
+};
+
+// Persists linked program binaries (ARB_get_program_binary) in res/cache/shaders so that
+// later runs skip the driver's compile and link. Entries are keyed by the preprocessed
+// source and the driver identification, so a driver update simply misses the cache.
+class ShaderCache {
+public:
+    static bool IsSupported();
+
+    static uint64_t Hash(const std::string &vertexSource, const std::string &fragmentSource);
+
+    // Returns a linked program, or 0 if there is no entry or the driver rejected it
+    static unsigned int Load(uint64_t key);
+    static void Store(uint64_t key, unsigned int program);
+
+    static void RecordLoadTime(bool hit, float milliseconds);
+    static const ShaderCacheStats &GetStats() {
+        return s_Stats;
+    }
+
+private:
+    static std::string GetPath(uint64_t key);
+    static const std::string &GetDriverString();
+
+    static ShaderCacheStats s_Stats;
+};
@@ -0,0 +1,27 @@
+#include "ShaderVariants.h"
+
+ShaderVariants::ShaderVariants(const std::string &filepath)
+    : m_FilePath(filepath) {
+}
+
+ShaderVariants::~ShaderVariants() {
+}
+
+Shader &ShaderVariants::Get(unsigned int features) {
+    auto &variant = m_Variants[features];
+    if (!variant) {
+        variant = std::make_unique<Shader>(m_FilePath, features);
+    }
+    return *variant;
+}
+
+void ShaderVariants::Prefetch(std::initializer_list<unsigned int> features) {
+    for (unsigned int variant : features) {
+        Get(variant);
+    }
+}
+
+bool ShaderVariants::IsReady(unsigned int features) const {
+    auto it = m_Variants.find(features);
+    return it != m_Variants.end() && it->second->IsReady();
+}
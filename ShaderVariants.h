@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Shader.h"
+
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Specialised variants of one .shader file, selected by a ShaderFeature bitmask. Variants are
+// compiled the first time they are asked for; Prefetch starts several at once so the driver
+// can compile them in parallel.
+class ShaderVariants {
+public:
+    ShaderVariants(const std::string &filepath);
+    ~ShaderVariants();
+
+    Shader &Get(unsigned int features);
+    void Prefetch(std::initializer_list<unsigned int> features);
+
+    // True once the variant exists and the driver is done compiling it
+    bool IsReady(unsigned int features) const;
+
+    inline size_t GetVariantCount() const {
+        return m_Variants.size();
+    }
+
+private:
+    std::string m_FilePath;
+    std::unordered_map<unsigned int, std::unique_ptr<Shader>> m_Variants;
+};
@@ -0,0 +1,233 @@
+#include "SoftwareRenderer.h"
+
+#include <algorithm>
+
+namespace {
+
+float Milliseconds(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::high_resolution_clock::now() - start)
+        .count();
+}
+
+}
+
+SoftwareRenderer::SoftwareRenderer(unsigned int width, unsigned int height)
+    : m_Width(width)
+    , m_Height(height)
+    , m_Stride((width + TileSize - 1) / TileSize * TileSize)
+    , m_TilesX(m_Stride / TileSize)
+    , m_TilesY((height + TileSize - 1) / TileSize)
+    , m_Color((size_t) m_Stride * m_TilesY * TileSize, 0)
+    , m_Depth((size_t) m_Stride * m_TilesY * TileSize, 1.0f)
+    , m_CullBackFaces(false)
+    , m_TileBins(m_TilesX * m_TilesY)
+    , m_TilePixels(m_TilesX * m_TilesY, 0) {
+}
+
+void SoftwareRenderer::Clear(const glm::vec4 &color, float depth) {
+    Flush();
+    std::fill(m_Color.begin(), m_Color.end(), PackColor(color));
+    std::fill(m_Depth.begin(), m_Depth.end(), depth);
+}
+
+void SoftwareRenderer::Setup(const unsigned int *indices, unsigned int indexCount,
+    unsigned int varyings, unsigned int draw) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Corners of the polygon left after cutting a triangle at the near plane
+    glm::vec4 clip[4];
+    float clipVaryings[4][MaxVaryings];
+    const float *corners[4];
+
+    for (unsigned int i = 0; i + 2 < indexCount; i += 3) {
+        m_Stats.Triangles++;
+
+        glm::vec4 in[3];
+        const float *inVaryings[3];
+        unsigned int outside = 0;
+        for (int k = 0; k < 3; k++) {
+            in[k] = m_ClipPositions[indices[i + k]];
+            inVaryings[k] = m_Varyings.data() + (size_t) indices[i + k] * varyings;
+            outside += in[k].z < -in[k].w;
+        }
+
+        if (outside == 3) {
+            m_Stats.Culled++;
+            continue;
+        }
+        if (outside == 0) {
+            SetupTriangle(in, inVaryings, 3, varyings, draw);
+            continue;
+        }
+
+        // Sutherland-Hodgman against z = -w, one plane turns 3 corners into at most 4
+        m_Stats.Clipped++;
+        unsigned int count = 0;
+        for (int k = 0; k < 3; k++) {
+            const glm::vec4 &a = in[k], &b = in[(k + 1) % 3];
+            float da = a.z + a.w, db = b.z + b.w;
+            if (da >= 0.0f) {
+                clip[count] = a;
+                std::copy(inVaryings[k], inVaryings[k] + varyings, clipVaryings[count]);
+                count++;
+            }
+            if ((da >= 0.0f) != (db >= 0.0f)) {
+                float t = da / (da - db);
+                clip[count] = a + (b - a) * t;
+                for (unsigned int v = 0; v < varyings; v++) {
+                    float va = inVaryings[k][v], vb = inVaryings[(k + 1) % 3][v];
+                    clipVaryings[count][v] = va + (vb - va) * t;
+                }
+                count++;
+            }
+        }
+        for (unsigned int k = 0; k < count; k++) {
+            corners[k] = clipVaryings[k];
+        }
+        SetupTriangle(clip, corners, count, varyings, draw);
+    }
+    m_Stats.SetupTime += Milliseconds(start);
+}
+
+void SoftwareRenderer::SetupTriangle(const glm::vec4 *clip, const float *const *varyings,
+    unsigned int count, unsigned int varyingCount, unsigned int draw) {
+    glm::vec2 screen(m_Width, m_Height);
+
+    // Clipping can leave a quad, drawn as a fan
+    for (unsigned int first = 1; first + 1 < count; first++) {
+        unsigned int corner[3] = { 0, first, first + 1 };
+        glm::vec3 v[3];
+        float invW[3];
+        for (int k = 0; k < 3; k++) {
+            const glm::vec4 &c = clip[corner[k]];
+            invW[k] = 1.0f / c.w;
+            glm::vec3 ndc = glm::vec3(c) * invW[k];
+            v[k] = glm::vec3((glm::vec2(ndc) * 0.5f + 0.5f) * screen, ndc.z * 0.5f + 0.5f);
+        }
+
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+        if (std::abs(area) < 1e-8f || (area < 0.0f && m_CullBackFaces)) {
+            m_Stats.Culled++;
+            continue;
+        }
+        // The edge functions below expect counter clockwise winding
+        if (area < 0.0f) {
+            std::swap(corner[1], corner[2]);
+            std::swap(v[1], v[2]);
+            std::swap(invW[1], invW[2]);
+        }
+
+        // Clamped before converting, corners close to the camera plane can be far off screen
+        glm::vec2 lo = glm::min(glm::min(glm::vec2(v[0]), glm::vec2(v[1])), glm::vec2(v[2]));
+        glm::vec2 hi = glm::max(glm::max(glm::vec2(v[0]), glm::vec2(v[1])), glm::vec2(v[2]));
+        lo = glm::floor(glm::clamp(lo, glm::vec2(0.0f), screen));
+        hi = glm::ceil(glm::clamp(hi, glm::vec2(0.0f), screen));
+        Triangle t;
+        t.MinX = (int) lo.x;
+        t.MinY = (int) lo.y;
+        t.MaxX = (int) hi.x;
+        t.MaxY = (int) hi.y;
+        if (t.MinX >= t.MaxX || t.MinY >= t.MaxY
+            || (v[0].z > 1.0f && v[1].z > 1.0f && v[2].z > 1.0f)) {
+            m_Stats.Culled++;
+            continue;
+        }
+
+        for (int e = 0; e < 3; e++) {
+            const glm::vec3 &a = v[(e + 1) % 3], &b = v[(e + 2) % 3];
+            t.A[e] = a.y - b.y;
+            t.B[e] = b.x - a.x;
+            t.C[e] = a.x * b.y - a.y * b.x;
+            // With y up and the inside on the left, left edges run down and top edges run left
+            bool topLeft = b.y < a.y || (b.y == a.y && b.x < a.x);
+            t.Owns[e] = topLeft ? 0xffffffffu : 0u;
+        }
+
+        // Edge e is vertex e's barycentric weight times the area, so any value interpolated
+        // across the triangle is a plane with these coefficients
+        float sum = t.C[0] + t.C[1] + t.C[2];
+        auto plane = [&t, sum](const float *values, float *out) {
+            out[0] = (values[0] * t.A[0] + values[1] * t.A[1] + values[2] * t.A[2]) / sum;
+            out[1] = (values[0] * t.B[0] + values[1] * t.B[1] + values[2] * t.B[2]) / sum;
+            out[2] = (values[0] * t.C[0] + values[1] * t.C[1] + values[2] * t.C[2]) / sum;
+        };
+        float z[3] = { v[0].z, v[1].z, v[2].z };
+        plane(z, t.Z);
+        plane(invW, t.W);
+
+        // Interpolating varying / w and dividing by the interpolated 1 / w is perspective correct
+        t.Planes = (unsigned int) m_Planes.size();
+        m_Planes.resize(m_Planes.size() + varyingCount * 3);
+        for (unsigned int i = 0; i < varyingCount; i++) {
+            float values[3];
+            for (int k = 0; k < 3; k++) {
+                values[k] = varyings[corner[k]][i] * invW[k];
+            }
+            plane(values, m_Planes.data() + t.Planes + i * 3);
+        }
+        t.Draw = draw;
+
+        unsigned int index = (unsigned int) m_Triangles.size();
+        m_Triangles.push_back(t);
+        for (int y = t.MinY / (int) TileSize; y <= (t.MaxY - 1) / (int) TileSize; y++) {
+            for (int x = t.MinX / (int) TileSize; x <= (t.MaxX - 1) / (int) TileSize; x++) {
+                m_TileBins[x + y * m_TilesX].push_back(index);
+                m_Stats.Binned++;
+            }
+        }
+    }
+}
+
+void SoftwareRenderer::Flush() {
+    if (m_Triangles.empty()) {
+        m_Draws.clear();
+        m_Planes.clear();
+        return;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Every tile owns its pixels, so tiles can be filled in any order on any thread
+    ThreadPool::Get().ParallelFor(
+        m_TilesX * m_TilesY, 1, [this](unsigned int begin, unsigned int end) {
+            for (unsigned int tile = begin; tile < end; tile++) {
+                int tileX = (tile % m_TilesX) * TileSize, tileY = (tile / m_TilesX) * TileSize;
+                unsigned int pixels = 0;
+                for (unsigned int index : m_TileBins[tile]) {
+                    const Triangle &t = m_Triangles[index];
+                    const DrawCall &draw = m_Draws[t.Draw];
+                    pixels += draw.Raster(*this, draw.Shader.get(), t, tileX, tileY);
+                }
+                m_TilePixels[tile] = pixels;
+                m_TileBins[tile].clear();
+            }
+        });
+
+    for (unsigned int pixels : m_TilePixels) {
+        m_Stats.Pixels += pixels;
+    }
+    m_Triangles.clear();
+    m_Planes.clear();
+    m_Draws.clear();
+    m_Stats.RasterTime += Milliseconds(start);
+}
+
+void SoftwareRenderer::ReadPixels(std::vector<unsigned char> &pixels) const {
+    pixels.resize((size_t) m_Width * m_Height * 4);
+    for (unsigned int y = 0; y < m_Height; y++) {
+        const uint32_t *row = m_Color.data() + (size_t) y * m_Stride;
+        unsigned char *out = pixels.data() + (size_t) y * m_Width * 4;
+        for (unsigned int x = 0; x < m_Width; x++) {
+            out[x * 4 + 0] = (unsigned char) (row[x] & 0xff);
+            out[x * 4 + 1] = (unsigned char) ((row[x] >> 8) & 0xff);
+            out[x * 4 + 2] = (unsigned char) ((row[x] >> 16) & 0xff);
+            out[x * 4 + 3] = (unsigned char) (row[x] >> 24);
+        }
+    }
+}
+
+uint32_t SoftwareRenderer::PackColor(const glm::vec4 &color) {
+    // Adding a half and truncating rounds the same as glm::round here, without the libm calls
+    glm::vec4 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+    return (uint32_t) c.r | (uint32_t) c.g << 8 | (uint32_t) c.b << 16 | (uint32_t) c.a << 24;
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+#include "Macros.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+#ifdef SPARTAN_SSE
+#include <emmintrin.h>
+#endif
+
+struct SoftwareRendererStats {
+    unsigned int Draws = 0;
+    unsigned int Triangles = 0;
+    // Back facing, degenerate, behind the camera or off screen
+    unsigned int Culled = 0;
+    // Triangles that crossed the near plane and were cut into one or two
+    unsigned int Clipped = 0;
+    // Triangle and tile pairs, each one is a bounding box walk on some thread
+    unsigned int Binned = 0;
+    // Fragments that passed the depth test and were shaded
+    unsigned int Pixels = 0;
+    float VertexTime = 0.0f;
+    float SetupTime = 0.0f;
+    float RasterTime = 0.0f;
+};
+
+// CPU rendering backend for headless runs and benchmarks, no GL context needed. Draw runs a
+// shader functor's vertex stage over the vertices in parallel, clips against the near plane
+// and bins the triangles into tiles. Flush rasterizes the tiles in parallel with 4 wide edge
+// functions, a LESS depth test and perspective correct varyings. Each tile keeps submission
+// order, so the image only depends on the input and not on how the threads were scheduled.
+//
+// A shader is a copyable struct with its uniforms as members and
+//     static const unsigned int Varyings;
+//     glm::vec4 Vertex(const VertexT &vertex, float *varyings) const; // Clip space position
+//     glm::vec4 Fragment(const float *varyings) const;                // Color
+// see SoftwareShaders.h for the equivalents of the built-in .shader files.
+class SoftwareRenderer {
+public:
+    static const unsigned int TileSize = 64;
+    static const unsigned int MaxVaryings = 8;
+
+    SoftwareRenderer(unsigned int width, unsigned int height);
+
+    // Flushes pending draws first
+    void Clear(const glm::vec4 &color, float depth = 1.0f);
+    // Counter clockwise triangles in window space face forward, as with glFrontFace(GL_CCW)
+    inline void SetCullBackFaces(bool cull) {
+        m_CullBackFaces = cull;
+    }
+
+    // Triangle list. The shader is copied, so it can change before the next Flush.
+    template <typename VertexT, typename ShaderT>
+    void Draw(const VertexT *vertices, unsigned int vertexCount, const unsigned int *indices,
+        unsigned int indexCount, const ShaderT &shader);
+    void Flush();
+
+    // Tight RGBA8 rows, bottom row first like glReadPixels
+    void ReadPixels(std::vector<unsigned char> &pixels) const;
+
+    inline unsigned int GetWidth() const {
+        return m_Width;
+    }
+    inline unsigned int GetHeight() const {
+        return m_Height;
+    }
+    inline const SoftwareRendererStats &GetStats() const {
+        return m_Stats;
+    }
+    inline void ResetStats() {
+        m_Stats = SoftwareRendererStats();
+    }
+
+private:
+    struct Triangle {
+        // Edge functions as A * x + B * y + C, positive inside. Edge e is opposite vertex e.
+        float A[3], B[3], C[3];
+        // Edges that own the pixels exactly on them (top-left rule), as SSE lane masks
+        uint32_t Owns[3];
+        // Planes of window depth and of 1 / w
+        float Z[3], W[3];
+        int MinX, MinY, MaxX, MaxY;
+        // Three plane coefficients per varying of varying / w, in m_Planes
+        unsigned int Planes;
+        unsigned int Draw;
+    };
+
+    using RasterFunc = unsigned int (*)(SoftwareRenderer &renderer, const void *shader,
+        const Triangle &triangle, int tileX, int tileY);
+
+    struct DrawCall {
+        std::shared_ptr<const void> Shader;
+        RasterFunc Raster;
+    };
+
+    void Setup(const unsigned int *indices, unsigned int indexCount, unsigned int varyings,
+        unsigned int draw);
+    // count corners after clipping, 3 or 4
+    void SetupTriangle(const glm::vec4 *clip, const float *const *varyings, unsigned int count,
+        unsigned int varyingCount, unsigned int draw);
+
+    template <typename ShaderT>
+    static unsigned int RasterizeTriangle(SoftwareRenderer &renderer, const void *shader,
+        const Triangle &triangle, int tileX, int tileY);
+    static uint32_t PackColor(const glm::vec4 &color);
+
+    unsigned int m_Width;
+    unsigned int m_Height;
+    // Buffers are padded to whole tiles, rows are m_Stride pixels and the first row is the bottom
+    unsigned int m_Stride;
+    unsigned int m_TilesX;
+    unsigned int m_TilesY;
+    std::vector<uint32_t> m_Color;
+    std::vector<float> m_Depth;
+    bool m_CullBackFaces;
+
+    // Output of the vertex stage of the current draw
+    std::vector<glm::vec4> m_ClipPositions;
+    std::vector<float> m_Varyings;
+
+    std::vector<DrawCall> m_Draws;
+    std::vector<Triangle> m_Triangles;
+    std::vector<float> m_Planes;
+    std::vector<std::vector<unsigned int>> m_TileBins;
+    std::vector<unsigned int> m_TilePixels;
+
+    SoftwareRendererStats m_Stats;
+};
+
+template <typename VertexT, typename ShaderT>
+void SoftwareRenderer::Draw(const VertexT *vertices, unsigned int vertexCount,
+    const unsigned int *indices, unsigned int indexCount, const ShaderT &shader) {
+    static_assert(ShaderT::Varyings <= MaxVaryings, "Too many varyings for SoftwareRenderer");
+    auto start = std::chrono::high_resolution_clock::now();
+
+    m_ClipPositions.resize(vertexCount);
+    m_Varyings.resize((size_t) vertexCount * ShaderT::Varyings);
+    ThreadPool::Get().ParallelFor(vertexCount, 1024, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++) {
+            m_ClipPositions[i] =
+                shader.Vertex(vertices[i], m_Varyings.data() + (size_t) i * ShaderT::Varyings);
+        }
+    });
+    m_Stats.VertexTime += std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::high_resolution_clock::now() - start)
+                              .count();
+
+    m_Draws.push_back({ std::make_shared<const ShaderT>(shader), &RasterizeTriangle<ShaderT> });
+    m_Stats.Draws++;
+    Setup(indices, indexCount, ShaderT::Varyings, (unsigned int) m_Draws.size() - 1);
+}
+
+template <typename ShaderT>
+unsigned int SoftwareRenderer::RasterizeTriangle(SoftwareRenderer &renderer,
+    const void *shaderData, const Triangle &t, int tileX, int tileY) {
+    const ShaderT &shader = *(const ShaderT *) shaderData;
+    const float *planes = renderer.m_Planes.data() + t.Planes;
+
+    // Tiles are a multiple of 4 wide, so aligning down stays inside the tile
+    int x0 = std::max(t.MinX, tileX) & ~3;
+    int x1 = std::min(t.MaxX, tileX + (int) TileSize);
+    int y0 = std::max(t.MinY, tileY);
+    int y1 = std::min(t.MaxY, tileY + (int) TileSize);
+
+    unsigned int shaded = 0;
+    float varyings[ShaderT::Varyings > 0 ? ShaderT::Varyings : 1];
+    for (int y = y0; y < y1; y++) {
+        float py = y + 0.5f;
+        uint32_t *color = renderer.m_Color.data() + (size_t) y * renderer.m_Stride;
+        float *depth = renderer.m_Depth.data() + (size_t) y * renderer.m_Stride;
+#ifdef SPARTAN_SSE
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        __m128 rowE0 = _mm_set1_ps(t.B[0] * py + t.C[0]);
+        __m128 rowE1 = _mm_set1_ps(t.B[1] * py + t.C[1]);
+        __m128 rowE2 = _mm_set1_ps(t.B[2] * py + t.C[2]);
+        __m128 rowZ = _mm_set1_ps(t.Z[1] * py + t.Z[2]);
+        __m128 owns0 = _mm_castsi128_ps(_mm_set1_epi32((int) t.Owns[0]));
+        __m128 owns1 = _mm_castsi128_ps(_mm_set1_epi32((int) t.Owns[1]));
+        __m128 owns2 = _mm_castsi128_ps(_mm_set1_epi32((int) t.Owns[2]));
+        // Inside, or exactly on an edge that owns its pixels
+        auto covers = [zero](__m128 e, __m128 owns) {
+            return _mm_or_ps(
+                _mm_cmpgt_ps(e, zero), _mm_and_ps(_mm_cmpeq_ps(e, zero), owns));
+        };
+        for (int x = x0; x < x1; x += 4) {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float) x), offsets);
+            __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.A[0]), px), rowE0);
+            __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.A[1]), px), rowE1);
+            __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.A[2]), px), rowE2);
+            __m128 inside = _mm_and_ps(_mm_and_ps(covers(e0, owns0), covers(e1, owns1)),
+                covers(e2, owns2));
+            if (_mm_movemask_ps(inside) == 0) {
+                continue;
+            }
+            __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.Z[0]), px), rowZ);
+            inside = _mm_and_ps(inside, _mm_cmplt_ps(z, _mm_loadu_ps(depth + x)));
+            int mask = _mm_movemask_ps(inside);
+            if (mask == 0) {
+                continue;
+            }
+            alignas(16) float zs[4];
+            _mm_store_ps(zs, z);
+            for (int lane = 0; lane < 4; lane++) {
+                if (!(mask & (1 << lane))) {
+                    continue;
+                }
+                float fx = x + lane + 0.5f;
+#else
+        for (int x = x0; x < x1; x += 4) {
+            float zs[4];
+            for (int lane = 0; lane < 4; lane++) {
+                float fx = x + lane + 0.5f;
+                bool inside = true;
+                for (int e = 0; e < 3; e++) {
+                    float edge = t.A[e] * fx + t.B[e] * py + t.C[e];
+                    inside &= edge > 0.0f || (edge == 0.0f && t.Owns[e]);
+                }
+                zs[lane] = t.Z[0] * fx + t.Z[1] * py + t.Z[2];
+                if (!inside || !(zs[lane] < depth[x + lane])) {
+                    continue;
+                }
+#endif
+                float w = 1.0f / (t.W[0] * fx + t.W[1] * py + t.W[2]);
+                for (unsigned int v = 0; v < ShaderT::Varyings; v++) {
+                    const float *plane = planes + v * 3;
+                    varyings[v] = (plane[0] * fx + plane[1] * py + plane[2]) * w;
+                }
+                depth[x + lane] = zs[lane];
+                color[x + lane] = PackColor(shader.Fragment(varyings));
+                shaded++;
+            }
+        }
+    }
+    return shaded;
+}
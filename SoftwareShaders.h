@@ -0,0 +1,73 @@
+#pragma once
+
+#include "VertexFormat.h"
+
+#include <glm/glm.hpp>
+
+// SoftwareRenderer equivalents of the built-in .shader files. They read the same packed
+// vertex formats with the same conversions as the GL attribute fetch.
+namespace SoftwareShaders {
+
+// res/shaders/Basic.shader
+struct Basic {
+    static const unsigned int Varyings = 0;
+
+    glm::mat4 MVP = glm::mat4(1.0f);
+    glm::vec4 Color = glm::vec4(1.0f);
+
+    glm::vec4 Vertex(const glm::vec3 &position, float *) const {
+        return MVP * glm::vec4(position, 1.0f);
+    }
+    glm::vec4 Fragment(const float *) const {
+        return Color;
+    }
+};
+
+// res/shaders/Normal.shader, for Cube
+struct Normal {
+    static const unsigned int Varyings = 3;
+
+    glm::mat4 MVP = glm::mat4(1.0f);
+
+    glm::vec4 Vertex(const CubeVertex &vertex, float *varyings) const {
+        glm::vec3 normal = VertexUnpack::Int2_10_10_10(vertex.Normal);
+        varyings[0] = normal.x;
+        varyings[1] = normal.y;
+        varyings[2] = normal.z;
+        return MVP
+            * glm::vec4(VertexUnpack::Half(vertex.Position[0]),
+                VertexUnpack::Half(vertex.Position[1]), VertexUnpack::Half(vertex.Position[2]),
+                1.0f);
+    }
+    // NormalColor in res/shaders/include/NormalColor.glsl
+    glm::vec4 Fragment(const float *varyings) const {
+        glm::vec3 normal(varyings[0], varyings[1], varyings[2]);
+        glm::vec3 color = glm::abs(normal);
+        if (glm::dot(normal, glm::vec3(1.0f)) < 0.0f) {
+            color = glm::vec3(1.0f) - color;
+        }
+        return glm::vec4(color, 1.0f);
+    }
+};
+
+// res/shaders/Plane.shader, for Plane and Terrain
+struct Plane {
+    static const unsigned int Varyings = 3;
+
+    glm::mat4 MVP = glm::mat4(1.0f);
+
+    glm::vec4 Vertex(const GridVertex &vertex, float *varyings) const {
+        for (int i = 0; i < 3; i++) {
+            varyings[i] = VertexUnpack::Unorm8(vertex.Color[i]);
+        }
+        return MVP
+            * glm::vec4(VertexUnpack::Snorm16(vertex.Position[0]),
+                VertexUnpack::Snorm16(vertex.Position[1]),
+                VertexUnpack::Snorm16(vertex.Position[2]), 1.0f);
+    }
+    glm::vec4 Fragment(const float *varyings) const {
+        return glm::vec4(varyings[0], varyings[1], varyings[2], 1.0f);
+    }
+};
+
+}
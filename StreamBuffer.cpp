@@ -0,0 +1,138 @@
+#include "StreamBuffer.h"
+
+#include "Renderer.h"
+
+#include <chrono>
+#include <iostream>
+
+StreamBuffer::StreamBuffer(unsigned int target, unsigned int frameSize, unsigned int frameCount)
+    : m_RendererID(0)
+    , m_Target(target)
+    , m_FrameSize(frameSize)
+    , m_FrameCount(frameCount)
+    , m_Frame(0)
+    , m_Head(0)
+    , m_MapStart(0)
+    , m_Persistent(GLEW_ARB_buffer_storage)
+    , m_Mapping(nullptr)
+    , m_Fences(frameCount, nullptr) {
+    ASSERT(frameCount > 0);
+
+    unsigned int size = m_FrameSize * m_FrameCount;
+    GLCall(glGenBuffers(1, &m_RendererID));
+    GLCall(glBindBuffer(m_Target, m_RendererID));
+
+    if (m_Persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GLCall(glBufferStorage(m_Target, size, nullptr, flags));
+        GLCall(m_Mapping = (unsigned char *) glMapBufferRange(m_Target, 0, size, flags));
+    } else {
+        GLCall(glBufferData(m_Target, size, nullptr, GL_STREAM_DRAW));
+    }
+
+    GLCall(glBindBuffer(m_Target, 0));
+}
+
+StreamBuffer::~StreamBuffer() {
+    for (GLsync fence : m_Fences) {
+        if (fence) {
+            GLCall(glDeleteSync(fence));
+        }
+    }
+    if (m_Mapping) {
+        GLCall(glBindBuffer(m_Target, m_RendererID));
+        GLCall(glUnmapBuffer(m_Target));
+    }
+    GLCall(glDeleteBuffers(1, &m_RendererID));
+}
+
+void StreamBuffer::BeginFrame() {
+    m_LastFrameStats = m_FrameStats;
+    m_FrameStats = StreamBufferStats();
+
+    m_Frame = (m_Frame + 1) % m_FrameCount;
+    m_Head = 0;
+
+    GLsync &fence = m_Fences[m_Frame];
+    if (!fence) {
+        return;
+    }
+
+    GLCall(GLenum result = glClientWaitSync(fence, 0, 0));
+    if (result == GL_TIMEOUT_EXPIRED) {
+        // The GPU is more than frameCount frames behind, we have to wait for it
+        auto start = std::chrono::high_resolution_clock::now();
+        do {
+            GLCall(result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000));
+        } while (result == GL_TIMEOUT_EXPIRED);
+        m_FrameStats.FenceStalls++;
+        m_FrameStats.StallTime
+            += std::chrono::duration<float, std::chrono::milliseconds::period>(
+                std::chrono::high_resolution_clock::now() - start)
+                   .count();
+    }
+
+    GLCall(glDeleteSync(fence));
+    fence = nullptr;
+}
+
+StreamAllocation StreamBuffer::Allocate(unsigned int size, unsigned int alignment) {
+    unsigned int head = (m_Head + alignment - 1) / alignment * alignment;
+    if (head + size > m_FrameSize) {
+        std::cerr << "StreamBuffer: frame region of " << m_FrameSize << " bytes is full"
+                  << std::endl;
+        return { nullptr, 0 };
+    }
+
+    if (!m_Mapping) {
+        // Map the rest of this frame's region once and hand out pieces until Commit. The
+        // fence already guarantees the GPU is done with it, so no driver synchronisation.
+        GLCall(glBindBuffer(m_Target, m_RendererID));
+        GLCall(m_Mapping = (unsigned char *) glMapBufferRange(m_Target,
+                   GetFrameOffset() + m_Head, m_FrameSize - m_Head,
+                   GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT
+                       | GL_MAP_FLUSH_EXPLICIT_BIT));
+        if (!m_Mapping) {
+            return { nullptr, 0 };
+        }
+        // Where the mapping starts in the buffer, 0 for the persistent one
+        m_MapStart = GetFrameOffset() + m_Head;
+    }
+
+    m_Head = head + size;
+    m_FrameStats.BytesStreamed += size;
+    m_FrameStats.Allocations++;
+
+    unsigned int offset = GetFrameOffset() + head;
+    return { m_Mapping + (offset - m_MapStart), offset };
+}
+
+void StreamBuffer::Commit() {
+    if (m_Persistent || !m_Mapping) {
+        return;
+    }
+
+    // Flush offsets are relative to the start of the mapped range
+    GLCall(glBindBuffer(m_Target, m_RendererID));
+    GLCall(glFlushMappedBufferRange(m_Target, 0, GetFrameOffset() + m_Head - m_MapStart));
+    GLCall(glUnmapBuffer(m_Target));
+    m_Mapping = nullptr;
+}
+
+void StreamBuffer::EndFrame() {
+    Commit();
+
+    GLsync &fence = m_Fences[m_Frame];
+    if (fence) {
+        GLCall(glDeleteSync(fence));
+    }
+    GLCall(fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
+
+void StreamBuffer::Bind() const {
+    GLCall(glBindBuffer(m_Target, m_RendererID));
+}
+
+void StreamBuffer::UnBind() const {
+    GLCall(glBindBuffer(m_Target, 0));
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+struct StreamAllocation {
+    // Write-only pointer into the mapped buffer, nullptr if the frame's region is full
+    void *Data;
+    // Byte offset of Data inside the GL buffer, for attribute pointers and draw offsets
+    unsigned int Offset;
+};
+
+struct StreamBufferStats {
+    size_t BytesStreamed = 0;
+    unsigned int Allocations = 0;
+    unsigned int FenceStalls = 0;
+    float StallTime = 0.0f; // ms spent waiting for the GPU to release a region
+};
+
+// Ring of frameCount regions for transient per-frame data (dynamic vertices, instance data).
+// The CPU writes straight into a persistent coherent mapping (ARB_buffer_storage) or, without
+// it, an unsynchronized glMapBufferRange of the current region. A fence per region keeps the
+// CPU from overwriting data the GPU has not consumed yet.
+class StreamBuffer {
+private:
+    unsigned int m_RendererID;
+    unsigned int m_Target;
+    unsigned int m_FrameSize;
+    unsigned int m_FrameCount;
+    unsigned int m_Frame;
+    unsigned int m_Head;
+    unsigned int m_MapStart;
+    bool m_Persistent;
+    unsigned char *m_Mapping;
+    std::vector<GLsync> m_Fences;
+
+    StreamBufferStats m_FrameStats;
+    StreamBufferStats m_LastFrameStats;
+
+public:
+    StreamBuffer(unsigned int target, unsigned int frameSize, unsigned int frameCount = 3);
+    ~StreamBuffer();
+
+    // Moves to the next region, waiting for the GPU if it still reads from it
+    void BeginFrame();
+    StreamAllocation Allocate(unsigned int size, unsigned int alignment = 16);
+    // Makes everything allocated so far visible to GL, call before drawing from the buffer
+    void Commit();
+    // Fences the region written this frame
+    void EndFrame();
+
+    void Bind() const;
+    void UnBind() const;
+
+    inline unsigned int GetRendererID() const {
+        return m_RendererID;
+    }
+    inline bool IsPersistent() const {
+        return m_Persistent;
+    }
+    // Bytes still free in this frame's region, before alignment
+    inline unsigned int GetRemaining() const {
+        return m_Head < m_FrameSize ? m_FrameSize - m_Head : 0;
+    }
+    inline const StreamBufferStats &GetStats() const {
+        return m_LastFrameStats;
+    }
+
+private:
+    unsigned int GetFrameOffset() const {
+        return m_Frame * m_FrameSize;
+    }
+};
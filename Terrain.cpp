@@ -1,27 +1,24 @@
 #include "Terrain.h"
 #include <vector>
+#include "MeshBuilder.h"
 #include "Renderer.h"
 #include <glm/gtc/noise.hpp>
 #include <iostream>
+#include <cmath>
 #include <functional>
 
 Terrain::Terrain(int width, int height)
+    : m_WidthSegments(width)
+    , m_HeightSegments(height)
 {
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
+    MeshBuilder builder("Terrain", VertexBufferLayout::Of<GridVertex>(), (width + 1) * (height + 1),
+        width * height * 6);
+    generateTerrain(width, height, builder);
 
-    generateTerrain(width, height, vertices, indices);
-
-    VertexBufferLayout layout = VertexBufferLayout();
-    layout.Push<float>(3); // Position
-    layout.Push<float>(3); // Normal
-    layout.Push<float>(2); // Texture
-    layout.Push<float>(3); // Color
-
-    m_VAO = std::make_shared<VertexArray>();
-    m_VBO = std::make_shared<VertexBuffer>(&vertices[0], vertices.size() * sizeof(float));
-    m_VAO->AddBuffer(*m_VBO, layout);
-    m_IBO = std::make_shared<IndexBuffer>(&indices[0], indices.size());
+    MeshBuffers mesh = builder.Finish();
+    m_VAO = std::move(mesh.VAO);
+    m_VBO = std::move(mesh.VBO);
+    m_IBO = std::move(mesh.IBO);
 
     m_Shader = std::make_shared<Shader>("res/shaders/Plane.shader");
     m_Shader->Bind();
@@ -43,6 +40,48 @@ void Terrain::Render(glm::mat4 MVP) {
     renderer.Draw(*m_VAO, *m_IBO, *m_Shader);
 }
 
+float Terrain::GetHeight(float x, float y) const {
+    int j = glm::clamp((int) std::round((x + 0.5f) * m_WidthSegments), 0, m_WidthSegments);
+    int i = glm::clamp((int) std::round((y + 0.5f) * m_HeightSegments), 0, m_HeightSegments);
+    return m_Positions[i * (m_WidthSegments + 1) + j].z;
+}
+
+void Terrain::GetOccluder(int segments, std::vector<glm::vec3>& positions,
+    std::vector<unsigned int>& indices) const {
+    positions.clear();
+    indices.clear();
+
+    float stepX = (float) m_WidthSegments / segments;
+    float stepY = (float) m_HeightSegments / segments;
+    for (int i = 0; i <= segments; i++) {
+        for (int j = 0; j <= segments; j++) {
+            // Lowest point of the source cells touching this vertex
+            int i0 = glm::max((int) ((i - 1) * stepY), 0);
+            int i1 = glm::min((int) std::ceil((i + 1) * stepY), m_HeightSegments);
+            int j0 = glm::max((int) ((j - 1) * stepX), 0);
+            int j1 = glm::min((int) std::ceil((j + 1) * stepX), m_WidthSegments);
+            float lowest = 1e30f;
+            for (int y = i0; y <= i1; y++) {
+                for (int x = j0; x <= j1; x++) {
+                    lowest = glm::min(lowest, m_Positions[y * (m_WidthSegments + 1) + x].z);
+                }
+            }
+            positions.push_back(
+                { (float) j / segments - 0.5f, (float) i / segments - 0.5f, lowest });
+        }
+    }
+
+    for (int i = 0; i < segments; i++) {
+        for (int j = 0; j < segments; j++) {
+            unsigned int a = i * (segments + 1) + j;
+            unsigned int b = a + 1;
+            unsigned int c = a + segments + 1;
+            unsigned int d = c + 1;
+            indices.insert(indices.end(), { a, b, c, c, b, d });
+        }
+    }
+}
+
 // Steps to generate terrain
 // 1. Heightmap -> use layered perlin noise to create vertex positions
 // 2. Road(s) 
@@ -51,21 +90,14 @@ void Terrain::Render(glm::mat4 MVP) {
 //      -> flatten a widened road area following the spline
 // 3. Normals -> calculate normals using updated vertex positions
 // 4. Coloring -> color based off: road, height, gradient (normal)
-void Terrain::generateTerrain(int widthSegments, int heightSegments, std::vector<float>& vertices, std::vector<unsigned int>& indices) {
+void Terrain::generateTerrain(int widthSegments, int heightSegments, MeshBuilder& builder) {
     
     float seg_width = 1.0f / widthSegments;
     float seg_height = 1.0f / heightSegments;
 
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec3> normals;
-    std::vector<glm::vec2> textures;
-    std::vector<glm::vec3> colors;
-
-    vertices.reserve((3 + 3 + 2 + 3) * (widthSegments + 1) * (heightSegments + 1));
+    std::vector<glm::vec3>& positions = m_Positions;
+    positions.clear();
     positions.reserve((widthSegments + 1) * (heightSegments + 1));
-    normals.reserve((widthSegments + 1) * (heightSegments + 1));
-    textures.reserve((widthSegments + 1) * (heightSegments + 1));
-    colors.reserve((widthSegments + 1) * (heightSegments + 1));
 
     std::function noise = [](float x, float y) {
         float z = glm::perlin(glm::vec2(x, y));
@@ -88,21 +120,16 @@ void Terrain::generateTerrain(int widthSegments, int heightSegments, std::vector
             float z = glm::pow(e, 1.6f);
 
             positions.push_back({ x, y, z });
-
-
-            // Texture
-            textures.push_back({ j * seg_width, i * seg_height });
         }
     }
 
     // TODO: Generate roads
     // generateRoads();
 
-    // Normals
+    // Vertices, packed straight into the mesh
+    GridVertex* vertex = builder.GetVertices<GridVertex>();
     for (int i = 0; i < heightSegments + 1; i++) {
         for (int j = 0; j < widthSegments + 1; j++) {
-            float y = i * seg_height - 0.5f;
-            float x = j * seg_width - 0.5f;
 
             float right;
             if (j == widthSegments) {
@@ -134,47 +161,26 @@ void Terrain::generateTerrain(int widthSegments, int heightSegments, std::vector
 			}
 
             glm::vec3 normal = glm::normalize(glm::vec3(left - right, down - up, 2.0f));
-            normals.push_back(normal);
-        }
-    }
 
-    // Colors
-    // TODO: Roads and normals
-    for (int i = 0; i < heightSegments; i++) {
-        for (int j = 0; j < widthSegments; j++) {
-			int index = i * (widthSegments + 1) + j;
-			glm::vec3 color = glm::vec3(1.0f, glm::clamp(positions[index].z, 0.0f, 1.0f), 1.0f);
-			colors.push_back(color);
-
-            //        // Color
-    //        glm::vec3 color /*= glm::vec3(1.0f, glm::clamp(e, 0.0f, 1.0f), 1.0f)*/;
-    //        switch (biome(z)) {
-    //            case WATER:
-                //	color = glm::vec3(0.0f, 0.0f, 1.0f);
-                //    break;
-    //            case SAND:
-    //                color = glm::vec3(1.0f, 1.0f, 0.0f);
-    //                break;
-    //            case GRASS:
-    //                color = glm::vec3(0.0f, 1.0f, 0.0f);
-                //	break;
-                //case ROCK:
-                //	color = glm::vec3(0.5f, 0.5f, 0.5f);
-                //	break;
-                //case SNOW:
-                //	color = glm::vec3(1.0f, 1.0f, 1.0f);
-                //	break;
-    //            default:
-    //                color = glm::vec3(1.0f, 0.0f, 1.0f);
-                //	break;
-    //        }
-    //        vertices.push_back(color.r);
-    //        vertices.push_back(color.g);
-    //        vertices.push_back(color.b);
-		}
+            // TODO: Roads and normals
+            const glm::vec3& position = positions[i * (widthSegments + 1) + j];
+            glm::vec3 color = glm::vec3(1.0f, glm::clamp(position.z, 0.0f, 1.0f), 1.0f);
+            //switch (biome(z)) {
+            //    case WATER: color = glm::vec3(0.0f, 0.0f, 1.0f); break;
+            //    case SAND:  color = glm::vec3(1.0f, 1.0f, 0.0f); break;
+            //    case GRASS: color = glm::vec3(0.0f, 1.0f, 0.0f); break;
+            //    case ROCK:  color = glm::vec3(0.5f, 0.5f, 0.5f); break;
+            //    case SNOW:  color = glm::vec3(1.0f, 1.0f, 1.0f); break;
+            //    default:    color = glm::vec3(1.0f, 0.0f, 1.0f); break;
+            //}
+
+            *vertex++ = GridVertex::Pack(
+                position, normal, glm::vec2(j * seg_width, i * seg_height), color);
+        }
     }
 
     // Indices
+    unsigned int* index = builder.GetIndices();
     for (int i = 0; i < heightSegments; i++) {
         for (int j = 0; j < widthSegments; j++) {
             unsigned int a = i * (widthSegments + 1) + (j + 1);
@@ -182,40 +188,13 @@ void Terrain::generateTerrain(int widthSegments, int heightSegments, std::vector
             unsigned int c = (i + 1) * (widthSegments + 1) + j;
             unsigned int d = (i + 1) * (widthSegments + 1) + (j + 1);
 
-            indices.push_back(a);
-            indices.push_back(b);
-            indices.push_back(c);
+            *index++ = a;
+            *index++ = b;
+            *index++ = c;
 
-            indices.push_back(c);
-            indices.push_back(d);
-            indices.push_back(a);
+            *index++ = c;
+            *index++ = d;
+            *index++ = a;
         }
     }
-
-
-    // Vertices
-    for (int i = 0; i < heightSegments; i++) {
-        for (int j = 0; j < widthSegments; j++) {
-            int index = i * (widthSegments + 1) + j;
-
-            // Position
-            vertices.push_back(positions[index].x);
-            vertices.push_back(positions[index].y);
-            vertices.push_back(positions[index].z);
-
-            // Normal
-            vertices.push_back(normals[index].x);
-            vertices.push_back(normals[index].y);
-            vertices.push_back(normals[index].z);
-
-            // Texture
-            vertices.push_back(textures[index].x);
-            vertices.push_back(textures[index].y);
-
-            // Color
-            vertices.push_back(colors[index].r);
-            vertices.push_back(colors[index].g);
-            vertices.push_back(colors[index].b);
-        }
-    }
-}
\ No newline at end of file
+}
@@ -4,6 +4,7 @@
 #include <memory>
 #include <vector>
 #include "IndexBuffer.h"
+#include "MeshBuilder.h"
 #include "Shader.h"
 #include "VertexArray.h"
 #include "VertexBuffer.h"
@@ -15,16 +16,28 @@ public:
 	~Terrain();
 
 private:
-	void generateTerrain(int widthSegments, int heightSegments,
-		std::vector<float>& vertices, std::vector<unsigned int>& indices);
+	// Fills all (width + 1) * (height + 1) vertices and the indices of builder
+	void generateTerrain(int widthSegments, int heightSegments, MeshBuilder& builder);
 
 	std::shared_ptr<VertexArray> m_VAO;
 	std::shared_ptr<VertexBuffer> m_VBO;
 	std::shared_ptr<IndexBuffer> m_IBO;
 	std::shared_ptr<Shader> m_Shader;
 
+	// Grid of (width + 1) * (height + 1) positions in local space, z is the height
+	std::vector<glm::vec3> m_Positions;
+	int m_WidthSegments;
+	int m_HeightSegments;
+
 public:
 	void Render(glm::mat4 mvp);
 
+	// Height at local x, y in [-0.5, 0.5], from the nearest grid vertex
+	float GetHeight(float x, float y) const;
+	// Coarse mesh for occlusion culling with segments quads per side. Every vertex takes the
+	// lowest height around it, so the occluder always stays below the real surface.
+	void GetOccluder(int segments, std::vector<glm::vec3>& positions,
+		std::vector<unsigned int>& indices) const;
+
 };
 
@@ -1,5 +1,7 @@
 #include "Test.h"
 
+#include "GLDebug.h"
+#include "ShaderCache.h"
 #include "imgui.h"
 
 #include <iostream>
@@ -10,13 +12,61 @@ TestMenu::TestMenu(Test **currentTestPointer)
     : m_CurrentTest(currentTestPointer) {
 }
 
+std::function<Test *()> TestMenu::GetFactory(const std::string &name) const {
+    for (const Entry &test : m_Tests) {
+        if (test.Name == name) {
+            return test.Create;
+        }
+    }
+    return nullptr;
+}
+
+bool TestMenu::SupportsSoftwareBackend(const std::string &name) const {
+    for (const Entry &test : m_Tests) {
+        if (test.Name == name) {
+            return test.Software;
+        }
+    }
+    return false;
+}
+
+std::string TestMenu::GetSoftwareTestNames() const {
+    std::string names;
+    for (const Entry &test : m_Tests) {
+        if (test.Software) {
+            names += (names.empty() ? "" : ", ") + test.Name;
+        }
+    }
+    return names;
+}
+
 void TestMenu::OnImGuiRender() {
-    for (const auto &test : m_Tests) {
-        if (ImGui::Button(test.first.c_str())) {
-            std::cout << "Switching to test " << test.first << std::endl;
-            *m_CurrentTest = test.second();
+    for (const Entry &test : m_Tests) {
+        if (ImGui::Button(test.Name.c_str())) {
+            std::cout << "Switching to test " << test.Name << std::endl;
+            *m_CurrentTest = test.Create();
+        }
+    }
+
+    const ShaderCacheStats &stats = ShaderCache::GetStats();
+    ImGui::Separator();
+    ImGui::Text("Shader cache: %s", ShaderCache::IsSupported() ? "enabled" : "unsupported");
+    ImGui::Text("Cached: %u (%.2f ms)  Compiled: %u (%.2f ms)  Rejected: %u", stats.Hits,
+        stats.HitTime, stats.Misses, stats.MissTime, stats.Rejected);
+
+#ifdef SPARTAN_GL_CALL_COUNTERS
+    if (ImGui::CollapsingHeader("GL call sites")) {
+        if (ImGui::Button("Reset counters")) {
+            GLResetCallCounters();
+        }
+        const GLCallSite *sites[20];
+        size_t count = GLGetCallSites(sites, 20);
+        for (size_t i = 0; i < count; i++) {
+            ImGui::Text("%llu  %s:%d  %s", sites[i]->Count.load(std::memory_order_relaxed),
+                sites[i]->File, sites[i]->Line, sites[i]->Function);
         }
     }
+#endif
 }
 
 }
\ No newline at end of file
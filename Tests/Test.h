@@ -25,6 +25,13 @@ public:
     virtual void OnImGuiRender() {
     }
 
+    // Runs after OnUpdate and OnImGuiRender while the render thread stands still. OnRender
+    // then overlaps the next OnUpdate, so a test copies what OnRender reads from its
+    // simulation here and returns true. The default keeps the next OnUpdate waiting instead.
+    virtual bool OnSync() {
+        return false;
+    }
+
     virtual void OnWindowResize(int width, int height) {
 		(void) width;
 		(void) height;
@@ -37,14 +44,27 @@ public:
 
     void OnImGuiRender() override;
 
-    template <typename T> void RegisterTest(const std::string &name) {
+    // software is set for tests that only draw through Renderer, the buffer classes and
+    // Shader, which are the ones that also run on the software backend (see RunHeadless)
+    template <typename T> void RegisterTest(const std::string &name, bool software = false) {
         std::cout << "Registering test " << name << std::endl;
-        m_Tests.push_back(std::make_pair(name, []() { return new T(); }));
+        m_Tests.push_back({ name, []() { return new T(); }, software });
     }
 
+    // Creates the test registered as name, empty if there is none
+    std::function<Test *()> GetFactory(const std::string &name) const;
+    bool SupportsSoftwareBackend(const std::string &name) const;
+    // Comma separated, for messages
+    std::string GetSoftwareTestNames() const;
+
 private:
     Test **m_CurrentTest;
-    std::vector<std::pair<std::string, std::function<Test *()>>> m_Tests;
+    struct Entry {
+        std::string Name;
+        std::function<Test *()> Create;
+        bool Software;
+    };
+    std::vector<Entry> m_Tests;
 };
 
 }
\ No newline at end of file
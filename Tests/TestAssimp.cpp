@@ -1,141 +1,236 @@
 #include "TestAssimp.h"
 
 #include "Macros.h"
+#include "MeshBuilder.h"
 #include "Renderer.h"
+#include "ResourceCache.h"
+#include "TextureLoader.h"
+#include "ThreadPool.h"
 #include "imgui.h"
 
-#include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
-#include <assimp/scene.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
 #include <glm/gtc/matrix_transform.hpp>
 
 namespace test {
 
+namespace {
+
+// The model is in centimeters
+const float c_ModelScale = 0.01f;
+const unsigned int c_NoTexture = ~0u;
+// Largest "Copies per side"
+const int c_MaxGridSize = 32;
+// Per frame, every meshlet of every copy as its own command would need far more
+const unsigned int c_MaxIndirectBytes = 4 * 1024 * 1024;
+
+}
+
 TestAssimp::TestAssimp()
-    : m_RotationSpeed(1.0f) {
-    m_Scene = m_Importer.ReadFile("res/models/Lambo.glb",
+    : m_Created(std::chrono::high_resolution_clock::now())
+    , m_FirstFrameMilliseconds(-1.0f)
+    , m_TexturesReadyMilliseconds(-1.0f)
+    , m_RotationSpeed(1.0f)
+    , m_Angle(0.0f)
+    , m_WhiteTexture(0)
+    , m_UseTextureArrays(true)
+    , m_TextureArrays(std::make_unique<TextureArrays>())
+    , m_TextureBinds(0)
+    , m_GridSize(8)
+    , m_UseImpostors(true)
+    , m_ImpostorDistance(25.0f)
+    , m_ImpostorView(0)
+    , m_BoundsCenter(0.0f)
+    , m_BoundsRadius(1.0f)
+    , m_UseMeshletCulling(true)
+    , m_UseIndirect(false)
+    , m_IndirectDraws(0)
+    , m_MeshCopies(0)
+    , m_MeshDraws(0)
+    , m_ImpostorCopies(0) {
+    // No aiProcess_ImproveCacheLocality, the cooker runs MeshOptimizer on every mesh
+    m_Model = std::make_unique<CookedModel>("res/models/Lambo.glb",
         aiProcess_CalcTangentSpace | aiProcess_Triangulate | aiProcess_JoinIdenticalVertices
             | aiProcess_SortByPType | aiProcess_OptimizeGraph | aiProcess_GenNormals
-            | aiProcess_GenUVCoords | aiProcess_GenBoundingBoxes | aiProcess_ValidateDataStructure
-            | aiProcess_ImproveCacheLocality);
-
-    if (!m_Scene || m_Scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !m_Scene->mRootNode) {
-        std::cout << "ERROR::ASSIMP::" << m_Importer.GetErrorString() << std::endl;
+            | aiProcess_GenUVCoords | aiProcess_GenBoundingBoxes
+            | aiProcess_ValidateDataStructure);
+    if (!m_Model->IsValid()) {
         return;
     }
-
-    for (unsigned int meshIndex = 0; meshIndex < m_Scene->mNumMeshes; meshIndex++) {
-        aiMesh *mesh = m_Scene->mMeshes[meshIndex];
-
-        Mesh m;
-
-        VertexBufferLayout layout = VertexBufferLayout();
-        layout.Push<float>(3); // Position
-        // layout.Push<float>(3); // Normal
-        layout.Push<float>(2); // Texture coordinates
-
-        std::vector<float> vertices;
-        vertices.reserve(mesh->mNumVertices * layout.GetStride());
-        for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-            vertices.push_back(mesh->mVertices[i].x);
-            vertices.push_back(mesh->mVertices[i].y);
-            vertices.push_back(mesh->mVertices[i].z);
-
-            // if (mesh->HasNormals()) {
-            //     vertices.push_back(mesh->mNormals[i].x);
-            //     vertices.push_back(mesh->mNormals[i].y);
-            //     vertices.push_back(mesh->mNormals[i].z);
-            // } else {
-            //     vertices.push_back(0.0f);
-            //     vertices.push_back(0.0f);
-            //     vertices.push_back(0.0f);
-            // }
-            if (mesh->HasTextureCoords(0)) {
-                vertices.push_back(mesh->mTextureCoords[0][i].x);
-                vertices.push_back(mesh->mTextureCoords[0][i].y);
-            } else {
-                vertices.push_back(0.0f);
-                vertices.push_back(0.0f);
-            }
-            // std::cout << "Vertex " << i << ": " << mesh->mVertices[i].x << ", "
-            //           << mesh->mVertices[i].y << ", " << mesh->mVertices[i].z << std::endl;
+    std::cout << "Lambo: " << (m_Model->WasCooked() ? "cooked" : "mapped") << " in "
+              << m_Model->GetLoadMilliseconds() << " ms ("
+              << m_Model->GetSize() / (1024.0f * 1024.0f) << " MB)" << std::endl;
+
+    // Materials share embedded images, each one is loaded once
+    std::unordered_map<int32_t, std::shared_ptr<Texture>> textures;
+
+    glm::vec3 sceneMin(std::numeric_limits<float>::max());
+    glm::vec3 sceneMax(-std::numeric_limits<float>::max());
+    const CookedModelHeader &header = m_Model->GetHeader();
+    // One draw per batch, the cooker merged the meshes of each material
+    m_Meshes.reserve(header.BatchCount);
+    for (unsigned int batchIndex = 0; batchIndex < header.BatchCount; batchIndex++) {
+        const CookedBatch &batch = m_Model->GetBatch(batchIndex);
+
+        Mesh &m = m_Meshes.emplace_back();
+
+        // Positions are stored relative to the bounding box, Dequantize maps them back
+        glm::vec3 boxMin(batch.BoundsMin[0], batch.BoundsMin[1], batch.BoundsMin[2]);
+        glm::vec3 boxMax(batch.BoundsMax[0], batch.BoundsMax[1], batch.BoundsMax[2]);
+        glm::vec3 center = (boxMin + boxMax) * 0.5f;
+        glm::vec3 extent = glm::max((boxMax - boxMin) * 0.5f, glm::vec3(1e-6f));
+        m.Dequantize = glm::scale(glm::translate(glm::mat4(1.0f), center), extent);
+        sceneMin = glm::min(sceneMin, boxMin);
+        sceneMax = glm::max(sceneMax, boxMax);
+
+        // Already in their final layout, the mapped pages are copied straight into the buffers
+        const QuantizedVertex *vertices = m_Model->GetVertices(batch);
+        const unsigned int *indices = m_Model->GetIndices(batch);
+        auto build = [this, &batch, vertices, indices]() {
+            // Optimized when cooked
+            MeshBuilder builder(m_Model->GetMaterial(batch.Material).Name,
+                VertexBufferLayout::Of<QuantizedVertex>(), batch.VertexCount, batch.IndexCount,
+                false);
+            std::memcpy(builder.GetVertices<QuantizedVertex>(), vertices,
+                batch.VertexCount * sizeof(QuantizedVertex));
+            std::memcpy(builder.GetIndices(), indices, batch.IndexCount * sizeof(unsigned int));
+            return std::make_shared<MeshBuffers>(builder.Finish());
+        };
+
+        // The model key already stands for the file's contents, so reopening the test shares
+        // the buffers without hashing them again
+        std::shared_ptr<MeshBuffers> buffers;
+        if (ResourceCache<MeshBuffers> *cache = ResourceCache<MeshBuffers>::Get()) {
+            uint64_t hash = ContentHash(&batchIndex, sizeof(batchIndex), header.Key);
+            buffers = cache->Acquire(ContentKey(hash), build);
+        } else {
+            buffers = build();
         }
-
-        m.VAO = std::make_unique<VertexArray>();
-        m.VBO = std::make_unique<VertexBuffer>(vertices.data(), vertices.size() * sizeof(float));
-
-        m.VAO->AddBuffer(*m.VBO, layout);
-        std::vector<unsigned int> indices;
-        indices.reserve(mesh->mNumFaces * 3);
-        for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-            aiFace *face = &mesh->mFaces[i];
-            unsigned int count = face->mNumIndices;
-            // std::cout << "Face " << i << " (" << count << "): ";
-            for (unsigned int j = 0; j < count; j++) {
-                indices.push_back(face->mIndices[j]);
-                // std::cout << face->mIndices[j] << " ";
-            }
-            // std::cout << std::endl;
-        }
-        m.IBO = std::make_unique<IndexBuffer>(indices.data(), indices.size());
-        // std::cout << "This mesh has " << indices.size() << " m_Indices!" << std::endl;
-
-        m.Model = glm::scale(glm::mat4(1.0f), glm::vec3(0.01f));
-
-        m.shader = std::make_unique<Shader>("res/shaders/BasicTexture.shader");
-        m.shader->Bind();
+        // Aliases of the cache entry, they keep it in use
+        m.VAO = std::shared_ptr<VertexArray>(buffers, buffers->VAO.get());
+        m.VBO = std::shared_ptr<VertexBuffer>(buffers, buffers->VBO.get());
+        m.IBO = std::shared_ptr<IndexBuffer>(buffers, buffers->IBO.get());
 
         m.VAO->UnBind();
         m.VBO->UnBind();
         m.IBO->UnBind();
-        m.shader->UnBind();
-
-        m.MaterialIndex = mesh->mMaterialIndex;
-        aiMaterial *material = m_Scene->mMaterials[mesh->mMaterialIndex];
-        aiString path;
-        material->GetTexture(aiTextureType_DIFFUSE, 0, &path);
-        const aiTexture *diffuseTexture = m_Scene->GetEmbeddedTexture(path.C_Str());
-        // std::cout << "Diffuse Texture: " << path.C_Str() << std::endl;
-        material->GetTexture(aiTextureType_SPECULAR, 0, &path);
-        const aiTexture *specularTexture = m_Scene->GetEmbeddedTexture(path.C_Str());
-        // std::cout << "Specular Texture: " << path.C_Str() << std::endl;
-
-        for (const auto &texture : { specularTexture, diffuseTexture }) {
-            if (texture) {
-                if (texture->mHeight == 0) {
-                    m.texture = std::make_unique<Texture>(
-                        (unsigned char *) texture->pcData, texture->mWidth);
-                    // std::cout << "Texture width: " << m.Texture->GetWidth() << std::endl;
-                    // std::cout << "Texture height: " << m.Texture->GetHeight() << std::endl;
-                } else {
-                    std::cout << "TODO!!" << std::endl;
-                    // m.Texture = std::make_unique<Texture>(texture->pcData, texture->mWidth, texture->mHeight);
-                }
+
+        m.MaterialIndex = batch.Material;
+        m.FirstMeshlet = batch.FirstMeshlet;
+        m.MeshletCount = batch.MeshletCount;
+        int32_t image = m_Model->GetMaterial(batch.Material).Image;
+        if (image >= 0) {
+            // Decoding the embedded images took most of the startup, the loader does it on the
+            // workers while the placeholder is drawn
+            // Looked up by index first, hashing the image for the cache is not free
+            auto loaded = textures.find(image);
+            if (loaded != textures.end()) {
+                m.texture = loaded->second;
+            } else {
+                const CookedImage &cookedImage = m_Model->GetImage(image);
+                m.texture = TextureLoader::Acquire(cookedImage.Name,
+                    m_Model->GetImageData(cookedImage), (unsigned int) cookedImage.Size);
+                textures[image] = m.texture;
             }
         }
 
-        m_Meshes.push_back(m);
+        m.TextureIndex = m.texture ? m_TextureArrays->Add(m.texture) : c_NoTexture;
     }
-
-    m_Proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.f);
+    m_Shader = std::make_unique<Shader>("res/shaders/BasicTexture.shader");
+    const unsigned char white[4] = { 255, 255, 255, 255 };
+    GLCall(glGenTextures(1, &m_WhiteTexture));
+    GLCall(glBindTexture(GL_TEXTURE_2D, m_WhiteTexture));
+    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+    GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white));
+    GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+    m_ArrayShader = std::make_unique<Shader>("res/shaders/BasicTextureArray.shader");
+    m_ArrayShader->Bind();
+    m_ArrayShader->SetUniform1i("u_Textures", 0);
+    m_ArrayShader->UnBind();
+
+    m_Proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 500.f);
     m_View = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.0f, -10.0f));
+
+    if (!m_Meshes.empty()) {
+        m_BoundsCenter = (sceneMin + sceneMax) * 0.5f;
+        m_BoundsRadius = glm::length(sceneMax - sceneMin) * 0.5f;
+    }
+    m_Impostor
+        = std::make_unique<Impostor>("res/models/Lambo.glb", m_BoundsCenter, m_BoundsRadius);
+    // Room for the largest grid
+    m_ImpostorInstances
+        = std::make_unique<StreamBuffer>(
+            GL_ARRAY_BUFFER, c_MaxGridSize * c_MaxGridSize * sizeof(glm::vec4));
+
+    m_MeshletCuller = std::make_unique<MeshletCuller>(*m_Model);
+    if (GLEW_ARB_multi_draw_indirect && header.MeshletCount > 0) {
+        // Enough for the worst case of the largest grid when that is small
+        size_t worstCase = (size_t) header.MeshletCount * c_MaxGridSize * c_MaxGridSize
+            * sizeof(DrawElementsIndirectCommand);
+        m_IndirectCommands = std::make_unique<StreamBuffer>(GL_DRAW_INDIRECT_BUFFER,
+            (unsigned int) std::min(worstCase, (size_t) c_MaxIndirectBytes));
+        // Every draw writes its own commands, without the persistent mapping that would map
+        // and unmap the buffer per draw
+        m_UseIndirect = m_IndirectCommands->IsPersistent();
+    }
 }
 
 TestAssimp::~TestAssimp() {
+    if (m_WhiteTexture) {
+        GLCall(glDeleteTextures(1, &m_WhiteTexture));
+    }
 }
 
 void TestAssimp::OnUpdate(float deltaTime) {
-    (void) deltaTime;
-    (void) m_RotationSpeed;
-    glm::vec3 axis = glm::normalize(glm::vec3(0.0f, 1.0f, 0.0f));
-    float angle = m_RotationSpeed * deltaTime * glm::radians(45.f);
-    for (auto &mesh : m_Meshes) {
-        mesh.Model = glm::rotate(mesh.Model, angle, axis);
+    m_Angle += m_RotationSpeed * deltaTime * glm::radians(45.f);
+}
+
+void TestAssimp::DrawMesh(const Renderer &renderer, const Mesh &mesh, Shader &shader,
+    const glm::mat4 &model, const glm::vec3 &cameraPosition) {
+    if (!m_UseMeshletCulling || mesh.MeshletCount == 0) {
+        renderer.Draw(*mesh.VAO, *mesh.IBO, shader);
+        return;
+    }
+
+    // The meshlet bounds are in model space, before Dequantize
+    glm::vec3 camera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+    m_Commands.clear();
+    m_MeshletCuller->Cull(
+        m_Proj * m_View * model, camera, mesh.FirstMeshlet, mesh.MeshletCount, m_Commands);
+    if (m_Commands.empty()) {
+        return;
+    }
+
+    // Once this frame's region is full the rest of the frame draws from client memory,
+    // without asking Allocate (and having it log) for every draw
+    unsigned int count = (unsigned int) m_Commands.size();
+    unsigned int bytes = count * sizeof(DrawElementsIndirectCommand);
+    StreamAllocation allocation = { nullptr, 0 };
+    if (m_UseIndirect && bytes + sizeof(unsigned int) <= m_IndirectCommands->GetRemaining()) {
+        allocation = m_IndirectCommands->Allocate(bytes, sizeof(unsigned int));
+    }
+    if (allocation.Data) {
+        std::memcpy(allocation.Data, m_Commands.data(), bytes);
+        m_IndirectCommands->Bind();
+        renderer.DrawIndirect(*mesh.VAO, *mesh.IBO, shader, allocation.Offset, count);
+        m_IndirectCommands->UnBind();
+        m_IndirectDraws++;
+    } else {
+        renderer.DrawRanges(*mesh.VAO, *mesh.IBO, shader, m_Commands.data(), count);
     }
 }
 
 void TestAssimp::OnRender() {
     GLCall(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+    // The constructor stops before the impostor and the culler without a model
+    if (!m_Model->IsValid()) {
+        return;
+    }
 
     GLCall(glEnable(GL_CULL_FACE));
     GLCall(glCullFace(GL_BACK));
@@ -143,71 +238,270 @@ void TestAssimp::OnRender() {
 
     Renderer renderer;
 
-    for (const auto &mesh : m_Meshes) {
+    if (m_FirstFrameMilliseconds < 0.0f) {
+        m_FirstFrameMilliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - m_Created)
+                                       .count();
+    }
+    bool texturesReady = m_TexturesReadyMilliseconds >= 0.0f;
+    if (!texturesReady) {
+        texturesReady = std::all_of(m_Meshes.begin(), m_Meshes.end(),
+            [](const Mesh &mesh) { return !mesh.texture || mesh.texture->IsReady(); });
+        if (texturesReady) {
+            m_TexturesReadyMilliseconds
+                = std::chrono::duration<float, std::chrono::milliseconds::period>(
+                    std::chrono::high_resolution_clock::now() - m_Created)
+                      .count();
+            size_t bytes = 0;
+            for (const auto &mesh : m_Meshes) {
+                bytes += mesh.texture ? mesh.texture->GetMemorySize() : 0;
+            }
+            std::cout << "Lambo: first frame after " << m_FirstFrameMilliseconds
+                      << " ms, all textures after " << m_TexturesReadyMilliseconds << " ms ("
+                      << bytes / (1024.0f * 1024.0f) << " MB)" << std::endl;
+        }
+    }
+
+    // A few views per frame until the atlas is done, unless it came from the cache. Waits for
+    // the textures, the atlas would keep the placeholder otherwise.
+    if (m_UseImpostors && !m_Impostor->IsReady() && texturesReady) {
+        m_Impostor->Bake([&](Shader &shader) {
+            for (const auto &mesh : m_Meshes) {
+                shader.SetUniformMat4f("u_Model", mesh.Dequantize);
+                if (mesh.texture) {
+                    mesh.texture->Bind();
+                } else {
+                    GLCall(glActiveTexture(GL_TEXTURE0));
+                    GLCall(glBindTexture(GL_TEXTURE_2D, m_WhiteTexture));
+                }
+                renderer.Draw(*mesh.VAO, *mesh.IBO, shader);
+            }
+        });
+    }
+    bool impostors = m_UseImpostors && m_Impostor->IsReady();
 
-        glm::mat4 mvp = m_Proj * m_View * mesh.Model;
-        mesh.shader->Bind();
-        mesh.shader->SetUniformMat4f("u_MVP", mvp);
-        if (mesh.texture) {
-            mesh.texture->Bind();
+    // Built once every texture is in, meshes sharing an array are then drawn next to each other
+    bool arrays = m_UseTextureArrays && texturesReady && m_TextureArrays->Build();
+    if (arrays && m_ArrayOrder.empty()) {
+        for (unsigned int i = 0; i < m_Meshes.size(); i++) {
+            m_ArrayOrder.push_back(i);
         }
-        renderer.Draw(*mesh.VAO, *mesh.IBO, *mesh.shader);
+        auto array = [this](unsigned int mesh) {
+            unsigned int index = m_Meshes[mesh].TextureIndex;
+            return index == c_NoTexture ? 0u : m_TextureArrays->GetLayer(index).Array + 1;
+        };
+        std::stable_sort(m_ArrayOrder.begin(), m_ArrayOrder.end(),
+            [&array](unsigned int a, unsigned int b) { return array(a) < array(b); });
+    }
+    // Binds persist across the copies, with one array there is one bind per frame
+    m_TextureBinds = 0;
+    int boundArray = -1;
+
+    unsigned int copies = (unsigned int) (m_GridSize * m_GridSize);
+    m_ImpostorInstances->BeginFrame();
+    if (m_IndirectCommands) {
+        m_IndirectCommands->BeginFrame();
+    }
+    m_IndirectDraws = 0;
+    m_MeshletCuller->BeginFrame();
+    StreamAllocation allocation = { nullptr, 0 };
+    if (impostors) {
+        allocation = m_ImpostorInstances->Allocate(copies * sizeof(glm::vec4));
+    }
+    glm::vec4 *impostor = (glm::vec4 *) allocation.Data;
+
+    glm::vec3 cameraPosition = glm::vec3(glm::inverse(m_View)[3]);
+    float spacing = 2.5f * m_BoundsRadius * c_ModelScale;
+    m_MeshCopies = 0;
+    m_MeshDraws = 0;
+    m_ImpostorCopies = 0;
+    for (int z = 0; z < m_GridSize; z++) {
+        for (int x = 0; x < m_GridSize; x++) {
+            glm::vec3 position((x - (m_GridSize - 1) * 0.5f) * spacing, 0.0f, -z * spacing);
+            float yaw = m_Angle + (x * 7 + z * 13) * 0.37f;
+            glm::mat4 model = glm::scale(
+                glm::rotate(glm::translate(glm::mat4(1.0f), position), yaw, glm::vec3(0, 1, 0)),
+                glm::vec3(c_ModelScale));
+
+            glm::vec3 center = glm::vec3(model * glm::vec4(m_BoundsCenter, 1.0f));
+            if (impostor && glm::distance(cameraPosition, center) > m_ImpostorDistance) {
+                impostor[m_ImpostorCopies++] = glm::vec4(position, yaw);
+                continue;
+            }
+
+            if (arrays) {
+                for (unsigned int index : m_ArrayOrder) {
+                    const Mesh &mesh = m_Meshes[index];
+                    glm::mat4 mvp = m_Proj * m_View * model * mesh.Dequantize;
+                    // Sorted first, they do not disturb the array binds
+                    if (mesh.TextureIndex == c_NoTexture) {
+                        m_Shader->Bind();
+                        m_Shader->SetUniformMat4f("u_MVP", mvp);
+                        GLCall(glActiveTexture(GL_TEXTURE0));
+                        GLCall(glBindTexture(GL_TEXTURE_2D, m_WhiteTexture));
+                        m_TextureBinds++;
+                        DrawMesh(renderer, mesh, *m_Shader, model, cameraPosition);
+                        m_MeshDraws++;
+                        continue;
+                    }
+                    m_ArrayShader->Bind();
+                    const TextureLayer &layer = m_TextureArrays->GetLayer(mesh.TextureIndex);
+                    if ((int) layer.Array != boundArray) {
+                        m_TextureArrays->Bind(layer.Array);
+                        boundArray = (int) layer.Array;
+                        m_TextureBinds++;
+                    }
+                    m_ArrayShader->SetUniform1f("u_Layer", (float) layer.Layer);
+                    m_ArrayShader->SetUniformMat4f("u_MVP", mvp);
+                    DrawMesh(renderer, mesh, *m_ArrayShader, model, cameraPosition);
+                    m_MeshDraws++;
+                }
+                m_MeshCopies++;
+                continue;
+            }
+
+            m_Shader->Bind();
+            for (const auto &mesh : m_Meshes) {
+                glm::mat4 mvp = m_Proj * m_View * model * mesh.Dequantize;
+                m_Shader->SetUniformMat4f("u_MVP", mvp);
+                if (mesh.texture) {
+                    mesh.texture->Bind();
+                } else {
+                    GLCall(glActiveTexture(GL_TEXTURE0));
+                    GLCall(glBindTexture(GL_TEXTURE_2D, m_WhiteTexture));
+                }
+                m_TextureBinds++;
+                DrawMesh(renderer, mesh, *m_Shader, model, cameraPosition);
+                m_MeshDraws++;
+            }
+            m_MeshCopies++;
+        }
+    }
+
+    if (m_ImpostorCopies > 0) {
+        m_ImpostorInstances->Commit();
+        m_Impostor->Draw(m_View, m_Proj, c_ModelScale, *m_ImpostorInstances, allocation.Offset,
+            m_ImpostorCopies, (ImpostorView) m_ImpostorView);
+    }
+    m_ImpostorInstances->EndFrame();
+    if (m_IndirectCommands) {
+        m_IndirectCommands->EndFrame();
     }
 }
 
 void TestAssimp::OnImGuiRender() {
     ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate,
         ImGui::GetIO().Framerate);
+    if (!m_Model->IsValid()) {
+        ImGui::Text("res/models/Lambo.glb could not be loaded");
+        return;
+    }
     ImGui::SliderFloat("Rotation Speed", &m_RotationSpeed, 0.0f, 20.0f);
+    ImGui::SliderInt("Copies per side", &m_GridSize, 1, c_MaxGridSize);
+    ImGui::Checkbox("Impostors", &m_UseImpostors);
+    if (m_UseImpostors) {
+        ImGui::SliderFloat("Impostor distance", &m_ImpostorDistance, 0.0f, 200.0f);
+        ImGui::Combo("Impostor view", &m_ImpostorView, "Albedo\0Normal\0Depth\0");
+        if (!m_Impostor->IsReady()) {
+            ImGui::ProgressBar(m_Impostor->GetBakeProgress(), ImVec2(-1.0f, 0.0f), "Baking");
+        } else if (m_Impostor->IsCached()) {
+            ImGui::Text("Atlas: %.1f MB, loaded from the cache",
+                m_Impostor->GetMemorySize() / (1024.0f * 1024.0f));
+        } else {
+            ImGui::Text("Atlas: %.1f MB, baked in %.1f ms",
+                m_Impostor->GetMemorySize() / (1024.0f * 1024.0f),
+                m_Impostor->GetBakeMilliseconds());
+        }
+    }
+    if (m_TexturesReadyMilliseconds >= 0.0f) {
+        ImGui::Text("First frame after %.1f ms, textures after %.1f ms", m_FirstFrameMilliseconds,
+            m_TexturesReadyMilliseconds);
+    } else {
+        ImGui::Text("First frame after %.1f ms, loading textures", m_FirstFrameMilliseconds);
+    }
+    ImGui::Checkbox("Texture arrays", &m_UseTextureArrays);
+    if (m_TextureArrays->IsBuilt()) {
+        const TextureArraysStats &arrayStats = m_TextureArrays->GetStats();
+        ImGui::Text("%u textures in %u arrays, built in %.1f ms (%s)", arrayStats.Textures,
+            arrayStats.Arrays, arrayStats.BuildMilliseconds,
+            arrayStats.CopyImage ? "copied on the GPU" : "read back");
+    }
+    ImGui::Text("Texture binds: %u per frame", m_TextureBinds);
+    ImGui::Text("Full meshes: %u copies (%u draws), impostors: %u copies (%u draw)",
+        m_MeshCopies, m_MeshDraws, m_ImpostorCopies, m_ImpostorCopies > 0 ? 1 : 0);
+    ImGui::Checkbox("Meshlet culling", &m_UseMeshletCulling);
+    if (m_UseMeshletCulling) {
+        const MeshletCullerStats &cullStats = m_MeshletCuller->GetStats();
+        float rejected = cullStats.Triangles > 0
+            ? 100.0f * cullStats.CulledTriangles / cullStats.Triangles
+            : 0.0f;
+        ImGui::Text("Triangles rejected: %.1f%% of %llu per frame", rejected,
+            (unsigned long long) cullStats.Triangles);
+        ImGui::Text("Meshlets: %u tested, %u outside the frustum, %u facing away",
+            cullStats.Meshlets, cullStats.FrustumCulled, cullStats.ConeCulled);
+        ImGui::Text("%u draw commands, culled in %.2f ms", cullStats.Commands,
+            cullStats.Milliseconds);
+        ImGui::Text("Multi draw indirect: %s, %u draws (the rest with glMultiDrawElements)",
+            m_UseIndirect ? "yes" : "no", m_IndirectDraws);
+    }
     ImGui::Separator();
-    ImGui::Text("Meshes: %d", m_Scene->mNumMeshes);
+    if (m_Model->WasCooked()) {
+        ImGui::Text("Model: %.2f MB, imported and cooked in %.1f ms (cold)",
+            m_Model->GetSize() / (1024.0f * 1024.0f), m_Model->GetLoadMilliseconds());
+        ImGui::Text("Converted in %.1f ms on %u threads", m_Model->GetConvertMilliseconds(),
+            ThreadPool::Get().GetThreadCount() + 1);
+    } else {
+        ImGui::Text("Model: %.2f MB, mapped from the cache in %.1f ms (warm)",
+            m_Model->GetSize() / (1024.0f * 1024.0f), m_Model->GetLoadMilliseconds());
+    }
+    const CookedModelHeader &header = m_Model->GetHeader();
+    ImGui::Text("Meshes: %u, merged into %u batches of %u meshlets", header.MeshCount,
+        header.BatchCount, header.MeshletCount);
+    const MeshBuilderStats &meshStats = MeshBuilder::GetStats();
+    ImGui::Text("Mesh buffers: %.2f MB, staged on the CPU: %.2f MB (peak %.2f MB)",
+        meshStats.GpuBytes / (1024.0f * 1024.0f), meshStats.StagedBytes / (1024.0f * 1024.0f),
+        meshStats.PeakStagingBytes / (1024.0f * 1024.0f));
     ImGui::Separator();
-    for (unsigned int i = 0; i < m_Scene->mNumMeshes; i++) {
-        ImGui::Text("Name: %s", m_Scene->mMeshes[i]->mName.C_Str());
-        ImGui::Text("m_Vertices: %d", m_Scene->mMeshes[i]->mNumVertices);
-        ImGui::Text("Faces: %d", m_Scene->mMeshes[i]->mNumFaces);
-        ImGui::Text("Material Index: %d", m_Scene->mMeshes[i]->mMaterialIndex);
-        ImGui::Text("Bones: %d", m_Scene->mMeshes[i]->mNumBones);
-        ImGui::Text("Has Normals: %s", m_Scene->mMeshes[i]->HasNormals() ? "true" : "false");
+    for (unsigned int i = 0; i < header.MeshCount; i++) {
+        const CookedMesh &mesh = m_Model->GetMesh(i);
+        ImGui::Text("Name: %s", mesh.Name);
+        ImGui::Text("m_Vertices: %u", mesh.VertexCount);
+        ImGui::Text("Faces: %u", mesh.FaceCount);
+        ImGui::Text("Material Index: %u", mesh.Material);
+        ImGui::Text("Batch: %u", mesh.Batch);
+        ImGui::Text("Bones: %u", mesh.BoneCount);
+        ImGui::Text("Has Normals: %s", mesh.Flags & CookedMeshNormals ? "true" : "false");
         ImGui::Text("Has Tangents and Bitangents: %s",
-            m_Scene->mMeshes[i]->HasTangentsAndBitangents() ? "true" : "false");
-        ImGui::Text("Has Texture Coordinates: %s",
-            m_Scene->mMeshes[i]->HasTextureCoords(0) ? "true" : "false");
+            mesh.Flags & CookedMeshTangents ? "true" : "false");
         ImGui::Text(
-            "Has Vertex Colors: %s", m_Scene->mMeshes[i]->HasVertexColors(0) ? "true" : "false");
+            "Has Texture Coordinates: %s", mesh.Flags & CookedMeshTexCoords ? "true" : "false");
+        ImGui::Text("Has Vertex Colors: %s", mesh.Flags & CookedMeshColors ? "true" : "false");
 
         ImGui::Separator();
     }
 
-    ImGui::Text("Materials: %d", m_Scene->mNumMaterials);
+    ImGui::Text("Materials: %u", header.MaterialCount);
     ImGui::Separator();
-    for (unsigned int i = 0; i < m_Scene->mNumMaterials; i++) {
-        ImGui::Text("Name: %s", m_Scene->mMaterials[i]->GetName().C_Str());
-        for (unsigned int j = 0; j < m_Scene->mMaterials[i]->mNumProperties; j++) {
-            ImGui::Text("Property Name: %s", m_Scene->mMaterials[i]->mProperties[j]->mKey.C_Str());
-            ImGui::Text("Property Type: %d", m_Scene->mMaterials[i]->mProperties[j]->mType);
-            ImGui::Text("Property Index: %d", m_Scene->mMaterials[i]->mProperties[j]->mIndex);
-            ImGui::Text(
-                "Property Data Length: %d", m_Scene->mMaterials[i]->mProperties[j]->mDataLength);
-            ImGui::Separator();
-        }
+    for (unsigned int i = 0; i < header.MaterialCount; i++) {
+        const CookedMaterial &material = m_Model->GetMaterial(i);
+        ImGui::Text("Name: %s", material.Name);
+        ImGui::Text("Texture: %d", material.Image);
         ImGui::Separator();
     }
 
-    ImGui::Text("Textures: %d", m_Scene->mNumTextures);
+    ImGui::Text("Textures: %u", header.ImageCount);
     ImGui::Separator();
-    for (unsigned int i = 0; i < m_Scene->mNumTextures; i++) {
-        ImGui::Text("Name: %s", m_Scene->mTextures[i]->mFilename.C_Str());
-        ImGui::Text("Width: %d", m_Scene->mTextures[i]->mWidth);
-        ImGui::Text("Height: %d", m_Scene->mTextures[i]->mHeight);
-        ImGui::Text("Format Hint: %s", m_Scene->mTextures[i]->achFormatHint);
-        ImGui::Text("Data Length: %d", m_Scene->mTextures[i]->mWidth);
+    for (unsigned int i = 0; i < header.ImageCount; i++) {
+        const CookedImage &image = m_Model->GetImage(i);
+        ImGui::Text("Name: %s", image.Name);
+        ImGui::Text("Format Hint: %s", image.FormatHint);
+        ImGui::Text("Data Length: %llu", (unsigned long long) image.Size);
         ImGui::Separator();
     }
 
-    ImGui::Text("Lights: %d", m_Scene->mNumLights);
-    ImGui::Text("Cameras: %d", m_Scene->mNumCameras);
-    ImGui::Text("Animations: %d", m_Scene->mNumAnimations);
+    ImGui::Text("Lights: %u", header.LightCount);
+    ImGui::Text("Cameras: %u", header.CameraCount);
+    ImGui::Text("Animations: %u", header.AnimationCount);
 }
 
 }
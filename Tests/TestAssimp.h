@@ -1,14 +1,18 @@
 #pragma once
 
+#include "CookedModel.h"
+#include "Impostor.h"
 #include "IndexBuffer.h"
+#include "MeshletCuller.h"
 #include "Shader.h"
+#include "StreamBuffer.h"
 #include "Test.h"
 #include "Texture.h"
+#include "TextureArrays.h"
 #include "VertexArray.h"
 #include "VertexBuffer.h"
 
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
+#include <chrono>
 #include <glm/glm.hpp>
 #include <memory>
 
@@ -24,27 +28,80 @@ public:
     void OnImGuiRender() override;
 
 private:
-    Assimp::Importer m_Importer;
-    const aiScene *m_Scene;
+    // Imported with Assimp once, then mapped from res/cache/models
+    std::unique_ptr<CookedModel> m_Model;
+
+    // Time to the first OnRender, and until every texture replaced its placeholder
+    std::chrono::high_resolution_clock::time_point m_Created;
+    float m_FirstFrameMilliseconds;
+    float m_TexturesReadyMilliseconds;
 
     glm::mat4 m_Proj;
     glm::mat4 m_View;
 
     float m_RotationSpeed;
+    float m_Angle;
 
     struct Mesh {
         std::shared_ptr<VertexArray> VAO;
         std::shared_ptr<VertexBuffer> VBO;
         std::shared_ptr<IndexBuffer> IBO;
-        std::shared_ptr<Shader> shader;
         std::shared_ptr<Texture> texture;
+        // Its layer in m_TextureArrays, if it has a texture
+        unsigned int TextureIndex;
 
         unsigned int MaterialIndex;
 
-        glm::mat4 Model;
+        // From the quantized vertex positions to model space
+        glm::mat4 Dequantize;
+
+        unsigned int FirstMeshlet;
+        unsigned int MeshletCount;
     };
 
+    // Draws a copy of one mesh, or with meshlet culling on only the meshlets that survive
+    void DrawMesh(const Renderer &renderer, const Mesh &mesh, Shader &shader,
+        const glm::mat4 &model, const glm::vec3 &cameraPosition);
+
+    // One per batch of the cooked model
     std::vector<Mesh> m_Meshes;
+    std::unique_ptr<Shader> m_Shader;
+    // 1x1 white, drawn with m_Shader for the batches without a texture
+    unsigned int m_WhiteTexture;
+
+    // Every texture as a layer of a few arrays, so draws only rebind when the array changes
+    bool m_UseTextureArrays;
+    std::unique_ptr<TextureArrays> m_TextureArrays;
+    std::unique_ptr<Shader> m_ArrayShader;
+    // Mesh indices sorted by their texture array
+    std::vector<unsigned int> m_ArrayOrder;
+    unsigned int m_TextureBinds;
+
+    // Copies of the model on a grid, the ones further away than m_ImpostorDistance drawn as
+    // impostors in a single instanced call
+    int m_GridSize;
+    bool m_UseImpostors;
+    float m_ImpostorDistance;
+    int m_ImpostorView;
+    // Bounding sphere of the whole model, before the model matrix
+    glm::vec3 m_BoundsCenter;
+    float m_BoundsRadius;
+    std::unique_ptr<Impostor> m_Impostor;
+    std::unique_ptr<StreamBuffer> m_ImpostorInstances;
+
+    // Meshlets outside the frustum or facing away are left out of the full meshes' draws,
+    // through glMultiDrawElementsIndirect when it is there
+    bool m_UseMeshletCulling;
+    bool m_UseIndirect;
+    std::unique_ptr<MeshletCuller> m_MeshletCuller;
+    std::unique_ptr<StreamBuffer> m_IndirectCommands;
+    // Draws this frame that fit into m_IndirectCommands
+    unsigned int m_IndirectDraws;
+    std::vector<DrawElementsIndirectCommand> m_Commands;
+
+    unsigned int m_MeshCopies;
+    unsigned int m_MeshDraws;
+    unsigned int m_ImpostorCopies;
 };
 
 }
\ No newline at end of file
@@ -12,6 +12,10 @@ public:
     void OnUpdate(float deltaTime) override;
     void OnRender() override;
     void OnImGuiRender() override;
+    // OnUpdate changes nothing OnRender reads
+    bool OnSync() override {
+        return true;
+    }
 
 private:
     float m_ClearColor[4];
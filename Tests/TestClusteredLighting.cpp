@@ -0,0 +1,134 @@
+#include "TestClusteredLighting.h"
+
+#include "Renderer.h"
+#include "ThreadPool.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <imgui.h>
+#include <cstring>
+#include <random>
+
+namespace test {
+
+namespace {
+
+const int c_GridSize = 64;
+const float c_Spacing = 1.5f;
+const int c_MaxLights = 8192;
+
+}
+
+TestClusteredLighting::TestClusteredLighting()
+    : m_CameraPosition(0.0f, 30.0f, 60.0f)
+    , m_LightCount(1024)
+    , m_LightRadius(6.0f)
+    , m_Time(0.0f)
+    , m_Animate(true) {
+    m_Camera.SetNearPlane(0.5f);
+    m_Camera.SetFarPlane(250.0f);
+    m_Camera.SetLookAt(m_CameraPosition, glm::vec3(0.0f), glm::vec3(0, 1, 0));
+
+    m_Shader = std::make_unique<Shader>("res/shaders/Surface.shader",
+        ShaderFeature::Lit | ShaderFeature::Instanced | ShaderFeature::Clustered);
+
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> height(0.5f, 4.0f);
+    float extent = (c_GridSize - 1) * c_Spacing * 0.5f;
+    for (int z = 0; z < c_GridSize; z++) {
+        for (int x = 0; x < c_GridSize; x++) {
+            float h = height(random);
+            glm::mat4 model = glm::translate(glm::mat4(1.0f),
+                glm::vec3(x * c_Spacing - extent, h * 0.5f, z * c_Spacing - extent));
+            m_Pillars.push_back(glm::scale(model, glm::vec3(1.0f, h, 1.0f)));
+        }
+    }
+    m_Instances = std::make_unique<StreamBuffer>(
+        GL_ARRAY_BUFFER, (unsigned int) (m_Pillars.size() * sizeof(glm::mat4)));
+
+    CreateLights(c_MaxLights);
+}
+
+TestClusteredLighting::~TestClusteredLighting() {
+}
+
+void TestClusteredLighting::CreateLights(unsigned int count) {
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    float extent = c_GridSize * c_Spacing * 0.5f;
+
+    m_Lights.resize(count);
+    m_Orbits.resize(count);
+    for (unsigned int i = 0; i < count; i++) {
+        m_Orbits[i] = { glm::vec3((unit(random) * 2.0f - 1.0f) * extent,
+                            1.0f + unit(random) * 4.0f, (unit(random) * 2.0f - 1.0f) * extent),
+            1.0f + unit(random) * 4.0f, 0.2f + unit(random), unit(random) * 6.2831853f };
+        m_Lights[i].Color = glm::vec3(unit(random), unit(random), unit(random));
+        m_Lights[i].Intensity = 1.0f;
+    }
+}
+
+void TestClusteredLighting::OnUpdate(float deltaTime) {
+    if (m_Animate) {
+        m_Time += deltaTime;
+    }
+    for (size_t i = 0; i < m_Lights.size(); i++) {
+        const LightOrbit &orbit = m_Orbits[i];
+        float angle = orbit.Phase + m_Time * orbit.Speed;
+        m_Lights[i].Position = orbit.Center
+            + orbit.Radius * glm::vec3(glm::cos(angle), 0.0f, glm::sin(angle));
+        m_Lights[i].Radius = m_LightRadius;
+    }
+}
+
+void TestClusteredLighting::OnRender() {
+    GLCall(glEnable(GL_DEPTH_TEST));
+    GLCall(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+
+    std::vector<PointLight> lights(m_Lights.begin(), m_Lights.begin() + m_LightCount);
+    m_Clusters.Update(m_Camera.GetViewMatrix(), m_Camera.GetProjectionMatrix(), lights);
+
+    m_Instances->BeginFrame();
+    unsigned int size = (unsigned int) (m_Pillars.size() * sizeof(glm::mat4));
+    StreamAllocation instances = m_Instances->Allocate(size);
+    if (instances.Data) {
+        memcpy(instances.Data, m_Pillars.data(), size);
+        m_Instances->Commit();
+
+        m_Shader->Bind();
+        m_Clusters.SetUniforms(*m_Shader, 0);
+        m_Shader->SetUniformMat4f("u_View", m_Camera.GetViewMatrix());
+        m_Shader->SetUniform3f("u_LightColor", 1.0f, 1.0f, 1.0f);
+        m_Shader->SetUniform3f(
+            "u_ViewPos", m_CameraPosition.x, m_CameraPosition.y, m_CameraPosition.z);
+        m_Cube.drawInstanced(m_Camera.GetViewProjectionMatrix(), *m_Shader, *m_Instances,
+            instances.Offset, (unsigned int) m_Pillars.size());
+    }
+    m_Instances->EndFrame();
+}
+
+void TestClusteredLighting::OnImGuiRender() {
+    ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate,
+        ImGui::GetIO().Framerate);
+    ImGui::SliderInt("Lights", &m_LightCount, 1, c_MaxLights);
+    ImGui::SliderFloat("Light radius", &m_LightRadius, 1.0f, 20.0f);
+    ImGui::Checkbox("Animate", &m_Animate);
+    if (ImGui::SliderFloat3("Camera Position", &m_CameraPosition.x, -100.0f, 100.0f)) {
+        m_Camera.SetLookAt(m_CameraPosition, glm::vec3(0.0f), glm::vec3(0, 1, 0));
+    }
+
+    const ClusterStats &stats = m_Clusters.GetStats();
+    ImGui::Separator();
+    ImGui::Text("%ux%ux%u clusters, binned on %u threads", ClusteredLighting::DimX,
+        ClusteredLighting::DimY, ClusteredLighting::DimZ, ThreadPool::Get().GetThreadCount() + 1);
+    ImGui::Text("Binning took %.3f ms", stats.BinningTime);
+    ImGui::Text("Lights per cluster: %.2f average, %.2f in occupied clusters, %u max",
+        stats.AverageLightsPerCluster, stats.AverageLightsPerOccupiedCluster,
+        stats.MaxLightsPerCluster);
+    ImGui::Text("%u light indices", stats.Indices);
+}
+
+void TestClusteredLighting::OnWindowResize(int width, int height) {
+    m_Camera.SetAspectRatio((float) width / (float) height);
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Camera.h"
+#include "ClusteredLighting.h"
+#include "Cube.h"
+#include "Shader.h"
+#include "StreamBuffer.h"
+#include "Test.h"
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+namespace test {
+
+// A field of pillars lit by up to a few thousand moving point lights
+class TestClusteredLighting : public Test {
+public:
+    TestClusteredLighting();
+    ~TestClusteredLighting();
+
+    void OnUpdate(float deltaTime) override;
+    void OnRender() override;
+    void OnImGuiRender() override;
+    void OnWindowResize(int width, int height) override;
+
+private:
+    void CreateLights(unsigned int count);
+
+    Cube m_Cube;
+    Camera m_Camera;
+    glm::vec3 m_CameraPosition;
+
+    std::unique_ptr<Shader> m_Shader;
+    std::unique_ptr<StreamBuffer> m_Instances;
+    std::vector<glm::mat4> m_Pillars;
+
+    // Lights circle around their own center at their own speed
+    struct LightOrbit {
+        glm::vec3 Center;
+        float Radius;
+        float Speed;
+        float Phase;
+    };
+    std::vector<PointLight> m_Lights;
+    std::vector<LightOrbit> m_Orbits;
+    ClusteredLighting m_Clusters;
+
+    int m_LightCount;
+    float m_LightRadius;
+    float m_Time;
+    bool m_Animate;
+};
+
+}
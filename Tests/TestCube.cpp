@@ -27,8 +27,10 @@ void TestCube::OnUpdate(float deltaTime) {
 }
 
 void TestCube::OnRender() {
-    GLCall(glEnable(GL_DEPTH_TEST));
-    GLCall(glDisable(GL_CULL_FACE));
+    // Through Renderer rather than GL, so the test also runs headless
+    Renderer renderer;
+    renderer.SetDepthTest(true);
+    renderer.SetBackFaceCulling(false);
 
     glm::mat4 mvp = m_Camera.GetViewProjectionMatrix() * m_Model;
     m_Cube.draw(mvp);
@@ -23,6 +23,7 @@
 #include <Jolt/Physics/Body/BodyCreationSettings.h>
 #include <Jolt/Physics/Collision/Shape/BoxShape.h>
 #include <Jolt/Physics/Collision/Shape/SphereShape.h>
+#include <Jolt/Physics/Constraints/ContactConstraintManager.h>
 #include <Jolt/Physics/PhysicsSettings.h>
 #include <Jolt/Physics/PhysicsSystem.h>
 #include <Jolt/RegisterTypes.h>
@@ -48,12 +49,39 @@ namespace test {
 
 TestJolt::TestJolt()
     : m_CameraPosition(0.0f, 15.0f, 90.0f)
+    , m_Instanced(true)
+    , m_FloorModel(glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+          glm::vec3(200.0f, 2.0f, 200.0f)))
+    , m_LightDirection(-0.4f, -1.0f, -0.3f)
+    , m_Shadows(true)
+    , m_PrintFrameGraph(false)
+#ifdef JPH_DEBUG_RENDERER
+    , m_DrawPhysics(false)
+    , m_DebugDrawTime(0.0f)
+#endif
     , m_PhysicsTime(0.0f) {
     m_Camera.SetProjectionMatrix(
         glm::perspective(glm::radians(50.0f), 16.0f / 9.0f, 0.1f, 1000.0f));
     m_Camera.SetLookAt(m_CameraPosition, m_CameraPosition - glm::vec3(0, 0, 1), glm::vec3(0, 1, 0));
 
     m_Shader = std::make_unique<Shader>("res/shaders/Normal.shader");
+    m_InstancedShader
+        = std::make_unique<Shader>("res/shaders/Surface.shader", ShaderFeature::Instanced);
+    m_Instances = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, cMaxBodies * sizeof(glm::mat4));
+
+    m_ShadowMap = std::make_unique<CascadedShadowMap>();
+    // The floor is the only static caster, the unit cube scaled by m_FloorModel
+    glm::vec3 floorCenter(m_FloorModel[3]);
+    glm::vec3 floorCorner(m_FloorModel * glm::vec4(0.5f, 0.5f, 0.5f, 1.0f));
+    m_ShadowMap->SetStaticBounds(floorCenter, glm::length(floorCorner - floorCenter));
+    m_DynamicResolution = std::make_unique<DynamicResolution>();
+    m_FloorShader = std::make_unique<Shader>(
+        "res/shaders/Surface.shader", ShaderFeature::Lit | ShaderFeature::Shadowed);
+    m_ShadowedShader = std::make_unique<Shader>("res/shaders/Surface.shader",
+        ShaderFeature::Lit | ShaderFeature::Shadowed | ShaderFeature::Instanced);
+    m_DepthShader = std::make_unique<Shader>("res/shaders/ShadowDepth.shader");
+    m_InstancedDepthShader
+        = std::make_unique<Shader>("res/shaders/ShadowDepth.shader", ShaderFeature::Instanced);
 
     // We need a temp allocator for temporary allocations during the physics update. We're
     // pre-allocating 10 MB to avoid having to do allocations during the physics update.
@@ -128,6 +156,10 @@ TestJolt::TestJolt()
 }
 
 TestJolt::~TestJolt() {
+#ifdef JPH_DEBUG_RENDERER
+    // Contacts are drawn from the physics jobs through DebugRenderer::sInstance
+    ContactConstraintManager::sDrawContactPoint = false;
+#endif
 
     for (const auto &box : m_Boxes) {
         body_interface->RemoveBody(box);
@@ -164,32 +196,271 @@ void TestJolt::OnUpdate(float deltaTime) {
 
 void TestJolt::OnRender() {
     GLCall(glEnable(GL_DEPTH_TEST));
-    GLCall(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
     GLCall(glDisable(GL_CULL_FACE)); // TODO: Remove this
 
-    for (const auto &BodyID : m_Boxes) {
-        Vec3 j_position = body_interface->GetCenterOfMassPosition(BodyID);
-        Quat j_rotation = body_interface->GetRotation(BodyID);
+    GLint viewport[4];
+    GLCall(glGetIntegerv(GL_VIEWPORT, viewport));
 
-        glm::mat4 translate = glm::translate(
-            glm::mat4(1.0f), glm::vec3(j_position.GetX(), j_position.GetY(), j_position.GetZ()));
-        glm::mat4 rotation = glm::mat4_cast(
-            glm::quat(j_rotation.GetW(), j_rotation.GetX(), j_rotation.GetY(), j_rotation.GetZ()));
+    StreamAllocation instances = { nullptr, 0 };
+    if (m_Instanced) {
+        m_Instances->BeginFrame();
+        instances = m_Instances->Allocate(m_Transforms.size() * sizeof(glm::mat4));
+        if (instances.Data) {
+            memcpy(instances.Data, m_Transforms.data(), m_Transforms.size() * sizeof(glm::mat4));
+            m_Instances->Commit();
+        }
+    }
+    bool instanced = m_Instanced && instances.Data;
+    glm::ivec2 renderSize = m_DynamicResolution->GetRenderSize(viewport[2], viewport[3]);
+    bool shadowed = instanced && m_Shadows;
+
+    m_FrameGraph.Reset();
+    FrameGraphResource backbuffer
+        = m_FrameGraph.ImportBackbuffer("Backbuffer", viewport[2], viewport[3]);
+    FrameGraphResource shadowMap = m_FrameGraph.ImportExternal("Shadow map");
+    FrameGraphResource sceneColor = -1;
+    FrameGraphResource sceneDepth = -1;
+
+    // Culled by the graph whenever the scene doesn't sample the shadow map
+    m_FrameGraph.AddPass(
+        "Shadows",
+        [&](FrameGraphBuilder &builder) { builder.Write(shadowMap, FrameGraphLoad::DontCare); },
+        [&](const FrameGraph &) { renderShadowMap(instances.Offset, m_Transforms.size()); });
+
+    m_FrameGraph.AddPass(
+        "Scene",
+        [&](FrameGraphBuilder &builder) {
+            sceneColor = builder.Create("Scene color", { viewport[2], viewport[3], GL_RGBA8 });
+            sceneDepth = builder.Create(
+                "Scene depth", { viewport[2], viewport[3], GL_DEPTH_COMPONENT24 });
+            builder.Write(sceneColor, FrameGraphLoad::Clear);
+            builder.Write(sceneDepth, FrameGraphLoad::Clear);
+            builder.SetViewport(renderSize.x, renderSize.y);
+            if (shadowed) {
+                builder.Read(shadowMap);
+            }
+        },
+        [&](const FrameGraph &) {
+            if (shadowed) {
+                renderShadowed(instances.Offset, m_Transforms.size());
+            } else if (instanced) {
+                m_Cube.drawInstanced(m_Camera.GetViewProjectionMatrix(), *m_InstancedShader,
+                    *m_Instances, instances.Offset, m_Transforms.size());
+            } else {
+                drawBoxes();
+            }
+        });
+
+#ifdef JPH_DEBUG_RENDERER
+    if (m_DrawPhysics) {
+        m_FrameGraph.AddPass(
+            "Physics debug",
+            [&](FrameGraphBuilder &builder) {
+                builder.Write(sceneColor);
+                builder.Write(sceneDepth);
+                builder.SetViewport(renderSize.x, renderSize.y);
+            },
+            [&](const FrameGraph &) { renderDebug(); });
+    }
+#endif
+
+    // Native resolution, so the ImGui overlay drawn afterwards is never scaled
+    m_FrameGraph.AddPass(
+        "Upscale",
+        [&](FrameGraphBuilder &builder) {
+            builder.Read(sceneColor);
+            builder.Write(backbuffer, FrameGraphLoad::DontCare);
+        },
+        [&](const FrameGraph &graph) {
+            bool native = renderSize == glm::ivec2(viewport[2], viewport[3]);
+            if (native && m_DynamicResolution->GetSettings().Sharpness <= 0.0f) {
+                graph.Blit(sceneColor);
+            } else {
+                m_DynamicResolution->Upscale(graph.GetTexture(sceneColor), renderSize);
+            }
+        });
+
+    m_FrameGraph.Compile();
+    m_FrameTimer.Begin();
+    m_FrameGraph.Execute();
+    m_FrameTimer.End();
+    m_DynamicResolution->Update(m_FrameTimer.GetMilliseconds());
+    if (m_PrintFrameGraph) {
+        std::cout << m_FrameGraph.GetReport();
+    }
 
-        glm::mat4 model = translate * rotation;
+    if (m_Instanced) {
+        m_Instances->EndFrame();
+    }
+}
 
+void TestJolt::drawBoxes() {
+    for (const glm::mat4 &model : m_Transforms) {
         glm::mat4 MVP = m_Camera.GetViewProjectionMatrix() * model;
-
         m_Cube.draw(MVP, m_Shader.get());
     }
 }
 
+void TestJolt::renderShadowMap(unsigned int offset, unsigned int count) {
+    m_ShadowMap->Update(
+        m_Camera.GetViewMatrix(), m_Camera.GetProjectionMatrix(), m_LightDirection);
+    m_ShadowMap->Render(
+        [&](const glm::mat4 &lightViewProj) {
+            m_Cube.draw(lightViewProj * m_FloorModel, m_DepthShader.get());
+        },
+        [&](const glm::mat4 &lightViewProj) {
+            // Same streamed transforms as the main pass, one instanced draw per cascade
+            m_Cube.drawInstanced(
+                lightViewProj, *m_InstancedDepthShader, *m_Instances, offset, count);
+        });
+}
+
+void TestJolt::renderShadowed(unsigned int offset, unsigned int count) {
+    m_FloorShader->Bind();
+    setLightUniforms(*m_FloorShader);
+    m_FloorShader->SetUniformMat4f("u_Model", m_FloorModel);
+    m_Cube.draw(m_Camera.GetViewProjectionMatrix() * m_FloorModel, m_FloorShader.get());
+
+    m_ShadowedShader->Bind();
+    setLightUniforms(*m_ShadowedShader);
+    m_Cube.drawInstanced(
+        m_Camera.GetViewProjectionMatrix(), *m_ShadowedShader, *m_Instances, offset, count);
+}
+
+bool TestJolt::OnSync() {
+    m_Transforms.resize(m_Boxes.size());
+    for (size_t i = 0; i < m_Boxes.size(); i++) {
+        // Both are column major
+        body_interface->GetCenterOfMassTransform(m_Boxes[i])
+            .StoreFloat4x4((Float4 *) &m_Transforms[i]);
+    }
+
+#ifdef JPH_DEBUG_RENDERER
+    // Collecting reads the bodies, so it can't wait for OnRender
+    if (m_DrawPhysics) {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        if (!m_DebugRenderer) {
+            m_DebugRenderer = std::make_unique<JoltDebugRenderer>();
+        }
+        m_DebugRenderer->SetCamera(m_Camera.GetViewProjectionMatrix(), m_CameraPosition);
+        physics_system.DrawBodies(m_DrawSettings, m_DebugRenderer.get());
+
+        m_DebugDrawTime = std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - start)
+                              .count();
+    }
+#endif
+    return true;
+}
+
+#ifdef JPH_DEBUG_RENDERER
+void TestJolt::renderDebug() {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    m_DebugRenderer->Flush();
+
+    m_DebugDrawTime += std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::high_resolution_clock::now() - start)
+                           .count();
+}
+#endif
+
+void TestJolt::setLightUniforms(Shader &shader) {
+    const unsigned int shadowSlot = 1;
+    m_ShadowMap->SetUniforms(shader, shadowSlot);
+    shader.SetUniformMat4f("u_View", m_Camera.GetViewMatrix());
+    shader.SetUniform3f("u_LightDir", m_LightDirection.x, m_LightDirection.y, m_LightDirection.z);
+    shader.SetUniform3f("u_LightColor", 1.0f, 1.0f, 1.0f);
+    shader.SetUniform3f("u_ViewPos", m_CameraPosition.x, m_CameraPosition.y, m_CameraPosition.z);
+}
+
 void TestJolt::OnImGuiRender() {
     ImGui::Text("%ld boxes", m_Boxes.size());
     ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate,
         ImGui::GetIO().Framerate);
     ImGui::Text(
         "Physics sim took %.3f ms/frame (%.1f FPS)", 1000.0f * m_PhysicsTime, 1.0f / m_PhysicsTime);
+    ImGui::Checkbox("Instanced", &m_Instanced);
+    if (m_Instanced) {
+        const StreamBufferStats &stats = m_Instances->GetStats();
+        ImGui::Text("Streamed %.1f KB in %u allocations (%s mapping)",
+            stats.BytesStreamed / 1024.0f, stats.Allocations,
+            m_Instances->IsPersistent() ? "persistent" : "unsynchronized");
+        ImGui::Text("Fence stalls: %u (%.3f ms)", stats.FenceStalls, stats.StallTime);
+
+        ImGui::Checkbox("Shadows", &m_Shadows);
+        if (m_Shadows) {
+            ImGui::SliderFloat3("Light direction", &m_LightDirection.x, -1.0f, 1.0f);
+            float distance = m_ShadowMap->GetShadowDistance();
+            if (ImGui::SliderFloat("Shadow distance", &distance, 20.0f, 500.0f)) {
+                m_ShadowMap->SetShadowDistance(distance);
+            }
+            float lambda = m_ShadowMap->GetSplitLambda();
+            if (ImGui::SliderFloat("Split lambda", &lambda, 0.0f, 1.0f)) {
+                m_ShadowMap->SetSplitLambda(lambda);
+            }
+            ImGui::Text("Shadow passes: %.3f ms GPU, %.3f ms CPU", m_ShadowMap->GetGpuTime(),
+                m_ShadowMap->GetCpuTime());
+            ImGui::Text("Static map redrawn: %u this frame, %u total",
+                m_ShadowMap->GetStaticRenders(), m_ShadowMap->GetTotalStaticRenders());
+        }
+    }
+
+    ImGui::Separator();
+    DynamicResolutionSettings &resolution = m_DynamicResolution->GetSettings();
+    ImGui::Checkbox("Dynamic resolution", &resolution.Enabled);
+    ImGui::SliderFloat("Target GPU time (ms)", &resolution.TargetMilliseconds, 2.0f, 33.3f);
+    ImGui::SliderFloat("Min scale", &resolution.MinScale, 0.25f, resolution.MaxScale);
+    ImGui::SliderFloat("Max scale", &resolution.MaxScale, resolution.MinScale, 1.0f);
+    ImGui::SliderFloat("Sharpness", &resolution.Sharpness, 0.0f, 1.0f);
+    ImGui::Text("Scale %.2f, GPU %.2f ms smoothed, %s", m_DynamicResolution->GetScale(),
+        m_DynamicResolution->GetSmoothedMilliseconds(),
+        DynamicResolution::GetStateName(m_DynamicResolution->GetState()));
+    const std::vector<float> &scales = m_DynamicResolution->GetScaleHistory();
+    const std::vector<float> &times = m_DynamicResolution->GetTimeHistory();
+    ImGui::PlotLines("Scale", scales.data(), (int) scales.size(), 0, nullptr, 0.0f, 1.0f);
+    ImGui::PlotLines("GPU ms", times.data(), (int) times.size(), 0, nullptr, 0.0f,
+        2.0f * resolution.TargetMilliseconds);
+
+    ImGui::Separator();
+    const FrameGraphStats &graphStats = m_FrameGraph.GetStats();
+    ImGui::Text("Frame graph: %u passes, %u culled, %u clears (%u dropped)", graphStats.Passes,
+        graphStats.CulledPasses, graphStats.Clears, graphStats.DroppedClears);
+    ImGui::Text("%u transients in %u textures, %.1f of %.1f MB", graphStats.Transients,
+        graphStats.Textures, graphStats.AllocatedBytes / (1024.0f * 1024.0f),
+        graphStats.RequestedBytes / (1024.0f * 1024.0f));
+    ImGui::Checkbox("Print frame graph", &m_PrintFrameGraph);
+    if (ImGui::TreeNode("Passes")) {
+        ImGui::TextUnformatted(m_FrameGraph.GetReport().c_str());
+        ImGui::TreePop();
+    }
+
+#ifdef JPH_DEBUG_RENDERER
+    ImGui::Separator();
+    if (ImGui::Checkbox("Draw physics", &m_DrawPhysics) && !m_DrawPhysics) {
+        // Nothing would flush the contacts the physics jobs keep adding
+        ContactConstraintManager::sDrawContactPoint = false;
+    }
+    if (m_DrawPhysics) {
+        ImGui::Checkbox("Shapes", &m_DrawSettings.mDrawShape);
+        ImGui::Checkbox("Wireframe", &m_DrawSettings.mDrawShapeWireframe);
+        ImGui::Checkbox("Bounding boxes", &m_DrawSettings.mDrawBoundingBox);
+        ImGui::Checkbox("Center of mass", &m_DrawSettings.mDrawCenterOfMassTransform);
+        ImGui::Checkbox("Velocity", &m_DrawSettings.mDrawVelocity);
+        if (m_DebugRenderer) {
+            ImGui::Checkbox("Contact points", &ContactConstraintManager::sDrawContactPoint);
+
+            const JoltDebugStats &stats = m_DebugRenderer->GetStats();
+            ImGui::Text("Debug draw took %.3f ms in %u draw calls", m_DebugDrawTime,
+                stats.DrawCalls);
+            ImGui::Text("%u instances of %u cached batches, %u culled", stats.Instances,
+                stats.CachedBatches, stats.FrustumCulled);
+            ImGui::Text("%u lines, %u triangles, %u dropped", stats.Lines, stats.Triangles,
+                stats.Dropped);
+        }
+    }
+#endif
 }
 
 void TestJolt::createStack(JPH::Vec3 transform, uint size, float halfExtent) {
@@ -1,8 +1,14 @@
 #pragma once
 
 #include "Camera.h"
+#include "CascadedShadowMap.h"
 #include "Cube.h"
+#include "DynamicResolution.h"
+#include "FrameGraph.h"
+#include "GpuTimer.h"
+#include "JoltDebugRenderer.h"
 #include "Shader.h"
+#include "StreamBuffer.h"
 #include "Test.h"
 
 // The Jolt headers don't include Jolt.h. Always include Jolt.h before including any other Jolt header.
@@ -173,15 +179,57 @@ public:
     void OnUpdate(float deltaTime) override;
     void OnRender() override;
     void OnImGuiRender() override;
+    bool OnSync() override;
 
 private:
     void createStack(JPH::Vec3 pos, unsigned int size, float halfExtent);
+    void drawBoxes();
+    void renderShadowMap(unsigned int offset, unsigned int count);
+    void renderShadowed(unsigned int offset, unsigned int count);
+    void setLightUniforms(Shader &shader);
+#ifdef JPH_DEBUG_RENDERER
+    void renderDebug();
+#endif
 
     Cube m_Cube;
     Camera m_Camera;
     glm::vec3 m_CameraPosition;
     std::unique_ptr<Shader> m_Shader;
 
+    // Box transforms as of the last OnSync, what OnRender draws while physics moves on
+    std::vector<glm::mat4> m_Transforms;
+
+    // Box transforms streamed every frame and drawn with one instanced call
+    std::unique_ptr<Shader> m_InstancedShader;
+    std::unique_ptr<StreamBuffer> m_Instances;
+    bool m_Instanced;
+
+    // The floor never moves, so it is the cached static caster of the shadow map
+    std::unique_ptr<CascadedShadowMap> m_ShadowMap;
+    std::unique_ptr<Shader> m_FloorShader;
+    std::unique_ptr<Shader> m_ShadowedShader;
+    std::unique_ptr<Shader> m_DepthShader;
+    std::unique_ptr<Shader> m_InstancedDepthShader;
+    glm::mat4 m_FloorModel;
+    glm::vec3 m_LightDirection;
+    bool m_Shadows;
+
+    // Shadows -> scene -> physics debug -> present, rebuilt every frame
+    FrameGraph m_FrameGraph;
+    // Writes each frame's pass list to stdout
+    bool m_PrintFrameGraph;
+    // Scene and debug passes render at a scale picked from the GPU time of the whole graph
+    std::unique_ptr<DynamicResolution> m_DynamicResolution;
+    GpuTimer m_FrameTimer;
+
+#ifdef JPH_DEBUG_RENDERER
+    // Created the first time physics drawing is switched on
+    std::unique_ptr<JoltDebugRenderer> m_DebugRenderer;
+    JPH::BodyManager::DrawSettings m_DrawSettings;
+    bool m_DrawPhysics;
+    float m_DebugDrawTime;
+#endif
+
     float m_PhysicsTime;
 
     JPH::BodyInterface *body_interface;
@@ -2,6 +2,7 @@
 
 #include "Macros.h"
 #include "Renderer.h"
+#include "TextureLoader.h"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <imgui.h>
@@ -14,9 +15,18 @@ namespace test {
         , m_RotationSpeed(0.0f)
         , m_CameraPosition(0, 0, 3)
         , m_LightPosition(1.2f, 1.0f, -2.0f)
-        , m_LightColor(0.2, 0.3, 0.5) {
+        , m_LightColor(0.2, 0.3, 0.5)
+        , m_Surface("res/shaders/Surface.shader")
+        , m_UseSurface(false)
+        , m_SurfaceLit(true)
+        , m_SurfaceTextured(false) {
 
         m_Shader = std::make_shared<Shader>("res/shaders/Lighting.shader");
+        m_Texture = TextureLoader::Acquire("res/textures/question.png");
+
+        // Kick off every variant the UI can select so the driver compiles them side by side
+        m_Surface.Prefetch({ ShaderFeature::None, ShaderFeature::Lit, ShaderFeature::Textured,
+            ShaderFeature::Lit | ShaderFeature::Textured });
     }
 
     TestLighting::~TestLighting() {
@@ -35,6 +45,27 @@ namespace test {
         GLCall(glDisable(GL_CULL_FACE));
 
         glm::mat4 mvp = m_Camera.GetViewProjectionMatrix() * m_Model;
+
+        unsigned int features = (m_SurfaceLit ? ShaderFeature::Lit : ShaderFeature::None)
+            | (m_SurfaceTextured ? ShaderFeature::Textured : ShaderFeature::None);
+        // Keep drawing with the hand written shader until the variant has finished compiling
+        if (m_UseSurface && m_Surface.IsReady(features)) {
+            Shader &shader = m_Surface.Get(features);
+            shader.Bind();
+            if (features & ShaderFeature::Lit) {
+                shader.SetUniformMat4f("u_Model", m_Model);
+                shader.SetUniform3f("u_LightPos", m_LightPosition.x, m_LightPosition.y, m_LightPosition.z);
+                shader.SetUniform3f("u_LightColor", m_LightColor.x, m_LightColor.y, m_LightColor.z);
+                shader.SetUniform3f("u_ViewPos", m_CameraPosition.x, m_CameraPosition.y, m_CameraPosition.z);
+            }
+            if (features & ShaderFeature::Textured) {
+                shader.SetUniform1i("u_Texture", 0);
+                m_Texture->Bind();
+            }
+            m_Cube.draw(mvp, &shader);
+            return;
+        }
+
         m_Shader->Bind();
         m_Shader->SetUniform3f("u_LightPos", m_LightPosition.x, m_LightPosition.y, m_LightPosition.z);
         m_Shader->SetUniform3f("u_LightColor", m_LightColor.x, m_LightColor.y, m_LightColor.z);
@@ -48,6 +79,12 @@ namespace test {
         ImGui::SliderFloat("Rotation Speed", &m_RotationSpeed, 0.0f, 20.0f);
         ImGui::SliderFloat3("Camera Position", &m_CameraPosition.x, -10.0f, 10.0f);
         ImGui::ColorPicker3("Light Color", &m_LightColor.x);
+        ImGui::Separator();
+        ImGui::Checkbox("Use Surface.shader", &m_UseSurface);
+        ImGui::Checkbox("Lit", &m_SurfaceLit);
+        ImGui::Checkbox("Textured", &m_SurfaceTextured);
+        ImGui::Text("Variants: %zu (parallel compile %s)", m_Surface.GetVariantCount(),
+            Shader::SupportsParallelCompile() ? "supported" : "unsupported");
     }
 
     void TestLighting::OnWindowResize(int width, int height) {
@@ -2,6 +2,7 @@
 
 #include "IndexBuffer.h"
 #include "Shader.h"
+#include "ShaderVariants.h"
 #include "Test.h"
 #include "Texture.h"
 #include "VertexArray.h"
@@ -36,5 +37,12 @@ namespace test {
 
 		glm::vec3 m_LightPosition;
 		glm::vec3 m_LightColor;
+
+		// Same effect built from Surface.shader, specialised at runtime
+		ShaderVariants m_Surface;
+		std::shared_ptr<Texture> m_Texture;
+		bool m_UseSurface;
+		bool m_SurfaceLit;
+		bool m_SurfaceTextured;
 	};
 }
\ No newline at end of file
@@ -6,17 +6,55 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <imgui.h>
 #include <iostream>
+#include <random>
 
 namespace test {
 
+namespace {
+
+const int c_PropCount = 4096;
+const int c_OccluderSegments = 64;
+
+}
+
 TestNoise::TestNoise() :
-    m_Terrain(511, 511) {
+    m_Terrain(511, 511)
+    , m_CameraPosition(0, 0, 1)
+    , m_OcclusionCulling(true)
+    , m_DrawnProps(0) {
     m_Camera.SetProjectionMatrix(
         glm::perspective(glm::radians(45.0f), 1280.0f / 720.0f, 0.1f, 100.0f));
-    m_Camera.SetLookAt(glm::vec3(0, 0, 1), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    m_Camera.SetLookAt(m_CameraPosition, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
     glm::mat4 scale = glm::scale(glm::mat4(1.0f), glm::vec3(0.75f, 0.75f, 0.1f));
     glm::mat4 rotate = glm::rotate(glm::mat4(1.0f), glm::radians(-45.0f), glm::vec3(1, 0, 0));
     m_Model = rotate * scale;
+
+    m_Terrain.GetOccluder(c_OccluderSegments, m_OccluderPositions, m_OccluderIndices);
+
+    // Thin posts standing on the terrain, bounds are precomputed in world space
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> coordinate(-0.5f, 0.5f);
+    for (int i = 0; i < c_PropCount; i++) {
+        float x = coordinate(random), y = coordinate(random);
+        float height = m_Terrain.GetHeight(x, y);
+        glm::mat4 local = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, height + 0.05f));
+        Prop prop;
+        prop.Model = m_Model * glm::scale(local, glm::vec3(0.008f, 0.008f, 0.1f));
+        prop.Min = glm::vec3(1e30f);
+        prop.Max = glm::vec3(-1e30f);
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec4 position = prop.Model
+                * glm::vec4((corner & 1) ? 0.5f : -0.5f, (corner & 2) ? 0.5f : -0.5f,
+                    (corner & 4) ? 0.5f : -0.5f, 1.0f);
+            prop.Min = glm::min(prop.Min, glm::vec3(position));
+            prop.Max = glm::max(prop.Max, glm::vec3(position));
+        }
+        m_Props.push_back(prop);
+    }
+
+    m_PropShader
+        = std::make_unique<Shader>("res/shaders/Surface.shader", ShaderFeature::Instanced);
+    m_Instances = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, c_PropCount * sizeof(glm::mat4));
 }
 
 TestNoise::~TestNoise() {
@@ -27,16 +65,57 @@ void TestNoise::OnUpdate(float deltaTime) {
 }
 
 void TestNoise::OnRender() {
-    GLCall(glEnable(GL_DEPTH_TEST));
-    GLCall(glDisable(GL_CULL_FACE));
+    Renderer renderer;
+    renderer.SetDepthTest(true);
+    renderer.SetBackFaceCulling(false);
+
+    glm::mat4 viewProj = m_Camera.GetViewProjectionMatrix();
+    m_Terrain.Render(viewProj * m_Model);
 
-    glm::mat4 mvp = m_Camera.GetViewProjectionMatrix() * m_Model;
-    m_Terrain.Render(mvp);
+    if (m_OcclusionCulling) {
+        m_Culler.BeginFrame(viewProj);
+        m_Culler.AddOccluder(m_OccluderPositions, m_OccluderIndices, m_Model);
+        m_Culler.Rasterize();
+    }
+
+    m_Instances->BeginFrame();
+    StreamAllocation instances = m_Instances->Allocate(m_Props.size() * sizeof(glm::mat4));
+    if (instances.Data) {
+        // Only props that pass the test are submitted at all
+        glm::mat4 *models = (glm::mat4 *) instances.Data;
+        m_DrawnProps = 0;
+        for (const Prop &prop : m_Props) {
+            if (!m_OcclusionCulling || m_Culler.IsVisible(prop.Min, prop.Max)) {
+                models[m_DrawnProps++] = prop.Model;
+            }
+        }
+        m_Instances->Commit();
+        if (m_DrawnProps > 0) {
+            m_Cube.drawInstanced(viewProj, *m_PropShader, *m_Instances, instances.Offset,
+                m_DrawnProps);
+        }
+    }
+    m_Instances->EndFrame();
 }
 
 void TestNoise::OnImGuiRender() {
     ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate,
         ImGui::GetIO().Framerate);
+    if (ImGui::SliderFloat3("Camera Position", &m_CameraPosition.x, -1.0f, 1.0f)) {
+        m_Camera.SetLookAt(m_CameraPosition, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    }
+
+    ImGui::Separator();
+    ImGui::Checkbox("Occlusion culling", &m_OcclusionCulling);
+    ImGui::Text("%u of %zu props drawn", m_DrawnProps, m_Props.size());
+    if (m_OcclusionCulling) {
+        const OcclusionStats &stats = m_Culler.GetStats();
+        ImGui::Text("Occluded: %u, outside frustum: %u", stats.Occluded, stats.FrustumCulled);
+        ImGui::Text("Occluder triangles: %u (%u rasterized) at %ux%u", stats.OccluderTriangles,
+            stats.RasterizedTriangles, m_Culler.GetWidth(), m_Culler.GetHeight());
+        ImGui::Text("Setup %.3f ms, raster %.3f ms, pyramid %.3f ms", stats.SetupTime,
+            stats.RasterTime, stats.PyramidTime);
+    }
 }
 
 }
\ No newline at end of file
@@ -1,9 +1,12 @@
 #pragma once
 
 #include "Camera.h"
+#include "Cube.h"
 #include "IndexBuffer.h"
+#include "OcclusionCuller.h"
 #include "Plane.h"
 #include "Shader.h"
+#include "StreamBuffer.h"
 #include "Test.h"
 #include "VertexArray.h"
 #include "VertexBuffer.h"
@@ -11,6 +14,7 @@
 
 #include <glm/glm.hpp>
 #include <memory>
+#include <vector>
 
 namespace test {
 
@@ -22,6 +26,10 @@ public:
     void OnUpdate(float deltaTime) override;
     void OnRender() override;
     void OnImGuiRender() override;
+    // OnUpdate changes nothing OnRender reads
+    bool OnSync() override {
+        return true;
+    }
 
 private:
     Terrain m_Terrain;
@@ -29,6 +37,24 @@ private:
     glm::mat4 m_Model;
 
     Camera m_Camera;
+    glm::vec3 m_CameraPosition;
+
+    // Props scattered over the terrain, tested against the terrain as occluder
+    struct Prop {
+        glm::mat4 Model;
+        glm::vec3 Min;
+        glm::vec3 Max;
+    };
+    std::vector<Prop> m_Props;
+    Cube m_Cube;
+    std::unique_ptr<Shader> m_PropShader;
+    std::unique_ptr<StreamBuffer> m_Instances;
+
+    OcclusionCuller m_Culler;
+    std::vector<glm::vec3> m_OccluderPositions;
+    std::vector<unsigned int> m_OccluderIndices;
+    bool m_OcclusionCulling;
+    unsigned int m_DrawnProps;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "TestParticles.h"
+
+#include "Macros.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <glm/gtc/matrix_transform.hpp>
+#include <imgui.h>
+
+namespace test {
+
+namespace {
+
+const float c_FieldSize = 60.0f;
+const float c_CameraDistance = 35.0f;
+
+}
+
+TestParticles::TestParticles()
+    : m_Floor(1, 1)
+    , m_CameraAngle(0.0f)
+    , m_Orbit(true)
+    , m_Dust(nullptr)
+    , m_ImpactTimer(0.0f)
+    , m_ImpactInterval(0.5f)
+    , m_ImpactSeed(12345)
+    , m_BudgetMilliseconds(4.0f)
+    , m_View(1.0f)
+    , m_Proj(1.0f) {
+    m_Camera.SetNearPlane(0.1f);
+    m_Camera.SetFarPlane(200.0f);
+
+    // About 200000 per second for 5 seconds, a million in the air once it has settled
+    ParticleEmitterSettings snow;
+    snow.MaxParticles = 1000000;
+    snow.Rate = 200000.0f;
+    snow.Position = glm::vec3(0.0f, 25.0f, 0.0f);
+    snow.Extent = glm::vec3(c_FieldSize * 0.5f, 0.0f, c_FieldSize * 0.5f);
+    snow.Velocity = glm::vec3(1.0f, -5.0f, 0.0f);
+    snow.VelocityJitter = glm::vec3(0.5f, 0.5f, 0.5f);
+    snow.Lifetime = 5.0f;
+    snow.LifetimeJitter = 0.2f;
+    snow.Acceleration = glm::vec3(0.0f);
+    snow.Ground = 0.0f;
+    snow.Restitution = 0.0f;
+    snow.StartSize = snow.EndSize = 0.08f;
+    snow.StartColor = glm::vec4(1.0f, 1.0f, 1.0f, 0.6f);
+    snow.EndColor = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+    snow.Blend = ParticleBlend::Additive;
+    m_Particles.AddEmitter("Snow", snow);
+
+    ParticleEmitterSettings exhaust;
+    exhaust.MaxParticles = 20000;
+    exhaust.Rate = 4000.0f;
+    exhaust.Position = glm::vec3(0.0f, 0.4f, 0.0f);
+    exhaust.Extent = glm::vec3(0.05f);
+    exhaust.Velocity = glm::vec3(0.0f, 0.3f, -4.0f);
+    exhaust.VelocityJitter = glm::vec3(0.4f, 0.3f, 0.4f);
+    exhaust.Lifetime = 2.0f;
+    exhaust.LifetimeJitter = 0.5f;
+    exhaust.Acceleration = glm::vec3(0.0f, 0.8f, 0.0f);
+    exhaust.Drag = 1.5f;
+    exhaust.StartSize = 0.15f;
+    exhaust.EndSize = 1.5f;
+    exhaust.StartColor = glm::vec4(0.3f, 0.3f, 0.3f, 0.6f);
+    exhaust.EndColor = glm::vec4(0.6f, 0.6f, 0.6f, 0.0f);
+    exhaust.Blend = ParticleBlend::Alpha;
+    m_Particles.AddEmitter("Exhaust", exhaust);
+
+    ParticleEmitterSettings dust;
+    dust.MaxParticles = 100000;
+    dust.Rate = 0.0f;
+    dust.Extent = glm::vec3(0.3f, 0.0f, 0.3f);
+    dust.Velocity = glm::vec3(0.0f, 2.0f, 0.0f);
+    dust.VelocityJitter = glm::vec3(3.0f, 1.5f, 3.0f);
+    dust.Lifetime = 2.5f;
+    dust.LifetimeJitter = 0.8f;
+    dust.Drag = 0.8f;
+    dust.Ground = 0.0f;
+    dust.Restitution = 0.2f;
+    dust.StartSize = 0.1f;
+    dust.EndSize = 0.6f;
+    dust.StartColor = glm::vec4(0.55f, 0.45f, 0.3f, 0.8f);
+    dust.EndColor = glm::vec4(0.6f, 0.5f, 0.35f, 0.0f);
+    dust.Blend = ParticleBlend::Alpha;
+    m_Dust = &m_Particles.AddEmitter("Dust", dust);
+}
+
+TestParticles::~TestParticles() {
+}
+
+void TestParticles::OnUpdate(float deltaTime) {
+    // A long frame would otherwise spawn a whole second of snow at once
+    deltaTime = std::min(deltaTime, 0.1f);
+
+    if (m_Orbit) {
+        m_CameraAngle += deltaTime * 0.1f;
+    }
+    glm::vec3 cameraPosition(glm::sin(m_CameraAngle) * c_CameraDistance, 10.0f,
+        glm::cos(m_CameraAngle) * c_CameraDistance);
+    m_Camera.SetLookAt(cameraPosition, glm::vec3(0.0f, 3.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    // Stand-ins for physics impacts, somewhere on the field every m_ImpactInterval
+    m_ImpactTimer += deltaTime;
+    while (m_ImpactInterval > 0.0f && m_ImpactTimer >= m_ImpactInterval) {
+        m_ImpactTimer -= m_ImpactInterval;
+        auto random = [this]() {
+            m_ImpactSeed = m_ImpactSeed * 1664525u + 1013904223u;
+            return (m_ImpactSeed >> 8) * (1.0f / 16777216.0f) - 0.5f;
+        };
+        float x = random() * c_FieldSize * 0.8f;
+        float z = random() * c_FieldSize * 0.8f;
+        m_Dust->Burst(glm::vec3(x, 0.0f, z), 3000);
+    }
+
+    m_Particles.Update(deltaTime, cameraPosition);
+}
+
+bool TestParticles::OnSync() {
+    m_Particles.Publish();
+    m_View = m_Camera.GetViewMatrix();
+    m_Proj = m_Camera.GetProjectionMatrix();
+    return true;
+}
+
+void TestParticles::OnRender() {
+    GLCall(glEnable(GL_DEPTH_TEST));
+    GLCall(glDisable(GL_CULL_FACE));
+
+    glm::mat4 floor = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1, 0, 0));
+    floor = glm::scale(floor, glm::vec3(c_FieldSize));
+    m_Floor.Render(m_Proj * m_View * floor);
+
+    m_Particles.Draw(m_View, m_Proj);
+}
+
+void TestParticles::OnImGuiRender() {
+    ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate,
+        ImGui::GetIO().Framerate);
+    ImGui::Checkbox("Orbit camera", &m_Orbit);
+
+    const ParticleSystemStats &stats = m_Particles.GetStats();
+    char label[64];
+    snprintf(label, sizeof(label), "%u / %u particles", stats.Alive, stats.Capacity);
+    ImGui::ProgressBar((float) stats.Alive / std::max(stats.Capacity, 1u), ImVec2(-1.0f, 0.0f),
+        label);
+    ImGui::SliderFloat("Budget (ms)", &m_BudgetMilliseconds, 0.5f, 16.0f);
+    snprintf(label, sizeof(label), "Update %.2f / %.2f ms", stats.UpdateTime, m_BudgetMilliseconds);
+    ImGui::ProgressBar(
+        std::min(stats.UpdateTime / m_BudgetMilliseconds, 1.0f), ImVec2(-1.0f, 0.0f), label);
+    if (stats.UpdateTime > m_BudgetMilliseconds) {
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.2f, 1.0f), "Over budget");
+    }
+    ImGui::Text("Upload %.2f ms on the render thread, %u draws", stats.UploadTime, stats.Draws);
+
+    ImGui::SliderFloat("Impact interval (s)", &m_ImpactInterval, 0.0f, 2.0f);
+    if (ImGui::Button("Impact")) {
+        m_Dust->Burst(glm::vec3(0.0f), 10000);
+    }
+
+    for (const auto &emitter : m_Particles.GetEmitters()) {
+        ImGui::PushID(emitter.get());
+        if (ImGui::CollapsingHeader(emitter->GetName().c_str())) {
+            ParticleEmitterSettings &settings = emitter->GetSettings();
+            const ParticleStats &emitterStats = emitter->GetStats();
+            bool enabled = emitter->IsEnabled();
+            if (ImGui::Checkbox("Enabled", &enabled)) {
+                emitter->SetEnabled(enabled);
+            }
+            ImGui::SliderFloat("Rate", &settings.Rate, 0.0f, 500000.0f, "%.0f /s");
+            ImGui::SliderFloat("Lifetime", &settings.Lifetime, 0.1f, 10.0f);
+            ImGui::Text("%u / %u alive, %u born, %u died, %u dropped", emitterStats.Alive,
+                settings.MaxParticles, emitterStats.Emitted, emitterStats.Died,
+                emitterStats.Dropped);
+            ImGui::Text("Simulate %.2f ms, sort %.2f ms (%s)", emitterStats.SimulateTime,
+                emitterStats.SortTime,
+                settings.Blend == ParticleBlend::Alpha ? "alpha, sorted" : "additive");
+        }
+        ImGui::PopID();
+    }
+}
+
+}
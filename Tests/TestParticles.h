@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Camera.h"
+#include "ParticleSystem.h"
+#include "Plane.h"
+#include "Test.h"
+
+#include <glm/glm.hpp>
+
+namespace test {
+
+// Snow over a field, exhaust smoke and bursts of dust from impacts, up to about a million
+// particles simulated on the worker threads
+class TestParticles : public Test {
+public:
+    TestParticles();
+    ~TestParticles();
+
+    void OnUpdate(float deltaTime) override;
+    void OnRender() override;
+    void OnImGuiRender() override;
+    bool OnSync() override;
+
+private:
+    Plane m_Floor;
+    Camera m_Camera;
+    float m_CameraAngle;
+    bool m_Orbit;
+
+    ParticleSystem m_Particles;
+    ParticleEmitter *m_Dust;
+    float m_ImpactTimer;
+    float m_ImpactInterval;
+    uint32_t m_ImpactSeed;
+
+    // CPU time the particle update may take, shown against the measured time
+    float m_BudgetMilliseconds;
+
+    // Camera as of the last OnSync, what OnRender draws with
+    glm::mat4 m_View;
+    glm::mat4 m_Proj;
+};
+
+}
@@ -5,6 +5,7 @@
 #include "Renderer.h"
 #include "Shader.h"
 #include "Texture.h"
+#include "TextureLoader.h"
 #include "VertexArray.h"
 #include "VertexBuffer.h"
 #include "VertexBufferLayout.h"
@@ -41,7 +42,7 @@ TestTexture2D::TestTexture2D()
     m_View = glm::translate(glm::mat4(1.0f), glm::vec3(0, 0, 0));
     m_Shader = std::make_unique<Shader>("res/shaders/BasicTexture.shader");
     m_Shader->Bind();
-    m_Texture = std::make_unique<Texture>("res/textures/sudou.jpg");
+    m_Texture = TextureLoader::Acquire("res/textures/sudou.jpg");
 
     m_Shader->SetUniform1i("u_Texture", 0);
 
@@ -21,13 +21,17 @@ public:
     void OnUpdate(float deltaTime) override;
     void OnRender() override;
     void OnImGuiRender() override;
+    // OnUpdate changes nothing OnRender reads
+    bool OnSync() override {
+        return true;
+    }
 
 private:
     std::unique_ptr<VertexArray> m_VAO;
     std::unique_ptr<VertexBuffer> m_VBO;
     std::unique_ptr<IndexBuffer> m_IBO;
     std::unique_ptr<Shader> m_Shader;
-    std::unique_ptr<Texture> m_Texture;
+    std::shared_ptr<Texture> m_Texture;
 
     glm::mat4 m_Proj;
     glm::mat4 m_View;
@@ -2,63 +2,126 @@
 
 #include "stb_image.h"
 
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
 Texture::Texture(const std::string &path)
     : m_RendererID(0)
     , m_FilePath(path)
-    , m_LocalBuffer(nullptr)
     , m_Width(0)
     , m_Height(0)
-    , m_BPP(0) {
-
-    stbi_set_flip_vertically_on_load(1);
-    m_LocalBuffer = stbi_load(path.c_str(), &m_Width, &m_Height, &m_BPP, 4);
-
-    GLCall(glGenTextures(1, &m_RendererID));
-    GLCall(glBindTexture(GL_TEXTURE_2D, m_RendererID));
-
-    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
-    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
-    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
-
-    GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_Width, m_Height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-        m_LocalBuffer));
-    GLCall(glBindTexture(GL_TEXTURE_2D, 0));
-
-    if (m_LocalBuffer) {
-        stbi_image_free(m_LocalBuffer);
-    }
+    , m_BPP(4)
+    , m_Encoding(TextureEncoding::RGBA8)
+    , m_LevelCount(0)
+    , m_MemorySize(0)
+    , m_Ready(true) {
+    std::ifstream stream(path, std::ios::binary);
+    std::vector<unsigned char> data(
+        (std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    Load(data.data(), data.size());
 }
 
 Texture::Texture(unsigned char *data, unsigned int size)
     : m_RendererID(0)
     , m_FilePath("")
-    , m_LocalBuffer(nullptr)
     , m_Width(0)
     , m_Height(0)
-    , m_BPP(0) {
-    stbi_set_flip_vertically_on_load(1);
-    m_LocalBuffer = stbi_load_from_memory(data, size, &m_Width, &m_Height, &m_BPP, 4);
+    , m_BPP(4)
+    , m_Encoding(TextureEncoding::RGBA8)
+    , m_LevelCount(0)
+    , m_MemorySize(0)
+    , m_Ready(true) {
+    Load(data, size);
+}
 
-    GLCall(glGenTextures(1, &m_RendererID));
-    GLCall(glBindTexture(GL_TEXTURE_2D, m_RendererID));
+Texture::Texture(const std::string &name, unsigned int placeholder)
+    : m_RendererID(placeholder)
+    , m_FilePath(name)
+    , m_Width(0)
+    , m_Height(0)
+    , m_BPP(4)
+    , m_Encoding(TextureEncoding::RGBA8)
+    , m_LevelCount(0)
+    , m_MemorySize(0)
+    , m_Ready(false) {
+}
+
+void Texture::Load(const unsigned char *data, size_t size) {
+    // Mipmapped and block compressed, straight from res/cache/textures after the first time
+    CookedTexture cooked;
+    if (!TextureCooker::Cook(data, size, GLEW_EXT_texture_compression_s3tc, cooked)) {
+        std::cerr << "Could not load texture " << m_FilePath << ": " << stbi_failure_reason()
+                  << std::endl;
+    }
+    m_RendererID = Create(cooked, true);
+    if (!cooked.Levels.empty()) {
+        m_Width = (int) cooked.Levels[0].Width;
+        m_Height = (int) cooked.Levels[0].Height;
+    }
+    m_Encoding = cooked.Encoding;
+    m_LevelCount = (unsigned int) cooked.Levels.size();
+    m_MemorySize = cooked.Data.size();
+}
+
+void Texture::Finish(unsigned int rendererID, const CookedTexture &cooked) {
+    m_RendererID = rendererID;
+    m_Width = (int) cooked.Levels[0].Width;
+    m_Height = (int) cooked.Levels[0].Height;
+    m_Encoding = cooked.Encoding;
+    m_LevelCount = (unsigned int) cooked.Levels.size();
+    const CookedLevel &last = cooked.Levels.back();
+    m_MemorySize = last.Offset + last.Size;
+    m_Ready = true;
+}
+
+unsigned int Texture::GetInternalFormat(TextureEncoding encoding) {
+    switch (encoding) {
+    case TextureEncoding::BC1:
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case TextureEncoding::BC3:
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    default:
+        return GL_RGBA8;
+    }
+}
 
-    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+unsigned int Texture::Create(const CookedTexture &cooked, bool withData) {
+    unsigned int texture;
+    GLCall(glGenTextures(1, &texture));
+    GLCall(glBindTexture(GL_TEXTURE_2D, texture));
+
+    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+        cooked.Levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR));
     GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
     GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
     GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+        std::max((int) cooked.Levels.size() - 1, 0)));
 
-    GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_Width, m_Height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-        m_LocalBuffer));
-    GLCall(glBindTexture(GL_TEXTURE_2D, 0));
-
-    if (m_LocalBuffer) {
-        stbi_image_free(m_LocalBuffer);
+    unsigned int format = GetInternalFormat(cooked.Encoding);
+    for (unsigned int i = 0; i < cooked.Levels.size(); i++) {
+        const CookedLevel &level = cooked.Levels[i];
+        const void *data = withData ? cooked.Data.data() + level.Offset : nullptr;
+        if (cooked.Encoding == TextureEncoding::RGBA8) {
+            GLCall(glTexImage2D(GL_TEXTURE_2D, i, format, level.Width, level.Height, 0, GL_RGBA,
+                GL_UNSIGNED_BYTE, data));
+        } else {
+            GLCall(glCompressedTexImage2D(GL_TEXTURE_2D, i, format, level.Width, level.Height, 0,
+                (GLsizei) level.Size, data));
+        }
     }
+    GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+    return texture;
 }
 
 Texture::~Texture() {
-    GLCall(glDeleteTextures(1, &m_RendererID));
+    // The placeholder belongs to the loader
+    if (m_Ready) {
+        GLCall(glDeleteTextures(1, &m_RendererID));
+    }
 }
 
 void Texture::Bind(unsigned int slot /* = 0*/) const {
@@ -68,4 +131,4 @@ void Texture::Bind(unsigned int slot /* = 0*/) const {
 
 void Texture::UnBind() {
     GLCall(glBindTexture(GL_TEXTURE_2D, 0));
-}
\ No newline at end of file
+}
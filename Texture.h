@@ -1,14 +1,28 @@
 #pragma once
 
 #include "Renderer.h"
+#include "TextureCooker.h"
 
 class Texture {
 
 private:
     unsigned int m_RendererID;
     std::string m_FilePath;
-    unsigned char *m_LocalBuffer;
     int m_Width, m_Height, m_BPP;
+    TextureEncoding m_Encoding;
+    unsigned int m_LevelCount;
+    // Every mip level as stored on the GPU
+    size_t m_MemorySize;
+    // False while a TextureLoader is still working on it, m_RendererID is its placeholder then
+    bool m_Ready;
+
+    friend class TextureLoader;
+    Texture(const std::string &name, unsigned int placeholder);
+    void Finish(unsigned int rendererID, const CookedTexture &cooked);
+
+    void Load(const unsigned char *data, size_t size);
+    // Creates the texture with storage for every level of cooked, filled when withData is set
+    static unsigned int Create(const CookedTexture &cooked, bool withData);
 
 public:
     Texture(const std::string &path);
@@ -18,10 +32,28 @@ public:
     void Bind(unsigned int slot = 0) const;
     void UnBind();
 
+    static unsigned int GetInternalFormat(TextureEncoding encoding);
+
+    inline unsigned int GetRendererID() const {
+        return m_RendererID;
+    }
     inline int GetWidth() const {
         return m_Width;
     }
     inline int GetHeight() const {
         return m_Height;
     }
+    inline TextureEncoding GetEncoding() const {
+        return m_Encoding;
+    }
+    inline unsigned int GetLevelCount() const {
+        return m_LevelCount;
+    }
+    inline size_t GetMemorySize() const {
+        return m_MemorySize;
+    }
+    // Synchronously loaded textures are always ready
+    inline bool IsReady() const {
+        return m_Ready;
+    }
 };
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "TextureArrays.h"
+
+#include "Renderer.h"
+
+#include <algorithm>
+#include <chrono>
+
+TextureArrays::TextureArrays()
+    : m_Built(false) {
+}
+
+TextureArrays::~TextureArrays() {
+    for (const Array &array : m_Arrays) {
+        GLCall(glDeleteTextures(1, &array.RendererID));
+    }
+}
+
+unsigned int TextureArrays::Add(const std::shared_ptr<Texture> &texture) {
+    auto found = std::find(m_Textures.begin(), m_Textures.end(), texture);
+    if (found != m_Textures.end()) {
+        return (unsigned int) (found - m_Textures.begin());
+    }
+    m_Textures.push_back(texture);
+    return (unsigned int) m_Textures.size() - 1;
+}
+
+bool TextureArrays::Build() {
+    if (m_Built) {
+        return true;
+    }
+    for (const auto &texture : m_Textures) {
+        if (!texture->IsReady()) {
+            return false;
+        }
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+
+    int maxLayers = 256;
+    GLCall(glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers));
+
+    // Group first, the arrays are allocated with their final layer count
+    m_Layers.resize(m_Textures.size());
+    for (unsigned int i = 0; i < m_Textures.size(); i++) {
+        const Texture &texture = *m_Textures[i];
+        auto group = std::find_if(m_Arrays.begin(), m_Arrays.end(), [&](const Array &array) {
+            return array.Encoding == texture.GetEncoding() && array.Width == texture.GetWidth()
+                && array.Height == texture.GetHeight()
+                && array.LevelCount == texture.GetLevelCount()
+                && array.LayerCount < (unsigned int) maxLayers;
+        });
+        if (group == m_Arrays.end()) {
+            m_Arrays.push_back({ 0, texture.GetEncoding(), texture.GetWidth(), texture.GetHeight(),
+                texture.GetLevelCount(), 0 });
+            group = m_Arrays.end() - 1;
+        }
+        m_Layers[i] = { (unsigned int) (group - m_Arrays.begin()), group->LayerCount++ };
+    }
+
+    for (Array &array : m_Arrays) {
+        GLCall(glGenTextures(1, &array.RendererID));
+        GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, array.RendererID));
+        GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+            array.LevelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR));
+        GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+        GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+        GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+        GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL,
+            std::max((int) array.LevelCount - 1, 0)));
+
+        unsigned int format = Texture::GetInternalFormat(array.Encoding);
+        int width = array.Width, height = array.Height;
+        for (unsigned int level = 0; level < array.LevelCount; level++) {
+            if (array.Encoding == TextureEncoding::RGBA8) {
+                GLCall(glTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, width, height,
+                    array.LayerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+            } else {
+                GLsizei size = (GLsizei) (TextureCooker::GetLevelSize(array.Encoding, width, height)
+                    * array.LayerCount);
+                GLCall(glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, width, height,
+                    array.LayerCount, 0, size, nullptr));
+            }
+            width = std::max(width / 2, 1);
+            height = std::max(height / 2, 1);
+        }
+    }
+
+    m_Stats.CopyImage = GLEW_ARB_copy_image;
+    std::vector<unsigned char> scratch;
+    for (unsigned int i = 0; i < m_Textures.size(); i++) {
+        const TextureLayer &layer = m_Layers[i];
+        CopyLayer(*m_Textures[i], m_Arrays[layer.Array], layer.Layer, scratch);
+        m_Stats.CopiedBytes += m_Textures[i]->GetMemorySize();
+    }
+    GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, 0));
+    GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+
+    m_Stats.Textures = (unsigned int) m_Textures.size();
+    m_Stats.Arrays = (unsigned int) m_Arrays.size();
+    m_Textures.clear();
+    m_Built = true;
+    m_Stats.BuildMilliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::high_resolution_clock::now() - start)
+                                    .count();
+    return true;
+}
+
+void TextureArrays::CopyLayer(const Texture &texture, const Array &array, unsigned int layer,
+    std::vector<unsigned char> &scratch) {
+    int width = array.Width, height = array.Height;
+    for (unsigned int level = 0; level < array.LevelCount; level++) {
+        if (m_Stats.CopyImage) {
+            // Whole levels, so compressed levels smaller than a block are fine too
+            GLCall(glCopyImageSubData(texture.GetRendererID(), GL_TEXTURE_2D, level, 0, 0, 0,
+                array.RendererID, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1));
+        } else {
+            scratch.resize(TextureCooker::GetLevelSize(array.Encoding, width, height));
+            GLCall(glBindTexture(GL_TEXTURE_2D, texture.GetRendererID()));
+            GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, array.RendererID));
+            if (array.Encoding == TextureEncoding::RGBA8) {
+                GLCall(glGetTexImage(
+                    GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, scratch.data()));
+                GLCall(glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1,
+                    GL_RGBA, GL_UNSIGNED_BYTE, scratch.data()));
+            } else {
+                GLCall(glGetCompressedTexImage(GL_TEXTURE_2D, level, scratch.data()));
+                GLCall(glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width,
+                    height, 1, Texture::GetInternalFormat(array.Encoding),
+                    (GLsizei) scratch.size(), scratch.data()));
+            }
+        }
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+}
+
+void TextureArrays::Bind(unsigned int array, unsigned int slot) const {
+    GLCall(glActiveTexture(GL_TEXTURE0 + slot));
+    GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, m_Arrays[array].RendererID));
+}
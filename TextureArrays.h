@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Texture.h"
+
+#include <memory>
+#include <vector>
+
+// Where an added texture ended up
+struct TextureLayer {
+    unsigned int Array;
+    unsigned int Layer;
+};
+
+struct TextureArraysStats {
+    unsigned int Textures = 0;
+    unsigned int Arrays = 0;
+    size_t CopiedBytes = 0;
+    float BuildMilliseconds = 0.0f;
+    // Copied on the GPU with ARB_copy_image, or read back and uploaded again
+    bool CopyImage = false;
+};
+
+// Collects textures and, once all of them are loaded, copies the ones with the same encoding,
+// size and mip count into the layers of one GL_TEXTURE_2D_ARRAY. Materials then refer to a
+// layer, and everything sampling from the same array needs a single bind. The textures are
+// released after the copy.
+class TextureArrays {
+public:
+    TextureArrays();
+    ~TextureArrays();
+
+    // Returns the index for GetLayer, adding the same texture twice gives the same index
+    unsigned int Add(const std::shared_ptr<Texture> &texture);
+    // Render thread. Does nothing until every added texture is ready, true once built.
+    bool Build();
+
+    inline bool IsBuilt() const {
+        return m_Built;
+    }
+    inline const TextureLayer &GetLayer(unsigned int index) const {
+        return m_Layers[index];
+    }
+    inline unsigned int GetArrayCount() const {
+        return (unsigned int) m_Arrays.size();
+    }
+    void Bind(unsigned int array, unsigned int slot = 0) const;
+
+    inline const TextureArraysStats &GetStats() const {
+        return m_Stats;
+    }
+
+private:
+    struct Array {
+        unsigned int RendererID;
+        TextureEncoding Encoding;
+        int Width;
+        int Height;
+        unsigned int LevelCount;
+        unsigned int LayerCount;
+    };
+
+    void CopyLayer(const Texture &texture, const Array &array, unsigned int layer,
+        std::vector<unsigned char> &scratch);
+
+    std::vector<std::shared_ptr<Texture>> m_Textures;
+    std::vector<TextureLayer> m_Layers;
+    std::vector<Array> m_Arrays;
+    bool m_Built;
+    TextureArraysStats m_Stats;
+};
@@ -0,0 +1,499 @@
+#include "TextureCooker.h"
+
+#include "ResourceCache.h"
+#include "ThreadPool.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+const char *c_CacheDirectory = "res/cache/textures";
+const uint32_t c_Magic = 0x58545053; // "SPTX"
+// Bump when the filter or the encoders change, old entries then simply miss
+const uint32_t c_Version = 1;
+
+struct CacheHeader {
+    uint32_t Magic;
+    uint32_t Version;
+    uint64_t Key;
+    uint32_t Encoding;
+    uint32_t LevelCount;
+    uint64_t DataSize;
+};
+
+float Milliseconds(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::high_resolution_clock::now() - start)
+        .count();
+}
+
+std::string GetCachePath(uint64_t key) {
+    std::stringstream ss;
+    ss << c_CacheDirectory << "/" << std::hex << std::setw(16) << std::setfill('0') << key
+       << ".tex";
+    return ss.str();
+}
+
+bool LoadCache(const std::string &path, uint64_t key, CookedTexture &texture) {
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        return false;
+    }
+
+    CacheHeader header;
+    if (!stream.read((char *) &header, sizeof(header)) || header.Magic != c_Magic
+        || header.Version != c_Version || header.Key != key
+        || header.Encoding > (uint32_t) TextureEncoding::BC3 || header.LevelCount == 0
+        || header.LevelCount > 32) {
+        return false;
+    }
+
+    texture.Encoding = (TextureEncoding) header.Encoding;
+    texture.Levels.resize(header.LevelCount);
+    texture.Data.resize(header.DataSize);
+    if (!stream.read((char *) texture.Levels.data(), texture.Levels.size() * sizeof(CookedLevel))
+        || !stream.read((char *) texture.Data.data(), texture.Data.size())) {
+        return false;
+    }
+    for (const CookedLevel &level : texture.Levels) {
+        if (level.Offset + level.Size > header.DataSize
+            || level.Size
+                != TextureCooker::GetLevelSize(texture.Encoding, level.Width, level.Height)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void StoreCache(const std::string &path, uint64_t key, const CookedTexture &texture) {
+    std::error_code error;
+    std::filesystem::create_directories(c_CacheDirectory, error);
+
+    // Two workers can cook the same image, each writes its own temporary file
+    std::stringstream tempPath;
+    tempPath << path << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+    {
+        std::ofstream stream(tempPath.str(), std::ios::binary | std::ios::trunc);
+        if (!stream) {
+            return;
+        }
+        CacheHeader header = { c_Magic, c_Version, key, (uint32_t) texture.Encoding,
+            (uint32_t) texture.Levels.size(), texture.Data.size() };
+        stream.write((const char *) &header, sizeof(header));
+        stream.write(
+            (const char *) texture.Levels.data(), texture.Levels.size() * sizeof(CookedLevel));
+        stream.write((const char *) texture.Data.data(), texture.Data.size());
+        if (!stream) {
+            return;
+        }
+    }
+    std::filesystem::rename(tempPath.str(), path, error);
+}
+
+// Textures are stored as sRGB colors, filtering has to happen on the light they stand for
+const float *GetLinearTable() {
+    static const std::vector<float> table = []() {
+        std::vector<float> values(256);
+        for (int i = 0; i < 256; i++) {
+            float c = i / 255.0f;
+            values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return values;
+    }();
+    return table.data();
+}
+
+const unsigned char *GetSrgbTable() {
+    static const std::vector<unsigned char> table = []() {
+        std::vector<unsigned char> values(4096);
+        for (int i = 0; i < 4096; i++) {
+            float c = i / 4095.0f;
+            c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+            values[i] = (unsigned char) (std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+        }
+        return values;
+    }();
+    return table.data();
+}
+
+// Copies the 4x4 block at (bx, by), repeating the last row and column past the edges
+void LoadBlock(const unsigned char *rgba, int width, int height, int bx, int by,
+    unsigned char *block) {
+    for (int y = 0; y < 4; y++) {
+        int sy = std::min(by * 4 + y, height - 1);
+        for (int x = 0; x < 4; x++) {
+            int sx = std::min(bx * 4 + x, width - 1);
+            std::memcpy(block + (y * 4 + x) * 4, rgba + ((size_t) sy * width + sx) * 4, 4);
+        }
+    }
+}
+
+uint16_t Quantize565(const float *color) {
+    auto channel = [](float value, int max) {
+        return (uint16_t) std::min(std::max((int) (value * max / 255.0f + 0.5f), 0), max);
+    };
+    return (uint16_t) (channel(color[0], 31) << 11 | channel(color[1], 63) << 5
+        | channel(color[2], 31));
+}
+
+void Expand565(uint16_t color, float *out) {
+    int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+    out[0] = (float) (r << 3 | r >> 2);
+    out[1] = (float) (g << 2 | g >> 4);
+    out[2] = (float) (b << 3 | b >> 2);
+}
+
+// Picks the nearest of the four palette colors for every pixel, returns the squared error
+float FitIndices(const float (*colors)[3], uint16_t &c0, uint16_t &c1, uint32_t &indices) {
+    // The larger endpoint first selects the four color mode, which BC1 and BC3 share
+    if (c0 < c1) {
+        std::swap(c0, c1);
+    }
+    float palette[4][3];
+    Expand565(c0, palette[0]);
+    Expand565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+    // Equal endpoints would decode as the three color mode in BC1, index 0 is right in both
+    int options = c0 == c1 ? 1 : 4;
+
+    float error = 0.0f;
+    indices = 0;
+    for (int i = 0; i < 16; i++) {
+        float best = 1e30f;
+        uint32_t index = 0;
+        for (int p = 0; p < options; p++) {
+            float d = 0.0f;
+            for (int c = 0; c < 3; c++) {
+                float delta = colors[i][c] - palette[p][c];
+                d += delta * delta;
+            }
+            if (d < best) {
+                best = d;
+                index = p;
+            }
+        }
+        indices |= index << (2 * i);
+        error += best;
+    }
+    return error;
+}
+
+// Endpoints along the principal axis of the colors, then least squares refinement against
+// the chosen indices while that lowers the error
+void EncodeColorBlock(const unsigned char *block, unsigned char *out) {
+    float colors[16][3];
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+            colors[i][c] = block[i * 4 + c];
+            mean[c] += colors[i][c] / 16.0f;
+        }
+    }
+
+    float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++) {
+        float r = colors[i][0] - mean[0], g = colors[i][1] - mean[1], b = colors[i][2] - mean[2];
+        covariance[0] += r * r;
+        covariance[1] += r * g;
+        covariance[2] += r * b;
+        covariance[3] += g * g;
+        covariance[4] += g * b;
+        covariance[5] += b * b;
+    }
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[3] = {
+            covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+            covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+            covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2],
+        };
+        float length = std::max(std::abs(next[0]), std::max(std::abs(next[1]), std::abs(next[2])));
+        if (length < 1e-6f) {
+            break;
+        }
+        for (int c = 0; c < 3; c++) {
+            axis[c] = next[c] / length;
+        }
+    }
+    float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    for (int c = 0; c < 3; c++) {
+        axis[c] /= length;
+    }
+
+    float lo = 1e30f, hi = -1e30f;
+    for (int i = 0; i < 16; i++) {
+        float t = (colors[i][0] - mean[0]) * axis[0] + (colors[i][1] - mean[1]) * axis[1]
+            + (colors[i][2] - mean[2]) * axis[2];
+        lo = std::min(lo, t);
+        hi = std::max(hi, t);
+    }
+    // Insetting by a sixteenth of the range keeps the outliers from stretching the palette
+    float inset = (hi - lo) / 16.0f;
+    float end0[3], end1[3];
+    for (int c = 0; c < 3; c++) {
+        end0[c] = mean[c] + axis[c] * (hi - inset);
+        end1[c] = mean[c] + axis[c] * (lo + inset);
+    }
+
+    uint16_t c0 = Quantize565(end0), c1 = Quantize565(end1);
+    uint32_t indices;
+    float error = FitIndices(colors, c0, c1, indices);
+
+    static const float c_Weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+    for (int iteration = 0; iteration < 2 && error > 0.0f; iteration++) {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; i++) {
+            float a = c_Weights[(indices >> (2 * i)) & 3], b = 1.0f - a;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int c = 0; c < 3; c++) {
+                ax[c] += a * colors[i][c];
+                bx[c] += b * colors[i][c];
+            }
+        }
+        float determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) < 1e-6f) {
+            break;
+        }
+        for (int c = 0; c < 3; c++) {
+            end0[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+            end1[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+        }
+        uint16_t r0 = Quantize565(end0), r1 = Quantize565(end1);
+        uint32_t refined;
+        float refinedError = FitIndices(colors, r0, r1, refined);
+        if (refinedError >= error) {
+            break;
+        }
+        c0 = r0;
+        c1 = r1;
+        indices = refined;
+        error = refinedError;
+    }
+
+    out[0] = (unsigned char) (c0 & 0xff);
+    out[1] = (unsigned char) (c0 >> 8);
+    out[2] = (unsigned char) (c1 & 0xff);
+    out[3] = (unsigned char) (c1 >> 8);
+    for (int i = 0; i < 4; i++) {
+        out[4 + i] = (unsigned char) (indices >> (8 * i));
+    }
+}
+
+// Eight step ramp between the extremes, 3 bit indices
+void EncodeAlphaBlock(const unsigned char *block, unsigned char *out) {
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; i++) {
+        a0 = std::max(a0, (int) block[i * 4 + 3]);
+        a1 = std::min(a1, (int) block[i * 4 + 3]);
+    }
+    out[0] = (unsigned char) a0;
+    out[1] = (unsigned char) a1;
+
+    uint64_t bits = 0;
+    if (a0 != a1) {
+        int palette[8] = { a0, a1 };
+        for (int i = 1; i < 7; i++) {
+            palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+        }
+        for (int i = 0; i < 16; i++) {
+            int alpha = block[i * 4 + 3], best = 256;
+            uint64_t index = 0;
+            for (int p = 0; p < 8; p++) {
+                int d = std::abs(alpha - palette[p]);
+                if (d < best) {
+                    best = d;
+                    index = p;
+                }
+            }
+            bits |= index << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; i++) {
+        out[2 + i] = (unsigned char) (bits >> (8 * i));
+    }
+}
+
+void EncodeBlocks(const unsigned char *rgba, int width, int height, unsigned char *out,
+    size_t blockSize, bool alpha) {
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    ThreadPool::Get().ParallelFor(blocksY, 8, [&](unsigned int begin, unsigned int end) {
+        unsigned char block[64];
+        for (unsigned int by = begin; by < end; by++) {
+            for (int bx = 0; bx < blocksX; bx++) {
+                LoadBlock(rgba, width, height, bx, (int) by, block);
+                unsigned char *target = out + ((size_t) by * blocksX + bx) * blockSize;
+                if (alpha) {
+                    EncodeAlphaBlock(block, target);
+                    target += 8;
+                }
+                EncodeColorBlock(block, target);
+            }
+        }
+    });
+}
+
+}
+
+size_t TextureCooker::GetLevelSize(TextureEncoding encoding, int width, int height) {
+    return (size_t) GetRowCount(encoding, height) * GetRowSize(encoding, width);
+}
+
+int TextureCooker::GetRowCount(TextureEncoding encoding, int height) {
+    return encoding == TextureEncoding::RGBA8 ? height : (height + 3) / 4;
+}
+
+size_t TextureCooker::GetRowSize(TextureEncoding encoding, int width) {
+    switch (encoding) {
+    case TextureEncoding::BC1:
+        return (size_t) (width + 3) / 4 * 8;
+    case TextureEncoding::BC3:
+        return (size_t) (width + 3) / 4 * 16;
+    default:
+        return (size_t) width * 4;
+    }
+}
+
+size_t TextureCooker::GetMaxSize(int width, int height) {
+    // RGBA8 levels are the largest, apart from BC blocks padding levels below 4x4
+    size_t size = 0;
+    while (true) {
+        size += std::max(GetLevelSize(TextureEncoding::RGBA8, width, height),
+            GetLevelSize(TextureEncoding::BC3, width, height));
+        if (width == 1 && height == 1) {
+            return size;
+        }
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+}
+
+void TextureCooker::Downsample(const unsigned char *src, int width, int height,
+    unsigned char *dst) {
+    const float *linear = GetLinearTable();
+    const unsigned char *srgb = GetSrgbTable();
+    // Tent over the 2x2 footprint and half of each neighbor, a box filter aliases visibly
+    static const float c_Taps[4] = { 0.125f, 0.375f, 0.375f, 0.125f };
+
+    int outWidth = std::max(width / 2, 1), outHeight = std::max(height / 2, 1);
+    for (int y = 0; y < outHeight; y++) {
+        for (int x = 0; x < outWidth; x++) {
+            // Colors weighted by alpha, so transparent texels do not bleed their color in
+            float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for (int j = 0; j < 4; j++) {
+                int sy = std::min(std::max(y * 2 - 1 + j, 0), height - 1);
+                for (int i = 0; i < 4; i++) {
+                    int sx = std::min(std::max(x * 2 - 1 + i, 0), width - 1);
+                    const unsigned char *p = src + ((size_t) sy * width + sx) * 4;
+                    float weight = c_Taps[i] * c_Taps[j];
+                    float alpha = p[3] / 255.0f * weight;
+                    sum[0] += linear[p[0]] * alpha;
+                    sum[1] += linear[p[1]] * alpha;
+                    sum[2] += linear[p[2]] * alpha;
+                    sum[3] += alpha;
+                }
+            }
+            unsigned char *out = dst + ((size_t) y * outWidth + x) * 4;
+            for (int c = 0; c < 3; c++) {
+                float value = sum[3] > 0.0f ? sum[c] / sum[3] : 0.0f;
+                out[c] = srgb[std::min((int) (value * 4095.0f + 0.5f), 4095)];
+            }
+            out[3] = (unsigned char) std::min((int) (sum[3] * 255.0f + 0.5f), 255);
+        }
+    }
+}
+
+void TextureCooker::EncodeBC1(const unsigned char *rgba, int width, int height,
+    unsigned char *out) {
+    EncodeBlocks(rgba, width, height, out, 8, false);
+}
+
+void TextureCooker::EncodeBC3(const unsigned char *rgba, int width, int height,
+    unsigned char *out) {
+    EncodeBlocks(rgba, width, height, out, 16, true);
+}
+
+bool TextureCooker::Cook(const unsigned char *data, size_t size, bool compress,
+    CookedTexture &texture) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    uint64_t key = ContentHash(data, size);
+    key = ContentHash(&compress, sizeof(compress), key);
+    std::string path = GetCachePath(key);
+    if (LoadCache(path, key, texture)) {
+        texture.Cached = true;
+        texture.Milliseconds = Milliseconds(start);
+        return true;
+    }
+
+    // Per thread, the global flag belongs to whoever else is decoding
+    stbi_set_flip_vertically_on_load_thread(1);
+    int width, height, components;
+    unsigned char *pixels
+        = stbi_load_from_memory(data, (int) size, &width, &height, &components, 4);
+    if (!pixels) {
+        return false;
+    }
+    std::vector<unsigned char> level(pixels, pixels + (size_t) width * height * 4);
+    stbi_image_free(pixels);
+
+    bool opaque = true;
+    for (size_t i = 3; i < level.size() && opaque; i += 4) {
+        opaque = level[i] == 255;
+    }
+    texture.Encoding = !compress ? TextureEncoding::RGBA8
+        : opaque                 ? TextureEncoding::BC1
+                                 : TextureEncoding::BC3;
+    texture.Levels.clear();
+    texture.Data.clear();
+    texture.Data.reserve(GetMaxSize(width, height));
+
+    std::vector<unsigned char> next;
+    while (true) {
+        CookedLevel cooked = { (uint32_t) width, (uint32_t) height, texture.Data.size(),
+            GetLevelSize(texture.Encoding, width, height) };
+        texture.Data.resize(cooked.Offset + cooked.Size);
+        unsigned char *out = texture.Data.data() + cooked.Offset;
+        switch (texture.Encoding) {
+        case TextureEncoding::BC1:
+            EncodeBC1(level.data(), width, height, out);
+            break;
+        case TextureEncoding::BC3:
+            EncodeBC3(level.data(), width, height, out);
+            break;
+        default:
+            std::memcpy(out, level.data(), cooked.Size);
+            break;
+        }
+        texture.Levels.push_back(cooked);
+
+        if (width == 1 && height == 1) {
+            break;
+        }
+        next.resize((size_t) std::max(width / 2, 1) * std::max(height / 2, 1) * 4);
+        Downsample(level.data(), width, height, next.data());
+        level.swap(next);
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+
+    StoreCache(path, key, texture);
+    texture.Cached = false;
+    texture.Milliseconds = Milliseconds(start);
+    return true;
+}
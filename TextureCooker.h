@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class TextureEncoding : uint32_t { RGBA8, BC1, BC3 };
+
+// One mip level inside CookedTexture::Data, written to the cache as is
+struct CookedLevel {
+    uint32_t Width;
+    uint32_t Height;
+    uint64_t Offset;
+    uint64_t Size;
+};
+
+struct CookedTexture {
+    TextureEncoding Encoding = TextureEncoding::RGBA8;
+    // Largest first, rows bottom to top like glTexImage2D expects
+    std::vector<CookedLevel> Levels;
+    std::vector<unsigned char> Data;
+    // Read from res/cache/textures instead of decoded and encoded
+    bool Cached = false;
+    float Milliseconds = 0.0f;
+};
+
+// Turns an encoded image (PNG, JPEG, ...) into what the GPU samples: the full mip chain,
+// downsampled in linear light with a 4 tap tent filter, and compressed to BC1, or to BC3 when
+// any pixel is not opaque. Results are cached in res/cache/textures by a hash of the encoded
+// bytes, so later loads read the blocks straight from disk without decoding anything. No GL,
+// safe to call from any thread.
+class TextureCooker {
+public:
+    // compress false keeps RGBA8 levels, for drivers without S3TC
+    static bool Cook(const unsigned char *data, size_t size, bool compress, CookedTexture &texture);
+
+    // Upper bound of CookedTexture::Data for an image of this size
+    static size_t GetMaxSize(int width, int height);
+    static size_t GetLevelSize(TextureEncoding encoding, int width, int height);
+    // Rows of 4x4 blocks for the BC formats, pixel rows for RGBA8
+    static int GetRowCount(TextureEncoding encoding, int height);
+    static size_t GetRowSize(TextureEncoding encoding, int width);
+
+    // Half the size of src, rounded down but at least 1
+    static void Downsample(const unsigned char *src, int width, int height, unsigned char *dst);
+    static void EncodeBC1(const unsigned char *rgba, int width, int height, unsigned char *out);
+    static void EncodeBC3(const unsigned char *rgba, int width, int height, unsigned char *out);
+};
@@ -0,0 +1,337 @@
+#include "TextureLoader.h"
+
+#include "Renderer.h"
+#include "ResourceCache.h"
+#include "ThreadPool.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <thread>
+
+TextureLoader *TextureLoader::s_Instance = nullptr;
+
+namespace {
+
+float Milliseconds(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::high_resolution_clock::now() - start)
+        .count();
+}
+
+}
+
+TextureLoader::TextureLoader(size_t uploadBudget, unsigned int maxDecoding, bool compress)
+    : m_UploadBudget(uploadBudget)
+    , m_MaxDecoding(std::max(maxDecoding, 1u))
+    , m_Compress(compress && GLEW_EXT_texture_compression_s3tc)
+    , m_Placeholder(0)
+    , m_HitTotal(0.0f)
+    , m_MissTotal(0.0f) {
+    const unsigned char grey[4] = { 128, 128, 128, 255 };
+    GLCall(glGenTextures(1, &m_Placeholder));
+    GLCall(glBindTexture(GL_TEXTURE_2D, m_Placeholder));
+    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+    GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey));
+    GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+    s_Instance = this;
+}
+
+TextureLoader::~TextureLoader() {
+    s_Instance = nullptr;
+    for (const auto &job : m_Active) {
+        while (!job->Decoded) {
+            std::this_thread::yield();
+        }
+        // Unfinished textures keep the placeholder
+        job->Failed = true;
+        Finish(*job);
+    }
+    for (const auto &staging : m_Staging) {
+        GLCall(glDeleteBuffers(1, &staging->Buffer));
+    }
+    GLCall(glDeleteTextures(1, &m_Placeholder));
+}
+
+TextureLoader *TextureLoader::Get() {
+    return s_Instance;
+}
+
+std::shared_ptr<Texture> TextureLoader::Acquire(const std::string &path) {
+    auto load = [&path]() -> std::shared_ptr<Texture> {
+        if (TextureLoader *loader = Get()) {
+            return loader->Load(path);
+        }
+        return std::make_shared<Texture>(path);
+    };
+    if (ResourceCache<Texture> *cache = ResourceCache<Texture>::Get()) {
+        return cache->Acquire(path, load);
+    }
+    return load();
+}
+
+std::shared_ptr<Texture> TextureLoader::Acquire(
+    const std::string &name, const unsigned char *data, unsigned int size) {
+    auto load = [&]() -> std::shared_ptr<Texture> {
+        if (TextureLoader *loader = Get()) {
+            return loader->Load(name, data, size);
+        }
+        return std::make_shared<Texture>((unsigned char *) data, size);
+    };
+    if (ResourceCache<Texture> *cache = ResourceCache<Texture>::Get()) {
+        return cache->Acquire(ContentKey(ContentHash(data, size)), load);
+    }
+    return load();
+}
+
+std::shared_ptr<Texture> TextureLoader::Load(const std::string &path) {
+    auto job = std::make_unique<Job>();
+    job->Path = path;
+    // Only the header, so the staging buffer can be mapped before the worker starts
+    int components;
+    if (!stbi_info(path.c_str(), &job->Width, &job->Height, &components)) {
+        job->Failed = true;
+    }
+    return Queue(std::move(job));
+}
+
+std::shared_ptr<Texture> TextureLoader::Load(
+    const std::string &name, const unsigned char *data, unsigned int size) {
+    auto job = std::make_unique<Job>();
+    job->Path = name;
+    job->Source.assign(data, data + size);
+    int components;
+    if (!stbi_info_from_memory(data, (int) size, &job->Width, &job->Height, &components)) {
+        job->Failed = true;
+    }
+    return Queue(std::move(job));
+}
+
+std::shared_ptr<Texture> TextureLoader::Queue(std::unique_ptr<Job> job) {
+    if (job->Failed) {
+        std::cerr << "Could not load texture " << job->Path << ": " << stbi_failure_reason()
+                  << std::endl;
+    }
+    std::shared_ptr<Texture> texture(new Texture(job->Path, m_Placeholder));
+    job->Target = texture;
+    job->Compress = m_Compress;
+    job->Requested = std::chrono::high_resolution_clock::now();
+
+    std::lock_guard<std::mutex> lock(m_QueueMutex);
+    m_Queued.push_back(std::move(job));
+    return texture;
+}
+
+void TextureLoader::Decode(Job &job) {
+    if (job.Source.empty()) {
+        std::ifstream stream(job.Path, std::ios::binary);
+        job.Source.assign(
+            (std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    }
+
+    CookedTexture &cooked = job.Cooked;
+    if (!TextureCooker::Cook(job.Source.data(), job.Source.size(), job.Compress, cooked)
+        || cooked.Levels[0].Width != (uint32_t) job.Width
+        || cooked.Levels[0].Height != (uint32_t) job.Height
+        || cooked.Data.size() > TextureCooker::GetMaxSize(job.Width, job.Height)) {
+        job.Failed = true;
+    } else {
+        std::memcpy(job.Mapped, cooked.Data.data(), cooked.Data.size());
+    }
+    cooked.Data = std::vector<unsigned char>();
+    job.Source = std::vector<unsigned char>();
+}
+
+TextureLoader::Staging *TextureLoader::AcquireStaging(size_t size) {
+    // Prefer the tightest fit, then growing the largest free one over making another
+    Staging *fit = nullptr, *grow = nullptr;
+    for (const auto &staging : m_Staging) {
+        if (staging->Used) {
+            continue;
+        }
+        if (staging->Capacity >= size) {
+            if (!fit || staging->Capacity < fit->Capacity) {
+                fit = staging.get();
+            }
+        } else if (!grow || staging->Capacity > grow->Capacity) {
+            grow = staging.get();
+        }
+    }
+    Staging *best = fit ? fit : grow;
+    if (!best) {
+        m_Staging.push_back(std::make_unique<Staging>());
+        best = m_Staging.back().get();
+        GLCall(glGenBuffers(1, &best->Buffer));
+    }
+
+    GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, best->Buffer));
+    if (best->Capacity < size) {
+        m_Stats.StagingBytes += size - best->Capacity;
+        best->Capacity = size;
+        GLCall(glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW));
+    }
+    best->Used = true;
+    return best;
+}
+
+void TextureLoader::Finish(Job &job) {
+    if (job.Stage) {
+        if (job.Mapped) {
+            GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job.Stage->Buffer));
+            GLCall(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+            GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+            job.Mapped = nullptr;
+        }
+        job.Stage->Used = false;
+        job.Stage = nullptr;
+    }
+
+    std::shared_ptr<Texture> texture = job.Target.lock();
+    if (job.Failed || !texture) {
+        if (job.RendererID) {
+            GLCall(glDeleteTextures(1, &job.RendererID));
+        }
+        m_Stats.Failed += job.Failed;
+        return;
+    }
+
+    texture->Finish(job.RendererID, job.Cooked);
+    m_Stats.Loaded++;
+    m_Stats.GpuBytes += texture->GetMemorySize();
+    m_Stats.Rgba8Bytes += (size_t) job.Width * job.Height * 4;
+    m_Stats.LastLatencyMilliseconds = Milliseconds(job.Requested);
+    m_Stats.MaxLatencyMilliseconds
+        = std::max(m_Stats.MaxLatencyMilliseconds, m_Stats.LastLatencyMilliseconds);
+    if (job.Cooked.Cached) {
+        m_HitTotal += job.Cooked.Milliseconds;
+        m_Stats.HitMilliseconds = m_HitTotal / ++m_Stats.CacheHits;
+    } else {
+        m_MissTotal += job.Cooked.Milliseconds;
+        m_Stats.MissMilliseconds = m_MissTotal / ++m_Stats.CacheMisses;
+    }
+}
+
+size_t TextureLoader::Upload(Job &job, size_t budget) {
+    const CookedTexture &cooked = job.Cooked;
+    const CookedLevel &level = cooked.Levels[job.Level];
+    size_t row = TextureCooker::GetRowSize(cooked.Encoding, level.Width);
+    int rowCount = TextureCooker::GetRowCount(cooked.Encoding, level.Height);
+    int rows = std::min(std::max((int) (budget / row), 1), rowCount - job.UploadedRows);
+    const void *offset = (const void *) (level.Offset + job.UploadedRows * row);
+
+    if (cooked.Encoding == TextureEncoding::RGBA8) {
+        GLCall(glTexSubImage2D(GL_TEXTURE_2D, job.Level, 0, job.UploadedRows, level.Width, rows,
+            GL_RGBA, GL_UNSIGNED_BYTE, offset));
+    } else {
+        // Block rows are 4 pixels, the last band may end at the edge of a smaller level
+        int y = job.UploadedRows * 4;
+        GLCall(glCompressedTexSubImage2D(GL_TEXTURE_2D, job.Level, 0, y, level.Width,
+            std::min(rows * 4, (int) level.Height - y), Texture::GetInternalFormat(cooked.Encoding),
+            (GLsizei) (rows * row), offset));
+    }
+
+    job.UploadedRows += rows;
+    if (job.UploadedRows == rowCount) {
+        job.Level++;
+        job.UploadedRows = 0;
+    }
+    return rows * row;
+}
+
+void TextureLoader::Update() {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Start decodes while there are free slots, each into a freshly mapped staging buffer
+    unsigned int decoding = 0;
+    for (const auto &job : m_Active) {
+        decoding += !job->Decoded;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_QueueMutex);
+        while (decoding < m_MaxDecoding && !m_Queued.empty()) {
+            std::unique_ptr<Job> job = std::move(m_Queued.front());
+            m_Queued.pop_front();
+            if (job->Failed || job->Target.expired()) {
+                Finish(*job);
+                continue;
+            }
+
+            size_t size = TextureCooker::GetMaxSize(job->Width, job->Height);
+            job->Stage = AcquireStaging(size);
+            // Invalidating lets the driver hand out new memory if the GPU still reads the old
+            GLCall(job->Mapped = (unsigned char *) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                       GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+            GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+            if (!job->Mapped) {
+                job->Failed = true;
+                Finish(*job);
+                continue;
+            }
+
+            Job *decode = job.get();
+            m_Active.push_back(std::move(job));
+            decoding++;
+            ThreadPool::Get().Submit([decode]() {
+                Decode(*decode);
+                decode->Decoded = true;
+            });
+        }
+        m_Stats.Queued = (unsigned int) m_Queued.size();
+    }
+
+    // Upload cooked images in request order, whole rows, until the budget is used up. At
+    // least one row goes every frame, so a budget smaller than a row still makes progress.
+    size_t budget = m_UploadBudget;
+    m_Stats.UploadedBytes = 0;
+    for (auto &job : m_Active) {
+        if (m_Stats.UploadedBytes > 0 && budget == 0) {
+            break;
+        }
+        if (!job->Decoded) {
+            continue;
+        }
+        if (job->Mapped) {
+            GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job->Stage->Buffer));
+            GLCall(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+            job->Mapped = nullptr;
+        }
+        if (job->Failed || job->Target.expired()) {
+            Finish(*job);
+            job.reset();
+            continue;
+        }
+
+        if (!job->RendererID) {
+            // Allocating with a bound unpack buffer would read from it
+            GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+            job->RendererID = Texture::Create(job->Cooked, false);
+        }
+        GLCall(glBindTexture(GL_TEXTURE_2D, job->RendererID));
+        GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job->Stage->Buffer));
+        while (job->Level < job->Cooked.Levels.size()
+            && (budget > 0 || m_Stats.UploadedBytes == 0)) {
+            size_t uploaded = Upload(*job, budget);
+            m_Stats.UploadedBytes += uploaded;
+            budget -= std::min(budget, uploaded);
+        }
+
+        if (job->Level == job->Cooked.Levels.size()) {
+            Finish(*job);
+            job.reset();
+        }
+    }
+    GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+    GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+    m_Active.erase(std::remove(m_Active.begin(), m_Active.end(), nullptr), m_Active.end());
+
+    m_Stats.Decoding = 0;
+    m_Stats.Uploading = 0;
+    for (const auto &job : m_Active) {
+        (job->Decoded ? m_Stats.Uploading : m_Stats.Decoding)++;
+    }
+    m_Stats.UpdateMilliseconds = Milliseconds(start);
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "Texture.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct TextureLoaderStats {
+    // Waiting for a decode slot, on a worker, and decoded but not fully uploaded yet
+    unsigned int Queued = 0;
+    unsigned int Decoding = 0;
+    unsigned int Uploading = 0;
+    unsigned int Loaded = 0;
+    unsigned int Failed = 0;
+    // Uploaded by the last Update, and what the staging buffers hold in total
+    size_t UploadedBytes = 0;
+    size_t StagingBytes = 0;
+    float UpdateMilliseconds = 0.0f;
+    // Cooked textures read from the cache versus decoded, filtered and compressed, with the
+    // average worker time of each
+    unsigned int CacheHits = 0;
+    unsigned int CacheMisses = 0;
+    float HitMilliseconds = 0.0f;
+    float MissMilliseconds = 0.0f;
+    // GPU memory of the loaded textures, and what they would take as plain RGBA8 without mips
+    size_t GpuBytes = 0;
+    size_t Rgba8Bytes = 0;
+    // From Load until the texture is bound instead of the placeholder
+    float LastLatencyMilliseconds = 0.0f;
+    float MaxLatencyMilliseconds = 0.0f;
+};
+
+// Loads textures without stalling the frame. Load returns a Texture that binds a grey
+// placeholder until its pixels arrive. Workers of the ThreadPool cook the image (see
+// TextureCooker) into mapped pixel unpack buffers from a recycled pool, and Update copies the
+// levels into the textures in row bands, no more than the byte budget per frame, so a large
+// image spreads over a few frames instead of one long one. Owned by main; while it exists Get
+// returns it.
+class TextureLoader {
+public:
+    // Needs the GL context. compress is ignored without S3TC support.
+    TextureLoader(size_t uploadBudget = 8 * 1024 * 1024, unsigned int maxDecoding = 4,
+        bool compress = true);
+    // Waits for the decodes still running, needs the GL context
+    ~TextureLoader();
+
+    // Any thread. The file is read by the worker.
+    std::shared_ptr<Texture> Load(const std::string &path);
+    // Any thread. The encoded image is copied, so data can go away right after.
+    std::shared_ptr<Texture> Load(
+        const std::string &name, const unsigned char *data, unsigned int size);
+
+    // Render thread, once per frame before anything draws
+    void Update();
+
+    inline size_t GetUploadBudget() const {
+        return m_UploadBudget;
+    }
+    inline void SetUploadBudget(size_t bytes) {
+        m_UploadBudget = bytes;
+    }
+    inline const TextureLoaderStats &GetStats() const {
+        return m_Stats;
+    }
+
+    // nullptr before main created the loader or after it is gone, e.g. in headless runs
+    static TextureLoader *Get();
+
+    // Shared through the texture cache and loaded asynchronously, when main created those.
+    // Embedded images are keyed by their content, so copies in different files share too.
+    static std::shared_ptr<Texture> Acquire(const std::string &path);
+    static std::shared_ptr<Texture> Acquire(
+        const std::string &name, const unsigned char *data, unsigned int size);
+
+private:
+    struct Staging {
+        unsigned int Buffer = 0;
+        size_t Capacity = 0;
+        bool Used = false;
+    };
+
+    struct Job {
+        std::weak_ptr<Texture> Target;
+        std::string Path;
+        // Encoded image for Load from memory, or the file once the worker read it
+        std::vector<unsigned char> Source;
+        std::chrono::high_resolution_clock::time_point Requested;
+
+        // From the header, the staging buffer is sized for it before the worker starts
+        int Width = 0;
+        int Height = 0;
+        bool Compress = true;
+        Staging *Stage = nullptr;
+        unsigned char *Mapped = nullptr;
+        std::atomic<bool> Decoded { false };
+        bool Failed = false;
+        // Levels and encoding, the data itself went to the staging buffer
+        CookedTexture Cooked;
+
+        unsigned int RendererID = 0;
+        unsigned int Level = 0;
+        int UploadedRows = 0;
+    };
+
+    std::shared_ptr<Texture> Queue(std::unique_ptr<Job> job);
+    // Worker side: reads and cooks the image and copies the result into Mapped
+    static void Decode(Job &job);
+    // Uploads whole rows of the job's current level, at least one
+    size_t Upload(Job &job, size_t budget);
+    // Smallest free staging buffer of at least size bytes, grown or created if there is none
+    Staging *AcquireStaging(size_t size);
+    // Drops a job, cleaning up what Update created for it
+    void Finish(Job &job);
+
+    size_t m_UploadBudget;
+    unsigned int m_MaxDecoding;
+    bool m_Compress;
+    unsigned int m_Placeholder;
+
+    std::mutex m_QueueMutex;
+    std::deque<std::unique_ptr<Job>> m_Queued;
+    // In request order, the front one is uploaded first
+    std::vector<std::unique_ptr<Job>> m_Active;
+    std::vector<std::unique_ptr<Staging>> m_Staging;
+
+    TextureLoaderStats m_Stats;
+    float m_HitTotal;
+    float m_MissTotal;
+
+    static TextureLoader *s_Instance;
+};
@@ -0,0 +1,99 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+    : m_Stopping(false) {
+    if (threadCount == 0) {
+        unsigned int cores = std::thread::hardware_concurrency();
+        threadCount = cores > 1 ? cores - 1 : 1;
+    }
+    for (unsigned int i = 0; i < threadCount; i++) {
+        m_Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_Condition.notify_all();
+    for (std::thread &worker : m_Workers) {
+        worker.join();
+    }
+}
+
+ThreadPool &ThreadPool::Get() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Tasks.push_back(std::move(task));
+    }
+    m_Condition.notify_one();
+}
+
+void ThreadPool::WorkerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Condition.wait(lock, [this] { return m_Stopping || !m_Tasks.empty(); });
+            if (m_Tasks.empty()) {
+                return;
+            }
+            task = std::move(m_Tasks.front());
+            m_Tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::ParallelFor(unsigned int count, unsigned int grain,
+    const std::function<void(unsigned int, unsigned int)> &func) {
+    if (count == 0) {
+        return;
+    }
+    grain = std::max(grain, 1u);
+    unsigned int chunks = (count + grain - 1) / grain;
+    if (chunks == 1 || m_Workers.empty()) {
+        func(0, count);
+        return;
+    }
+
+    struct State {
+        std::atomic<unsigned int> Next { 0 };
+        std::atomic<unsigned int> Done { 0 };
+        std::mutex Mutex;
+        std::condition_variable Finished;
+    };
+    auto state = std::make_shared<State>();
+
+    // Helpers that start after the last chunk was taken return without touching func
+    auto run = [state, chunks, count, grain, &func]() {
+        unsigned int chunk;
+        while ((chunk = state->Next++) < chunks) {
+            unsigned int begin = chunk * grain;
+            func(begin, std::min(begin + grain, count));
+            if (++state->Done == chunks) {
+                std::lock_guard<std::mutex> lock(state->Mutex);
+                state->Finished.notify_all();
+            }
+        }
+    };
+
+    unsigned int helpers = std::min((unsigned int) m_Workers.size(), chunks - 1);
+    for (unsigned int i = 0; i < helpers; i++) {
+        Submit(run);
+    }
+    run();
+
+    std::unique_lock<std::mutex> lock(state->Mutex);
+    state->Finished.wait(lock, [&] { return state->Done == chunks; });
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small pool of worker threads for CPU side render work. Submit queues fire-and-forget tasks,
+// ParallelFor splits a range into chunks and lets the calling thread help until it is done,
+// so it is safe to call from inside a task as well.
+class ThreadPool {
+private:
+    std::vector<std::thread> m_Workers;
+    std::deque<std::function<void()>> m_Tasks;
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    bool m_Stopping;
+
+public:
+    // 0 uses one thread per core, minus the one calling ParallelFor
+    ThreadPool(unsigned int threadCount = 0);
+    ~ThreadPool();
+
+    void Submit(std::function<void()> task);
+    // Calls func(begin, end) for chunks of at most grain items covering [0, count)
+    void ParallelFor(unsigned int count, unsigned int grain,
+        const std::function<void(unsigned int, unsigned int)> &func);
+
+    inline unsigned int GetThreadCount() const {
+        return (unsigned int) m_Workers.size();
+    }
+
+    // Pool shared by the renderer systems
+    static ThreadPool &Get();
+
+private:
+    void WorkerLoop();
+};
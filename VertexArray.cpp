@@ -3,35 +3,78 @@
 #include "Renderer.h"
 #include "VertexBufferLayout.h"
 
-VertexArray::VertexArray() {
+#include <cstdint>
+
+VertexArray::VertexArray()
+    : m_RendererID(0)
+    , m_SoftwareBuffer(nullptr) {
+    if (Renderer::GetSoftwareBackend()) {
+        return;
+    }
     GLCall(glGenVertexArrays(1, &m_RendererID));
 }
 
 VertexArray::~VertexArray() {
+    if (Renderer::GetSoftwareBackend()) {
+        return;
+    }
     GLCall(glDeleteVertexArrays(1, &m_RendererID));
 }
 
 void VertexArray::AddBuffer(const VertexBuffer &vb, const VertexBufferLayout &layout) {
+    if (Renderer::GetSoftwareBackend()) {
+        m_SoftwareBuffer = &vb;
+        m_SoftwareLayout = layout;
+        return;
+    }
     Bind();
     vb.Bind();
+    SetAttributes(layout, 0, 0, 0);
+}
+
+void VertexArray::AddBuffer(
+    const StreamBuffer &buffer, unsigned int offset, const VertexBufferLayout &layout) {
+    if (Renderer::GetSoftwareBackend()) {
+        return;
+    }
+    Bind();
+    buffer.Bind();
+    SetAttributes(layout, 0, offset, 0);
+}
+
+void VertexArray::AddInstanceBuffer(const StreamBuffer &buffer, unsigned int offset,
+    const VertexBufferLayout &layout, unsigned int firstAttribute) {
+    if (Renderer::GetSoftwareBackend()) {
+        return;
+    }
+    Bind();
+    buffer.Bind();
+    SetAttributes(layout, firstAttribute, offset, 1);
+}
+
+void VertexArray::SetAttributes(const VertexBufferLayout &layout, unsigned int firstAttribute,
+    unsigned int offset, unsigned int divisor) {
     const auto &elements = layout.GetElements();
-    unsigned int offset = 0;
     for (unsigned int i = 0; i < elements.size(); i++) {
         const auto &element = elements[i];
-        GLCall(glEnableVertexAttribArray(i));
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wint-to-void-pointer-cast"
-        GLCall(glVertexAttribPointer(i, element.count, element.type, element.normalized,
-            layout.GetStride(), (void *) offset));
-#pragma clang diagnostic pop
-        offset += element.count * VertexBufferElement::GetSizeOfType(element.type);
+        GLCall(glEnableVertexAttribArray(firstAttribute + i));
+        uintptr_t pointer = offset + element.offset;
+        GLCall(glVertexAttribPointer(firstAttribute + i, element.count, element.type,
+            element.normalized, layout.GetStride(), (void *) pointer));
+        GLCall(glVertexAttribDivisor(firstAttribute + i, divisor));
     }
 }
 
 void VertexArray::Bind() const {
+    if (Renderer::GetSoftwareBackend()) {
+        return;
+    }
     GLCall(glBindVertexArray(m_RendererID));
 }
 
 void VertexArray::UnBind() const {
+    if (Renderer::GetSoftwareBackend()) {
+        return;
+    }
     GLCall(glBindVertexArray(0));
 }
\ No newline at end of file
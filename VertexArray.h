@@ -1,18 +1,40 @@
 #pragma once
 
+#include "StreamBuffer.h"
 #include "VertexBuffer.h"
 #include "VertexBufferLayout.h"
 
 class VertexArray {
 private:
     unsigned int m_RendererID;
+    // What AddBuffer attached when there is a software backend, stream buffers are not kept
+    const VertexBuffer *m_SoftwareBuffer;
+    VertexBufferLayout m_SoftwareLayout;
 
 public:
     VertexArray();
     ~VertexArray();
 
     void AddBuffer(const VertexBuffer &vb, const VertexBufferLayout &layout);
+    // Per-vertex attributes read from offset in a stream buffer, like AddInstanceBuffer
+    void AddBuffer(
+        const StreamBuffer &buffer, unsigned int offset, const VertexBufferLayout &layout);
+    // Per-instance attributes starting at firstAttribute, read from offset in a stream buffer.
+    // Call again whenever the offset changes (typically once per frame).
+    void AddInstanceBuffer(const StreamBuffer &buffer, unsigned int offset,
+        const VertexBufferLayout &layout, unsigned int firstAttribute);
 
     void Bind() const;
     void UnBind() const;
-};
\ No newline at end of file
+
+    inline const VertexBuffer *GetSoftwareBuffer() const {
+        return m_SoftwareBuffer;
+    }
+    inline const VertexBufferLayout &GetSoftwareLayout() const {
+        return m_SoftwareLayout;
+    }
+
+private:
+    void SetAttributes(const VertexBufferLayout &layout, unsigned int firstAttribute,
+        unsigned int offset, unsigned int divisor);
+};
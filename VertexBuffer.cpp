@@ -2,20 +2,68 @@
 
 #include "Renderer.h"
 
-VertexBuffer::VertexBuffer(const void *data, unsigned int size) {
+#include <algorithm>
+#include <cstring>
+
+VertexBuffer::VertexBuffer(const void *data, unsigned int size)
+    : m_RendererID(0) {
+    if (Renderer::GetSoftwareBackend()) {
+        m_SoftwareData.resize(size);
+        if (data) {
+            std::memcpy(m_SoftwareData.data(), data, size);
+        }
+        return;
+    }
     GLCall(glGenBuffers(1, &m_RendererID));
     GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_RendererID));
     GLCall(glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW));
 }
 
 VertexBuffer::~VertexBuffer() {
+    if (Renderer::GetSoftwareBackend()) {
+        return;
+    }
     GLCall(glDeleteBuffers(1, &m_RendererID));
 }
 
 void VertexBuffer::Bind() const {
+    if (Renderer::GetSoftwareBackend()) {
+        return;
+    }
     GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_RendererID));
 }
 
 void VertexBuffer::UnBind() const {
+    if (Renderer::GetSoftwareBackend()) {
+        return;
+    }
     GLCall(glBindBuffer(GL_ARRAY_BUFFER, 0));
+}
+
+void *VertexBuffer::Map(unsigned int size) {
+    if (Renderer::GetSoftwareBackend()) {
+        return size <= m_SoftwareData.size() ? m_SoftwareData.data() : nullptr;
+    }
+    Bind();
+    GLCall(void *data = glMapBufferRange(
+               GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    return data;
+}
+
+bool VertexBuffer::Unmap() {
+    if (Renderer::GetSoftwareBackend()) {
+        return true;
+    }
+    Bind();
+    GLCall(GLboolean intact = glUnmapBuffer(GL_ARRAY_BUFFER));
+    return intact == GL_TRUE;
+}
+
+void VertexBuffer::SetData(const void *data, unsigned int size) {
+    if (Renderer::GetSoftwareBackend()) {
+        std::memcpy(m_SoftwareData.data(), data, std::min<size_t>(size, m_SoftwareData.size()));
+        return;
+    }
+    Bind();
+    GLCall(glBufferSubData(GL_ARRAY_BUFFER, 0, size, data));
 }
\ No newline at end of file
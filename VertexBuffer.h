@@ -1,8 +1,12 @@
 #pragma once
 
+#include <vector>
+
 class VertexBuffer {
 private:
     unsigned int m_RendererID;
+    // The contents when there is a software backend, instead of the GL buffer
+    std::vector<unsigned char> m_SoftwareData;
 
 public:
     VertexBuffer(const void *data, unsigned int size);
@@ -10,4 +14,14 @@ public:
 
     void Bind() const;
     void UnBind() const;
+
+    // Write-only mapping of the whole buffer for filling it in place, nullptr on failure
+    void *Map(unsigned int size);
+    // False if the driver lost the contents while mapped, they need to be written again
+    bool Unmap();
+    void SetData(const void *data, unsigned int size);
+
+    inline const std::vector<unsigned char> &GetSoftwareData() const {
+        return m_SoftwareData;
+    }
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Macros.h"
+#include "VertexFormat.h"
 
 #include <GL/glew.h>
 #include <vector>
@@ -9,6 +10,7 @@ struct VertexBufferElement {
     unsigned int type;
     unsigned int count;
     unsigned int normalized;
+    unsigned int offset;
 
     static unsigned int GetSizeOfType(unsigned int type) {
         switch (type) {
@@ -33,25 +35,18 @@ public:
         : m_Stride(0) {
     }
 
-    template <typename T> void Push(unsigned int count) {
-        (void) count;
-        ASSERT(false);
-    }
-
-    template <> void Push<float>(unsigned int count) {
-        m_Elements.push_back({ GL_FLOAT, count, GL_FALSE });
-        m_Stride += count * VertexBufferElement::GetSizeOfType(GL_FLOAT);
-    }
-
-    template <> void Push<unsigned int>(unsigned int count) {
-        m_Elements.push_back({ GL_UNSIGNED_INT, count, GL_FALSE });
-        m_Stride += count * VertexBufferElement::GetSizeOfType(GL_UNSIGNED_INT);
+    // Layout of a vertex struct described by VertexFormat<T>
+    template <typename T> static VertexBufferLayout Of() {
+        VertexBufferLayout layout;
+        for (const VertexAttribute &attribute : VertexFormat<T>::Attributes) {
+            layout.m_Elements.push_back({ attribute.Type, attribute.Count,
+                attribute.Normalized ? (unsigned int) GL_TRUE : GL_FALSE, attribute.Offset });
+        }
+        layout.m_Stride = sizeof(T);
+        return layout;
     }
 
-    template <> void Push<unsigned char>(unsigned int count) {
-        m_Elements.push_back({ GL_UNSIGNED_BYTE, count, GL_TRUE });
-        m_Stride += count * VertexBufferElement::GetSizeOfType(GL_UNSIGNED_BYTE);
-    }
+    template <typename T> void Push(unsigned int count);
 
     inline const std::vector<VertexBufferElement> &GetElements() const {
         return m_Elements;
@@ -60,4 +55,27 @@ public:
     inline unsigned int GetStride() const {
         return m_Stride;
     };
-};
\ No newline at end of file
+
+private:
+    void PushElement(unsigned int type, unsigned int count, unsigned int normalized) {
+        m_Elements.push_back({ type, count, normalized, m_Stride });
+        m_Stride += count * VertexBufferElement::GetSizeOfType(type);
+    }
+};
+
+template <typename T> inline void VertexBufferLayout::Push(unsigned int count) {
+    (void) count;
+    ASSERT(false);
+}
+
+template <> inline void VertexBufferLayout::Push<float>(unsigned int count) {
+    PushElement(GL_FLOAT, count, GL_FALSE);
+}
+
+template <> inline void VertexBufferLayout::Push<unsigned int>(unsigned int count) {
+    PushElement(GL_UNSIGNED_INT, count, GL_FALSE);
+}
+
+template <> inline void VertexBufferLayout::Push<unsigned char>(unsigned int count) {
+    PushElement(GL_UNSIGNED_BYTE, count, GL_TRUE);
+}
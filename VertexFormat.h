@@ -0,0 +1,225 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+// One attribute of a vertex struct, as handed to glVertexAttribPointer. Built with the
+// constexpr helpers below so the description can be checked against the struct at compile time.
+struct VertexAttribute {
+    unsigned int Type;
+    unsigned int Count;
+    bool Normalized;
+    unsigned int Offset;
+
+    static constexpr VertexAttribute Float(unsigned int count, size_t offset) {
+        return { GL_FLOAT, count, false, (unsigned int) offset };
+    }
+    static constexpr VertexAttribute Half(unsigned int count, size_t offset) {
+        return { GL_HALF_FLOAT, count, false, (unsigned int) offset };
+    }
+    static constexpr VertexAttribute Snorm16(unsigned int count, size_t offset) {
+        return { GL_SHORT, count, true, (unsigned int) offset };
+    }
+    static constexpr VertexAttribute Unorm16(unsigned int count, size_t offset) {
+        return { GL_UNSIGNED_SHORT, count, true, (unsigned int) offset };
+    }
+    static constexpr VertexAttribute Unorm8(unsigned int count, size_t offset) {
+        return { GL_UNSIGNED_BYTE, count, true, (unsigned int) offset };
+    }
+    // xyz in 10 signed normalized bits each, w in the top 2, read as a vec4 (or vec3)
+    static constexpr VertexAttribute Int2_10_10_10(size_t offset) {
+        return { GL_INT_2_10_10_10_REV, 4, true, (unsigned int) offset };
+    }
+    // Unit vector folded onto an octahedron, the shader unpacks it with OctahedralDecode
+    static constexpr VertexAttribute Octahedral16(size_t offset) {
+        return Snorm16(2, offset);
+    }
+
+    constexpr unsigned int GetSize() const {
+        switch (Type) {
+        case GL_FLOAT: return 4 * Count;
+        case GL_UNSIGNED_INT: return 4 * Count;
+        case GL_HALF_FLOAT: return 2 * Count;
+        case GL_SHORT: return 2 * Count;
+        case GL_UNSIGNED_SHORT: return 2 * Count;
+        case GL_UNSIGNED_BYTE: return Count;
+        case GL_INT_2_10_10_10_REV: return 4;
+        }
+        return 0;
+    }
+};
+
+// Specialized after each vertex struct with a constexpr Attributes array, in shader location
+// order, e.g. template <> struct VertexFormat<CubeVertex> { static constexpr ... };
+template <typename T> struct VertexFormat;
+
+// True if the attributes of T are 4 byte aligned, in order, don't overlap and cover the whole
+// struct without holes, so a stride of sizeof(T) matches what the shader reads.
+template <typename T> constexpr bool IsVertexFormatPacked() {
+    unsigned int end = 0;
+    for (const VertexAttribute &attribute : VertexFormat<T>::Attributes) {
+        if (attribute.GetSize() == 0 || attribute.Offset != end || attribute.Offset % 4 != 0) {
+            return false;
+        }
+        end = attribute.Offset + attribute.GetSize();
+    }
+    return end == sizeof(T);
+}
+
+// Conversions for filling packed vertices, all clamp to the representable range
+namespace VertexPack {
+
+inline uint16_t Half(float value) {
+    return glm::packHalf1x16(value);
+}
+
+inline int16_t Snorm16(float value) {
+    return (int16_t) glm::round(glm::clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+inline uint16_t Unorm16(float value) {
+    return (uint16_t) glm::round(glm::clamp(value, 0.0f, 1.0f) * 65535.0f);
+}
+
+inline uint8_t Unorm8(float value) {
+    return (uint8_t) glm::round(glm::clamp(value, 0.0f, 1.0f) * 255.0f);
+}
+
+inline uint32_t Int2_10_10_10(const glm::vec3 &v, float w = 0.0f) {
+    auto pack = [](float value, float scale, uint32_t mask) {
+        return (uint32_t) (int32_t) glm::round(glm::clamp(value, -1.0f, 1.0f) * scale) & mask;
+    };
+    return pack(v.x, 511.0f, 0x3ff) | pack(v.y, 511.0f, 0x3ff) << 10
+        | pack(v.z, 511.0f, 0x3ff) << 20 | pack(w, 1.0f, 0x3) << 30;
+}
+
+// Octahedral mapping of a unit vector to [-1, 1]^2, matches OctahedralDecode in
+// res/shaders/include/Octahedral.glsl
+inline glm::vec2 OctahedralEncode(const glm::vec3 &n) {
+    glm::vec2 p = glm::vec2(n.x, n.y) / (glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z));
+    if (n.z < 0.0f) {
+        glm::vec2 sign = glm::vec2(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+        p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * sign;
+    }
+    return p;
+}
+
+// Inverse of OctahedralEncode
+inline glm::vec3 OctahedralDecode(const glm::vec2 &e) {
+    glm::vec3 n(e.x, e.y, 1.0f - glm::abs(e.x) - glm::abs(e.y));
+    if (n.z < 0.0f) {
+        glm::vec2 sign = glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+        glm::vec2 folded = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * sign;
+        n.x = folded.x;
+        n.y = folded.y;
+    }
+    return glm::normalize(n);
+}
+
+}
+
+// The reverse conversions, with the rules GL applies when fetching normalized attributes
+namespace VertexUnpack {
+
+inline float Half(uint16_t value) {
+    return glm::unpackHalf1x16(value);
+}
+
+inline float Snorm16(int16_t value) {
+    return glm::max(value / 32767.0f, -1.0f);
+}
+
+inline float Unorm16(uint16_t value) {
+    return value / 65535.0f;
+}
+
+inline float Unorm8(uint8_t value) {
+    return value / 255.0f;
+}
+
+inline glm::vec4 Int2_10_10_10(uint32_t value) {
+    // Shift each field to the top of an int so the arithmetic shift back extends its sign
+    auto field = [value](int shift, int bits, float scale) {
+        int32_t v = (int32_t) (value << (32 - shift - bits)) >> (32 - bits);
+        return glm::max(v / scale, -1.0f);
+    };
+    return glm::vec4(field(0, 10, 511.0f), field(10, 10, 511.0f), field(20, 10, 511.0f),
+        field(30, 2, 1.0f));
+}
+
+}
+
+// Formats of the built-in meshes
+
+// Terrain and Plane, 20 bytes instead of 44. Positions are in [-1, 1] (the grid spans
+// [-0.5, 0.5] with heights in [0, 1]), w is stored as 1.
+struct GridVertex {
+    int16_t Position[4];
+    int16_t Normal[2];
+    uint16_t TexCoord[2];
+    uint8_t Color[4];
+
+    static GridVertex Pack(const glm::vec3 &position, const glm::vec3 &normal,
+        const glm::vec2 &texCoord, const glm::vec3 &color) {
+        glm::vec2 octahedral = VertexPack::OctahedralEncode(normal);
+        return { { VertexPack::Snorm16(position.x), VertexPack::Snorm16(position.y),
+                     VertexPack::Snorm16(position.z), 32767 },
+            { VertexPack::Snorm16(octahedral.x), VertexPack::Snorm16(octahedral.y) },
+            { VertexPack::Unorm16(texCoord.x), VertexPack::Unorm16(texCoord.y) },
+            { VertexPack::Unorm8(color.r), VertexPack::Unorm8(color.g),
+                VertexPack::Unorm8(color.b), 255 } };
+    }
+};
+
+template <> struct VertexFormat<GridVertex> {
+    static constexpr VertexAttribute Attributes[] = {
+        VertexAttribute::Snorm16(4, offsetof(GridVertex, Position)),
+        VertexAttribute::Octahedral16(offsetof(GridVertex, Normal)),
+        VertexAttribute::Unorm16(2, offsetof(GridVertex, TexCoord)),
+        VertexAttribute::Unorm8(4, offsetof(GridVertex, Color)),
+    };
+};
+static_assert(IsVertexFormatPacked<GridVertex>(), "GridVertex does not match its attributes");
+
+// Cube, 16 bytes instead of 32. Halves hold the +-0.5 corners exactly, w is 1.
+struct CubeVertex {
+    uint16_t Position[4];
+    uint32_t Normal;
+    uint16_t TexCoord[2];
+
+    static CubeVertex Pack(
+        const glm::vec3 &position, const glm::vec3 &normal, const glm::vec2 &texCoord) {
+        return { { VertexPack::Half(position.x), VertexPack::Half(position.y),
+                     VertexPack::Half(position.z), VertexPack::Half(1.0f) },
+            VertexPack::Int2_10_10_10(normal),
+            { VertexPack::Half(texCoord.x), VertexPack::Half(texCoord.y) } };
+    }
+};
+
+template <> struct VertexFormat<CubeVertex> {
+    static constexpr VertexAttribute Attributes[] = {
+        VertexAttribute::Half(4, offsetof(CubeVertex, Position)),
+        VertexAttribute::Int2_10_10_10(offsetof(CubeVertex, Normal)),
+        VertexAttribute::Half(2, offsetof(CubeVertex, TexCoord)),
+    };
+};
+static_assert(IsVertexFormatPacked<CubeVertex>(), "CubeVertex does not match its attributes");
+
+// Imported meshes, 12 bytes instead of 20. Positions are quantized to the mesh's bounding box,
+// the model matrix has to apply the box afterwards.
+struct QuantizedVertex {
+    int16_t Position[4];
+    uint16_t TexCoord[2];
+};
+
+template <> struct VertexFormat<QuantizedVertex> {
+    static constexpr VertexAttribute Attributes[] = {
+        VertexAttribute::Snorm16(4, offsetof(QuantizedVertex, Position)),
+        VertexAttribute::Half(2, offsetof(QuantizedVertex, TexCoord)),
+    };
+};
+static_assert(
+    IsVertexFormatPacked<QuantizedVertex>(), "QuantizedVertex does not match its attributes");
@@ -1,7 +1,15 @@
+#include "FrameCapture.h"
+#include "Headless.h"
 #include "IndexBuffer.h"
+#include "MeshBuilder.h"
+#include "MeshOptimizer.h"
+#include "RenderThread.h"
 #include "Renderer.h"
+#include "ResourceCache.h"
 #include "Shader.h"
+#include "ShaderCache.h"
 #include "Texture.h"
+#include "TextureLoader.h"
 #include "VertexArray.h"
 #include "VertexBuffer.h"
 #include "VertexBufferLayout.h"
@@ -10,9 +18,11 @@
 #include "Test.h"
 #include "TestAssimp.h"
 #include "TestClearColor.h"
+#include "TestClusteredLighting.h"
 #include "TestCube.h"
 #include "TestJolt.h"
 #include "TestNoise.h"
+#include "TestParticles.h"
 #include "TestTexture2D.h"
 #include "TestLighting.h"
 
@@ -29,7 +39,10 @@
 
 // STD
 #include <chrono>
+#include <cstdlib>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <string>
 
 // Jolt
@@ -72,7 +85,60 @@ static bool AssertFailedImpl(
 
 #endif // JPH_ENABLE_ASSERTS
 
+// Copy of this frame's ImGui output that stays valid on the render thread while the main thread
+// builds the next frame
+static std::shared_ptr<ImDrawData> CloneDrawData(const ImDrawData &source) {
+    ImDrawData *clone = IM_NEW(ImDrawData)(source);
+    for (ImDrawList *&list : clone->CmdLists) {
+        list = list->CloneOutput();
+    }
+    return std::shared_ptr<ImDrawData>(clone, [](ImDrawData *data) {
+        for (ImDrawList *list : data->CmdLists) {
+            IM_DELETE(list);
+        }
+        IM_DELETE(data);
+    });
+}
+
+static void RegisterTests(test::TestMenu &menu) {
+    menu.RegisterTest<test::TestClearColor>("Clear Color");
+    menu.RegisterTest<test::TestTexture2D>("2D Texture");
+    menu.RegisterTest<test::TestCube>("Cube", true);
+    menu.RegisterTest<test::TestAssimp>("Assimp");
+    menu.RegisterTest<test::TestNoise>("Noise");
+    menu.RegisterTest<test::TestJolt>("Jolt");
+    menu.RegisterTest<test::TestLighting>("Lighting");
+    menu.RegisterTest<test::TestClusteredLighting>("Clustered Lighting");
+    menu.RegisterTest<test::TestParticles>("Particles");
+}
+
 int main(void) {
+    // SPARTAN_HEADLESS=<file.png> renders on the CPU instead, without a window: a fixed scene,
+    // or the test registered as SPARTAN_HEADLESS_TEST (e.g. "Cube")
+    if (const char *headless = std::getenv("SPARTAN_HEADLESS")) {
+        std::function<test::Test *()> createTest;
+        if (const char *name = std::getenv("SPARTAN_HEADLESS_TEST")) {
+            test::Test *current = nullptr;
+            test::TestMenu menu(&current);
+            RegisterTests(menu);
+            createTest = menu.GetFactory(name);
+            if (!createTest) {
+                std::cerr << "No test named " << name << std::endl;
+                return 1;
+            }
+            // The others create GL objects Renderer does not route, they need a context
+            if (!menu.SupportsSoftwareBackend(name)) {
+                std::cerr << "Test " << name << " needs a GL context, headless runs support: "
+                          << menu.GetSoftwareTestNames() << std::endl;
+                return 1;
+            }
+        }
+        return RunHeadless(headless, createTest);
+    }
+
+    auto startupTime = std::chrono::high_resolution_clock::now();
+    bool firstFrame = true;
+
     GLFWwindow *window;
 
     /* Initialize the library */
@@ -83,6 +149,9 @@ int main(void) {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef _DEBUG
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
 
     /* Create a windowed mode window and its OpenGL context */
     window = glfwCreateWindow(1920, 1080, "Hello World", NULL, NULL);
@@ -104,6 +173,9 @@ int main(void) {
 
     std::cout << glGetString(GL_VERSION) << std::endl;
 
+    // Synchronous debug output pins errors to the exact GLCall, at a large cost in speed
+    GLDebugInit(std::getenv("SPARTAN_GL_SYNC_DEBUG") != nullptr);
+
     GLCall(glEnable(GL_BLEND));
     GLCall(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
 
@@ -151,21 +223,37 @@ int main(void) {
     test::TestMenu *testMenu = new test::TestMenu(&currentTest);
     currentTest = testMenu;
 
-    testMenu->RegisterTest<test::TestClearColor>("Clear Color");
-    testMenu->RegisterTest<test::TestTexture2D>("2D Texture");
-    testMenu->RegisterTest<test::TestCube>("Cube");
-    testMenu->RegisterTest<test::TestAssimp>("Assimp");
-    testMenu->RegisterTest<test::TestNoise>("Noise");
-    testMenu->RegisterTest<test::TestJolt>("Jolt");
-    testMenu->RegisterTest<test::TestLighting>("Lighting");
+    RegisterTests(*testMenu);
+
+    // F12 saves a screenshot, F11 starts and stops a sequence. SPARTAN_CAPTURE records from the
+    // first frame, SPARTAN_CAPTURE_FORMAT=raw writes one raw RGBA file instead of PNGs.
+    FrameCapture *capture = new FrameCapture();
+    const char *captureFormat = std::getenv("SPARTAN_CAPTURE_FORMAT");
+    CaptureFormat sequenceFormat = captureFormat && std::string(captureFormat) == "raw"
+        ? CaptureFormat::Raw
+        : CaptureFormat::Png;
+    if (std::getenv("SPARTAN_CAPTURE") != nullptr) {
+        capture->StartSequence(sequenceFormat);
+    }
+
+    // Tests load their textures through it, it has to exist before the first one is created.
+    // SPARTAN_RGBA8_TEXTURES skips block compression, to compare memory and load times.
+    TextureLoader *textureLoader = new TextureLoader(
+        8 * 1024 * 1024, 4, std::getenv("SPARTAN_RGBA8_TEXTURES") == nullptr);
+    // Released textures and meshes stay cached up to these sizes, reopening a test is instant
+    auto *textureCache = new ResourceCache<Texture>(
+        "Textures", 256 * 1024 * 1024, [](const Texture &texture) {
+            return texture.GetMemorySize();
+        });
+    auto *meshCache = new ResourceCache<MeshBuffers>(
+        "Meshes", 64 * 1024 * 1024, [](const MeshBuffers &mesh) { return mesh.GpuBytes; });
 
     auto currentTime = std::chrono::high_resolution_clock::now();
     auto lastUpdateTime = currentTime;
 
-
-    glfwSetWindowSizeCallback(window, [](GLFWwindow* window, int width, int height) {
-        GLCall(glViewport(0, 0, width, height));
-    });
+    // SPARTAN_NO_RENDER_THREAD keeps all GL work on the main thread, e.g. for GL debuggers
+    RenderThread *renderThread
+        = new RenderThread(window, std::getenv("SPARTAN_NO_RENDER_THREAD") == nullptr);
 
     while (!glfwWindowShouldClose(window)) {
         currentTime = std::chrono::high_resolution_clock::now();
@@ -174,36 +262,179 @@ int main(void) {
                               .count();
         lastUpdateTime = currentTime;
 
-        GLCall(glClearColor(0.0f, 0.0f, 0.0f, 1.0f));
-        renderer.Clear();
+        glfwPollEvents();
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
 
-        ImGui_ImplOpenGL3_NewFrame();
+        // Neither touches GL. The render thread only reads the draw data cloned below.
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
+        // Overlaps the render thread drawing the previous frame
         if (currentTest) {
             currentTest->OnUpdate(deltaTime);
-            currentTest->OnRender();
-            ImGui::Begin("Test");
-            if (currentTest != testMenu && ImGui::Button("<-")) {
-                delete currentTest;
-                currentTest = testMenu;
-            }
-            currentTest->OnImGuiRender();
-            ImGui::End();
         }
 
+        bool pipelined = false;
+        renderThread->Sync([&]() {
+            ImGui_ImplOpenGL3_NewFrame();
+
+            if (currentTest) {
+                ImGui::Begin("Test");
+                if (currentTest != testMenu && ImGui::Button("<-")) {
+                    delete currentTest;
+                    currentTest = testMenu;
+                }
+                currentTest->OnImGuiRender();
+                if (capture->IsRecording()) {
+                    const FrameCaptureStats &stats = capture->GetStats();
+                    ImGui::Text("Recording: %u written, %u dropped, %.3f ms/frame (max %.3f), "
+                                "%.1f ms encode",
+                        stats.Written, stats.Dropped, stats.LastMilliseconds,
+                        stats.MaxMilliseconds, stats.EncodeMilliseconds);
+                }
+                if (ImGui::CollapsingHeader("Threads")) {
+                    const RenderThreadStats &stats = renderThread->GetStats();
+                    ImGui::Text("Main: %.2f ms, %.2f ms waiting", stats.MainMilliseconds,
+                        stats.WaitMilliseconds);
+                    ImGui::Text("Render: %.2f ms, %.2f ms idle (%u commands)%s",
+                        stats.RenderMilliseconds, stats.IdleMilliseconds, stats.Commands,
+                        renderThread->IsThreaded() ? "" : ", inline");
+                    ImGui::Text("Sync: %.2f ms, %s", stats.SyncMilliseconds,
+                        pipelined ? "overlapped" : "serial");
+                    const std::vector<float> &main = renderThread->GetMainHistory();
+                    const std::vector<float> &render = renderThread->GetRenderHistory();
+                    ImGui::PlotLines("Main ms", main.data(), (int) main.size(), 0, nullptr, 0.0f,
+                        33.3f);
+                    ImGui::PlotLines("Render ms", render.data(), (int) render.size(), 0, nullptr,
+                        0.0f, 33.3f);
+                }
+                if (ImGui::CollapsingHeader("Resource caches")) {
+                    auto show = [](const auto &cache) {
+                        const ResourceCacheStats &stats = cache.GetStats();
+                        unsigned int requests = stats.Hits + stats.Misses;
+                        ImGui::Text("%s: %u hits, %u misses (%.0f%%), %.1f MB saved",
+                            cache.GetName().c_str(), stats.Hits, stats.Misses,
+                            requests > 0 ? 100.0f * stats.Hits / requests : 0.0f,
+                            stats.SavedBytes / (1024.0f * 1024.0f));
+                        ImGui::Text("  %u entries (%.1f MB), %u retained (%.1f MB), %u evicted",
+                            stats.Entries, stats.Bytes / (1024.0f * 1024.0f), stats.Retained,
+                            stats.RetainedBytes / (1024.0f * 1024.0f), stats.Evictions);
+                    };
+                    show(*textureCache);
+                    show(*meshCache);
+                }
+                if (ImGui::CollapsingHeader("Meshes")) {
+                    const MeshBuilderStats &builder = MeshBuilder::GetStats();
+                    MeshOptimizerStats optimizer = MeshOptimizer::GetStats();
+                    ImGui::Text("%u meshes, %.2f MB (%.2f MB with 32 bit indices, %u use 16)",
+                        builder.Meshes, builder.GpuBytes / (1024.0f * 1024.0f),
+                        builder.WideGpuBytes / (1024.0f * 1024.0f), builder.ShortIndexMeshes);
+                    float triangles = (float) std::max(optimizer.Triangles, 1u);
+                    ImGui::Text("Optimized %u meshes, %u triangles in %.1f ms", optimizer.Meshes,
+                        optimizer.Triangles, optimizer.Milliseconds);
+                    ImGui::Text("ACMR %.3f -> %.3f", optimizer.MissesBefore / triangles,
+                        optimizer.MissesAfter / triangles);
+                    ImGui::Text("Vertex fetch %.2f MB -> %.2f MB (%.2f MB of vertices)",
+                        optimizer.FetchedBytesBefore / (1024.0f * 1024.0f),
+                        optimizer.FetchedBytesAfter / (1024.0f * 1024.0f),
+                        optimizer.VertexBytes / (1024.0f * 1024.0f));
+                }
+                if (ImGui::CollapsingHeader("Texture loading")) {
+                    const TextureLoaderStats &stats = textureLoader->GetStats();
+                    int budget = (int) (textureLoader->GetUploadBudget() / 1024);
+                    if (ImGui::SliderInt("Upload budget (KB/frame)", &budget, 64, 65536)) {
+                        textureLoader->SetUploadBudget((size_t) budget * 1024);
+                    }
+                    ImGui::Text("%u queued, %u decoding, %u uploading, %u loaded, %u failed",
+                        stats.Queued, stats.Decoding, stats.Uploading, stats.Loaded, stats.Failed);
+                    ImGui::Text("Uploaded %.2f MB in %.2f ms, staging %.1f MB",
+                        stats.UploadedBytes / (1024.0f * 1024.0f), stats.UpdateMilliseconds,
+                        stats.StagingBytes / (1024.0f * 1024.0f));
+                    ImGui::Text("Latency %.1f ms (max %.1f)", stats.LastLatencyMilliseconds,
+                        stats.MaxLatencyMilliseconds);
+                    ImGui::Text("Cache: %u hits (%.1f ms), %u cooked (%.1f ms)", stats.CacheHits,
+                        stats.HitMilliseconds, stats.CacheMisses, stats.MissMilliseconds);
+                    ImGui::Text("GPU memory %.1f MB, %.1f MB as RGBA8 without mips",
+                        stats.GpuBytes / (1024.0f * 1024.0f),
+                        stats.Rgba8Bytes / (1024.0f * 1024.0f));
+                }
+                ImGui::End();
+
+                pipelined = currentTest->OnSync();
+            }
+            // After a test switch, what the old test released may be over the budget
+            textureCache->Trim();
+            meshCache->Trim();
+
+            if (ImGui::IsKeyPressed(ImGuiKey_F12, false)) {
+                capture->Screenshot();
+            }
+            if (ImGui::IsKeyPressed(ImGuiKey_F11, false)) {
+                if (capture->IsRecording()) {
+                    capture->StopSequence();
+                } else {
+                    capture->StartSequence(sequenceFormat);
+                }
+            }
+        });
+
         ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        std::shared_ptr<ImDrawData> drawData = CloneDrawData(*ImGui::GetDrawData());
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        test::Test *test = currentTest;
+        renderThread->GetCommandList().Record(
+            [&renderer, test, capture, textureLoader, drawData, window, framebufferWidth,
+                framebufferHeight]() {
+                textureLoader->Update();
+
+                GLCall(glViewport(0, 0, framebufferWidth, framebufferHeight));
+                GLCall(glClearColor(0.0f, 0.0f, 0.0f, 1.0f));
+                renderer.Clear();
+
+                if (test) {
+                    test->OnRender();
+                }
+
+                // Before the UI is drawn, captures only show the scene
+                capture->EndFrame(framebufferWidth, framebufferHeight);
+
+                ImGui_ImplOpenGL3_RenderDrawData(drawData.get());
+                glfwSwapBuffers(window);
+            });
+        renderThread->Submit();
+
+        // The next OnUpdate may only run alongside OnRender if the test copied its state
+        if (!pipelined) {
+            renderThread->Finish();
+        }
+
+        if (firstFrame) {
+            renderThread->Finish();
+            firstFrame = false;
+            const ShaderCacheStats &stats = ShaderCache::GetStats();
+            std::cout << "Startup took "
+                      << std::chrono::duration<float, std::chrono::milliseconds::period>(
+                             std::chrono::high_resolution_clock::now() - startupTime)
+                             .count()
+                      << " ms (" << stats.Hits << " cached shaders, " << stats.Misses
+                      << " compiled)" << std::endl;
+        }
     }
 
+    // Gives the context back to this thread
+    delete renderThread;
+
     if (currentTest != testMenu) {
         delete currentTest;
     }
     delete testMenu;
+    delete meshCache;
+    delete textureCache;
+    delete textureLoader;
+    delete capture;
+
+    GLDumpCallCounters(std::cout, 20);
 
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
@@ -0,0 +1,31 @@
+#shader vertex
+#version 330 core
+
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec2 texCoord;
+
+out vec2 v_TexCoord;
+
+uniform mat4 u_MVP;
+
+void main()
+{
+    gl_Position = u_MVP * position;
+    v_TexCoord = texCoord;
+};
+
+#shader fragment
+#version 330 core
+
+layout(location = 0) out vec4 color;
+
+in vec2 v_TexCoord;
+
+// BasicTexture with the texture as a layer of an array, see TextureArrays
+uniform sampler2DArray u_Textures;
+uniform float u_Layer;
+
+void main()
+{
+    color = texture(u_Textures, vec3(v_TexCoord, u_Layer));
+};
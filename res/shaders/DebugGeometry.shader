@@ -0,0 +1,34 @@
+#shader vertex
+#version 330 core
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 3) in vec4 color;
+layout(location = 4) in mat4 instanceModel;
+layout(location = 8) in vec4 instanceColor;
+
+out vec3 v_Normal;
+out vec4 v_Color;
+
+uniform mat4 u_ViewProj;
+
+void main() {
+    gl_Position = u_ViewProj * instanceModel * vec4(position, 1.0);
+    v_Normal = mat3(instanceModel) * normal;
+    v_Color = color * instanceColor;
+}
+
+#shader fragment
+#version 330 core
+
+layout(location = 0) out vec4 color;
+
+in vec3 v_Normal;
+in vec4 v_Color;
+
+uniform vec3 u_LightDir;
+
+void main() {
+    float diffuse = max(dot(normalize(v_Normal), -normalize(u_LightDir)), 0.0);
+    color = vec4(v_Color.rgb * (0.35 + 0.65 * diffuse), v_Color.a);
+}
@@ -0,0 +1,116 @@
+#shader vertex
+#version 330 core
+
+#include "include/Octahedral.glsl"
+
+// World position of the object space origin, rotation around y
+layout(location = 0) in vec4 instance;
+
+out vec3 v_World;
+out vec3 v_ToCamera;
+out vec2 v_TexCoord[4];
+out vec4 v_Weights;
+
+uniform mat4 u_View;
+uniform mat4 u_Proj;
+uniform vec3 u_CameraPos;
+// Bounding sphere in object space
+uniform vec3 u_Center;
+uniform float u_Radius;
+// Object space to world units
+uniform float u_Scale;
+uniform float u_Frames;
+
+vec3 RotateY(vec3 v, float angle) {
+    float c = cos(angle);
+    float s = sin(angle);
+    return vec3(c * v.x + s * v.z, v.y, c * v.z - s * v.x);
+}
+
+// Image plane of a view looking back along direction, same as glm::lookAt in Impostor.cpp
+void ViewBasis(vec3 direction, out vec3 right, out vec3 up) {
+    vec3 worldUp = abs(direction.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    right = normalize(cross(worldUp, direction));
+    up = cross(direction, right);
+}
+
+void main() {
+    // Triangle strip from the vertex index, there is no vertex buffer
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+
+    float yaw = instance.w;
+    float radius = u_Radius * u_Scale;
+    vec3 center = instance.xyz + RotateY(u_Center * u_Scale, yaw);
+    vec3 toCamera = normalize(u_CameraPos - center);
+    vec3 right, up;
+    ViewBasis(toCamera, right, up);
+    vec3 offset = (right * corner.x + up * corner.y) * radius;
+
+    v_World = center + offset;
+    v_ToCamera = toCamera * radius;
+    gl_Position = u_Proj * u_View * vec4(v_World, 1.0);
+
+    // Blend the four views around the camera direction on the octahedral grid
+    vec3 direction = RotateY(toCamera, -yaw);
+    vec3 local = RotateY(offset, -yaw) / radius;
+    vec2 grid = (OctahedralEncode(direction) * 0.5 + 0.5) * (u_Frames - 1.0);
+    vec2 cell = min(floor(grid), vec2(u_Frames - 2.0));
+    vec2 f = grid - cell;
+    v_Weights = vec4((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y), (1.0 - f.x) * f.y, f.x * f.y);
+    for (int i = 0; i < 4; i++) {
+        vec2 frame = cell + vec2(i & 1, i >> 1);
+        vec3 frameRight, frameUp;
+        ViewBasis(OctahedralDecode(frame / (u_Frames - 1.0) * 2.0 - 1.0), frameRight, frameUp);
+        // The quad's point projected into that view, the model never reaches past a frame
+        vec2 uv = vec2(dot(local, frameRight), dot(local, frameUp)) * 0.5 + 0.5;
+        v_TexCoord[i] = (frame + clamp(uv, 0.0, 1.0)) / u_Frames;
+    }
+}
+
+#shader fragment
+#version 330 core
+
+layout(location = 0) out vec4 color;
+
+in vec3 v_World;
+in vec3 v_ToCamera;
+in vec2 v_TexCoord[4];
+in vec4 v_Weights;
+
+uniform mat4 u_View;
+uniform mat4 u_Proj;
+uniform sampler2D u_Albedo;
+uniform sampler2D u_NormalDepth;
+// 0 albedo, 1 normal, 2 depth
+uniform int u_Mode;
+
+void main() {
+    vec3 albedo = vec3(0.0);
+    vec4 normalDepth = vec4(0.0);
+    float coverage = 0.0;
+    for (int i = 0; i < 4; i++) {
+        vec4 texel = texture(u_Albedo, v_TexCoord[i]);
+        float weight = v_Weights[i] * texel.a;
+        albedo += texel.rgb * weight;
+        normalDepth += texture(u_NormalDepth, v_TexCoord[i]) * weight;
+        coverage += weight;
+    }
+    if (coverage < 0.5) {
+        discard;
+    }
+    albedo /= coverage;
+    normalDepth /= coverage;
+
+    // Baked depth 0 is the near side of the bounding sphere, 0.5 its center
+    vec3 world = v_World + v_ToCamera * (1.0 - 2.0 * normalDepth.a);
+    vec4 clip = u_Proj * u_View * vec4(world, 1.0);
+    gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+
+    if (u_Mode == 1) {
+        color = vec4(normalDepth.rgb, 1.0);
+    } else if (u_Mode == 2) {
+        color = vec4(vec3(normalDepth.a), 1.0);
+    } else {
+        color = vec4(albedo, 1.0);
+    }
+}
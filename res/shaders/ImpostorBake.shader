@@ -0,0 +1,43 @@
+#shader vertex
+#version 330 core
+
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec2 texCoord;
+
+out vec3 v_Position;
+out vec2 v_TexCoord;
+
+// Part of the model to its object space
+uniform mat4 u_Model;
+uniform mat4 u_ViewProj;
+
+void main() {
+    vec4 objectPosition = u_Model * position;
+    v_Position = objectPosition.xyz;
+    v_TexCoord = texCoord;
+    gl_Position = u_ViewProj * objectPosition;
+}
+
+#shader fragment
+#version 330 core
+
+layout(location = 0) out vec4 albedo;
+layout(location = 1) out vec4 normalDepth;
+
+in vec3 v_Position;
+in vec2 v_TexCoord;
+
+uniform sampler2D u_Texture;
+// Object space direction towards the bake camera
+uniform vec3 u_ViewDir;
+
+void main() {
+    // Imported meshes have no normals, the faceted one is plenty at impostor distances
+    vec3 normal = normalize(cross(dFdx(v_Position), dFdy(v_Position)));
+    if (dot(normal, u_ViewDir) < 0.0) {
+        normal = -normal;
+    }
+    albedo = vec4(texture(u_Texture, v_TexCoord).rgb, 1.0);
+    // The orthographic depth is linear across the bounding sphere
+    normalDepth = vec4(normal * 0.5 + 0.5, gl_FragCoord.z);
+}
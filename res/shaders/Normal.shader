@@ -21,10 +21,9 @@ layout(location = 0) out vec4 color;
 
 in vec3 v_Normal;
 
+#include "include/NormalColor.glsl"
+
 void main() {
-    color.rgb = abs(v_Normal);
-    vec3 ones = vec3(1, 1, 1);
-    if (dot(v_Normal, ones) < 0.0)
-        color.rgb = ones - color.rgb;
+    color.rgb = NormalColor(v_Normal);
     color.a = 1.0;
 }
\ No newline at end of file
@@ -0,0 +1,46 @@
+#shader vertex
+#version 330 core
+
+// World position, age / lifetime
+layout(location = 0) in vec4 instance;
+
+out vec2 v_Corner;
+out vec4 v_Color;
+
+uniform mat4 u_View;
+uniform mat4 u_Proj;
+// At birth and at death
+uniform vec2 u_Size;
+uniform vec4 u_StartColor;
+uniform vec4 u_EndColor;
+
+void main() {
+    // Triangle strip from the vertex index, there is no vertex buffer
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+
+    // The camera's right and up vectors are the first two rows of the view matrix
+    vec3 right = vec3(u_View[0][0], u_View[1][0], u_View[2][0]);
+    vec3 up = vec3(u_View[0][1], u_View[1][1], u_View[2][1]);
+    float size = mix(u_Size.x, u_Size.y, instance.w) * 0.5;
+    vec3 world = instance.xyz + (right * corner.x + up * corner.y) * size;
+
+    v_Corner = corner;
+    v_Color = mix(u_StartColor, u_EndColor, instance.w);
+    gl_Position = u_Proj * u_View * vec4(world, 1.0);
+}
+
+#shader fragment
+#version 330 core
+
+layout(location = 0) out vec4 color;
+
+in vec2 v_Corner;
+in vec4 v_Color;
+
+void main() {
+    // Round and soft towards the edge
+    float r2 = dot(v_Corner, v_Corner);
+    if (r2 > 1.0)
+        discard;
+    color = vec4(v_Color.rgb, v_Color.a * (1.0 - r2));
+}
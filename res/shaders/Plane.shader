@@ -2,7 +2,7 @@
 #version 330 core
 
 layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 normal;
+layout(location = 1) in vec2 normal; // Octahedral, see OctahedralDecode
 layout(location = 2) in vec2 texCoord;
 layout(location = 3) in vec3 color;
 
@@ -10,6 +10,8 @@ out vec3 v_Color;
 
 uniform mat4 u_MVP;
 
+#include "include/Octahedral.glsl"
+
 void main() {
     gl_Position = u_MVP * vec4(position, 1.0);
     v_Color = color;
@@ -0,0 +1,28 @@
+#features instanced
+
+#shader vertex
+#version 330 core
+
+layout(location = 0) in vec3 position;
+#ifdef FEATURE_INSTANCED
+layout(location = 4) in mat4 instanceModel;
+
+uniform mat4 u_ViewProj;
+#else
+uniform mat4 u_MVP;
+#endif
+
+void main() {
+#ifdef FEATURE_INSTANCED
+    gl_Position = u_ViewProj * instanceModel * vec4(position, 1.0);
+#else
+    gl_Position = u_MVP * vec4(position, 1.0);
+#endif
+}
+
+#shader fragment
+#version 330 core
+
+// Depth only
+void main() {
+}
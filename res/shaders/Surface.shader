@@ -0,0 +1,157 @@
+#features textured lit instanced skinned shadowed clustered
+
+#shader vertex
+#version 330 core
+
+// Shadows and clustered lights are only defined for the lit path
+#if (defined(FEATURE_SHADOWED) || defined(FEATURE_CLUSTERED)) && !defined(FEATURE_LIT)
+#define FEATURE_LIT
+#endif
+#if defined(FEATURE_SHADOWED) || defined(FEATURE_CLUSTERED)
+#define VIEW_DEPTH
+#endif
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 texCoord;
+#ifdef FEATURE_INSTANCED
+layout(location = 4) in mat4 instanceModel;
+#endif
+#ifdef FEATURE_SKINNED
+layout(location = 8) in vec4 boneIds;
+layout(location = 9) in vec4 boneWeights;
+#endif
+
+out vec3 v_Color;
+#ifdef FEATURE_TEXTURED
+out vec2 v_TexCoord;
+#endif
+#ifdef FEATURE_LIT
+out vec3 v_Pos;
+out vec3 v_Normal;
+#endif
+#ifdef VIEW_DEPTH
+out float v_ViewDepth;
+
+uniform mat4 u_View;
+#endif
+
+#ifdef FEATURE_INSTANCED
+uniform mat4 u_ViewProj;
+#else
+uniform mat4 u_MVP;
+#ifdef FEATURE_LIT
+uniform mat4 u_Model;
+#endif
+#endif
+#ifdef FEATURE_SKINNED
+#define MAX_BONES 64
+uniform mat4 u_Bones[MAX_BONES];
+#endif
+
+#include "include/NormalColor.glsl"
+
+void main() {
+    vec4 localPos = vec4(position, 1.0);
+    vec3 localNormal = normal;
+
+#ifdef FEATURE_SKINNED
+    mat4 skin = boneWeights.x * u_Bones[int(boneIds.x)]
+              + boneWeights.y * u_Bones[int(boneIds.y)]
+              + boneWeights.z * u_Bones[int(boneIds.z)]
+              + boneWeights.w * u_Bones[int(boneIds.w)];
+    localPos = skin * localPos;
+    localNormal = mat3(skin) * localNormal;
+#endif
+
+#ifdef FEATURE_INSTANCED
+    mat4 model = instanceModel;
+    gl_Position = u_ViewProj * model * localPos;
+#else
+    gl_Position = u_MVP * localPos;
+#ifdef FEATURE_LIT
+    mat4 model = u_Model;
+#endif
+#endif
+
+#ifdef FEATURE_LIT
+    v_Pos = vec3(model * localPos);
+    v_Normal = mat3(model) * localNormal;
+#endif
+#ifdef VIEW_DEPTH
+    v_ViewDepth = -(u_View * vec4(v_Pos, 1.0)).z;
+#endif
+#ifdef FEATURE_TEXTURED
+    v_TexCoord = texCoord;
+#endif
+    v_Color = NormalColor(localNormal);
+}
+
+#shader fragment
+#version 330 core
+
+// Shadows and clustered lights are only defined for the lit path
+#if (defined(FEATURE_SHADOWED) || defined(FEATURE_CLUSTERED)) && !defined(FEATURE_LIT)
+#define FEATURE_LIT
+#endif
+#if defined(FEATURE_SHADOWED) || defined(FEATURE_CLUSTERED)
+#define VIEW_DEPTH
+#endif
+
+layout(location = 0) out vec4 color;
+
+in vec3 v_Color;
+#ifdef FEATURE_TEXTURED
+in vec2 v_TexCoord;
+
+uniform sampler2D u_Texture;
+#endif
+#ifdef FEATURE_LIT
+in vec3 v_Pos;
+in vec3 v_Normal;
+
+uniform vec3 u_LightColor;
+uniform vec3 u_ViewPos;
+#ifdef VIEW_DEPTH
+in float v_ViewDepth;
+#endif
+#ifdef FEATURE_CLUSTERED
+#include "include/Clustered.glsl"
+#endif
+#ifdef FEATURE_SHADOWED
+uniform vec3 u_LightDir;
+
+#include "include/Shadows.glsl"
+#else
+uniform vec3 u_LightPos;
+#endif
+
+#include "include/Phong.glsl"
+#endif
+
+void main() {
+#ifdef FEATURE_TEXTURED
+    vec4 base = texture(u_Texture, v_TexCoord);
+#else
+    vec4 base = vec4(v_Color, 1.0);
+#endif
+
+#if defined(FEATURE_SHADOWED)
+    float shadow = ShadowFactor(v_Pos, v_Normal, u_LightDir, v_ViewDepth);
+    vec3 lighting
+        = PhongDirectional(v_Normal, v_Pos, u_ViewPos, u_LightDir, u_LightColor, shadow);
+#elif defined(FEATURE_CLUSTERED)
+    // The point lights replace the single light, keep a little ambient
+    vec3 lighting = 0.05 * u_LightColor;
+#elif defined(FEATURE_LIT)
+    vec3 lighting = Phong(v_Normal, v_Pos, u_ViewPos, u_LightPos, u_LightColor);
+#endif
+#ifdef FEATURE_CLUSTERED
+    lighting += ClusteredLighting(v_Normal, v_Pos, u_ViewPos, v_ViewDepth);
+#endif
+#ifdef FEATURE_LIT
+    base.rgb *= lighting;
+#endif
+
+    color = base;
+}
\ No newline at end of file
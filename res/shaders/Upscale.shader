@@ -0,0 +1,53 @@
+#shader vertex
+#version 330 core
+
+out vec2 v_TexCoord;
+
+void main() {
+    // Fullscreen triangle from the vertex index, there is no vertex buffer
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    v_TexCoord = position;
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
+
+#shader fragment
+#version 330 core
+
+layout(location = 0) out vec4 color;
+
+in vec2 v_TexCoord;
+
+uniform sampler2D u_Scene;
+// Pixels of u_Scene covered by the scaled render, starting at the lower left corner
+uniform vec2 u_RenderSize;
+uniform float u_Sharpness;
+
+vec3 Fetch(vec2 pixel) {
+    // Stay half a texel inside the rendered area so filtering never picks up stale pixels
+    pixel = clamp(pixel, vec2(0.5), u_RenderSize - 0.5);
+    return texture(u_Scene, pixel / vec2(textureSize(u_Scene, 0))).rgb;
+}
+
+void main() {
+    vec2 pixel = v_TexCoord * u_RenderSize;
+    vec3 c = Fetch(pixel);
+    if (u_Sharpness <= 0.0) {
+        color = vec4(c, 1.0);
+        return;
+    }
+
+    // Contrast adaptive sharpening: a negative lobe on the cross neighbours, weakened where
+    // the neighbourhood is already close to black or white so edges don't ring
+    vec3 n = Fetch(pixel + vec2(0.0, 1.0));
+    vec3 s = Fetch(pixel - vec2(0.0, 1.0));
+    vec3 e = Fetch(pixel + vec2(1.0, 0.0));
+    vec3 w = Fetch(pixel - vec2(1.0, 0.0));
+
+    vec3 lowest = min(c, min(min(n, s), min(e, w)));
+    vec3 highest = max(c, max(max(n, s), max(e, w)));
+    vec3 amplitude = sqrt(clamp(min(lowest, 1.0 - highest) / max(highest, 1e-4), 0.0, 1.0));
+    vec3 weight = -amplitude * mix(0.125, 0.2, u_Sharpness);
+
+    vec3 sharpened = (c + (n + s + e + w) * weight) / (1.0 + 4.0 * weight);
+    color = vec4(clamp(sharpened, 0.0, 1.0), 1.0);
+}
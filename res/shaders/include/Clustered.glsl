@@ -0,0 +1,37 @@
+// Point lights binned by ClusteredLighting, uniforms are set by ClusteredLighting::SetUniforms
+uniform samplerBuffer u_Lights;
+uniform usamplerBuffer u_ClusterGrid;
+uniform usamplerBuffer u_LightIndices;
+uniform vec3 u_ClusterDims;
+// Tile size in pixels (xy), depth slice scale and bias (zw)
+uniform vec4 u_ClusterParams;
+
+// Diffuse + specular of the lights whose cluster contains this fragment
+vec3 ClusteredLighting(vec3 normal, vec3 position, vec3 viewPos, float viewDepth) {
+    ivec3 dims = ivec3(u_ClusterDims);
+    ivec2 tile = ivec2(gl_FragCoord.xy / u_ClusterParams.xy);
+    int slice = int(max(log(viewDepth) * u_ClusterParams.z + u_ClusterParams.w, 0.0));
+    ivec3 cluster = min(ivec3(tile, slice), dims - 1);
+    uvec2 range = texelFetch(u_ClusterGrid, cluster.x + dims.x * (cluster.y + dims.y * cluster.z)).xy;
+
+    vec3 norm = normalize(normal);
+    vec3 viewDir = normalize(viewPos - position);
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++) {
+        int light = int(texelFetch(u_LightIndices, int(range.x + i)).x);
+        vec4 positionRadius = texelFetch(u_Lights, light * 2);
+        vec3 color = texelFetch(u_Lights, light * 2 + 1).rgb;
+
+        vec3 toLight = positionRadius.xyz - position;
+        float distance = length(toLight);
+        // Smooth falloff that reaches zero at the radius the light was binned with
+        float falloff = clamp(1.0 - distance / positionRadius.w, 0.0, 1.0);
+        falloff *= falloff;
+
+        vec3 lightDir = toLight / max(distance, 1e-4);
+        float diff = max(dot(norm, lightDir), 0.0);
+        float spec = pow(max(dot(viewDir, reflect(-lightDir, norm)), 0.0), 32);
+        result += falloff * (diff + 0.5 * spec) * color;
+    }
+    return result;
+}
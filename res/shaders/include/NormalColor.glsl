@@ -0,0 +1,8 @@
+// Debug colouring from an object space normal, shared by the untextured shaders
+vec3 NormalColor(vec3 normal) {
+    vec3 color = abs(normal);
+    vec3 ones = vec3(1, 1, 1);
+    if (dot(normal, ones) < 0.0)
+        color = ones - color;
+    return color;
+}
@@ -0,0 +1,41 @@
+// Ambient + diffuse + specular contribution of a single point light
+vec3 Phong(vec3 normal, vec3 position, vec3 viewPos, vec3 lightPos, vec3 lightColor) {
+    // Ambient
+    float ambientStrength = 0.1;
+    vec3 ambient = ambientStrength * lightColor;
+
+    // Diffuse
+    vec3 norm = normalize(normal);
+    vec3 lightDir = normalize(lightPos - position);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = diff * lightColor;
+
+    // Specular
+    float specularStrength = 0.5;
+    vec3 viewDir = normalize(viewPos - position);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+    vec3 specular = specularStrength * spec * lightColor;
+
+    return ambient + diffuse + specular;
+}
+
+// Same model for a directional light, shadow scales everything but the ambient term
+vec3 PhongDirectional(
+    vec3 normal, vec3 position, vec3 viewPos, vec3 lightDirection, vec3 lightColor, float shadow) {
+    float ambientStrength = 0.1;
+    vec3 ambient = ambientStrength * lightColor;
+
+    vec3 norm = normalize(normal);
+    vec3 lightDir = normalize(-lightDirection);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = diff * lightColor;
+
+    float specularStrength = 0.5;
+    vec3 viewDir = normalize(viewPos - position);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+    vec3 specular = specularStrength * spec * lightColor;
+
+    return ambient + shadow * (diffuse + specular);
+}
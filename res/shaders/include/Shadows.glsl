@@ -0,0 +1,71 @@
+// Cascaded shadow lookup, uniforms are set by CascadedShadowMap::SetUniforms
+#define MAX_CASCADES 4
+
+uniform sampler2DArrayShadow u_ShadowMap;
+uniform mat4 u_CascadeMatrices[MAX_CASCADES];
+// View space far distance of each cascade
+uniform vec4 u_CascadeSplits;
+// World space size of one shadow map texel in each cascade
+uniform vec4 u_CascadeTexelSizes;
+uniform int u_CascadeCount;
+// The static casters, in one map over their bounds
+uniform sampler2DShadow u_StaticShadowMap;
+uniform mat4 u_StaticMatrix;
+uniform float u_StaticTexelSize;
+
+// 3x3 PCF of the static map, 1 outside of it
+float StaticShadowFactor(vec3 worldPos, vec3 norm, float slope) {
+    vec3 offsetPos = worldPos + norm * u_StaticTexelSize * (1.0 + 2.0 * slope);
+    vec4 lightPos = u_StaticMatrix * vec4(offsetPos, 1.0);
+    vec3 coords = lightPos.xyz / lightPos.w * 0.5 + 0.5;
+    if (any(lessThan(coords, vec3(0.0))) || any(greaterThan(coords, vec3(1.0)))) {
+        return 1.0;
+    }
+
+    vec2 texelSize = 1.0 / vec2(textureSize(u_StaticShadowMap, 0));
+    float lit = 0.0;
+    for (int x = -1; x <= 1; x++) {
+        for (int y = -1; y <= 1; y++) {
+            vec2 uv = coords.xy + vec2(x, y) * texelSize;
+            lit += texture(u_StaticShadowMap, vec3(uv, coords.z));
+        }
+    }
+    return lit / 9.0;
+}
+
+// 1 when fully lit, 0 when fully in shadow
+float ShadowFactor(vec3 worldPos, vec3 normal, vec3 lightDirection, float viewDepth) {
+    int cascade = u_CascadeCount - 1;
+    for (int i = 0; i < u_CascadeCount; i++) {
+        if (viewDepth < u_CascadeSplits[i]) {
+            cascade = i;
+            break;
+        }
+    }
+    if (viewDepth > u_CascadeSplits[u_CascadeCount - 1]) {
+        return 1.0;
+    }
+
+    // Push the lookup along the normal, more so at grazing angles and in wider cascades
+    vec3 norm = normalize(normal);
+    float slope = 1.0 - max(dot(norm, -normalize(lightDirection)), 0.0);
+    vec2 texelSize = 1.0 / vec2(textureSize(u_ShadowMap, 0).xy);
+    vec3 offsetPos = worldPos + norm * u_CascadeTexelSizes[cascade] * (1.0 + 2.0 * slope);
+
+    vec4 lightPos = u_CascadeMatrices[cascade] * vec4(offsetPos, 1.0);
+    vec3 coords = lightPos.xyz / lightPos.w * 0.5 + 0.5;
+    float staticLit = StaticShadowFactor(worldPos, norm, slope);
+    if (coords.z > 1.0) {
+        return staticLit;
+    }
+
+    // 3x3 PCF on top of the hardware 2x2 comparison filter
+    float lit = 0.0;
+    for (int x = -1; x <= 1; x++) {
+        for (int y = -1; y <= 1; y++) {
+            vec2 uv = coords.xy + vec2(x, y) * texelSize;
+            lit += texture(u_ShadowMap, vec4(uv, float(cascade), coords.z));
+        }
+    }
+    return min(lit / 9.0, staticLit);
+}